@@ -14,6 +14,7 @@
  * For more details, see http://www.mrtrix.org/.
  */
 
+#include <algorithm>
 #include <sstream>
 #include <string>
 
@@ -90,7 +91,11 @@ void usage() {
     " (most typically there will be two entries per streamline,"
     " one for each endpoint;"
     " but this is not strictly a requirement)."
-    " This file will most typically be generated using the tck2connectome command with the -out_assignments option.";
+    " This file will most typically be generated using the tck2connectome command with the -out_assignments option."
+
+  + "If the -nodes option is used, and the index of streamline offsets of the input track file"
+    " is available (as generated by the tckindex command),"
+    " then only those streamlines assigned to at least one node of interest are read from the track file.";
 
   EXAMPLES
   + Example ("Default usage",
@@ -422,19 +427,50 @@ void run() {
     }
 
     ProgressBar progress("Extracting tracks from connectome", count);
+
+    // If only a subset of nodes is of interest, and an up-to-date index of streamline offsets
+    //   is stored alongside the track file (as generated by tckindex),
+    //   only those streamlines assigned to at least one of these nodes need to be read
+    const bool selective = manual_node_list && reader.load_index() && reader.num_streamlines() == count;
+    auto of_interest = [&](const node_t node) { return std::binary_search(nodes.begin(), nodes.end(), node); };
+    auto extract_selected = [&](auto &tck, const auto &assignments, auto &&is_candidate) {
+      for (size_t index = 0; index != count; ++index) {
+        if (is_candidate(assignments[index])) {
+          reader.read(index, tck);
+          tck.set_nodes(assignments[index]);
+          writer(tck);
+        } else {
+          writer.skip();
+        }
+        ++progress;
+      }
+    };
+
     if (assignments_pairs.empty()) {
       Tractography::Connectome::Streamline_nodelist tck;
-      while (reader(tck)) {
-        tck.set_nodes(assignments_lists[tck.get_index()]);
-        writer(tck);
-        ++progress;
+      if (selective) {
+        extract_selected(tck, assignments_lists, [&](const std::vector<node_t> &list) {
+          return std::any_of(list.begin(), list.end(), of_interest);
+        });
+      } else {
+        while (reader(tck)) {
+          tck.set_nodes(assignments_lists[tck.get_index()]);
+          writer(tck);
+          ++progress;
+        }
       }
     } else {
       Tractography::Connectome::Streamline_nodepair tck;
-      while (reader(tck)) {
-        tck.set_nodes(assignments_pairs[tck.get_index()]);
-        writer(tck);
-        ++progress;
+      if (selective) {
+        extract_selected(tck, assignments_pairs, [&](const NodePair &pair) {
+          return of_interest(pair.first) || of_interest(pair.second);
+        });
+      } else {
+        while (reader(tck)) {
+          tck.set_nodes(assignments_pairs[tck.get_index()]);
+          writer(tck);
+          ++progress;
+        }
       }
     }
   }
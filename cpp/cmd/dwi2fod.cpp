@@ -14,6 +14,7 @@
  * For more details, see http://www.mrtrix.org/.
  */
 
+#include "algo/masked_threaded_loop.h"
 #include "algo/threaded_loop.h"
 #include "command.h"
 #include "dwi/gradient.h"
@@ -308,11 +309,13 @@ void run() {
 
     MSMT_Processor processor(shared, mask, odfs, dwi_modelled);
     auto dwi = header_in.get_image<float>().with_direct_io(3);
-    ThreadedLoop("performing MSMT CSD (" + str(shared.num_shells()) + " shell" + (shared.num_shells() > 1 ? "s" : "") +
-                     ", " + str(num_tissues) + " tissue" + (num_tissues > 1 ? "s" : "") + ")",
-                 dwi,
-                 0,
-                 3)
+    MaskedThreadedLoop("performing MSMT CSD (" + str(shared.num_shells()) + " shell" +
+                           (shared.num_shells() > 1 ? "s" : "") + ", " + str(num_tissues) + " tissue" +
+                           (num_tissues > 1 ? "s" : "") + ")",
+                       dwi,
+                       mask,
+                       0,
+                       3)
         .run(processor, dwi);
 
   } else {
@@ -14,6 +14,7 @@
  * For more details, see http://www.mrtrix.org/.
  */
 
+#include "algo/masked_threaded_loop.h"
 #include "algo/threaded_copy.h"
 #include "command.h"
 #include "dwi/directions/predefined.h"
@@ -346,5 +347,6 @@ void run() {
     }
   }
 
-  ThreadedLoop("computing tensors", dwi, 0, 3).run(processor(A, Aneq, ols, iter, mask, b0, dt, dkt, predict), dwi);
+  MaskedThreadedLoop("computing tensors", dwi, mask, 0, 3)
+      .run(processor(A, Aneq, ols, iter, mask, b0, dt, dkt, predict), dwi);
 }
@@ -152,6 +152,10 @@ void usage() {
 
   + Option ("cfe_legacy", "use the legacy (non-normalised) form of the cfe equation")
 
+  + Option ("cfe_quantise", "store the fixel-fixel connectivity values in RAM using 16 bits rather than 32;"
+                            " this reduces memory usage, at the expense of a small loss of precision"
+                            " in the enhanced statistics")
+
   + Math::Stats::GLM::glm_options ("fixel");
 
 }
@@ -211,6 +215,7 @@ void run() {
   const value_type cfe_e = get_option_value("cfe_e", DEFAULT_CFE_E);
   const value_type cfe_c = get_option_value("cfe_c", DEFAULT_CFE_C);
   const bool cfe_legacy = !get_options("cfe_legacy").empty();
+  const bool cfe_quantise = !get_options("cfe_quantise").empty();
 
   const bool do_nonstationarity_adjustment = !get_options("nonstationarity").empty();
   const default_type empirical_skew = get_option_value("skew_nonstationarity", DEFAULT_EMPIRICAL_SKEW);
@@ -445,7 +450,8 @@ void run() {
   }
 
   // Construct the class for performing fixel-based statistical enhancement
-  std::shared_ptr<Stats::EnhancerBase> cfe_integrator(new Stats::CFE(matrix, cfe_dh, cfe_e, cfe_h, cfe_c, !cfe_legacy));
+  std::shared_ptr<Stats::EnhancerBase> cfe_integrator(
+      new Stats::CFE(matrix, cfe_dh, cfe_e, cfe_h, cfe_c, !cfe_legacy, cfe_quantise));
 
   // If performing non-stationarity adjustment we need to pre-compute the empirical CFE statistic
   matrix_type empirical_cfe_statistic;
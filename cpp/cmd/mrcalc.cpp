@@ -314,20 +314,26 @@ UNARY_OP(
   Main program
  **********************************************************************/
 
+#include "adapter/subset.h"
+#include "algo/copy.h"
 #include "algo/threaded_copy.h"
 #include "command.h"
 #include "dwi/gradient.h"
 #include "image.h"
+#include "image_io/slab_reader.h"
 #include "math/rng.h"
 #include "memory.h"
 #include "phase_encoding.h"
+#include "thread_queue.h"
 
 using namespace MR;
 using namespace App;
 
 using real_type = float;
 using complex_type = cfloat;
+using SlabReader = ImageIO::SlabReader<complex_type>;
 static bool transform_mis_match_reported(false);
+static size_t max_memory(0);
 
 inline bool is_true(const complex_type &z) { return z.real() || z.imag(); }
 
@@ -372,7 +378,18 @@ void usage() {
     " 'rand' (random number between 0 and 1);"
     " 'randn' (random number from unit std.dev. normal distribution);"
     " 'e' (Euler's number);"
-    " 'pi' (ratio of circumference of circle to diameter)";
+    " 'pi' (ratio of circumference of circle to diameter)"
+
+  + "If the -max_memory option is provided,"
+    " the input images are read in slabs of consecutive slices along the z axis,"
+    " with each slab being processed and written to the output"
+    " while the next ones are being read in,"
+    " rather than being accessed in their entirety."
+    " The thickness of the slabs is chosen such that"
+    " the total amount of image data held in memory"
+    " stays approximately within the limit specified."
+    " Images of unit size along the z axis are still loaded in their entirety."
+    " The output is identical to that obtained without this option.";
 
 EXAMPLES
   + Example ("Double the value stored in every voxel",
@@ -410,6 +427,12 @@ OPTIONS
 #define SECTION 1
 #include "mrcalc.cpp"
 
+  + OptionGroup ("Out-of-core processing options")
+  + Option ("max_memory", "process the images in slabs of consecutive slices,"
+                          " holding approximately no more than this amount of image data"
+                          " (in MB) in memory at any one time (see Description).")
+    + Argument ("size").type_integer (1)
+
   + DataType::options();
 }
 // clang-format on
@@ -471,10 +494,15 @@ class ThreadLocalStorage : public std::vector<ThreadLocalStorageItem> {
   size_t current;
 };
 
+// the slabs of each input image read in slabs, for the slab currently being processed:
+using SlabImages = std::map<const SlabReader *, Image<complex_type>>;
+
 class LoadedImage {
 public:
   LoadedImage(std::shared_ptr<Image<complex_type>> &i, const bool c) : image(i), image_is_complex(c) {}
+  LoadedImage(std::shared_ptr<SlabReader> &r, const bool c) : reader(r), image_is_complex(c) {}
   std::shared_ptr<Image<complex_type>> image;
+  std::shared_ptr<SlabReader> reader;
   bool image_is_complex;
 };
 
@@ -491,13 +519,19 @@ class StackEntry {
     if (search != image_list.end()) {
       DEBUG(std::string("image \"") + arg + "\" already loaded - re-using exising image");
       image = search->second.image;
+      reader = search->second.reader;
       image_is_complex = search->second.image_is_complex;
     } else {
       try {
         auto header = Header::open(arg);
         image_is_complex = header.datatype().is_complex();
-        image.reset(new Image<complex_type>(header.get_image<complex_type>()));
-        image_list.insert(std::make_pair(arg, LoadedImage(image, image_is_complex)));
+        if (max_memory && header.ndim() > 2 && header.size(2) > 1) {
+          reader.reset(new SlabReader(std::move(header)));
+          image_list.insert(std::make_pair(arg, LoadedImage(reader, image_is_complex)));
+        } else {
+          image.reset(new Image<complex_type>(header.get_image<complex_type>()));
+          image_list.insert(std::make_pair(arg, LoadedImage(image, image_is_complex)));
+        }
       } catch (Exception &e_image) {
         try {
           std::string a = lowercase(arg);
@@ -535,11 +569,14 @@ class StackEntry {
   std::string arg;
   std::shared_ptr<Evaluator> evaluator;
   std::shared_ptr<Image<complex_type>> image;
+  std::shared_ptr<SlabReader> reader;
   copy_ptr<Math::RNG> rng;
   complex_type value;
   bool rng_gaussian;
   bool image_is_complex;
 
+  bool is_image() const { return image || reader; }
+  Header image_header() const { return reader ? reader->header() : Header(*image); }
   bool is_complex() const;
 
   static std::map<std::string, LoadedImage> image_list;
@@ -595,7 +632,7 @@ class Evaluator {
 };
 
 inline bool StackEntry::is_complex() const {
-  if (image)
+  if (is_image())
     return image_is_complex;
   if (evaluator)
     return evaluator->is_complex();
@@ -642,8 +679,8 @@ inline void replace(std::string &orig, size_t n, const std::string &value) {
 // get evaluated there and then and so get left out if the string is created
 // later:
 std::string operation_string(const StackEntry &entry) {
-  if (entry.image)
-    return entry.image->name();
+  if (entry.is_image())
+    return entry.image_header().name();
   else if (entry.rng)
     return entry.rng_gaussian ? "randn()" : "rand()";
   else if (entry.evaluator) {
@@ -735,7 +772,7 @@ void unary_operation(const std::string &operation_name, std::vector<StackEntry>
     throw Exception("no operand in stack for operation \"" + operation_name + "\"!");
   StackEntry &a(stack[stack.size() - 1]);
   a.load();
-  if (a.evaluator || a.image || a.rng) {
+  if (a.evaluator || a.is_image() || a.rng) {
     StackEntry entry(new UnaryEvaluator<Operation>(operation_name, operation, a));
     stack.back() = entry;
   } else {
@@ -755,7 +792,7 @@ void binary_operation(const std::string &operation_name, std::vector<StackEntry>
   StackEntry &b(stack[stack.size() - 1]);
   a.load();
   b.load();
-  if (a.evaluator || a.image || a.rng || b.evaluator || b.image || b.rng) {
+  if (a.evaluator || a.is_image() || a.rng || b.evaluator || b.is_image() || b.rng) {
     StackEntry entry(new BinaryEvaluator<Operation>(operation_name, operation, a, b));
     stack.pop_back();
     stack.back() = entry;
@@ -776,7 +813,8 @@ void ternary_operation(const std::string &operation_name, std::vector<StackEntry
   a.load();
   b.load();
   c.load();
-  if (a.evaluator || a.image || a.rng || b.evaluator || b.image || b.rng || c.evaluator || c.image || c.rng) {
+  if (a.evaluator || a.is_image() || a.rng || b.evaluator || b.is_image() || b.rng || c.evaluator || c.is_image() ||
+      c.rng) {
     StackEntry entry(new TernaryEvaluator<Operation>(operation_name, operation, a, b, c));
     stack.pop_back();
     stack.pop_back();
@@ -801,37 +839,48 @@ void get_header(const StackEntry &entry, Header &header) {
     return;
   }
 
-  if (!entry.image)
+  if (!entry.is_image())
     return;
 
+  const Header image = entry.image_header();
   if (header.ndim() == 0) {
-    header = *entry.image;
+    header = image;
     return;
   }
 
-  if (header.ndim() < entry.image->ndim())
-    header.ndim() = entry.image->ndim();
-  for (size_t n = 0; n < std::min<size_t>(header.ndim(), entry.image->ndim()); ++n) {
-    if (header.size(n) > 1 && entry.image->size(n) > 1 && header.size(n) != entry.image->size(n))
+  if (header.ndim() < image.ndim())
+    header.ndim() = image.ndim();
+  for (size_t n = 0; n < std::min<size_t>(header.ndim(), image.ndim()); ++n) {
+    if (header.size(n) > 1 && image.size(n) > 1 && header.size(n) != image.size(n))
       throw Exception("dimensions of input images do not match - aborting");
-    if (!voxel_grids_match_in_scanner_space(header, *(entry.image), 1.0e-4) && !transform_mis_match_reported) {
+    if (!voxel_grids_match_in_scanner_space(header, image, 1.0e-4) && !transform_mis_match_reported) {
       WARN("header transformations of input images do not match");
       transform_mis_match_reported = true;
     }
-    header.size(n) = std::max(header.size(n), entry.image->size(n));
+    header.size(n) = std::max(header.size(n), image.size(n));
     if (!std::isfinite(header.spacing(n)))
-      header.spacing(n) = entry.image->spacing(n);
+      header.spacing(n) = image.spacing(n);
   }
 
-  header.merge_keyval(*entry.image);
+  header.merge_keyval(image);
+}
+
+void get_readers(const StackEntry &entry, std::vector<std::shared_ptr<SlabReader>> &readers) {
+  if (entry.evaluator) {
+    for (size_t n = 0; n < entry.evaluator->operands.size(); ++n)
+      get_readers(entry.evaluator->operands[n], readers);
+  } else if (entry.reader && std::find(readers.begin(), readers.end(), entry.reader) == readers.end()) {
+    readers.push_back(entry.reader);
+  }
 }
 
 class ThreadFunctor {
 public:
   ThreadFunctor(const std::vector<size_t> &inner_axes,
                 const StackEntry &top_of_stack,
-                Image<complex_type> &output_image)
-      : top_entry(top_of_stack), image(output_image), loop(Loop(inner_axes)) {
+                Image<complex_type> &output_image,
+                const SlabImages *slab_images = nullptr)
+      : top_entry(top_of_stack), image(output_image), loop(Loop(inner_axes)), slabs(slab_images) {
     storage.axes = loop.axes;
     storage.size.push_back(image.size(storage.axes[0]));
     storage.size.push_back(image.size(storage.axes[1]));
@@ -847,8 +896,8 @@ class ThreadFunctor {
     }
 
     storage.push_back(ThreadLocalStorageItem());
-    if (entry.image) {
-      storage.back().image.reset(new Image<complex_type>(*entry.image));
+    if (entry.is_image()) {
+      storage.back().image.reset(new Image<complex_type>(entry.image ? *entry.image : slabs->at(entry.reader.get())));
       storage.back().chunk.resize(chunk_size);
       return;
     } else if (entry.rng) {
@@ -873,6 +922,94 @@ class ThreadFunctor {
   decltype(Loop(std::vector<size_t>())) loop;
   ThreadLocalStorage storage;
   size_t chunk_size;
+  const SlabImages *slabs;
+};
+
+// Out-of-core processing: the input images are read in slabs of consecutive
+// slices along the z axis, and each slab is processed and written to the
+// output while the following slabs are being read in:
+class Slab {
+public:
+  size_t from = 0, to = 0;
+  SlabImages inputs;
+  Image<complex_type> output;
+};
+
+constexpr size_t slab_queue_capacity = 2;
+
+class SlabSource {
+public:
+  SlabSource(const StackEntry &top_of_stack, const Header &header) : from(0), num_slices(header.size(2)) {
+    get_readers(top_of_stack, readers);
+    size_t bytes_per_slice = 2 * voxel_count(header) / num_slices * sizeof(complex_type);
+    for (const auto &reader : readers) {
+      const Header &H(reader->header());
+      bytes_per_slice += voxel_count(H) / H.size(2) * (sizeof(complex_type) + H.datatype().bytes());
+    }
+    const size_t in_flight = 2 * slab_queue_capacity + std::max<size_t>(Thread::number_of_threads(), 1) + 2;
+    thickness = ImageIO::slab_thickness(max_memory << 20, bytes_per_slice, num_slices, in_flight);
+    progress = std::make_unique<ProgressBar>("computing: " + operation_string(top_of_stack),
+                                             (num_slices + thickness - 1) / thickness);
+  }
+
+  bool operator()(Slab &slab) {
+    if (from >= num_slices)
+      return false;
+    slab.from = from;
+    slab.to = from = std::min(from + thickness, num_slices);
+    slab.inputs.clear();
+    for (const auto &reader : readers)
+      slab.inputs[reader.get()] = reader->read(slab.from, slab.to);
+    ++(*progress);
+    return true;
+  }
+
+private:
+  std::vector<std::shared_ptr<SlabReader>> readers;
+  size_t from, num_slices, thickness;
+  std::unique_ptr<ProgressBar> progress;
+};
+
+class SlabProcessor {
+public:
+  SlabProcessor(const StackEntry &top_of_stack, const Header &header) : top_entry(top_of_stack), header(header) {}
+
+  bool operator()(Slab &in, Slab &out) {
+    Header slab_header(header);
+    slab_header.size(2) = in.to - in.from;
+    out.from = in.from;
+    out.to = in.to;
+    out.output = Image<complex_type>::scratch(slab_header);
+    auto loop = ThreadedLoop(out.output, 0, out.output.ndim(), 2);
+    ThreadFunctor functor(loop.inner_axes, top_entry, out.output, &in.inputs);
+    loop.run_outer(functor);
+    in.inputs.clear();
+    return true;
+  }
+
+private:
+  const StackEntry &top_entry;
+  const Header header;
+};
+
+class SlabWriter {
+public:
+  SlabWriter(Image<complex_type> &output) : output(output) {}
+
+  bool operator()(Slab &slab) {
+    std::vector<ssize_t> offset(output.ndim(), 0), extent(output.ndim());
+    for (size_t n = 0; n < output.ndim(); ++n)
+      extent[n] = output.size(n);
+    offset[2] = slab.from;
+    extent[2] = slab.to - slab.from;
+    Adapter::Subset<Image<complex_type>> dest(output, offset, extent);
+    copy(slab.output, dest);
+    slab.output = Image<complex_type>();
+    return true;
+  }
+
+private:
+  Image<complex_type> output;
 };
 
 void run_operations(const std::vector<StackEntry> &stack) {
@@ -885,7 +1022,7 @@ void run_operations(const std::vector<StackEntry> &stack) {
       throw Exception("too many operands left on stack!");
 
     assert(!stack[0].evaluator);
-    assert(!stack[0].image);
+    assert(!stack[0].is_image());
 
     print(str(stack[0].value) + "\n");
     return;
@@ -909,6 +1046,16 @@ void run_operations(const std::vector<StackEntry> &stack) {
 
   auto output = Header::create(stack[1].arg, header).get_image<complex_type>();
 
+  std::vector<std::shared_ptr<SlabReader>> readers;
+  get_readers(stack[0], readers);
+  if (!readers.empty()) {
+    SlabSource source(stack[0], header);
+    SlabProcessor processor(stack[0], header);
+    SlabWriter writer(output);
+    Thread::run_queue(source, Slab(), Thread::multi(processor), Slab(), writer, slab_queue_capacity);
+    return;
+  }
+
   auto loop = ThreadedLoop("computing: " + operation_string(stack[0]), output, 0, output.ndim(), 2);
 
   ThreadFunctor functor(loop.inner_axes, stack[0], output);
@@ -982,13 +1129,14 @@ class OpTernary : public OpBase {
 
 void run() {
   std::vector<StackEntry> stack;
+  max_memory = get_option_value<size_t>("max_memory", 0);
 
   for (size_t n = 0; n < raw_arguments_list.size(); ++n) {
     const auto &argument = raw_arguments_list[n];
     const Option *opt = match_option(argument);
     if (opt) {
 
-      if (opt->is("datatype") || opt->is("nthreads"))
+      if (opt->is("datatype") || opt->is("nthreads") || opt->is("max_memory"))
         ++n;
       else if (opt->is("force") || opt->is("info") || opt->is("debug") || opt->is("quiet"))
         continue;
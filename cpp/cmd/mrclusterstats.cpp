@@ -97,7 +97,15 @@ void usage() {
       + Argument ("value").type_float (1.0e-6)
 
     + Option ("connectivity", "use 26-voxel-neighbourhood connectivity"
-                              " (Default: 6)");
+                              " (Default: 6)")
+
+    + Option ("reorder", "reorder the voxels within the mask for processing, such that"
+                         " neighbouring voxels are close together in memory"
+                         " (reverse Cuthill-McKee ordering);"
+                         " this may accelerate cluster-based enhancement of large masks,"
+                         " and leaves the statistical results unchanged other than for floating-point rounding"
+                         " (though where multiple voxels share the maximal statistic in a shuffle,"
+                         " which of them is credited in the null contributions image may differ).");
 
 }
 // clang-format on
@@ -187,6 +195,14 @@ void run() {
   Filter::Connector connector;
   connector.adjacency.set_26_adjacency(do_26_connectivity);
   connector.adjacency.initialise(mask_header, *v2v);
+  if (!get_options("reorder").empty()) {
+    const size_t initial_bandwidth = connector.adjacency.bandwidth();
+    const auto order = connector.adjacency.reverse_cuthill_mckee();
+    v2v->reorder(order);
+    connector.adjacency.reorder(order);
+    INFO("Voxel adjacency bandwidth reduced from " + str(initial_bandwidth) + " to " +
+         str(connector.adjacency.bandwidth()) + " through reordering");
+  }
   const index_type num_voxels = v2v->size();
 
   // Read file names and check files exist
@@ -16,17 +16,21 @@
 
 #include <limits>
 
+#include "adapter/subset.h"
+#include "algo/copy.h"
 #include "algo/threaded_loop.h"
 #include "command.h"
 #include "dwi/gradient.h"
 #include "image.h"
 #include "image_helpers.h"
+#include "image_io/slab_reader.h"
 #include "math/math.h"
 #include "math/median.h"
 #include "memory.h"
 #include "misc/voxel2vector.h"
 #include "phase_encoding.h"
 #include "progressbar.h"
+#include "thread_queue.h"
 
 #include <limits>
 
@@ -77,7 +81,19 @@ void usage() {
       " calculating some statistic from the values along each traversal."
       " If you are seeking to instead perform mathematical calculations"
       " that are done independently for each voxel,"
-      " pleaase see the 'mrcalc' command.";
+      " pleaase see the 'mrcalc' command."
+
+    + "By default, the input images are accessed in their entirety,"
+      " which for compressed images requires them to be loaded into memory."
+      " If the -max_memory option is provided,"
+      " the input images are instead read in slabs of consecutive slices,"
+      " with each slab being processed and written to the output"
+      " while the next ones are being read in,"
+      " and with the thickness of the slabs chosen such that"
+      " the total amount of image data held in memory"
+      " stays approximately within the limit specified."
+      " This allows statistics to be computed across large numbers of images,"
+      " with identical results.";
 
   EXAMPLES
   + Example ("Calculate a 3D volume representing the mean intensity across a 4D image series",
@@ -108,6 +124,11 @@ void usage() {
   + Option ("keep_unary_axes", "Keep unary axes in input images prior to calculating the stats."
                                " The default is to wipe axes with single elements.")
 
+  + Option ("max_memory", "process the images in slabs of consecutive slices,"
+                          " holding approximately no more than this amount of image data"
+                          " (in MB) in memory at any one time (see Description).")
+    + Argument ("size").type_integer (1)
+
   + DataType::options();
 }
 // clang-format on
@@ -293,6 +314,7 @@ class ImageKernelBase {
 public:
   virtual ~ImageKernelBase() {}
   virtual void process(Header &image_in) = 0;
+  virtual void process(Image<value_type> &in) = 0;
   virtual void write_back(Image<value_type> &out) = 0;
 };
 
@@ -324,19 +346,216 @@ template <class Operation> class ImageKernel : public ImageKernelBase {
 
   void process(Header &header_in) {
     auto in = header_in.get_image<value_type>();
-    ThreadedLoop(in).run(ProcessFunctor(*this), in);
+    process(in);
   }
 
+  void process(Image<value_type> &in) { ThreadedLoop(in).run(ProcessFunctor(*this), in); }
+
 protected:
   Voxel2Vector v2v;
   std::vector<Operation> data;
 };
 
+std::unique_ptr<ImageKernelBase> make_kernel(int op, const Header &header) {
+  switch (op) {
+  case 0:
+    return std::make_unique<ImageKernel<Mean>>(header);
+  case 1:
+    return std::make_unique<ImageKernel<Median>>(header);
+  case 2:
+    return std::make_unique<ImageKernel<Sum>>(header);
+  case 3:
+    return std::make_unique<ImageKernel<Product>>(header);
+  case 4:
+    return std::make_unique<ImageKernel<RMS>>(header);
+  case 5:
+    return std::make_unique<ImageKernel<NORM2>>(header);
+  case 6:
+    return std::make_unique<ImageKernel<Var>>(header);
+  case 7:
+    return std::make_unique<ImageKernel<Std>>(header);
+  case 8:
+    return std::make_unique<ImageKernel<Min>>(header);
+  case 9:
+    return std::make_unique<ImageKernel<Max>>(header);
+  case 10:
+    return std::make_unique<ImageKernel<AbsMax>>(header);
+  case 11:
+    return std::make_unique<ImageKernel<MagMax>>(header);
+  default:
+    assert(0);
+    return nullptr;
+  }
+}
+
+template <class LoopType>
+void run_axis_kernel(LoopType &&loop, int op, size_t axis, Image<value_type> &in, Image<value_type> &out) {
+  switch (op) {
+  case 0:
+    loop.run(AxisKernel<Mean>(axis), in, out);
+    return;
+  case 1:
+    loop.run(AxisKernel<Median>(axis), in, out);
+    return;
+  case 2:
+    loop.run(AxisKernel<Sum>(axis), in, out);
+    return;
+  case 3:
+    loop.run(AxisKernel<Product>(axis), in, out);
+    return;
+  case 4:
+    loop.run(AxisKernel<RMS>(axis), in, out);
+    return;
+  case 5:
+    loop.run(AxisKernel<NORM2>(axis), in, out);
+    return;
+  case 6:
+    loop.run(AxisKernel<Var>(axis), in, out);
+    return;
+  case 7:
+    loop.run(AxisKernel<Std>(axis), in, out);
+    return;
+  case 8:
+    loop.run(AxisKernel<Min>(axis), in, out);
+    return;
+  case 9:
+    loop.run(AxisKernel<Max>(axis), in, out);
+    return;
+  case 10:
+    loop.run(AxisKernel<AbsMax>(axis), in, out);
+    return;
+  case 11:
+    loop.run(AxisKernel<MagMax>(axis), in, out);
+    return;
+  default:
+    assert(0);
+  }
+}
+
+// Out-of-core processing: the input images are read in slabs of consecutive
+// slices along slab_axis, and each slab is processed (by as many threads as
+// requested) and written to the output while the following slabs are being
+// read in. Each slab in flight holds its input and output data in memory,
+// hence the thickness of the slabs is set to fit them all within max_memory.
+class Slab {
+public:
+  size_t from = 0, to = 0;
+  std::vector<Image<value_type>> inputs;
+  Image<value_type> output;
+};
+
+constexpr size_t slab_queue_capacity = 2;
+
+class SlabSource {
+public:
+  SlabSource(std::vector<Header> &headers_in, size_t slab_axis, size_t max_memory, const std::string &message)
+      : from(0) {
+    size_t bytes_per_slice = 0;
+    for (auto &H : headers_in) {
+      bytes_per_slice += voxel_count(H) / H.size(slab_axis) * (sizeof(value_type) + H.datatype().bytes());
+      readers.push_back(std::make_unique<ImageIO::SlabReader<value_type>>(std::move(H), slab_axis));
+    }
+    // output and kernel state:
+    bytes_per_slice += voxel_count(readers[0]->header()) / readers[0]->size() * (sizeof(value_type) + sizeof(Var));
+
+    const size_t num_slices = readers[0]->size();
+    const size_t in_flight = 2 * slab_queue_capacity + std::max<size_t>(Thread::number_of_threads(), 1) + 2;
+    thickness = ImageIO::slab_thickness(max_memory << 20, bytes_per_slice, num_slices, in_flight);
+    progress = std::make_unique<ProgressBar>(message, (num_slices + thickness - 1) / thickness);
+  }
+
+  bool operator()(Slab &slab) {
+    if (from >= readers[0]->size())
+      return false;
+    slab.from = from;
+    slab.to = from = std::min(from + thickness, readers[0]->size());
+    slab.inputs.clear();
+    for (auto &reader : readers)
+      slab.inputs.push_back(reader->read(slab.from, slab.to));
+    ++(*progress);
+    return true;
+  }
+
+private:
+  std::vector<std::unique_ptr<ImageIO::SlabReader<value_type>>> readers;
+  size_t from, thickness;
+  std::unique_ptr<ProgressBar> progress;
+};
+
+class SlabProcessor {
+public:
+  SlabProcessor(const Image<value_type> &out, size_t slab_axis, int op, ssize_t axis)
+      : header(out), slab_axis(slab_axis), op(op), axis(axis) {}
+
+  bool operator()(Slab &in, Slab &out) {
+    Header slab_header(header);
+    slab_header.size(slab_axis) = in.to - in.from;
+    out.from = in.from;
+    out.to = in.to;
+    out.output = Image<value_type>::scratch(slab_header);
+    if (axis < 0) {
+      auto kernel = make_kernel(op, slab_header);
+      for (auto &image : in.inputs)
+        kernel->process(image);
+      kernel->write_back(out.output);
+    } else {
+      run_axis_kernel(ThreadedLoop(out.output), op, axis, in.inputs[0], out.output);
+    }
+    in.inputs.clear();
+    return true;
+  }
+
+private:
+  const Header header;
+  const size_t slab_axis;
+  const int op;
+  const ssize_t axis;
+};
+
+class SlabWriter {
+public:
+  SlabWriter(Image<value_type> &out, size_t slab_axis) : out(out), slab_axis(slab_axis) {}
+
+  bool operator()(Slab &slab) {
+    std::vector<ssize_t> offset(out.ndim(), 0), extent(out.ndim());
+    for (size_t n = 0; n < out.ndim(); ++n)
+      extent[n] = out.size(n);
+    offset[slab_axis] = slab.from;
+    extent[slab_axis] = slab.to - slab.from;
+    Adapter::Subset<Image<value_type>> dest(out, offset, extent);
+    copy(slab.output, dest);
+    slab.output = Image<value_type>();
+    return true;
+  }
+
+private:
+  Image<value_type> out;
+  const size_t slab_axis;
+};
+
+// reduce across the input images if axis is negative, or along axis otherwise:
+void run_slabs(int op,
+               std::vector<Header> &headers_in,
+               Image<value_type> &out,
+               size_t slab_axis,
+               size_t max_memory,
+               ssize_t axis) {
+  const std::string message =
+      std::string("computing ") + operations[op] +
+      (axis < 0 ? " across " + str(headers_in.size()) + " images" : " along axis " + str(axis));
+  SlabSource source(headers_in, slab_axis, max_memory, message);
+  SlabProcessor processor(out, slab_axis, op, axis);
+  SlabWriter writer(out, slab_axis);
+  Thread::run_queue(source, Slab(), Thread::multi(processor), Slab(), writer, slab_queue_capacity);
+}
+
 void run() {
   const size_t num_inputs = argument.size() - 2;
   const int op = argument[num_inputs];
   const std::string &output_path = argument.back();
 
+  const size_t max_memory = get_option_value<size_t>("max_memory", 0);
+
   auto opt = get_options("axis");
   if (!opt.empty()) {
 
@@ -345,13 +564,13 @@ void run() {
 
     const size_t axis = opt[0][0];
 
-    auto image_in = Header::open(argument[0]).get_image<value_type>().with_direct_io(axis);
+    auto header_in = Header::open(argument[0]);
 
-    if (axis >= image_in.ndim())
-      throw Exception("Cannot perform operation along axis " + str(axis) + "; image only has " + str(image_in.ndim()) +
+    if (axis >= header_in.ndim())
+      throw Exception("Cannot perform operation along axis " + str(axis) + "; image only has " + str(header_in.ndim()) +
                       " axes");
 
-    Header header_out(image_in);
+    Header header_out(header_in);
 
     if (axis == 3) {
       try {
@@ -369,50 +588,20 @@ void run() {
 
     auto image_out = Header::create(output_path, header_out).get_image<float>();
 
-    auto loop =
-        ThreadedLoop(std::string("computing ") + operations[op] + " along axis " + str(axis) + "...", image_out);
-
-    switch (op) {
-    case 0:
-      loop.run(AxisKernel<Mean>(axis), image_in, image_out);
-      return;
-    case 1:
-      loop.run(AxisKernel<Median>(axis), image_in, image_out);
-      return;
-    case 2:
-      loop.run(AxisKernel<Sum>(axis), image_in, image_out);
-      return;
-    case 3:
-      loop.run(AxisKernel<Product>(axis), image_in, image_out);
-      return;
-    case 4:
-      loop.run(AxisKernel<RMS>(axis), image_in, image_out);
+    // slice along z, unless that is the axis being reduced:
+    const size_t slab_axis = axis == 2 ? 1 : 2;
+    if (max_memory && slab_axis < image_out.ndim()) {
+      std::vector<Header> headers_in(1);
+      headers_in[0] = std::move(header_in);
+      run_slabs(op, headers_in, image_out, slab_axis, max_memory, axis);
       return;
-    case 5:
-      loop.run(AxisKernel<NORM2>(axis), image_in, image_out);
-      return;
-    case 6:
-      loop.run(AxisKernel<Var>(axis), image_in, image_out);
-      return;
-    case 7:
-      loop.run(AxisKernel<Std>(axis), image_in, image_out);
-      return;
-    case 8:
-      loop.run(AxisKernel<Min>(axis), image_in, image_out);
-      return;
-    case 9:
-      loop.run(AxisKernel<Max>(axis), image_in, image_out);
-      return;
-    case 10:
-      loop.run(AxisKernel<AbsMax>(axis), image_in, image_out);
-      return;
-    case 11:
-      loop.run(AxisKernel<MagMax>(axis), image_in, image_out);
-      return;
-    default:
-      assert(0);
     }
 
+    auto image_in = header_in.get_image<value_type>().with_direct_io(axis);
+    auto loop =
+        ThreadedLoop(std::string("computing ") + operations[op] + " along axis " + str(axis) + "...", image_out);
+    run_axis_kernel(loop, op, axis, image_in, image_out);
+
   } else {
 
     if (num_inputs < 2)
@@ -452,49 +641,15 @@ void run() {
       header.merge_keyval(temp);
     }
 
-    // Instantiate a kernel depending on the operation requested
-    std::unique_ptr<ImageKernelBase> kernel;
-    switch (op) {
-    case 0:
-      kernel.reset(new ImageKernel<Mean>(header));
-      break;
-    case 1:
-      kernel.reset(new ImageKernel<Median>(header));
-      break;
-    case 2:
-      kernel.reset(new ImageKernel<Sum>(header));
-      break;
-    case 3:
-      kernel.reset(new ImageKernel<Product>(header));
-      break;
-    case 4:
-      kernel.reset(new ImageKernel<RMS>(header));
-      break;
-    case 5:
-      kernel.reset(new ImageKernel<NORM2>(header));
-      break;
-    case 6:
-      kernel.reset(new ImageKernel<Var>(header));
-      break;
-    case 7:
-      kernel.reset(new ImageKernel<Std>(header));
-      break;
-    case 8:
-      kernel.reset(new ImageKernel<Min>(header));
-      break;
-    case 9:
-      kernel.reset(new ImageKernel<Max>(header));
-      break;
-    case 10:
-      kernel.reset(new ImageKernel<AbsMax>(header));
-      break;
-    case 11:
-      kernel.reset(new ImageKernel<MagMax>(header));
-      break;
-    default:
-      assert(0);
+    if (max_memory && header.ndim() > 2) {
+      auto out = Header::create(output_path, header).get_image<value_type>();
+      run_slabs(op, headers_in, out, 2, max_memory, -1);
+      return;
     }
 
+    // Instantiate a kernel depending on the operation requested
+    auto kernel = make_kernel(op, header);
+
     // Feed the input images to the kernel one at a time
     {
       ProgressBar progress(std::string("computing ") + operations[op] + " across " + str(headers_in.size()) + " images",
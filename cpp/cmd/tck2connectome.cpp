@@ -159,18 +159,19 @@ void execute(Image<node_t> &node_image, const node_t max_node_index, const std::
   // Initialise classes in preparation for multi-threading
   Mapping::TrackLoader loader(
       reader, properties["count"].empty() ? 0 : to<size_t>(properties["count"]), "Constructing connectome");
+  const size_t loader_threads = loader.num_threads();
   Tractography::Connectome::Mapper mapper(*tck2nodes, metric);
   Tractography::Connectome::Matrix<T> connectome(max_node_index, statistic, vector_output, track_assignments);
 
   // Multi-threaded connectome construction
   if (tck2nodes->provides_pair()) {
-    Thread::run_queue(loader,
+    Thread::run_queue(Thread::multi(loader, loader_threads),
                       Thread::batch(Tractography::Streamline<float>()),
                       Thread::multi(mapper),
                       Thread::batch(Mapped_track_nodepair()),
                       connectome);
   } else {
-    Thread::run_queue(loader,
+    Thread::run_queue(Thread::multi(loader, loader_threads),
                       Thread::batch(Tractography::Streamline<float>()),
                       Thread::multi(mapper),
                       Thread::batch(Mapped_track_nodelist()),
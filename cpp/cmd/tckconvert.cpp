@@ -15,8 +15,10 @@
  */
 
 #include "command.h"
+#include "dwi/tractography/compressed_file.h"
 #include "dwi/tractography/file.h"
 #include "dwi/tractography/properties.h"
+#include "dwi/tractography/scalar_file.h"
 #include "file/matrix.h"
 #include "file/name_parser.h"
 #include "file/ofstream.h"
@@ -47,11 +49,29 @@ void usage() {
   DESCRIPTION
     + "The program currently supports"
       " MRtrix .tck files (input/output),"
+      " MRtrix compressed .tckz files (input/output),"
       " ascii text files (input/output),"
       " VTK polydata files (input/output),"
-      " and RenderMan RIB (export only).";
+      " and RenderMan RIB (export only)."
+
+    + "Compressed track files (.tckz) store vertex positions rounded to a fixed step size"
+      " (set using the -quantisation option),"
+      " as the differences from their linear prediction based on the previous two vertices,"
+      " in independently compressed blocks of streamlines;"
+      " this typically reduces the file size several-fold,"
+      " while allowing the file to be decoded by multiple threads."
+      " The weight of each streamline is stored within the file,"
+      " as are the values of a track scalar file if provided using the -scalar_in option;"
+      " these can be recovered using the -scalar_out option.";
 
   EXAMPLES
+    + Example("Compressing a track file,"
+              " along with the values of a track scalar file",
+              "tckconvert input.tck output.tckz -scalar_in input.tsf",
+              "Vertex positions will be within 0.005mm"
+              " (half the default quantisation step size)"
+              " of those in the input file.")
+
     + Example("Writing multiple ASCII files, one per streamline",
               "tckconvert input.tck output-[].txt",
               "By using the multi-file numbering syntax,"
@@ -108,11 +128,91 @@ void usage() {
     + OptionGroup ("Options specific to VTK writer")
 
     + Option ("ascii", "write an ASCII VTK file"
-                       " (binary by default)");
+                       " (binary by default)")
+
+    + OptionGroup ("Options specific to compressed track (.tckz) files")
+
+    + Option ("quantisation", "the step size (in mm) to which vertex positions are rounded"
+                              " when writing a compressed track file"
+                              " (default: 0.01, or as set by the TrackCompressionQuantisation config file option)")
+      + Argument("step").type_float(0.0)
+
+    + Option ("scalar_in", "a track scalar file (.tsf) whose values are to be stored"
+                           " within the output compressed track file")
+      + Argument("file").type_file_in()
+
+    + Option ("scalar_out", "write the track scalar values stored"
+                            " within the input compressed track file to a track scalar file (.tsf)")
+      + Argument("file").type_file_out();
 
 }
 // clang-format on
 
+class TCKZReader : public ReaderInterface<float> {
+public:
+  TCKZReader(const std::string &file, Properties &properties) : reader(file, properties) {
+    auto opt = get_options("scalar_out");
+    if (!opt.empty()) {
+      if (reader.num_scalars() != 1)
+        throw Exception("cannot write track scalar file: input file \"" + file + "\" contains " +
+                        str(reader.num_scalars()) + " scalar values per vertex");
+      scalar_writer.reset(new ScalarWriter<float>(opt[0][0], properties));
+    }
+  }
+
+  bool operator()(Streamline<float> &tck) {
+    if (!scalar_writer)
+      return reader(tck);
+    if (!reader(tck, &scalars))
+      return false;
+    (*scalar_writer)(scalars);
+    return true;
+  }
+
+private:
+  Compressed::Reader reader;
+  std::unique_ptr<ScalarWriter<float>> scalar_writer;
+  TrackScalar<float> scalars;
+};
+
+class TCKZWriter : public WriterInterface<float> {
+public:
+  TCKZWriter(const std::string &file, const Properties &properties) {
+    auto opt = get_options("scalar_in");
+    if (!opt.empty()) {
+      Properties scalar_properties;
+      scalar_reader.reset(new ScalarReader<float>(opt[0][0], scalar_properties));
+      check_properties_match(properties, scalar_properties, "scalar", false);
+    }
+    const_cast<Properties &>(properties).set_timestamp();
+    const_cast<Properties &>(properties).set_version_info();
+    const_cast<Properties &>(properties).update_command_history();
+    writer.reset(new Compressed::Writer(file,
+                                        properties,
+                                        scalar_reader ? 1 : 0,
+                                        get_option_value("quantisation", Compressed::default_quantisation())));
+  }
+
+  bool operator()(const Streamline<float> &tck) {
+    if (!scalar_reader) {
+      writer->append(tck);
+      return true;
+    }
+    if (!(*scalar_reader)(scalars))
+      throw Exception("track scalar file contains fewer streamlines than the input track file");
+    if (scalars.size() != tck.size())
+      throw Exception("track scalar file does not match the input track file (streamline " + str(writer->count) +
+                      " contains " + str(tck.size()) + " vertices, but " + str(scalars.size()) + " scalar values)");
+    writer->append(tck, scalars.data());
+    return true;
+  }
+
+private:
+  std::unique_ptr<Compressed::Writer> writer;
+  std::unique_ptr<ScalarReader<float>> scalar_reader;
+  TrackScalar<float> scalars;
+};
+
 class VTKWriter : public WriterInterface<float> {
 public:
   VTKWriter(const std::string &file, bool write_ascii = true)
@@ -678,11 +778,18 @@ class RibWriter : public WriterInterface<float> {
 };
 
 void run() {
+  if (!get_options("scalar_out").empty() && !Compressed::is_compressed(argument[0]))
+    throw Exception("-scalar_out option is only applicable to compressed (.tckz) input track files");
+  if (!get_options("scalar_in").empty() && !Compressed::is_compressed(argument[1]))
+    throw Exception("-scalar_in option is only applicable to compressed (.tckz) output track files");
+
   // Reader
   Properties properties;
   std::unique_ptr<ReaderInterface<float>> reader;
   if (Path::has_suffix(argument[0], ".tck")) {
     reader.reset(new Reader<float>(argument[0], properties));
+  } else if (Compressed::is_compressed(argument[0])) {
+    reader.reset(new TCKZReader(argument[0], properties));
   } else if (Path::has_suffix(argument[0], ".txt")) {
     reader.reset(new ASCIIReader(argument[0]));
   } else if (Path::has_suffix(argument[0], ".vtk")) {
@@ -695,6 +802,8 @@ void run() {
   std::unique_ptr<WriterInterface<float>> writer;
   if (Path::has_suffix(argument[1], ".tck")) {
     writer.reset(new Writer<float>(argument[1], properties));
+  } else if (Compressed::is_compressed(argument[1])) {
+    writer.reset(new TCKZWriter(argument[1], properties));
   } else if (Path::has_suffix(argument[1], ".vtk")) {
     auto write_ascii = get_options("ascii").size();
     writer.reset(new VTKWriter(argument[1], write_ascii));
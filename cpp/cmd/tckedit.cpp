@@ -84,7 +84,16 @@ void usage() {
              " of output streamlines than input streamlines,"
              " as a single input streamline may have the vertices at either endpoint retained"
              " but some vertices at its midpoint removed,"
-             " effectively cutting one long streamline into multiple shorter streamlines.");
+             " effectively cutting one long streamline into multiple shorter streamlines.")
+
+  + Example ("Extract streamlines from a large tractogram using a spatial index",
+             "tckindex in.tck; tckedit in.tck out.tck -include ROI1.mif -include ROI2.mif",
+             "Once a spatial index of a track file has been generated using the tckindex command,"
+             " tckedit will use it to read only those streamlines"
+             " that could possibly satisfy the -include, -include_ordered and -mask criteria,"
+             " rather than the entire file."
+             " The index is not used if the -inverse option is specified,"
+             " or if the track file has since been modified.");
 
 
 
@@ -208,10 +217,12 @@ void run() {
   const size_t number = get_option_value("number", size_t(0));
   const size_t skip = get_option_value("skip", size_t(0));
 
-  Loader loader(input_file_list);
+  // An inverse selection may include any streamline, so cannot make use of a spatial index
+  Loader loader(input_file_list, properties, ends_only, !inverse);
   Worker worker(properties, inverse, ends_only);
   Receiver receiver(output_path, properties, number, skip);
 
   Thread::run_ordered_queue(
       loader, Thread::batch(Streamline<>()), Thread::multi(worker), Thread::batch(Streamline<>()), receiver);
+  receiver.add_unread(loader.unread(receiver.num_received()));
 }
@@ -0,0 +1,64 @@
+/* Copyright (c) 2008-2024 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "command.h"
+#include "dwi/tractography/spatial_index.h"
+
+using namespace MR;
+using namespace App;
+using namespace MR::DWI::Tractography;
+
+constexpr float default_brick_size = 4.0f;
+
+// clang-format off
+void usage() {
+
+  AUTHOR = "MRtrix3 contributors";
+
+  SYNOPSIS = "Generate a spatial index of the streamlines in a track file, to accelerate subsequent queries";
+
+  DESCRIPTION
+  + "The extent of the tractogram is divided into cubic bricks,"
+    " and for each brick, the streamlines with at least one vertex within it"
+    " (and separately those with an endpoint within it) are listed."
+    " This index is stored alongside the track file as \"<tracks>.sidx\","
+    " together with the index of the offset of every streamline within the file (\"<tracks>.idx\")."
+
+  + "Commands that select streamlines based on regions of interest (currently tckedit)"
+    " then read only those streamlines that could possibly traverse the regions of interest,"
+    " rather than the entire track file;"
+    " commands that select streamlines by other means (currently connectome2tck with the -nodes option)"
+    " use the index of streamline offsets to read only those streamlines selected."
+    " Each index is ignored if the track file is modified after the index was generated."
+
+  + "Smaller bricks allow the candidate streamlines to be determined more precisely,"
+    " at the expense of a larger index.";
+
+  ARGUMENTS
+  + Argument ("tracks", "the input track file").type_file_in();
+
+  OPTIONS
+  + Option ("brick_size", "the edge length of each brick in mm"
+                          " (default: " + str(default_brick_size) + ")")
+    + Argument ("size").type_float(0.0);
+
+}
+// clang-format on
+
+void run() {
+  const float brick_size = get_option_value("brick_size", default_brick_size);
+  SpatialIndex::build(argument[0], brick_size);
+}
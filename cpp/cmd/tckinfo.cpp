@@ -73,7 +73,10 @@ void run() {
     if (actual_count) {
       Tractography::Streamline<float> tck;
       size_t count = 0;
-      {
+      // An up-to-date index of streamline offsets stored alongside the file (see tckindex) already holds the count
+      if (file.load_index()) {
+        count = file.num_streamlines();
+      } else {
         ProgressBar progress("counting tracks in file");
         while (file(tck)) {
           ++count;
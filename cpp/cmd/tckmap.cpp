@@ -44,6 +44,8 @@ using namespace MR::DWI;
 using namespace MR::DWI::Tractography;
 using namespace MR::DWI::Tractography::Mapping;
 
+constexpr size_t default_max_memory = 1024;
+
 // clang-format off
 const OptionGroup OutputHeaderOption = OptionGroup ("Options for the header of the output image")
   + Option ("template", "an image file to be used as a template for the output"
@@ -123,7 +125,14 @@ const OptionGroup MappingOption = OptionGroup ("Options for the streamline-to-vo
       " that accurately quantifies the length through each voxel"
       " (these lengths are then taken into account during TWI calculation)")
   + Option ("ends_only",
-      "only map the streamline endpoints to the image");
+      "only map the streamline endpoints to the image")
+  + Option ("max_memory",
+      "the maximum amount of memory (in MB) to use for the per-thread buffers"
+      " into which streamline contributions are accumulated;"
+      " if this would be exceeded, all threads instead write into a single buffer,"
+      " with access to each image slice serialised"
+      " (default: " + str(default_max_memory) + ")")
+    + Argument ("size").type_integer(0);
 
 void usage () {
 
@@ -257,6 +266,38 @@ DataType determine_datatype(const DataType current_dt,
   }
 }
 
+// Maps each streamline, and adds its contribution to the output image within the same
+//   thread (using a writer obtained from MapWriterBase::partial()), rather than passing
+//   the mapped voxels on to a single writer thread
+template <class MapperType, class SetType> class MapAccumulator {
+public:
+  MapAccumulator(const MapperType &mapper, MapWriterBase &writer) : mapper(mapper), master(writer), writer(nullptr) {}
+  MapAccumulator(const MapAccumulator &that) : mapper(that.mapper), master(that.master), writer(nullptr) {}
+
+  bool operator()(Tractography::Streamline<float> &tck) {
+    if (!writer)
+      writer = &master.partial();
+    mapper(tck, set);
+    return (*writer)(set);
+  }
+
+private:
+  MapperType mapper;
+  MapWriterBase &master;
+  MapWriterBase *writer;
+  SetType set;
+};
+
+template <class SetType, class MapperType>
+void accumulate(TrackLoader &loader, const MapperType &mapper, MapWriterBase &writer, const size_t max_memory) {
+  const size_t num_threads = std::max(Thread::threads_to_execute(), size_t(1));
+  writer.set_num_partials(num_threads, max_memory << 20);
+  MapAccumulator<MapperType, SetType> accumulator(mapper, writer);
+  Thread::run_queue(Thread::multi(loader, loader.num_threads()),
+                    Thread::batch(Tractography::Streamline<float>()),
+                    Thread::multi(accumulator, num_threads));
+}
+
 void run() {
 
   Tractography::Properties properties;
@@ -660,6 +701,7 @@ void run() {
   // Finally get to do some number crunching!
   // Complete branch here for Gaussian track-wise statistic; it's a nightmare to manage, so am
   //   keeping the code as separate as possible
+  const size_t max_memory = get_option_value("max_memory", default_max_memory);
   if (stat_tck == GAUSSIAN) {
     Gaussian::TrackMapper *const mapper_ptr = dynamic_cast<Gaussian::TrackMapper *>(mapper.get());
     mapper_ptr->set_gaussian_FWHM(gaussian_fwhm_tck);
@@ -667,32 +709,16 @@ void run() {
     case UNDEFINED:
       throw Exception("Invalid TWI writer image dimensionality");
     case GREYSCALE:
-      Thread::run_queue(loader,
-                        Thread::batch(Tractography::Streamline<float>()),
-                        Thread::multi(*mapper_ptr),
-                        Thread::batch(Gaussian::SetVoxel()),
-                        *writer);
+      accumulate<Gaussian::SetVoxel>(loader, *mapper_ptr, *writer, max_memory);
       break;
     case DEC:
-      Thread::run_queue(loader,
-                        Thread::batch(Tractography::Streamline<float>()),
-                        Thread::multi(*mapper_ptr),
-                        Thread::batch(Gaussian::SetVoxelDEC()),
-                        *writer);
+      accumulate<Gaussian::SetVoxelDEC>(loader, *mapper_ptr, *writer, max_memory);
       break;
     case DIXEL:
-      Thread::run_queue(loader,
-                        Thread::batch(Tractography::Streamline<float>()),
-                        Thread::multi(*mapper_ptr),
-                        Thread::batch(Gaussian::SetDixel()),
-                        *writer);
+      accumulate<Gaussian::SetDixel>(loader, *mapper_ptr, *writer, max_memory);
       break;
     case TOD:
-      Thread::run_queue(loader,
-                        Thread::batch(Tractography::Streamline<float>()),
-                        Thread::multi(*mapper_ptr),
-                        Thread::batch(Gaussian::SetVoxelTOD()),
-                        *writer);
+      accumulate<Gaussian::SetVoxelTOD>(loader, *mapper_ptr, *writer, max_memory);
       break;
     }
   } else {
@@ -700,32 +726,16 @@ void run() {
     case UNDEFINED:
       throw Exception("Invalid TWI writer image dimensionality");
     case GREYSCALE:
-      Thread::run_queue(loader,
-                        Thread::batch(Tractography::Streamline<float>()),
-                        Thread::multi(*mapper),
-                        Thread::batch(SetVoxel()),
-                        *writer);
+      accumulate<SetVoxel>(loader, *mapper, *writer, max_memory);
       break;
     case DEC:
-      Thread::run_queue(loader,
-                        Thread::batch(Tractography::Streamline<float>()),
-                        Thread::multi(*mapper),
-                        Thread::batch(SetVoxelDEC()),
-                        *writer);
+      accumulate<SetVoxelDEC>(loader, *mapper, *writer, max_memory);
       break;
     case DIXEL:
-      Thread::run_queue(loader,
-                        Thread::batch(Tractography::Streamline<float>()),
-                        Thread::multi(*mapper),
-                        Thread::batch(SetDixel()),
-                        *writer);
+      accumulate<SetDixel>(loader, *mapper, *writer, max_memory);
       break;
     case TOD:
-      Thread::run_queue(loader,
-                        Thread::batch(Tractography::Streamline<float>()),
-                        Thread::multi(*mapper),
-                        Thread::batch(SetVoxelTOD()),
-                        *writer);
+      accumulate<SetVoxelTOD>(loader, *mapper, *writer, max_memory);
       break;
     }
   }
@@ -100,7 +100,11 @@ const OptionGroup SIFT2AlgorithmOption = OptionGroup ("Options for controlling t
   + Option ("linear", "perform a linear estimation of streamline weights,"
                       " rather than the standard non-linear optimisation"
                       " (typically does not provide as accurate a model fit;"
-                      " but only requires a single pass)");
+                      " but only requires a single pass)")
+  + Option ("sparse", "assemble the matrix of streamline contributions to fixels in compressed sparse row"
+                      " and column forms prior to optimisation, such that each iteration traverses contiguous"
+                      " memory; this is typically faster for large tractograms,"
+                      " at the cost of approximately 16 bytes of additional memory per streamline-fixel contribution");
 
 void usage() {
 
@@ -215,6 +219,9 @@ void run() {
     if (!opt.empty())
       tckfactor.set_min_cf_decrease(float(opt[0][0]));
 
+    if (!get_options("sparse").empty())
+      tckfactor.assemble_matrix();
+
     tckfactor.estimate_factors();
   }
 
@@ -246,9 +246,9 @@ void run() {
 
   // Precompute default statistic
   // Don't use convenience function: No enhancer!
-  // Manually construct default shuffling matrix
+  // Manually construct default shuffle
   // TODO Change to use convenience function; we make an empty enhancer later anyway
-  const matrix_type default_shuffle(matrix_type::Identity(num_inputs, num_inputs));
+  const Math::Stats::Shuffle default_shuffle(num_inputs);
   matrix_type default_statistic, default_zstat;
   (*glm_test)(default_shuffle, default_statistic, default_zstat);
   for (index_type i = 0; i != num_hypotheses; ++i) {
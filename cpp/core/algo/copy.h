@@ -21,13 +21,48 @@
 
 namespace MR {
 
+//! \cond skip
+namespace {
+// copies whole rows along the innermost axis at a time, so that images that
+// support it can convert contiguous runs of values in a single call:
+template <class LoopType, class InputImageType, class OutputImageType>
+void __copy_rows(const LoopType &loop, InputImageType &source, OutputImageType &destination, size_t axis) {
+  Helper::RowBuffer<typename InputImageType::value_type> in_row;
+  Helper::RowBuffer<typename OutputImageType::value_type> out_row;
+  source.index(axis) = 0;
+  destination.index(axis) = 0;
+  if (loop.axes.empty()) {
+    copy_row(source, destination, axis, in_row, out_row);
+    return;
+  }
+  for (auto i = loop(source, destination); i; ++i)
+    copy_row(source, destination, axis, in_row, out_row);
+}
+
+// the innermost axis, removed from the (non-empty) list of axes to loop over:
+inline size_t __row_axis(std::vector<size_t> &axes) {
+  assert(!axes.empty());
+  const size_t axis = axes.front();
+  axes.erase(axes.begin());
+  return axis;
+}
+} // namespace
+//! \endcond
+
 template <class InputImageType, class OutputImageType>
 void copy(InputImageType &&source,
           OutputImageType &&destination,
           size_t from_axis = 0,
           size_t to_axis = std::numeric_limits<size_t>::max()) {
-  for (auto i = Loop(source, from_axis, to_axis)(source, destination); i; ++i)
-    destination.value() = source.value();
+  auto axes = Stride::order(source, from_axis, to_axis);
+  // no axes to copy along (e.g. from_axis >= to_axis): copy the current voxel only
+  if (axes.empty()) {
+    for (auto i = Loop(source, from_axis, to_axis)(source, destination); i; ++i)
+      destination.value() = source.value();
+    return;
+  }
+  const size_t axis = __row_axis(axes);
+  __copy_rows(Loop(axes), source, destination, axis);
 }
 
 template <class InputImageType, class OutputImageType>
@@ -49,8 +84,15 @@ void copy_with_progress_message(const std::string &message,
                                 OutputImageType &&destination,
                                 size_t from_axis = 0,
                                 size_t to_axis = std::numeric_limits<size_t>::max()) {
-  for (auto i = Loop(message, source, from_axis, to_axis)(source, destination); i; ++i)
-    destination.value() = source.value();
+  auto axes = Stride::order(source, from_axis, to_axis);
+  // no axes to copy along (e.g. from_axis >= to_axis): copy the current voxel only
+  if (axes.empty()) {
+    for (auto i = Loop(message, source, from_axis, to_axis)(source, destination); i; ++i)
+      destination.value() = source.value();
+    return;
+  }
+  const size_t axis = __row_axis(axes);
+  __copy_rows(Loop(message, axes), source, destination, axis);
 }
 
 } // namespace MR
@@ -0,0 +1,259 @@
+/* Copyright (c) 2008-2024 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#pragma once
+
+#include "algo/threaded_loop.h"
+#include "apply.h"
+#include "image.h"
+
+namespace MR {
+
+/** \addtogroup thread_classes
+ * @{ */
+
+/*! \defgroup masked_thread_looping Thread-safe image looping within a mask
+ *
+ * The MaskedThreadedLoop() functions behave like ThreadedLoop(), but only
+ * invoke the functor for those voxels that lie within the \a mask image
+ * provided. Rather than visiting every voxel and discarding those outside
+ * the mask within the functor, the mask is scanned once up-front to build
+ * a compact list of runs of consecutive active voxels along the innermost
+ * axis. These runs are then distributed across threads in chunks of
+ * roughly equal numbers of active voxels (using the same work-stealing
+ * scheme as ThreadedLoop()), so that the image data outside the mask are
+ * never accessed.
+ *
+ * The loop iterates over all axes from \a from_axis up to (but not
+ * including) \a to_axis, in order of increasing stride of the \a source
+ * `HeaderType`. The mask must match the source along all these axes. If the
+ * mask provided is not valid (e.g. when no mask was supplied on the command
+ * line), all voxels are processed.
+ *
+ * For example:
+ * ~~~{.cpp}
+ * auto mask = Image<bool>();
+ * auto opt = get_options ("mask");
+ * if (!opt.empty())
+ *   mask = Image<bool>::open (opt[0][0]);
+ *
+ * MaskedThreadedLoop ("processing voxels", dwi, mask, 0, 3).run (processor, dwi);
+ * ~~~
+ *
+ * As with ThreadedLoop(), the run() method can also be invoked with no
+ * `ImageType` arguments, in which case the functor will be invoked with an
+ * Iterator set to the position of each voxel within the mask.
+ *
+ * \sa image_thread_looping
+ * @} */
+
+//! \cond skip
+namespace {
+
+template <int N, class Functor, class... ImageType> struct MaskedThreadedLoopRunInner {
+  const std::vector<size_t> &axes;
+  typename std::remove_reference<Functor>::type func;
+  std::tuple<ImageType...> vox;
+
+  MaskedThreadedLoopRunInner(const std::vector<size_t> &axes, const Functor &functor, ImageType &...voxels)
+      : axes(axes), func(functor), vox(voxels...) {}
+
+  void operator()(Iterator &pos, size_t count) {
+    assign_pos_of(pos, axes).to(vox);
+    for (size_t n = 0; n < count; ++n) {
+      std::apply(func, vox);
+      apply_for_each(inc_pos(axes[0]), vox);
+    }
+  }
+};
+
+template <class Functor, class... ImageType> struct MaskedThreadedLoopRunInner<0, Functor, ImageType...> {
+  const std::vector<size_t> &axes;
+  typename std::remove_reference<Functor>::type func;
+
+  MaskedThreadedLoopRunInner(const std::vector<size_t> &axes, const Functor &functor, ImageType &.../*voxels*/)
+      : axes(axes), func(functor) {}
+
+  void operator()(Iterator &pos, size_t count) {
+    for (size_t n = 0; n < count; ++n) {
+      func(pos);
+      ++pos.index(axes[0]);
+    }
+  }
+};
+
+struct MaskedThreadedLoopRun {
+  // a run of consecutive active voxels along the innermost axis:
+  struct Run {
+    size_t position; // index of the first voxel in the run, in loop order
+    size_t first;    // number of active voxels in all previous runs
+  };
+
+  Iterator iterator;
+  std::vector<size_t> axes;
+  std::string progress_message;
+  std::vector<Run> runs;
+
+  template <class HeaderType>
+  MaskedThreadedLoopRun(const HeaderType &source,
+                        const Image<bool> &mask_image,
+                        const std::vector<size_t> &loop_axes,
+                        const std::string &message)
+      : iterator(source), axes(loop_axes), progress_message(message) {
+    Image<bool> mask(mask_image);
+    if (mask.valid()) {
+      for (const auto axis : axes) {
+        if (axis >= mask.ndim() || mask.size(axis) != iterator.size(axis))
+          throw Exception("dimensions of mask image \"" + mask.name() + "\" do not match those of image \"" +
+                          source.name() + "\"");
+      }
+    }
+    size_t position = 0, num_active = 0;
+    bool in_run = false;
+    for (auto l = Loop(axes)(iterator); l; ++l, ++position) {
+      bool active = true;
+      if (mask.valid()) {
+        assign_pos_of(iterator, axes).to(mask);
+        active = mask.value();
+      }
+      if (active) {
+        // runs never straddle rows, so that they can be traversed by
+        // simply incrementing the position along the innermost axis:
+        if (!in_run || iterator.index(axes[0]) == 0)
+          runs.push_back({position, num_active});
+        ++num_active;
+      }
+      in_run = active;
+    }
+    runs.push_back({position, num_active});
+  }
+
+  size_t num_runs() const { return runs.size() - 1; }
+  size_t num_active() const { return runs.back().first; }
+
+  // process active voxels [from, to), and return the number of runs completed:
+  template <class InnerType> size_t process(InnerType &inner, Iterator &pos, size_t from, size_t to) const {
+    auto run = std::upper_bound(runs.begin(), runs.end() - 1, from, [](size_t n, const Run &r) { return n < r.first; });
+    size_t completed = 0;
+    --run;
+    while (from < to) {
+      const size_t count = std::min((run + 1)->first, to) - from;
+      set_position(pos, run->position + (from - run->first));
+      inner(pos, count);
+      from += count;
+      if (from == (run + 1)->first)
+        ++completed;
+      ++run;
+    }
+    return completed;
+  }
+
+  // iteration order matches that of Loop(axes), with axes[0] varying fastest:
+  void set_position(Iterator &pos, size_t index) const {
+    for (const auto axis : axes) {
+      pos.index(axis) = index % pos.size(axis);
+      index /= pos.size(axis);
+    }
+  }
+
+  // invoke inner (Iterator& pos, size_t count) for each run of count active voxels from pos:
+  template <class InnerType> void run_runs(InnerType &inner) {
+    const size_t nthreads = Thread::threads_to_execute();
+    std::unique_ptr<ProgressBar> progress;
+    if (!progress_message.empty())
+      progress.reset(new ProgressBar(progress_message, num_runs()));
+
+    if (nthreads == 0) {
+      Iterator pos(iterator);
+      for (size_t n = 0; n < num_runs(); ++n) {
+        process(inner, pos, runs[n].first, runs[n + 1].first);
+        if (progress)
+          ++(*progress);
+      }
+      return;
+    }
+
+    ProgressBar::SwitchToMultiThreaded progress_functions;
+    ThreadedLoopScheduler scheduler(num_active(), nthreads);
+    std::atomic<size_t> num_threads_started(0);
+
+    struct PerThread {
+      const MaskedThreadedLoopRun &loop;
+      ThreadedLoopScheduler &scheduler;
+      std::atomic<size_t> &num_threads_started;
+      ProgressBar *progress;
+      InnerType inner;
+      void execute() {
+        const size_t id = num_threads_started++;
+        Iterator pos(loop.iterator);
+        size_t from, to;
+        bool stolen;
+        while (scheduler.next(id, from, to, stolen)) {
+          const size_t completed = loop.process(inner, pos, from, to);
+          if (progress)
+            for (size_t n = 0; n < completed; ++n)
+              ++(*progress);
+        }
+      }
+    } loop_thread = {*this, scheduler, num_threads_started, progress.get(), inner};
+
+    auto threads = Thread::run(Thread::multi(loop_thread, nthreads), "masked loop threads");
+    if (progress)
+      progress->run_update_thread(threads);
+    threads.wait();
+  }
+
+  //! invoke \a functor (ImageType&... vox) for each active voxel
+  template <class Functor, class... ImageType> void run(Functor &&functor, ImageType &&...vox) {
+    MaskedThreadedLoopRunInner<sizeof...(ImageType),
+                               typename std::remove_reference<Functor>::type,
+                               typename std::remove_reference<ImageType>::type...>
+    inner(axes, functor, vox...);
+    run_runs(inner);
+    check_app_exit_code();
+  }
+};
+
+} // namespace
+//! \endcond
+
+/** \addtogroup masked_thread_looping
+ * @{ */
+
+//! Multi-threaded loop over the voxels within a mask
+/*! \sa masked_thread_looping for details */
+template <class HeaderType>
+inline MaskedThreadedLoopRun MaskedThreadedLoop(const HeaderType &source,
+                                                const Image<bool> &mask,
+                                                size_t from_axis = 0,
+                                                size_t to_axis = std::numeric_limits<size_t>::max()) {
+  return {source, mask, Stride::order(source, from_axis, to_axis), std::string()};
+}
+
+//! Multi-threaded loop over the voxels within a mask, displaying a progress message
+/*! \sa masked_thread_looping for details */
+template <class HeaderType>
+inline MaskedThreadedLoopRun MaskedThreadedLoop(const std::string &progress_message,
+                                                const HeaderType &source,
+                                                const Image<bool> &mask,
+                                                size_t from_axis = 0,
+                                                size_t to_axis = std::numeric_limits<size_t>::max()) {
+  return {source, mask, Stride::order(source, from_axis, to_axis), progress_message};
+}
+
+/** @} */
+
+} // namespace MR
@@ -23,13 +23,42 @@ namespace MR {
 //! \cond skip
 namespace {
 
-struct __copy_func {
-  template <class InputImageType, class OutputImageType>
-  FORCE_INLINE void operator()(InputImageType &in, OutputImageType &out) const {
-    out.value() = in.value();
+// copies whole rows along the innermost axis at a time, so that images that
+// support it can convert contiguous runs of values in a single call:
+template <class InputImageType, class OutputImageType> struct __copy_rows_func {
+  const std::vector<size_t> &outer_axes;
+  const std::vector<size_t> &inner_axes;
+  InputImageType in;
+  OutputImageType out;
+  Helper::RowBuffer<typename InputImageType::value_type> in_row;
+  Helper::RowBuffer<typename OutputImageType::value_type> out_row;
+
+  void operator()(const Iterator &pos) {
+    assign_pos_of(pos, outer_axes).to(in, out);
+    copy(inner_axes.size() - 1);
+  }
+
+  void copy(size_t n) {
+    const size_t axis = inner_axes[n];
+    in.index(axis) = 0;
+    out.index(axis) = 0;
+    if (n == 0) {
+      copy_row(in, out, axis, in_row, out_row);
+      return;
+    }
+    for (; in.index(axis) < in.size(axis); ++in.index(axis), ++out.index(axis))
+      copy(n - 1);
   }
 };
 
+template <class LoopType, class InputImageType, class OutputImageType>
+inline void __threaded_copy(LoopType &&loop, InputImageType &source, OutputImageType &destination) {
+  __copy_rows_func<InputImageType, OutputImageType> functor = {
+      loop.outer_loop.axes, loop.inner_axes, source, destination, {}, {}};
+  loop.run_outer(functor);
+  check_app_exit_code();
+}
+
 } // namespace
 
 //! \endcond
@@ -39,7 +68,7 @@ inline void threaded_copy(InputImageType &source,
                           OutputImageType &destination,
                           const std::vector<size_t> &axes,
                           size_t num_axes_in_thread = 1) {
-  ThreadedLoop(source, axes, num_axes_in_thread).run(__copy_func(), source, destination);
+  __threaded_copy(ThreadedLoop(source, axes, num_axes_in_thread), source, destination);
 }
 
 template <class InputImageType, class OutputImageType>
@@ -48,7 +77,7 @@ inline void threaded_copy(InputImageType &source,
                           size_t from_axis = 0,
                           size_t to_axis = std::numeric_limits<size_t>::max(),
                           size_t num_axes_in_thread = 1) {
-  ThreadedLoop(source, from_axis, to_axis, num_axes_in_thread).run(__copy_func(), source, destination);
+  __threaded_copy(ThreadedLoop(source, from_axis, to_axis, num_axes_in_thread), source, destination);
 }
 
 template <class InputImageType, class OutputImageType>
@@ -57,7 +86,7 @@ inline void threaded_copy_with_progress_message(const std::string &message,
                                                 OutputImageType &destination,
                                                 const std::vector<size_t> &axes,
                                                 size_t num_axes_in_thread = 1) {
-  ThreadedLoop(message, source, axes, num_axes_in_thread).run(__copy_func(), source, destination);
+  __threaded_copy(ThreadedLoop(message, source, axes, num_axes_in_thread), source, destination);
 }
 
 template <class InputImageType, class OutputImageType>
@@ -67,7 +96,7 @@ inline void threaded_copy_with_progress_message(const std::string &message,
                                                 size_t from_axis = 0,
                                                 size_t to_axis = std::numeric_limits<size_t>::max(),
                                                 size_t num_axes_in_thread = 1) {
-  ThreadedLoop(message, source, from_axis, to_axis, num_axes_in_thread).run(__copy_func(), source, destination);
+  __threaded_copy(ThreadedLoop(message, source, from_axis, to_axis, num_axes_in_thread), source, destination);
 }
 
 template <class InputImageType, class OutputImageType>
@@ -19,8 +19,10 @@
 #include "algo/iterator.h"
 #include "algo/loop.h"
 #include "debug.h"
+#include "file/prefetch.h"
 #include "mutexprotected.h"
 #include "thread.h"
+#include "timer.h"
 #include <tuple>
 
 namespace MR {
@@ -59,15 +61,30 @@ namespace MR {
  * been set to the z and volume axes (i.e. axes 2 & 3). Each thread will do
  * the following:
  *
- * 1. lock the loop mutex, obtain a new set of z & volume coordinates, then
- *    release the mutex so other threads can obtain their own unique set of
- *    coordinates to process;
+ * 1. obtain a new set of z & volume coordinates that no other thread will
+ *    process;
  * 2. set the position of all `ImageType` classes to be processed according
  *    to these coordinates;
  * 3. iterate over the x & y axes, invoking the user-supplied functor each
  *    time;
  * 4. repeat from step 1 until all the data have been processed.
  *
+ * To minimise contention between threads while keeping them all busy even
+ * when the amount of work varies greatly between different parts of the
+ * image (e.g. when most voxels lie outside a processing mask), the outer
+ * loop is divided up into one contiguous range per thread. Each thread
+ * takes chunks of coordinates from its own range, starting with large
+ * chunks and reducing the chunk size as its range empties. Once its range
+ * is exhausted, the thread steals the second half of the largest range
+ * remaining amongst the other threads. A report of the time each thread
+ * spent busy and idle is produced at the end of the loop when running at
+ * the debug log level (i.e. using the `-debug` option), to help diagnose
+ * any remaining imbalance.
+ *
+ * If background prefetching of memory-mapped images is enabled (see
+ * File::Prefetch), each thread also requests that the data for its next
+ * chunk be read ahead while it processes the current one.
+ *
  *
  * \section threaded_loop_constructor Instantiating a ThreadedLoop() object
  *
@@ -296,6 +313,83 @@ template <class Functor, class... ImageType> struct ThreadedLoopRunInner<0, Func
   }
 };
 
+// hands out chunks of a range of indices [0, size) to a fixed number of
+// threads, each working through its own contiguous range, and stealing half
+// of the largest remaining range from other threads once exhausted:
+class ThreadedLoopScheduler {
+public:
+  ThreadedLoopScheduler(size_t size, size_t nthreads)
+      : ranges(new MutexProtected<Range>[nthreads]), nthreads(nthreads), total(size) {
+    for (size_t n = 0; n < nthreads; ++n) {
+      auto range = ranges[n].lock();
+      range->begin = (n * size) / nthreads;
+      range->end = ((n + 1) * size) / nthreads;
+    }
+  }
+
+  //! get the next chunk [from, to) to be processed by thread \a id
+  /*! returns false once there is nothing left to process */
+  bool next(size_t id, size_t &from, size_t &to, bool &stolen) {
+    stolen = false;
+    while (!take(id, from, to)) {
+      if (!steal(id))
+        return false;
+      stolen = true;
+    }
+    return true;
+  }
+
+  //! the total number of iterations to be scheduled
+  size_t size() const { return total; }
+
+private:
+  struct Range {
+    size_t begin = 0, end = 0;
+  };
+  std::unique_ptr<MutexProtected<Range>[]> ranges;
+  const size_t nthreads, total;
+
+  bool take(size_t id, size_t &from, size_t &to) {
+    auto range = ranges[id].lock();
+    const size_t remaining = range->end - range->begin;
+    if (!remaining)
+      return false;
+    from = range->begin;
+    to = from + std::max<size_t>(1, remaining / (2 * nthreads));
+    range->begin = to;
+    return true;
+  }
+
+  bool steal(size_t id) {
+    size_t victim = id, largest = 0;
+    for (size_t n = 0; n < nthreads; ++n) {
+      if (n == id)
+        continue;
+      auto range = ranges[n].lock();
+      if (range->end - range->begin > largest) {
+        largest = range->end - range->begin;
+        victim = n;
+      }
+    }
+    if (!largest)
+      return false;
+    size_t from, to;
+    {
+      auto range = ranges[victim].lock();
+      // the victim may have made progress in the meantime:
+      if (range->end == range->begin)
+        return true;
+      from = range->begin + (range->end - range->begin) / 2;
+      to = range->end;
+      range->end = from;
+    }
+    auto range = ranges[id].lock();
+    range->begin = from;
+    range->end = to;
+    return true;
+  }
+};
+
 inline void __manage_progress(...) {}
 template <class LoopType, class ThreadType>
 inline auto __manage_progress(const LoopType *loop, const ThreadType *threads)
@@ -318,6 +412,7 @@ template <class OuterLoopType> struct ThreadedLoopRunOuter {
 
     ProgressBar::SwitchToMultiThreaded progress_functions;
 
+    // the outer loop object is only used to keep track of progress:
     struct Shared {
       Shared(const Shared &) = delete;
       Shared(Shared &&) = delete;
@@ -326,20 +421,27 @@ template <class OuterLoopType> struct ThreadedLoopRunOuter {
       ~Shared() = default;
       Iterator &iterator;
       decltype(outer_loop(iterator)) loop;
-      FORCE_INLINE bool next(Iterator &pos) {
-        if (loop) {
-          assign_pos_of(iterator, loop.axes).to(pos);
+      size_t num_threads_started;
+      FORCE_INLINE void completed(size_t count) {
+        while (count--)
           ++loop;
-          return true;
-        } else
-          return false;
       }
     };
 
-    MutexProtected<Shared> shared = {iterator, outer_loop(iterator)};
+    MutexProtected<Shared> shared = {iterator, outer_loop(iterator), size_t(0)};
+    const std::vector<size_t> &axes(outer_loop.axes);
+    size_t size = 1;
+    for (const auto axis : axes)
+      size *= iterator.size(axis);
+    const size_t nthreads = Thread::threads_to_execute();
+    ThreadedLoopScheduler scheduler(size, nthreads);
+    Timer timer;
 
     struct PerThread {
       MutexProtected<Shared> &shared;
+      ThreadedLoopScheduler &scheduler;
+      const std::vector<size_t> &axes;
+      Timer &timer;
       PerThread(const PerThread &) = default;
       PerThread(PerThread &&) noexcept = default;
       PerThread &operator=(const PerThread &) = delete;
@@ -347,13 +449,52 @@ template <class OuterLoopType> struct ThreadedLoopRunOuter {
       ~PerThread() = default;
       typename std::remove_reference<Functor>::type func;
       void execute() {
-        auto pos = shared.lock()->iterator;
-        while (shared.lock()->next(pos))
-          func(pos);
+        size_t id, from, to, num_chunks = 0, num_stolen = 0;
+        bool stolen;
+        double busy = 0.0;
+        Iterator pos = [&] {
+          auto s = shared.lock();
+          id = s->num_threads_started++;
+          return s->iterator;
+        }();
+        Iterator outer(pos);
+        while (scheduler.next(id, from, to, stolen)) {
+          Timer chunk_timer;
+          // the next chunk for this thread will most likely follow on from this one:
+          if (File::Prefetch::active())
+            File::Prefetch::request(double(to) / scheduler.size(), double(2 * to - from) / scheduler.size());
+          set_position(outer, from);
+          for (size_t n = from; n < to; ++n) {
+            assign_pos_of(outer, axes).to(pos);
+            func(pos);
+            increment(outer);
+          }
+          shared.lock()->completed(to - from);
+          busy += chunk_timer.elapsed();
+          ++num_chunks;
+          num_stolen += stolen;
+        }
+        DEBUG("loop thread " + str(id) + ": busy for " + str(busy, 3) + "s, idle for " +
+              str(std::max(timer.elapsed() - busy, 0.0), 3) + "s, processed " + str(num_chunks) + " chunks (" +
+              str(num_stolen) + " stolen)");
+      }
+      // iteration order matches that of Loop(axes), with axes[0] varying fastest:
+      void set_position(Iterator &pos, size_t index) const {
+        for (const auto axis : axes) {
+          pos.index(axis) = index % pos.size(axis);
+          index /= pos.size(axis);
+        }
+      }
+      void increment(Iterator &pos) const {
+        for (const auto axis : axes) {
+          if (++pos.index(axis) < pos.size(axis))
+            return;
+          pos.index(axis) = 0;
+        }
       }
-    } loop_thread = {shared, functor};
+    } loop_thread = {shared, scheduler, axes, timer, functor};
 
-    auto threads = Thread::run(Thread::multi(loop_thread), "loop threads");
+    auto threads = Thread::run(Thread::multi(loop_thread, nthreads), "loop threads");
 
     auto *loop = &(shared.lock()->loop);
     __manage_progress(loop, &threads);
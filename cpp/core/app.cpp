@@ -1093,10 +1093,10 @@ void parse() {
     }
     if (i.arg->type == ArgDirectoryOut)
       check_overwrite(text);
-    if (i.arg->type == TracksIn && !Path::has_suffix(text, ".tck"))
+    if (i.arg->type == TracksIn && !Path::has_suffix(text, {".tck", ".tckz"}))
       throw Exception("input file \"" + text + "\" is not a valid track file");
-    if (i.arg->type == TracksOut && !Path::has_suffix(text, ".tck"))
-      throw Exception("output track file \"" + text + "\" must use the .tck suffix");
+    if (i.arg->type == TracksOut && !Path::has_suffix(text, {".tck", ".tckz"}))
+      throw Exception("output track file \"" + text + "\" must use the .tck or .tckz suffix");
   }
   for (const auto &i : option) {
     for (size_t j = 0; j != i.opt->size(); ++j) {
@@ -1122,12 +1122,12 @@ void parse() {
       }
       if (arg.type == ArgDirectoryOut)
         check_overwrite(text);
-      if (arg.type == TracksIn && !Path::has_suffix(text, ".tck"))
+      if (arg.type == TracksIn && !Path::has_suffix(text, {".tck", ".tckz"}))
         throw Exception("input file \"" + text + "\" for option \"-" + std::string(i.opt->id) +
                         "\" is not a valid track file");
-      if (arg.type == TracksOut && !Path::has_suffix(text, ".tck"))
+      if (arg.type == TracksOut && !Path::has_suffix(text, {".tck", ".tckz"}))
         throw Exception("output track file \"" + text + "\" for option \"-" + std::string(i.opt->id) +
-                        "\" must use the .tck suffix");
+                        "\" must use the .tck or .tckz suffix");
     }
   }
 
@@ -22,6 +22,7 @@
 
 #include "app.h"
 #include "executable_version.h"
+#include "file/mmap.h"
 #include "mrtrix.h"
 #include "mrtrix_version.h"
 #ifdef MRTRIX_PROJECT
@@ -114,6 +115,7 @@ int main(int cmdline_argc, char **cmdline_argv) {
       return 0;
     }
     run();
+    ::MR::File::report_page_faults();
   } catch (::MR::Exception &E) {
     E.display();
     return 1;
@@ -57,6 +57,22 @@ void NBS::operator()(in_column_type in, const value_type T, out_column_type out)
   }
 }
 
+bool NBS::integrate(in_column_type in,
+                    const std::vector<value_type> &thresholds,
+                    const value_type E,
+                    const value_type H,
+                    out_column_type out) const {
+  Stats::TFCE::integrate_clusters(
+      in,
+      thresholds,
+      E,
+      H,
+      [](const value_type value, const value_type T) { return std::isfinite(value) && value >= T; },
+      [&](const uint32_t index) -> const std::vector<size_t> & { return (*adjacency)[index]; },
+      out);
+  return true;
+}
+
 void NBS::initialise(const node_t num_nodes) {
   const Mat2Vec mat2vec(num_nodes);
   const size_t num_edges = mat2vec.vec_size();
@@ -53,6 +53,12 @@ class NBS : public Stats::TFCE::EnhancerBase {
 
   void operator()(in_column_type, const value_type, out_column_type) const override;
 
+  bool integrate(in_column_type,
+                 const std::vector<value_type> &,
+                 const value_type,
+                 const value_type,
+                 out_column_type) const override;
+
 protected:
   std::shared_ptr<std::vector<std::vector<size_t>>> adjacency;
   value_type threshold;
@@ -0,0 +1,162 @@
+/* Copyright (c) 2008-2024 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "dwi/tractography/SIFT/contribution_store.h"
+
+#include <algorithm>
+
+#include "exception.h"
+#include "file/entry.h"
+#include "file/utils.h"
+
+namespace MR::DWI::Tractography::SIFT {
+
+ContributionStore::ContributionStore()
+    : chunks(new std::unique_ptr<Block[]>[max_chunks]),
+      num_blocks(0),
+      resident_bytes(0),
+      max_bytes(0),
+      finalised(false),
+      scratch_size(0) {}
+
+ContributionStore::~ContributionStore() {
+  scratch_mmap.reset();
+  scratch.reset();
+  if (!scratch_path.empty())
+    File::remove(scratch_path);
+}
+
+void ContributionStore::initialise(const track_t num_tracks, const size_t max_bytes) {
+  records.assign(num_tracks, Record());
+  this->max_bytes = max_bytes;
+}
+
+void ContributionStore::finalise() {
+  std::lock_guard<std::mutex> lock(mutex);
+  finalised = true;
+  if (!scratch)
+    return;
+  scratch->close();
+  if (!*scratch)
+    throw Exception("error writing streamline contributions to scratch file \"" + scratch_path + "\"");
+  scratch.reset();
+  scratch_mmap.reset(new File::MMap(File::Entry(scratch_path), true));
+  for (uint32_t n = 0; n != num_blocks; ++n) {
+    Block &b(block(n));
+    if (b.file_offset >= 0)
+      b.address = scratch_mmap->address() + b.file_offset;
+  }
+  INFO(str(spilled() >> 20) + " MB of streamline contributions held in scratch file \"" + scratch_path + "\"");
+}
+
+track_t ContributionStore::count() const {
+  return std::count_if(records.begin(), records.end(), [](const Record &r) { return r.block != no_block; });
+}
+
+size_t ContributionStore::footprint() const {
+  size_t bytes = records.size() * sizeof(Record) + num_blocks * sizeof(Block);
+  for (uint32_t n = 0; n != num_blocks; ++n)
+    bytes += block(n).size;
+  return bytes;
+}
+
+size_t ContributionStore::spilled() const {
+  size_t bytes = 0;
+  for (uint32_t n = 0; n != num_blocks; ++n) {
+    if (block(n).file_offset >= 0)
+      bytes += block(n).size;
+  }
+  return bytes;
+}
+
+uint32_t ContributionStore::acquire(const size_t min_size, uint8_t *&data, size_t &capacity) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (num_blocks == max_chunks * blocks_per_chunk)
+    throw Exception("too many blocks of streamline contributions");
+  if (!(num_blocks % blocks_per_chunk))
+    chunks[num_blocks / blocks_per_chunk].reset(new Block[blocks_per_chunk]);
+  Block &b(block(num_blocks));
+  capacity = std::max(block_size, min_size);
+  b.data.reset(new uint8_t[capacity]);
+  b.address = data = b.data.get();
+  b.size = capacity;
+  b.file_offset = -1;
+  resident_bytes += capacity;
+  return num_blocks++;
+}
+
+void ContributionStore::release(const uint32_t index, const size_t used) {
+  if (index == no_block)
+    return;
+  std::lock_guard<std::mutex> lock(mutex);
+  Block &b(block(index));
+  // Blocks can only be spilled to file until the scratch file has been mapped
+  if (!max_bytes || finalised || resident_bytes <= max_bytes)
+    return;
+  if (!scratch) {
+    scratch_path = File::create_tempfile(0, "sift");
+    scratch.reset(new std::ofstream(scratch_path, std::ios_base::out | std::ios_base::binary));
+    if (!*scratch)
+      throw Exception("error opening scratch file \"" + scratch_path + "\" for streamline contributions");
+    DEBUG("memory budget of " + str(max_bytes >> 20) + " MB exceeded;" +
+          " spilling streamline contributions to scratch file \"" + scratch_path + "\"");
+  }
+  scratch->write(reinterpret_cast<const char *>(b.data.get()), used);
+  if (!*scratch)
+    throw Exception("error writing streamline contributions to scratch file \"" + scratch_path + "\"");
+  b.file_offset = scratch_size;
+  scratch_size += used;
+  b.data.reset();
+  b.address = nullptr;
+  resident_bytes -= b.size;
+  b.size = used;
+}
+
+void ContributionStore::Arena::set(const track_t index,
+                                   std::vector<Track_fixel_contribution> &contributions,
+                                   const float total_contribution,
+                                   const float total_length) {
+  std::sort(contributions.begin(), contributions.end());
+  const size_t bytes = TrackContribution::encoded_size(contributions);
+  if (used + bytes > capacity) {
+    store.release(block, used);
+    used = 0;
+    block = store.acquire(bytes, data, capacity);
+  }
+  TrackContribution::encode(contributions, data + used);
+  Record &r(store.records[index]);
+  r.block = block;
+  r.offset = used;
+  r.total_contribution = total_contribution;
+  r.total_length = total_length;
+  used += bytes;
+}
+
+void ContributionStore::Arena::replace(const track_t index,
+                                       std::vector<Track_fixel_contribution> &contributions,
+                                       const float total_contribution) {
+  Record &r(store.records[index]);
+  const TrackContribution existing(store[index]);
+  std::sort(contributions.begin(), contributions.end());
+  if (existing && TrackContribution::encoded_size(contributions) <= existing.bytes()) {
+    TrackContribution::encode(contributions, store.block(r.block).address + r.offset);
+    r.total_contribution = total_contribution;
+    return;
+  }
+  set(index, contributions, total_contribution, r.total_length);
+}
+
+} // namespace MR::DWI::Tractography::SIFT
@@ -0,0 +1,143 @@
+/* Copyright (c) 2008-2024 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#pragma once
+
+#include <cassert>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "file/mmap.h"
+
+#include "dwi/tractography/SIFT/track_contribution.h"
+#include "dwi/tractography/SIFT/types.h"
+
+namespace MR::DWI::Tractography::SIFT {
+
+// Storage for the fixel contributions of all streamlines in the model
+// The encoded contributions of each streamline (see TrackContribution) are written into large
+//   blocks of memory, each of which is filled by a single thread via its own Arena, so that no
+//   locking is required per streamline; only a small fixed-size record is held per streamline.
+// If a memory budget is set, then once the blocks held in RAM would exceed it, each block is
+//   written to a scratch file as soon as it has been filled; once all streamlines have been
+//   mapped, this file is memory-mapped, so that the operating system can page the contributions
+//   in and out of RAM as required.
+class ContributionStore {
+public:
+  ContributionStore();
+  ContributionStore(const ContributionStore &) = delete;
+  ~ContributionStore();
+
+  // Set the number of streamlines, and the maximal number of bytes of encoded contributions
+  //   to be held in RAM (0 for no limit)
+  void initialise(const track_t num_tracks, const size_t max_bytes);
+  // Must be called once all streamline contributions have been added via Arenas
+  void finalise();
+
+  track_t size() const { return records.size(); }
+  // The number of streamlines that have not been removed
+  track_t count() const;
+  // Discard streamlines beyond the first num_tracks
+  void resize(const track_t num_tracks) { records.resize(num_tracks); }
+
+  TrackContribution operator[](const track_t index) const {
+    const Record &r(records[index]);
+    if (r.block == no_block)
+      return TrackContribution();
+    assert(block(r.block).address);
+    return TrackContribution(block(r.block).address + r.offset, r.total_contribution, r.total_length);
+  }
+
+  // Remove a streamline from the reconstruction
+  void erase(const track_t index) { records[index].block = no_block; }
+
+  // Total memory used, and the amount of this that has been spilled to file
+  size_t footprint() const;
+  size_t spilled() const;
+
+  // Each thread adding streamline contributions to the store should do so via its own Arena
+  class Arena {
+  public:
+    Arena(ContributionStore &store) : store(store), block(no_block), data(nullptr), used(0), capacity(0) {}
+    Arena(const Arena &that) : Arena(that.store) {}
+    ~Arena() { store.release(block, used); }
+
+    // Set the contributions of a streamline; these will be sorted by fixel index
+    void set(const track_t index,
+             std::vector<Track_fixel_contribution> &contributions,
+             const float total_contribution,
+             const float total_length);
+
+    // As set(), but re-use the memory of the existing contributions of this streamline if possible
+    void replace(const track_t index,
+                 std::vector<Track_fixel_contribution> &contributions,
+                 const float total_contribution);
+
+  private:
+    ContributionStore &store;
+    uint32_t block;
+    uint8_t *data;
+    size_t used, capacity;
+  };
+
+protected:
+  static constexpr uint32_t no_block = std::numeric_limits<uint32_t>::max();
+  static constexpr size_t block_size = size_t(1) << 20;
+  static constexpr size_t blocks_per_chunk = 1024;
+  static constexpr size_t max_chunks = 65536;
+
+  class Record {
+  public:
+    Record() : block(no_block), offset(0), total_contribution(0.0F), total_length(0.0F) {}
+    uint32_t block, offset;
+    float total_contribution, total_length;
+  };
+
+  class Block {
+  public:
+    std::unique_ptr<uint8_t[]> data;
+    uint8_t *address;
+    size_t size;
+    int64_t file_offset;
+  };
+
+  std::vector<Record> records;
+  // Blocks are held in a fixed table of chunks, rather than a std::vector<>, so that they can
+  //   be read by any thread while other threads are acquiring new blocks
+  std::unique_ptr<std::unique_ptr<Block[]>[]> chunks;
+  uint32_t num_blocks;
+  std::mutex mutex;
+  size_t resident_bytes, max_bytes;
+  bool finalised;
+
+  std::string scratch_path;
+  std::unique_ptr<std::ofstream> scratch;
+  int64_t scratch_size;
+  std::unique_ptr<File::MMap> scratch_mmap;
+
+  Block &block(const uint32_t index) const { return chunks[index / blocks_per_chunk][index % blocks_per_chunk]; }
+
+  // Obtain a new block of at least min_size bytes
+  uint32_t acquire(const size_t min_size, uint8_t *&data, size_t &capacity);
+  // Return a block once it has been filled with used bytes; this may be written to file
+  void release(const uint32_t index, const size_t used);
+};
+
+} // namespace MR::DWI::Tractography::SIFT
@@ -33,6 +33,7 @@
 #include "dwi/tractography/mapping/mapping.h"
 #include "dwi/tractography/mapping/voxel.h"
 
+#include "dwi/tractography/SIFT/contribution_store.h"
 #include "dwi/tractography/SIFT/model_base.h"
 #include "dwi/tractography/SIFT/track_contribution.h"
 #include "dwi/tractography/SIFT/track_index_range.h"
@@ -52,8 +53,6 @@ template <class Fixel> class Model : public ModelBase<Fixel> {
   }
   Model(const Model &that) = delete;
 
-  virtual ~Model();
-
   // Over-rides the function defined in ModelBase; need to build contributions member also
   void map_streamlines(const std::string &);
 
@@ -70,7 +69,7 @@ template <class Fixel> class Model : public ModelBase<Fixel> {
 
 protected:
   std::string tck_file_path;
-  std::vector<TrackContribution *> contributions;
+  ContributionStore contributions;
 
   using Fixel_map<Fixel>::accessor;
   using Fixel_map<Fixel>::begin;
@@ -87,6 +86,7 @@ template <class Fixel> class Model : public ModelBase<Fixel> {
     TrackMappingWorker(Model &i, const default_type upsample_ratio)
         : master(i),
           mapper(i.header(), i.dirs),
+          arena(i.contributions),
           mutex(new std::mutex),
           TD_sum(0.0),
           fixel_TDs(master.fixels.size(), 0.0),
@@ -97,6 +97,7 @@ template <class Fixel> class Model : public ModelBase<Fixel> {
     TrackMappingWorker(const TrackMappingWorker &that)
         : master(that.master),
           mapper(that.mapper),
+          arena(that.arena),
           mutex(that.mutex),
           TD_sum(0.0),
           fixel_TDs(master.fixels.size(), 0.0),
@@ -107,6 +108,7 @@ template <class Fixel> class Model : public ModelBase<Fixel> {
   private:
     Model &master;
     Mapping::TrackMapperBase mapper;
+    ContributionStore::Arena arena;
     std::shared_ptr<std::mutex> mutex;
     double TD_sum;
     std::vector<double> fixel_TDs;
@@ -115,24 +117,16 @@ template <class Fixel> class Model : public ModelBase<Fixel> {
 
   class FixelRemapper {
   public:
-    FixelRemapper(Model &i, std::vector<size_t> &r) : master(i), remapper(r) {}
+    FixelRemapper(Model &i, std::vector<size_t> &r) : master(i), remapper(r), arena(i.contributions) {}
     bool operator()(const TrackIndexRange &);
 
   private:
     Model &master;
     std::vector<size_t> &remapper;
+    ContributionStore::Arena arena;
   };
 };
 
-template <class Fixel> Model<Fixel>::~Model() {
-  for (std::vector<TrackContribution *>::iterator i = contributions.begin(); i != contributions.end(); ++i) {
-    if (*i) {
-      delete *i;
-      *i = nullptr;
-    }
-  }
-}
-
 template <class Fixel> void Model<Fixel>::map_streamlines(const std::string &path) {
   Tractography::Properties properties;
   Tractography::Reader<> file(path, properties);
@@ -141,15 +135,17 @@ template <class Fixel> void Model<Fixel>::map_streamlines(const std::string &pat
   if (!count)
     throw Exception("Cannot map streamlines: track file " + Path::basename(path) + " is empty");
 
-  contributions.assign(count, nullptr);
+  contributions.initialise(count, App::get_option_value<size_t>("max_memory", 0) << 20);
 
   {
     Mapping::TrackLoader loader(file, count);
     TrackMappingWorker worker(*this, Mapping::determine_upsample_ratio(Fixel_map<Fixel>::header(), properties, 0.1));
     Thread::run_queue(loader, Thread::batch(Tractography::Streamline<>()), Thread::multi(worker));
   }
+  contributions.finalise();
+  INFO("Streamline contributions occupy " + str(contributions.footprint() >> 20) + " MB");
 
-  if (!contributions.back()) {
+  if (!contributions[contributions.size() - 1]) {
     track_t num_tracks = 0, max_index = 0;
     for (track_t i = 0; i != contributions.size(); ++i) {
       if (contributions[i]) {
@@ -229,10 +225,8 @@ template <class Fixel> void Model<Fixel>::check_TD() {
   VAR(sum_from_fixels);
   VAR(sum_from_fixels_weighted);
   double sum_from_tracks = 0.0;
-  for (std::vector<TrackContribution *>::const_iterator i = contributions.begin(); i != contributions.end(); ++i) {
-    if (*i)
-      sum_from_tracks += (*i)->get_total_contribution();
-  }
+  for (track_t i = 0; i != contributions.size(); ++i)
+    sum_from_tracks += contributions[i].get_total_contribution();
   VAR(sum_from_tracks);
 }
 
@@ -244,7 +238,7 @@ template <class Fixel> void Model<Fixel>::output_non_contributing_streamlines(co
   ProgressBar progress("Writing non-contributing streamlines output file", contributions.size());
   track_t tck_counter = 0;
   while (reader(tck) && tck_counter < contributions.size()) {
-    if (contributions[tck_counter] && !contributions[tck_counter++]->get_total_contribution())
+    if (contributions[tck_counter] && !contributions[tck_counter++].get_total_contribution())
       writer(tck);
     else
       writer.skip();
@@ -309,8 +303,7 @@ template <class Fixel> bool Model<Fixel>::TrackMappingWorker::operator()(const T
       }
     }
 
-    master.contributions[in.get_index()] =
-        new TrackContribution(masked_contributions, total_contribution, total_length);
+    arena.set(in.get_index(), masked_contributions, total_contribution, total_length);
 
     TD_sum += total_contribution;
     for (std::vector<Track_fixel_contribution>::const_iterator i = masked_contributions.begin();
@@ -330,21 +323,18 @@ template <class Fixel> bool Model<Fixel>::TrackMappingWorker::operator()(const T
 
 template <class Fixel> bool Model<Fixel>::FixelRemapper::operator()(const TrackIndexRange &in) {
   for (track_t track_index = in.first; track_index != in.second; ++track_index) {
-    if (master.contributions[track_index]) {
-      TrackContribution &this_cont(*master.contributions[track_index]);
+    const TrackContribution this_cont(master.contributions[track_index]);
+    if (this_cont) {
       std::vector<Track_fixel_contribution> new_cont;
       double total_contribution = 0.0;
-      for (size_t i = 0; i != this_cont.dim(); ++i) {
-        const size_t new_index = remapper[this_cont[i].get_fixel_index()];
+      for (const auto &c : this_cont) {
+        const size_t new_index = remapper[c.get_fixel_index()];
         if (new_index) {
-          new_cont.push_back(Track_fixel_contribution(new_index, this_cont[i].get_length()));
-          total_contribution += this_cont[i].get_length() * master[new_index].get_weight();
+          new_cont.push_back(Track_fixel_contribution(new_index, c.get_length()));
+          total_contribution += c.get_length() * master[new_index].get_weight();
         }
       }
-      TrackContribution *new_contribution =
-          new TrackContribution(new_cont, total_contribution, this_cont.get_total_length());
-      delete master.contributions[track_index];
-      master.contributions[track_index] = new_contribution;
+      arena.replace(track_index, new_cont, total_contribution);
     }
   }
   return true;
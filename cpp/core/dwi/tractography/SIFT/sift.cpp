@@ -50,7 +50,13 @@ const OptionGroup SIFTModelOption =
              " exclude an FOD lobe from filtering processing if its integral is less than this amount"
              " (streamlines will still be mapped to it,"
              " but it will not contribute to the cost function or the filtering)")
-      + Argument("value").type_float(0.0, 2.0 * Math::pi);
+      + Argument("value").type_float(0.0, 2.0 * Math::pi)
+    + Option("max_memory",
+             "the maximum amount of memory (in MB) to use for holding the fixel contributions of the streamlines;"
+             " beyond this, they are written to a scratch file that is memory-mapped,"
+             " such that the operating system can page them in and out of RAM as required"
+             " (default: no limit)")
+      + Argument("size").type_integer(1);
 
 const OptionGroup SIFTOutputOption =
     OptionGroup("Options to make SIFT provide additional output files")
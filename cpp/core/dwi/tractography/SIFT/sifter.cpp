@@ -16,8 +16,11 @@
 
 #include "dwi/tractography/SIFT/sifter.h"
 
+#include <atomic>
+
 #include "memory.h"
 #include "progressbar.h"
+#include "thread.h"
 #include "timer.h"
 
 #include "algo/loop.h"
@@ -39,6 +42,37 @@
 
 namespace MR::DWI::Tractography::SIFT {
 
+namespace {
+
+// Maximal number of candidate streamlines in each batch of removals,
+//   and maximal number deferred due to traversing the same fixels as others in the batch
+constexpr size_t removal_batch_size = 4096;
+constexpr size_t min_chunk_size = 32;
+
+// Invoke func (from, to) for consecutive chunks of the range [0, size), in parallel
+template <class Functor> void for_each_chunk(const size_t size, Functor &&func) {
+  const size_t nthreads = std::min(Thread::threads_to_execute(), size / min_chunk_size);
+  if (nthreads < 2) {
+    func(size_t(0), size);
+    return;
+  }
+  struct Chunk {
+    typename std::remove_reference<Functor>::type &func;
+    std::atomic<size_t> &next;
+    const size_t size;
+    void execute() {
+      size_t from;
+      while ((from = next.fetch_add(min_chunk_size)) < size)
+        func(from, std::min(from + min_chunk_size, size));
+    }
+  };
+  std::atomic<size_t> next(0);
+  Chunk chunk = {func, next, size};
+  Thread::run(Thread::multi(chunk, nthreads), "SIFT removal threads").wait();
+}
+
+} // namespace
+
 void SIFTer::perform_filtering() {
 
   enum recalc_reason { UNDEFINED, NONLINEARITY, QUANTISATION, TERM_COUNT, TERM_RATIO, TERM_MU, POS_GRADIENT };
@@ -49,10 +83,10 @@ void SIFTer::perform_filtering() {
   std::vector<track_t> noncontributing_indices;
   for (track_t i = 0; i != contributions.size(); ++i) {
     if (contributions[i]) {
-      if (contributions[i]->get_total_contribution()) {
-        sum_contributing_length += contributions[i]->get_total_length();
+      if (contributions[i].get_total_contribution()) {
+        sum_contributing_length += contributions[i].get_total_length();
       } else {
-        sum_noncontributing_length += contributions[i]->get_total_length();
+        sum_noncontributing_length += contributions[i].get_total_length();
         noncontributing_indices.push_back(i);
       }
     }
@@ -80,6 +114,7 @@ void SIFTer::perform_filtering() {
   unsigned int iteration = 0;
   double cf_end_iteration = init_cf;
   unsigned int removed_this_iteration = 0;
+  double removal_rate = 0.0;
 
   if (!csv_path.empty()) {
     File::OFStream csv_out(csv_path, std::ios_base::out | std::ios_base::trunc);
@@ -90,13 +125,14 @@ void SIFTer::perform_filtering() {
   }
 
   auto display_func = [&]() {
-    return printf(" %6u      %7u     %9u       %.2f%%",
+    return printf(" %6u      %7u     %9u       %.2f%%     %9.0f",
                   iteration,
                   removed_this_iteration,
                   tracks_remaining,
-                  100.0 * cf_end_iteration / init_cf);
+                  100.0 * cf_end_iteration / init_cf,
+                  removal_rate);
   };
-  CONSOLE("       Iteration     Removed     Remaining     Cost fn");
+  CONSOLE("       Iteration     Removed     Remaining     Cost fn    Removals/s");
   ProgressBar progress("");
 
   bool another_iteration = true;
@@ -107,7 +143,8 @@ void SIFTer::perform_filtering() {
     ++iteration;
 
     const double current_mu = mu();
-    const double current_cf = calc_cost_function();
+    // The fixels have not changed since the cost function was last calculated
+    const double current_cf = cf_end_iteration;
     const double current_roc_cf = calc_roc_cost_function();
 
     TrackIndexRangeWriter range_writer(SIFT_TRACK_INDEX_BUFFER_SIZE, num_tracks());
@@ -133,11 +170,24 @@ void SIFTer::perform_filtering() {
     MT_gradient_vector_sorter sorter(gradient_vector, sort_size);
 
     // Remove candidate streamlines one at a time, and correspondingly modify the fixels to which they were attributed
+    // Candidates are drawn from the sorter in batches, within which no two streamlines traverse the same fixel;
+    //   a candidate that conflicts with the current batch is deferred to the next one. Since the first candidate
+    //   that fails the removal criteria ends the iteration, those removed from each batch are always a prefix
+    //   of it, and so the value of mu before each removal is known in advance. The changes in cost function are
+    //   therefore evaluated for all candidates in the batch in parallel, with results identical to evaluating
+    //   them one at a time; the fixels of the streamlines removed are updated in parallel once the fate of the
+    //   batch is known. The outcome is hence independent of the number of threads.
     removed_this_iteration = 0;
     recalculate = UNDEFINED;
+    std::vector<Removal> batch, deferred;
+    size_t next_in_batch = 0, applied_in_batch = 0;
+    bool candidates_exhausted = false;
+    Timer iteration_timer;
     do {
 
       if (!output_at_counts.empty() && (tracks_remaining == output_at_counts.back())) {
+        apply_batch(batch, applied_in_batch, next_in_batch);
+        applied_in_batch = next_in_batch;
         const std::string prefix = str(tracks_remaining);
         if (App::log_level)
           fprintf(stderr, "\n");
@@ -169,72 +219,45 @@ void SIFTer::perform_filtering() {
         noncontributing_indices.pop_back();
 
         // Remove this streamline, and adjust all of the relevant quantities
-        noncontributing_length_removed += contributions[to_remove]->get_total_length();
-        delete contributions[to_remove];
-        contributions[to_remove] = nullptr;
+        noncontributing_length_removed += contributions[to_remove].get_total_length();
+        contributions.erase(to_remove);
         ++removed_this_iteration;
         --tracks_remaining;
 
       } else { // Proceed as normal
 
-        const std::vector<Cost_fn_gradient_sort>::iterator candidate = sorter.get();
-        if (candidate == gradient_vector.end()) {
-          recalculate = POS_GRADIENT;
-          if (!removed_this_iteration)
-            another_iteration = false;
-          goto end_iteration;
+        if (next_in_batch == batch.size()) {
+          apply_batch(batch, applied_in_batch, next_in_batch);
+          fill_batch(sorter, gradient_vector.end(), batch, deferred, candidates_exhausted);
+          evaluate_batch(batch, current_roc_cf);
+          next_in_batch = applied_in_batch = 0;
         }
-
-        const track_t candidate_index = candidate->get_tck_index();
-        if (candidate->get_cost_gradient() >= 0.0) {
+        if (batch.empty()) {
           recalculate = POS_GRADIENT;
           if (!removed_this_iteration)
             another_iteration = false;
           goto end_iteration;
         }
 
-        assert(candidate_index != num_tracks());
-        assert(contributions[candidate_index]);
+        const Removal &candidate(batch[next_in_batch]);
+        assert(contributions[candidate.index]);
 
         const double streamline_density_ratio =
-            candidate->get_cost_gradient() / (sum_contributing_length - contributing_length_removed);
+            candidate.gradient / (sum_contributing_length - contributing_length_removed);
         const double required_cf_change_ratio = -term_ratio * streamline_density_ratio * current_cf;
 
-        const TrackContribution &candidate_contribution(*contributions[candidate_index]);
-
-        const double old_mu = mu();
-        const double new_mu = FOD_sum / (TD_sum - candidate_contribution.get_total_contribution());
-        const double mu_change = new_mu - old_mu;
-
-        // Initial estimate of cost change knowing only the change to the normalisation coefficient
-        double this_actual_cf_change = current_roc_cf * mu_change;
-        double quantisation = 0.0;
-
-        for (size_t f = 0; f != candidate_contribution.dim(); ++f) {
-          const Track_fixel_contribution &fixel_cont = candidate_contribution[f];
-          const float length = fixel_cont.get_length();
-          Fixel &this_fixel = fixels[fixel_cont.get_fixel_index()];
-          quantisation += this_fixel.calc_quantisation(old_mu, length);
-          const double undo_change_mu_only = this_fixel.get_d_cost_d_mu(old_mu) * mu_change;
-          const double change_remove_tck = this_fixel.get_cost_wo_track(new_mu, length) - this_fixel.get_cost(old_mu);
-          this_actual_cf_change = this_actual_cf_change - undo_change_mu_only + change_remove_tck;
-        }
-
-        const double required_cf_change_quantisation = enforce_quantisation ? (-0.5 * quantisation) : 0.0;
-        const double this_nonlinearity = (candidate->get_cost_gradient() - this_actual_cf_change);
+        const double required_cf_change_quantisation = enforce_quantisation ? (-0.5 * candidate.quantisation) : 0.0;
+        const double this_nonlinearity = (candidate.gradient - candidate.cf_change);
 
-        if (this_actual_cf_change <
+        if (candidate.cf_change <
             std::min({required_cf_change_ratio, required_cf_change_quantisation, this_nonlinearity})) {
 
           // Candidate streamline removal meets all criteria; remove from reconstruction
-          for (size_t f = 0; f != candidate_contribution.dim(); ++f) {
-            const Track_fixel_contribution &fixel_cont = candidate_contribution[f];
-            fixels[fixel_cont.get_fixel_index()] -= fixel_cont.get_length();
-          }
+          //   (the fixels to which it was attributed are updated along with the rest of the batch)
+          const TrackContribution candidate_contribution(contributions[candidate.index]);
           TD_sum -= candidate_contribution.get_total_contribution();
           contributing_length_removed += candidate_contribution.get_total_length();
-          delete contributions[candidate_index];
-          contributions[candidate_index] = nullptr;
+          ++next_in_batch;
           ++removed_this_iteration;
           --tracks_remaining;
 
@@ -242,9 +265,9 @@ void SIFTer::perform_filtering() {
 
           // Removal doesn't meet all criteria
 
-          if (this_actual_cf_change >= this_nonlinearity)
+          if (candidate.cf_change >= this_nonlinearity)
             recalculate = NONLINEARITY;
-          else if (term_ratio && this_actual_cf_change >= required_cf_change_ratio)
+          else if (term_ratio && candidate.cf_change >= required_cf_change_ratio)
             recalculate = TERM_RATIO;
           else
             recalculate = QUANTISATION;
@@ -275,6 +298,8 @@ void SIFTer::perform_filtering() {
 
   end_iteration:
 
+    apply_batch(batch, applied_in_batch, next_in_batch);
+    removal_rate = removed_this_iteration / std::max(iteration_timer.elapsed(), 1.0e-6);
     cf_end_iteration = calc_cost_function();
 
     progress.update(display_func);
@@ -343,6 +368,87 @@ void SIFTer::perform_filtering() {
   INFO("Proportionality coefficient at end of filtering is " + str(mu()));
 }
 
+void SIFTer::fill_batch(MT_gradient_vector_sorter &sorter,
+                        const std::vector<Cost_fn_gradient_sort>::iterator end,
+                        std::vector<Removal> &batch,
+                        std::vector<Removal> &deferred,
+                        bool &exhausted) {
+  if (fixel_batch.size() != fixels.size())
+    fixel_batch.assign(fixels.size(), 0);
+  ++batch_counter;
+  auto add = [&](const Removal &candidate) {
+    const TrackContribution candidate_contribution(contributions[candidate.index]);
+    for (const auto &fixel_cont : candidate_contribution) {
+      if (fixel_batch[fixel_cont.get_fixel_index()] == batch_counter)
+        return false;
+    }
+    for (const auto &fixel_cont : candidate_contribution)
+      fixel_batch[fixel_cont.get_fixel_index()] = batch_counter;
+    batch.push_back(candidate);
+    return true;
+  };
+
+  batch.clear();
+  std::vector<Removal> still_deferred;
+  for (const auto &candidate : deferred) {
+    if (!add(candidate))
+      still_deferred.push_back(candidate);
+  }
+  while (!exhausted && batch.size() < removal_batch_size && still_deferred.size() < removal_batch_size) {
+    const std::vector<Cost_fn_gradient_sort>::iterator candidate = sorter.get();
+    if (candidate == end || candidate->get_cost_gradient() >= 0.0) {
+      exhausted = true;
+      break;
+    }
+    assert(candidate->get_tck_index() != num_tracks());
+    const Removal removal(candidate->get_tck_index(), candidate->get_cost_gradient());
+    if (!add(removal))
+      still_deferred.push_back(removal);
+  }
+  deferred.swap(still_deferred);
+
+  // Proportionality coefficient before and after the removal of each candidate,
+  //   assuming that all preceding candidates in the batch have been removed
+  double TD_remaining = TD_sum;
+  for (auto &candidate : batch) {
+    candidate.old_mu = FOD_sum / TD_remaining;
+    TD_remaining -= contributions[candidate.index].get_total_contribution();
+    candidate.new_mu = FOD_sum / TD_remaining;
+  }
+}
+
+void SIFTer::evaluate_batch(std::vector<Removal> &batch, const double current_roc_cf) const {
+  for_each_chunk(batch.size(), [&](const size_t from, const size_t to) {
+    for (size_t i = from; i != to; ++i) {
+      Removal &candidate(batch[i]);
+      const double mu_change = candidate.new_mu - candidate.old_mu;
+      // Initial estimate of cost change knowing only the change to the normalisation coefficient
+      candidate.cf_change = current_roc_cf * mu_change;
+      candidate.quantisation = 0.0;
+      for (const auto &fixel_cont : contributions[candidate.index]) {
+        const float length = fixel_cont.get_length();
+        const Fixel &this_fixel = fixels[fixel_cont.get_fixel_index()];
+        candidate.quantisation += this_fixel.calc_quantisation(candidate.old_mu, length);
+        const double undo_change_mu_only = this_fixel.get_d_cost_d_mu(candidate.old_mu) * mu_change;
+        const double change_remove_tck =
+            this_fixel.get_cost_wo_track(candidate.new_mu, length) - this_fixel.get_cost(candidate.old_mu);
+        candidate.cf_change = candidate.cf_change - undo_change_mu_only + change_remove_tck;
+      }
+    }
+  });
+}
+
+void SIFTer::apply_batch(const std::vector<Removal> &batch, const size_t from, const size_t to) {
+  for_each_chunk(to - from, [&](const size_t first, const size_t last) {
+    for (size_t i = from + first; i != from + last; ++i) {
+      const track_t index = batch[i].index;
+      for (const auto &fixel_cont : contributions[index])
+        fixels[fixel_cont.get_fixel_index()] -= fixel_cont.get_length();
+      contributions.erase(index);
+    }
+  });
+}
+
 void SIFTer::output_filtered_tracks(const std::string &input_path, const std::string &output_path) const {
   Tractography::Properties p;
   Tractography::Reader<float> reader(input_path, p);
@@ -431,16 +537,16 @@ double SIFTer::calc_roc_cost_function() const {
 double SIFTer::calc_gradient(const track_t index, const double current_mu, const double current_roc_cost) const {
   if (!contributions[index])
     return std::numeric_limits<double>::max();
-  const TrackContribution &tck_cont = *contributions[index];
+  const TrackContribution tck_cont(contributions[index]);
   const double TD_sum_if_removed = TD_sum - tck_cont.get_total_contribution();
   const double mu_if_removed = FOD_sum / TD_sum_if_removed;
   const double mu_change_if_removed = mu_if_removed - current_mu;
   double gradient = current_roc_cost * mu_change_if_removed;
-  for (size_t f = 0; f != tck_cont.dim(); ++f) {
-    const Fixel &fixel = fixels[tck_cont[f].get_fixel_index()];
+  for (const auto &fixel_cont : tck_cont) {
+    const Fixel &fixel = fixels[fixel_cont.get_fixel_index()];
     const double undo_gradient_mu_only = fixel.get_d_cost_d_mu(current_mu) * mu_change_if_removed;
     const double gradient_remove_tck =
-        fixel.get_cost_wo_track(mu_if_removed, tck_cont[f].get_length()) - fixel.get_cost(current_mu);
+        fixel.get_cost_wo_track(mu_if_removed, fixel_cont.get_length()) - fixel.get_cost(current_mu);
     gradient = gradient - undo_gradient_mu_only + gradient_remove_tck;
   }
   return gradient;
@@ -448,11 +554,11 @@ double SIFTer::calc_gradient(const track_t index, const double current_mu, const
 
 bool SIFTer::TrackGradientCalculator::operator()(const TrackIndexRange &in) const {
   for (track_t track_index = in.first; track_index != in.second; ++track_index) {
-    if (master.contributions[track_index]) {
+    const TrackContribution tck_cont(master.contributions[track_index]);
+    if (tck_cont) {
       const double gradient = master.calc_gradient(track_index, current_mu, current_roc_cost);
-      const double grad_per_unit_length = master.contributions[track_index]->get_total_contribution()
-                                              ? (gradient / master.contributions[track_index]->get_total_contribution())
-                                              : 0.0;
+      const double grad_per_unit_length =
+          tck_cont.get_total_contribution() ? (gradient / tck_cont.get_total_contribution()) : 0.0;
       gradient_vector[track_index].set(track_index, gradient, grad_per_unit_length);
     } else {
       gradient_vector[track_index].set(master.num_tracks(), 0.0, 0.0);
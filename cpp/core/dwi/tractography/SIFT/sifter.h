@@ -41,7 +41,7 @@ class SIFTer : public Model<Fixel> {
 
 public:
   SIFTer(Image<float> &i, const DWI::Directions::FastLookupSet &d)
-      : MapType(i, d), term_number(0), term_ratio(0.0), term_mu(0.0), enforce_quantisation(true) {}
+      : MapType(i, d), term_number(0), term_ratio(0.0), term_mu(0.0), enforce_quantisation(true), batch_counter(0) {}
 
   SIFTer(const SIFTer &that) = delete;
 
@@ -85,6 +85,26 @@ class SIFTer : public Model<Fixel> {
   double calc_roc_cost_function() const;
   double calc_gradient(const track_t, const double, const double) const;
 
+  // A candidate for streamline removal, and the consequences of removing it
+  class Removal {
+  public:
+    Removal(const track_t index, const double gradient)
+        : index(index), gradient(gradient), old_mu(0.0), new_mu(0.0), cf_change(0.0), quantisation(0.0) {}
+    track_t index;
+    double gradient, old_mu, new_mu, cf_change, quantisation;
+  };
+
+  // Candidates for removal are processed in batches, within which no two streamlines traverse the same fixel
+  std::vector<track_t> fixel_batch;
+  track_t batch_counter;
+  void fill_batch(MT_gradient_vector_sorter &,
+                  const std::vector<Cost_fn_gradient_sort>::iterator,
+                  std::vector<Removal> &,
+                  std::vector<Removal> &,
+                  bool &);
+  void evaluate_batch(std::vector<Removal> &, const double) const;
+  void apply_batch(const std::vector<Removal> &, const size_t, const size_t);
+
   // For calculating the streamline removal gradients in a multi-threaded fashion
   class TrackGradientCalculator {
   public:
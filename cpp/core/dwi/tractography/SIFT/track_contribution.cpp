@@ -16,10 +16,62 @@
 
 #include "dwi/tractography/SIFT/track_contribution.h"
 
+#include <cassert>
+
 namespace MR::DWI::Tractography::SIFT {
 
 float Track_fixel_contribution::scale_to_storage = 0.0;
 float Track_fixel_contribution::scale_from_storage = 0.0;
 float Track_fixel_contribution::min_length_for_storage = 0.0;
 
+namespace {
+size_t varint_size(uint32_t value) {
+  size_t size = 1;
+  while (value >>= 7)
+    ++size;
+  return size;
+}
+uint8_t *write_varint(uint32_t value, uint8_t *out) {
+  while (value >= 0x80) {
+    *out++ = uint8_t(value) | 0x80;
+    value >>= 7;
+  }
+  *out++ = uint8_t(value);
+  return out;
+}
+} // namespace
+
+size_t TrackContribution::bytes() const {
+  if (!data)
+    return 0;
+  const uint8_t *p = data;
+  for (uint32_t remaining = read_varint(p); remaining; --remaining) {
+    read_varint(p);
+    ++p;
+  }
+  return p - data;
+}
+
+size_t TrackContribution::encoded_size(const std::vector<Track_fixel_contribution> &contributions) {
+  size_t size = varint_size(contributions.size());
+  uint32_t previous = 0;
+  for (const auto &c : contributions) {
+    assert(c.get_fixel_index() >= previous);
+    size += varint_size(c.get_fixel_index() - previous) + 1;
+    previous = c.get_fixel_index();
+  }
+  return size;
+}
+
+uint8_t *TrackContribution::encode(const std::vector<Track_fixel_contribution> &contributions, uint8_t *out) {
+  out = write_varint(contributions.size(), out);
+  uint32_t previous = 0;
+  for (const auto &c : contributions) {
+    out = write_varint(c.get_fixel_index() - previous, out);
+    *out++ = uint8_t(c.length);
+    previous = c.get_fixel_index();
+  }
+  return out;
+}
+
 } // namespace MR::DWI::Tractography::SIFT
@@ -16,38 +16,44 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
+#include <iterator>
+#include <vector>
 
 #include "header.h"
-#include "min_mem_array.h"
 
 #include "math/math.h"
 
 namespace MR::DWI::Tractography::SIFT {
 
+// The contribution of a single streamline to a single fixel: the fixel index, and the length
+//   of the streamline within that fixel, quantised to 8 bits
+// This is only used to construct and traverse the contributions of each streamline; these are
+//   stored in compressed form (see TrackContribution and ContributionStore)
 class Track_fixel_contribution {
 public:
-  Track_fixel_contribution(const uint32_t fixel_index, const float length) {
-    const uint32_t length_as_int = std::min(uint32_t(255), uint32_t(std::round(scale_to_storage * length)));
-    data = (fixel_index & 0x00FFFFFF) | (length_as_int << 24);
-  }
+  Track_fixel_contribution(const uint32_t fixel_index, const float length)
+      : fixel_index(fixel_index),
+        length(std::min(uint32_t(255), uint32_t(std::round(scale_to_storage * length)))) {}
 
-  Track_fixel_contribution() : data(0) {}
+  Track_fixel_contribution() : fixel_index(0), length(0) {}
 
-  uint32_t get_fixel_index() const { return (data & 0x00FFFFFF); }
-  float get_length() const { return (uint32_t((data & 0xFF000000) >> 24) * scale_from_storage); }
+  uint32_t get_fixel_index() const { return fixel_index; }
+  float get_length() const { return length * scale_from_storage; }
 
   bool add(const float length) {
     // Allow summing of multiple contributions to a fixel, UNLESS it would cause truncation, in which
     //   case keep them separate
     const uint32_t increment = std::round(scale_to_storage * length);
-    const uint32_t existing = (data & 0xFF000000) >> 24;
-    if (existing + increment > 255)
+    if (this->length + increment > 255)
       return false;
-    data = (data & 0x00FFFFFF) | ((existing + increment) << 24);
+    this->length += increment;
     return true;
   }
 
+  bool operator<(const Track_fixel_contribution &that) const { return fixel_index < that.fixel_index; }
+
   static void set_scaling(const Header &H) {
     const float max_length = std::sqrt(Math::pow2(H.spacing(0)) + Math::pow2(H.spacing(1)) + Math::pow2(H.spacing(2)));
     // TODO Newer mapping performs chordal approximation of length
@@ -57,64 +63,97 @@ class Track_fixel_contribution {
     min_length_for_storage = 0.5 / scale_to_storage;
   }
 
-  // Minimum length that will be non-zero once converted to an integer for word-sharing storage
+  // Minimum length that will be non-zero once converted to an integer for storage
   static float min() { return min_length_for_storage; }
 
 private:
-  uint32_t data;
+  uint32_t fixel_index;
+  uint32_t length;
 
   static float scale_to_storage, scale_from_storage, min_length_for_storage;
-};
-
-/*
-// This is a 'safe' version of Track_fixel_contribution that does not use byte-sharing, but requires double the RAM
-// Simply comment the class above and un-comment this one to use
-class Track_fixel_contribution
-{
-  public:
-    Track_fixel_contribution (const uint32_t fixel_index, const float length) :
-      fixel (fixel_index),
-      length (length) { }
-
-    Track_fixel_contribution() :
-      fixel (0),
-      length (0.0) { }
-
-
-    bool add (const float length) { value += length; return true; }
-
-    uint32_t get_fixel_index() const { return fixel; }
-    float    get_length()      const { return length; }
-
-
-    static void set_scaling (const Image::Info& in) { min_length_for_storage = 0.0; }
-    static float min() { return min_length_for_storage; }
-
-
-  private:
-    uint32_t fixel;
-    float length;
-
-    static float scale_to_storage, scale_from_storage, min_length_for_storage;
 
+  friend class TrackContribution;
 };
-*/
-
-class TrackContribution : public Min_mem_array<Track_fixel_contribution> {
 
+// The fixel contributions of a single streamline, as stored in a ContributionStore
+// The contributions are held in a variable-length byte encoding: the number of contributions,
+//   followed by each contribution in order of increasing fixel index, as the difference in
+//   fixel index from the previous contribution followed by the quantised length in a single byte;
+//   the number of contributions and the index differences are encoded in groups of 7 bits,
+//   with the high bit of each byte set if more bytes follow.
+// This class is a lightweight read-only view onto that encoding; the contributions can only be
+//   traversed in order, e.g. using a range-based for loop
+class TrackContribution {
 public:
-  TrackContribution(const std::vector<Track_fixel_contribution> &in, const float c, const float l)
-      : Min_mem_array<Track_fixel_contribution>(in), total_contribution(c), total_length(l) {}
-
-  TrackContribution() : Min_mem_array<Track_fixel_contribution>(), total_contribution(0.0), total_length(0.0) {}
+  class const_iterator {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = Track_fixel_contribution;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Track_fixel_contribution *;
+    using reference = const Track_fixel_contribution &;
+
+    const_iterator(const uint8_t *data, const uint32_t remaining) : data(data), remaining(remaining) { decode(); }
+    const Track_fixel_contribution &operator*() const { return current; }
+    const Track_fixel_contribution *operator->() const { return &current; }
+    const_iterator &operator++() {
+      --remaining;
+      decode();
+      return *this;
+    }
+    bool operator==(const const_iterator &that) const { return remaining == that.remaining; }
+    bool operator!=(const const_iterator &that) const { return remaining != that.remaining; }
 
-  ~TrackContribution() {}
+  private:
+    const uint8_t *data;
+    uint32_t remaining;
+    Track_fixel_contribution current;
+    void decode() {
+      if (remaining) {
+        current.fixel_index += read_varint(data);
+        current.length = *data++;
+      }
+    }
+  };
+
+  TrackContribution() : data(nullptr), total_contribution(0.0), total_length(0.0) {}
+  TrackContribution(const uint8_t *data, const float c, const float l)
+      : data(data), total_contribution(c), total_length(l) {}
+
+  // False if the streamline has been removed from the reconstruction
+  explicit operator bool() const { return data; }
+
+  size_t dim() const {
+    const uint8_t *p = data;
+    return data ? read_varint(p) : 0;
+  }
+  const_iterator begin() const {
+    const uint8_t *p = data;
+    const uint32_t count = data ? read_varint(p) : 0;
+    return const_iterator(p, count);
+  }
+  const_iterator end() const { return const_iterator(nullptr, 0); }
 
   float get_total_contribution() const { return total_contribution; }
   float get_total_length() const { return total_length; }
 
+  // Number of bytes occupied by the encoded contributions
+  size_t bytes() const;
+
+  // Encoding of a set of contributions; these must be sorted by fixel index
+  static size_t encoded_size(const std::vector<Track_fixel_contribution> &contributions);
+  static uint8_t *encode(const std::vector<Track_fixel_contribution> &contributions, uint8_t *out);
+
 private:
-  const float total_contribution, total_length;
+  const uint8_t *data;
+  float total_contribution, total_length;
+
+  static uint32_t read_varint(const uint8_t *&p) {
+    uint32_t value = *p & 0x7F;
+    for (uint32_t shift = 7; *p++ & 0x80; shift += 7)
+      value |= uint32_t(*p & 0x7F) << shift;
+    return value;
+  }
 };
 
 } // namespace MR::DWI::Tractography::SIFT
@@ -92,8 +92,10 @@ CoefficientOptimiserBase::~CoefficientOptimiserBase() {
 
 bool CoefficientOptimiserBase::operator()(const SIFT::TrackIndexRange &range) {
 
-  for (SIFT::track_t track_index = range.first; track_index != range.second; ++track_index) {
+  for (SIFT::track_t i = range.first; i != range.second; ++i) {
 
+    // If the contribution matrix has been assembled, traverse the streamlines in the order of its rows
+    const SIFT::track_t track_index = master.matrix ? master.matrix->track(i) : i;
     double dFs = get_coeff_change(track_index);
 
 #ifdef SIFT2_COEFF_OPTIMISER_DEBUG
@@ -133,8 +135,7 @@ bool CoefficientOptimiserBase::operator()(const SIFT::TrackIndexRange &range) {
     // Update the stats
     local_stats_steps += dFs;
     local_stats_coefficients += new_coefficient;
-    if (master.contributions[track_index] && master.contributions[track_index]->dim() &&
-        new_coefficient > master.min_coeff)
+    if (master.contributions[track_index].dim() && new_coefficient > master.min_coeff)
       ++local_nonzero_count;
 
 #ifdef STREAMLINE_OF_INTEREST
@@ -163,15 +164,15 @@ bool CoefficientOptimiserBase::operator()(const SIFT::TrackIndexRange &range) {
 }
 
 double CoefficientOptimiserBase::do_fixel_exclusion(const SIFT::track_t track_index) {
-  const SIFT::TrackContribution &this_contribution(*(master.contributions[track_index]));
+  const SIFT::TrackContribution this_contribution(master.contributions[track_index]);
 
   // Task 1: Identify the fixel that should be excluded
   size_t index_to_exclude = 0.0;
   float cost_to_exclude = 0.0;
 
-  for (size_t j = 0; j != this_contribution.dim(); ++j) {
-    const size_t fixel_index = this_contribution[j].get_fixel_index();
-    const float length = this_contribution[j].get_length();
+  for (const auto &c : this_contribution) {
+    const size_t fixel_index = c.get_fixel_index();
+    const float length = c.get_length();
     const Fixel &fixel = master.fixels[fixel_index];
     if (!fixel.is_excluded() && (fixel.get_diff(mu) < 0.0)) {
 
@@ -191,9 +192,9 @@ double CoefficientOptimiserBase::do_fixel_exclusion(const SIFT::track_t track_in
   // Task 2: Calculate a new coefficient for this streamline
   double weighted_sum = 0.0, sum_weights = 0.0;
 
-  for (size_t j = 0; j != this_contribution.dim(); ++j) {
-    const size_t fixel_index = this_contribution[j].get_fixel_index();
-    const float length = this_contribution[j].get_length();
+  for (const auto &c : this_contribution) {
+    const size_t fixel_index = c.get_fixel_index();
+    const float length = c.get_length();
     const Fixel &fixel = master.fixels[fixel_index];
     if (!fixel.is_excluded() && (fixel_index != index_to_exclude)) {
 
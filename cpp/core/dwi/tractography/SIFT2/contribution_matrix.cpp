@@ -0,0 +1,137 @@
+/* Copyright (c) 2008-2024 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "dwi/tractography/SIFT2/contribution_matrix.h"
+
+#include <algorithm>
+
+#include "exception.h"
+#include "thread_queue.h"
+
+#include "dwi/tractography/SIFT/track_index_range.h"
+
+namespace MR::DWI::Tractography::SIFT2 {
+
+namespace {
+
+// Count the contributions of each streamline, and find the first fixel traversed by it
+class RowCounter {
+public:
+  RowCounter(const SIFT::ContributionStore &contributions,
+             std::vector<uint64_t> &counts,
+             std::vector<uint32_t> &first_fixels)
+      : contributions(contributions), counts(counts), first_fixels(first_fixels) {}
+  bool operator()(const SIFT::TrackIndexRange &range) const {
+    for (SIFT::track_t track_index = range.first; track_index != range.second; ++track_index) {
+      const SIFT::TrackContribution this_contribution(contributions[track_index]);
+      counts[track_index] = this_contribution.dim();
+      first_fixels[track_index] = counts[track_index] ? this_contribution.begin()->get_fixel_index() : 0;
+    }
+    return true;
+  }
+
+private:
+  const SIFT::ContributionStore &contributions;
+  std::vector<uint64_t> &counts;
+  std::vector<uint32_t> &first_fixels;
+};
+
+// Fill the CSR form of the matrix, given the offset of each row
+class RowFiller {
+public:
+  RowFiller(const SIFT::ContributionStore &contributions, ContributionMatrix &matrix)
+      : contributions(contributions), matrix(matrix) {}
+  bool operator()(const SIFT::TrackIndexRange &range) const {
+    for (SIFT::track_t row = range.first; row != range.second; ++row) {
+      uint64_t k = matrix.row_start[row];
+      for (const auto &c : contributions[matrix.track(row)]) {
+        matrix.row_fixel[k] = c.get_fixel_index();
+        matrix.row_length[k++] = c.get_length();
+      }
+    }
+    return true;
+  }
+
+private:
+  const SIFT::ContributionStore &contributions;
+  ContributionMatrix &matrix;
+};
+
+} // namespace
+
+ContributionMatrix::ContributionMatrix(const SIFT::ContributionStore &contributions, const size_t num_fixels) {
+  const SIFT::track_t num_tracks = contributions.size();
+  try {
+    std::vector<uint64_t> counts(num_tracks);
+    {
+      std::vector<uint32_t> first_fixels(num_tracks);
+      SIFT::TrackIndexRangeWriter writer(SIFT_TRACK_INDEX_BUFFER_SIZE, num_tracks);
+      RowCounter counter(contributions, counts, first_fixels);
+      Thread::run_queue(writer, SIFT::TrackIndexRange(), Thread::multi(counter));
+
+      order.resize(num_tracks);
+      for (SIFT::track_t i = 0; i != num_tracks; ++i)
+        order[i] = i;
+      std::sort(order.begin(), order.end(), [&](const SIFT::track_t a, const SIFT::track_t b) {
+        return first_fixels[a] < first_fixels[b] || (first_fixels[a] == first_fixels[b] && a < b);
+      });
+    }
+    row_of_track.resize(num_tracks);
+    row_start.resize(num_tracks + 1);
+    row_start[0] = 0;
+    for (SIFT::track_t row = 0; row != num_tracks; ++row) {
+      row_of_track[order[row]] = row;
+      row_start[row + 1] = row_start[row] + counts[order[row]];
+    }
+
+    row_fixel.resize(row_start.back());
+    row_length.resize(row_start.back());
+    {
+      SIFT::TrackIndexRangeWriter writer(SIFT_TRACK_INDEX_BUFFER_SIZE, num_tracks);
+      RowFiller filler(contributions, *this);
+      Thread::run_queue(writer, SIFT::TrackIndexRange(), Thread::multi(filler));
+    }
+
+    // Transpose: within each column, rows are filled in increasing order
+    col_start.assign(num_fixels + 1, 0);
+    for (const auto fixel : row_fixel)
+      ++col_start[fixel + 1];
+    for (size_t f = 0; f != num_fixels; ++f)
+      col_start[f + 1] += col_start[f];
+    col_row.resize(row_start.back());
+    col_length.resize(row_start.back());
+    std::vector<uint64_t> position(col_start.begin(), col_start.end() - 1);
+    for (SIFT::track_t row = 0; row != num_tracks; ++row) {
+      for (uint64_t k = row_start[row]; k != row_start[row + 1]; ++k) {
+        const uint64_t p = position[row_fixel[k]]++;
+        col_row[p] = row;
+        col_length[p] = row_length[k];
+      }
+    }
+  } catch (std::bad_alloc &) {
+    throw Exception("Error allocating memory for streamline-fixel contribution matrix");
+  }
+  INFO("Streamline-fixel contribution matrix has " + str(nonzeros()) + " non-zero entries, occupying " +
+       str(footprint() >> 20) + " MB");
+}
+
+size_t ContributionMatrix::footprint() const {
+  return row_start.size() * sizeof(uint64_t) + row_fixel.size() * (sizeof(uint32_t) + sizeof(float)) +
+         col_start.size() * sizeof(uint64_t) + col_row.size() * (sizeof(SIFT::track_t) + sizeof(float)) +
+         (order.size() + row_of_track.size()) * sizeof(SIFT::track_t);
+}
+
+} // namespace MR::DWI::Tractography::SIFT2
@@ -0,0 +1,65 @@
+/* Copyright (c) 2008-2024 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "types.h"
+
+#include "dwi/tractography/SIFT/contribution_store.h"
+#include "dwi/tractography/SIFT/types.h"
+
+namespace MR::DWI::Tractography::SIFT2 {
+
+// The matrix of streamline-fixel contributions (the length of each streamline within each fixel),
+//   assembled once and held in both compressed sparse row (CSR) and compressed sparse column (CSC) form
+// Each row corresponds to a streamline and each column to a fixel. The rows are ordered by the first fixel
+//   traversed by each streamline, such that streamlines that traverse the same fixels tend to be adjacent;
+//   within each column of the CSC form, the rows are in increasing order. This allows each iteration of SIFT2
+//   to update the fixels through column-wise reductions, and each streamline through row-wise traversals,
+//   with contiguous memory access throughout and without the need for per-thread copies of the fixel data.
+class ContributionMatrix {
+public:
+  ContributionMatrix(const SIFT::ContributionStore &contributions, const size_t num_fixels);
+
+  SIFT::track_t rows() const { return order.size(); }
+  size_t cols() const { return col_start.size() - 1; }
+  uint64_t nonzeros() const { return row_fixel.size(); }
+  size_t footprint() const;
+
+  // The streamline corresponding to each row, and the row corresponding to each streamline
+  SIFT::track_t track(const SIFT::track_t row) const { return order[row]; }
+  SIFT::track_t row(const SIFT::track_t track) const { return row_of_track[track]; }
+
+  // CSR: the fixels traversed by the streamline in row r are row_fixel[k] for k in [row_start[r], row_start[r+1]),
+  //   with lengths row_length[k]
+  std::vector<uint64_t> row_start;
+  std::vector<uint32_t> row_fixel;
+  std::vector<float> row_length;
+
+  // CSC: the rows of the streamlines traversing fixel f are col_row[k] for k in [col_start[f], col_start[f+1]),
+  //   with lengths col_length[k]
+  std::vector<uint64_t> col_start;
+  std::vector<SIFT::track_t> col_row;
+  std::vector<float> col_length;
+
+private:
+  std::vector<SIFT::track_t> order, row_of_track;
+};
+
+} // namespace MR::DWI::Tractography::SIFT2
@@ -40,11 +40,11 @@ FixelUpdater::~FixelUpdater() {
 bool FixelUpdater::operator()(const SIFT::TrackIndexRange &range) {
   for (SIFT::track_t track_index = range.first; track_index != range.second; ++track_index) {
     const double coefficient = master.coefficients[track_index];
-    const SIFT::TrackContribution &this_contribution(*(master.contributions[track_index]));
+    const SIFT::TrackContribution this_contribution(master.contributions[track_index]);
     const double weighting_factor = (coefficient > master.min_coeff) ? std::exp(coefficient) : 0.0;
-    for (size_t j = 0; j != this_contribution.dim(); ++j) {
-      const size_t fixel_index = this_contribution[j].get_fixel_index();
-      const float length = this_contribution[j].get_length();
+    for (const auto &c : this_contribution) {
+      const size_t fixel_index = c.get_fixel_index();
+      const float length = c.get_length();
       fixel_coeff_sums[fixel_index] += length * coefficient;
       fixel_TDs[fixel_index] += length * weighting_factor;
       fixel_counts[fixel_index]++;
@@ -53,4 +53,19 @@ bool FixelUpdater::operator()(const SIFT::TrackIndexRange &range) {
   return true;
 }
 
+bool SparseFixelUpdater::operator()(const SIFT::TrackIndexRange &range) const {
+  const ContributionMatrix &matrix(*master.matrix);
+  for (size_t fixel_index = range.first; fixel_index != range.second; ++fixel_index) {
+    double coeff_sum = 0.0, TD = 0.0;
+    for (uint64_t k = matrix.col_start[fixel_index]; k != matrix.col_start[fixel_index + 1]; ++k) {
+      const float length = matrix.col_length[k];
+      coeff_sum += length * row_coefficients[matrix.col_row[k]];
+      TD += length * row_weights[matrix.col_row[k]];
+    }
+    master.fixels[fixel_index].add_to_mean_coeff(coeff_sum);
+    master.fixels[fixel_index].add_TD(TD, matrix.col_start[fixel_index + 1] - matrix.col_start[fixel_index]);
+  }
+  return true;
+}
+
 } // namespace MR::DWI::Tractography::SIFT2
@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include <vector>
+
 #include "types.h"
 
 #include "dwi/tractography/SIFT/track_index_range.h"
@@ -42,4 +44,23 @@ class FixelUpdater {
   std::vector<SIFT::track_t> fixel_counts;
 };
 
+// Equivalent to FixelUpdater, but using the column-wise form of the streamline-fixel contribution matrix;
+//   each range provided is a range of fixels, which are updated directly
+// The coefficients and weighting factors of the streamlines must be provided in the order of the matrix rows
+class SparseFixelUpdater {
+
+public:
+  SparseFixelUpdater(TckFactor &tckfactor,
+                     const std::vector<double> &row_coefficients,
+                     const std::vector<double> &row_weights)
+      : master(tckfactor), row_coefficients(row_coefficients), row_weights(row_weights) {}
+
+  bool operator()(const SIFT::TrackIndexRange &range) const;
+
+private:
+  TckFactor &master;
+  const std::vector<double> &row_coefficients;
+  const std::vector<double> &row_weights;
+};
+
 } // namespace MR::DWI::Tractography::SIFT2
@@ -27,12 +27,22 @@ LineSearchFunctor::LineSearchFunctor(const SIFT::track_t index, const TckFactor
       reg_tik(tckfactor.reg_multiplier_tikhonov),
       // Pre-scale reg_tv by total streamline contribution; each fixel then contributes (PM * length),
       //   and the whole thing is appropriately normalised
-      reg_tv(tckfactor.reg_multiplier_tv / tckfactor.contributions[track_index]->get_total_contribution()) {
-  const SIFT::TrackContribution &track_contribution = *tckfactor.contributions[track_index];
-  for (size_t i = 0; i != track_contribution.dim(); ++i) {
-    const SIFT2::Fixel &fixel(tckfactor.fixels[track_contribution[i].get_fixel_index()]);
+      reg_tv(tckfactor.reg_multiplier_tv / tckfactor.contributions[track_index].get_total_contribution()) {
+  if (tckfactor.matrix) {
+    const ContributionMatrix &matrix(*tckfactor.matrix);
+    const SIFT::track_t row = matrix.row(track_index);
+    for (uint64_t k = matrix.row_start[row]; k != matrix.row_start[row + 1]; ++k) {
+      const SIFT2::Fixel &fixel(tckfactor.fixels[matrix.row_fixel[k]]);
+      if (!fixel.is_excluded())
+        fixels.push_back(Fixel(matrix.row_fixel[k], matrix.row_length[k], tckfactor, Fs, fixel.get_mean_coeff()));
+    }
+    return;
+  }
+  const SIFT::TrackContribution track_contribution(tckfactor.contributions[track_index]);
+  for (const auto &c : track_contribution) {
+    const SIFT2::Fixel &fixel(tckfactor.fixels[c.get_fixel_index()]);
     if (!fixel.is_excluded())
-      fixels.push_back(Fixel(track_contribution[i], tckfactor, Fs, fixel.get_mean_coeff()));
+      fixels.push_back(Fixel(c.get_fixel_index(), c.get_length(), tckfactor, Fs, fixel.get_mean_coeff()));
   }
 }
 
@@ -82,12 +92,13 @@ double LineSearchFunctor::operator()(const double dFs) const {
   return (cf_data + (reg_tik * cf_reg_tik) + (reg_tv * cf_reg_tv));
 }
 
-LineSearchFunctor::Fixel::Fixel(const SIFT::Track_fixel_contribution &in,
+LineSearchFunctor::Fixel::Fixel(const uint32_t fixel_index,
+                                const float fixel_length,
                                 const TckFactor &tckfactor,
                                 const double Fs,
                                 const double fixel_coeff_mean)
-    : index(in.get_fixel_index()),
-      length(in.get_length()),
+    : index(fixel_index),
+      length(fixel_length),
       PM(tckfactor.fixels[index].get_weight()),
       TD(tckfactor.fixels[index].get_TD() - (length * std::exp(Fs))),
       cost_frac(length / tckfactor.fixels[index].get_orig_TD()),
@@ -64,7 +64,7 @@ class LineSearchFunctor {
   // Necessary information for those fixels traversed by this streamline
   class Fixel {
   public:
-    Fixel(const SIFT::Track_fixel_contribution &, const TckFactor &, const double, const double);
+    Fixel(const uint32_t, const float, const TckFactor &, const double, const double);
     // void set_damping (const double i) { dTD_dFs *= i; }
     uint32_t index;
     double length, PM, TD, cost_frac, SL_eff, dTD_dFs, meanFs, expmeanFs, FOD;
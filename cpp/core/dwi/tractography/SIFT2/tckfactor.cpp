@@ -84,6 +84,32 @@ void TckFactor::remove_excluded_fixels(const float min_td_frac) {
   }
 }
 
+void TckFactor::assemble_matrix() { matrix.reset(new ContributionMatrix(contributions, fixels.size())); }
+
+void TckFactor::update_fixels() {
+  for (std::vector<Fixel>::iterator i = fixels.begin(); i != fixels.end(); ++i) {
+    i->clear_TD();
+    i->clear_mean_coeff();
+  }
+  if (matrix) {
+    // Gather the streamline coefficients into the order of the matrix rows,
+    //   then compute the fixel sums as products with the transpose of the matrix
+    std::vector<double> row_coefficients(num_tracks()), row_weights(num_tracks());
+    for (SIFT::track_t row = 0; row != num_tracks(); ++row) {
+      const double coefficient = coefficients[matrix->track(row)];
+      row_coefficients[row] = coefficient;
+      row_weights[row] = (coefficient > min_coeff) ? std::exp(coefficient) : 0.0;
+    }
+    SIFT::TrackIndexRangeWriter writer(SIFT_TRACK_INDEX_BUFFER_SIZE, fixels.size());
+    SparseFixelUpdater worker(*this, row_coefficients, row_weights);
+    Thread::run_queue(writer, SIFT::TrackIndexRange(), Thread::multi(worker));
+  } else {
+    SIFT::TrackIndexRangeWriter writer(SIFT_TRACK_INDEX_BUFFER_SIZE, num_tracks());
+    FixelUpdater worker(*this);
+    Thread::run_queue(writer, SIFT::TrackIndexRange(), Thread::multi(worker));
+  }
+}
+
 void TckFactor::test_streamline_length_scaling() {
   VAR(calc_cost_function());
 
@@ -94,11 +120,11 @@ void TckFactor::test_streamline_length_scaling() {
   TD_sum = 0.0;
 
   for (SIFT::track_t track_index = 0; track_index != num_tracks(); ++track_index) {
-    const SIFT::TrackContribution &tck_cont(*contributions[track_index]);
+    const SIFT::TrackContribution tck_cont(contributions[track_index]);
     const double weight = 1.0 / tck_cont.get_total_length();
     coefficients[track_index] = std::log(weight);
-    for (size_t i = 0; i != tck_cont.dim(); ++i)
-      fixels[tck_cont[i].get_fixel_index()] += weight * tck_cont[i].get_length();
+    for (const auto &c : tck_cont)
+      fixels[c.get_fixel_index()] += weight * c.get_length();
     TD_sum += weight * tck_cont.get_total_contribution();
   }
 
@@ -134,12 +160,12 @@ void TckFactor::calc_afcsa() {
     Functor(const Functor &) = default;
     bool operator()(const SIFT::TrackIndexRange &range) const {
       for (SIFT::track_t track_index = range.first; track_index != range.second; ++track_index) {
-        const SIFT::TrackContribution &tckcont = *master.contributions[track_index];
+        const SIFT::TrackContribution tckcont(master.contributions[track_index]);
         double sum_afd = 0.0;
-        for (size_t f = 0; f != tckcont.dim(); ++f) {
-          const size_t fixel_index = tckcont[f].get_fixel_index();
+        for (const auto &c : tckcont) {
+          const size_t fixel_index = c.get_fixel_index();
           const Fixel &fixel = master.fixels[fixel_index];
-          const float length = tckcont[f].get_length();
+          const float length = c.get_length();
           sum_afd += fixel.get_weight() * fixel.get_FOD() * (length / fixel.get_orig_TD());
         }
         if (sum_afd && tckcont.get_total_contribution()) {
@@ -162,15 +188,7 @@ void TckFactor::calc_afcsa() {
     Thread::run_queue(writer, SIFT::TrackIndexRange(), Thread::multi(functor));
   }
 
-  for (std::vector<Fixel>::iterator i = fixels.begin(); i != fixels.end(); ++i) {
-    i->clear_TD();
-    i->clear_mean_coeff();
-  }
-  {
-    SIFT::TrackIndexRangeWriter writer(SIFT_TRACK_INDEX_BUFFER_SIZE, num_tracks());
-    FixelUpdater worker(*this);
-    Thread::run_queue(writer, SIFT::TrackIndexRange(), Thread::multi(worker));
-  }
+  update_fixels();
 
   CONSOLE("Cost function after linear optimisation is " + str(calc_cost_function()) + ")");
 }
@@ -192,7 +210,7 @@ void TckFactor::estimate_factors() {
 
   unsigned int nonzero_streamlines = 0;
   for (SIFT::track_t i = 0; i != num_tracks(); ++i) {
-    if (contributions[i] && contributions[i]->dim())
+    if (contributions[i].dim())
       ++nonzero_streamlines;
   }
 
@@ -271,15 +289,7 @@ void TckFactor::estimate_factors() {
     }
 
     // Multi-threaded calculation of updated streamline density, and mean weighting coefficient, in each fixel
-    for (std::vector<Fixel>::iterator i = fixels.begin(); i != fixels.end(); ++i) {
-      i->clear_TD();
-      i->clear_mean_coeff();
-    }
-    {
-      SIFT::TrackIndexRangeWriter writer(SIFT_TRACK_INDEX_BUFFER_SIZE, num_tracks());
-      FixelUpdater worker(*this);
-      Thread::run_queue(writer, SIFT::TrackIndexRange(), Thread::multi(worker));
-    }
+    update_fixels();
     // Scale the fixel mean coefficient terms (each streamline in the fixel is weighted by its length)
     for (std::vector<Fixel>::iterator i = fixels.begin(); i != fixels.end(); ++i)
       i->normalise_mean_coeff();
@@ -397,18 +407,18 @@ void TckFactor::output_all_debug_images(const std::string &dirpath, const std::s
     ProgressBar progress("Generating streamline coefficient statistic images", num_tracks());
     for (SIFT::track_t i = 0; i != num_tracks(); ++i) {
       const double coeff = coefficients[i];
-      const SIFT::TrackContribution &this_contribution(*contributions[i]);
+      const SIFT::TrackContribution this_contribution(contributions[i]);
       if (coeff > min_coeff) {
-        for (size_t j = 0; j != this_contribution.dim(); ++j) {
-          const size_t fixel_index = this_contribution[j].get_fixel_index();
+        for (const auto &c : this_contribution) {
+          const size_t fixel_index = c.get_fixel_index();
           const double mean_coeff = fixels[fixel_index].get_mean_coeff();
           mins[fixel_index] = std::min(mins[fixel_index], coeff);
           stdevs[fixel_index] += Math::pow2(coeff - mean_coeff);
           maxs[fixel_index] = std::max(maxs[fixel_index], coeff);
         }
       } else {
-        for (size_t j = 0; j != this_contribution.dim(); ++j)
-          ++zeroed[this_contribution[j].get_fixel_index()];
+        for (const auto &c : this_contribution)
+          ++zeroed[c.get_fixel_index()];
       }
       ++progress;
     }
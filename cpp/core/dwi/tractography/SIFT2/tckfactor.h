@@ -18,6 +18,7 @@
 
 #include <fstream>
 #include <limits>
+#include <memory>
 #include <mutex>
 
 #include "image.h"
@@ -28,6 +29,7 @@
 #include "dwi/tractography/SIFT/model.h"
 #include "dwi/tractography/SIFT/output.h"
 
+#include "dwi/tractography/SIFT2/contribution_matrix.h"
 #include "dwi/tractography/SIFT2/fixel.h"
 
 #define SIFT2_REGULARISATION_TIKHONOV_DEFAULT 0.0
@@ -75,6 +77,10 @@ class TckFactor : public SIFT::Model<Fixel> {
 
   void remove_excluded_fixels(const float);
 
+  // Assemble the streamline-fixel contribution matrix in sparse form, and use it for all subsequent
+  //   iterations of the optimisation; this must be done after any fixels are removed from the model
+  void assemble_matrix();
+
   // Function that prints the cost function, then sets the streamline weights according to
   //   the inverse of length, and re-calculates and prints the cost function
   void test_streamline_length_scaling();
@@ -104,17 +110,23 @@ class TckFactor : public SIFT::Model<Fixel> {
 
   double data_scale_term;
 
+  std::unique_ptr<ContributionMatrix> matrix;
+
   friend class LineSearchFunctor;
   friend class CoefficientOptimiserBase;
   friend class CoefficientOptimiserGSS;
   friend class CoefficientOptimiserQLS;
   friend class CoefficientOptimiserIterative;
   friend class FixelUpdater;
+  friend class SparseFixelUpdater;
   friend class RegularisationCalculator;
 
   // For when multiple threads are trying to write their final information back
   std::mutex mutex;
 
+  // Re-calculate the streamline density and mean weighting coefficient in each fixel
+  void update_fixels();
+
   void indicate_progress() {
     if (App::log_level)
       fprintf(stderr, ".");
@@ -35,6 +35,9 @@ class FACT : public MethodBase {
     Shared(const std::string &diff_path, DWI::Tractography::Properties &property_set)
         : SharedBase(diff_path, property_set), num_vec(source.size(3) / 3) {
 
+      // FACT samples the source image directly, rather than its in-RAM copy:
+      source = source.with_direct_io(3);
+
       if (source.size(3) % 3)
         throw Exception("Number of volumes in FACT algorithm input image should be a multiple of 3");
 
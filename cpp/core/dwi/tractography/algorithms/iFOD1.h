@@ -108,12 +108,13 @@ class iFOD1 : public MethodBase {
   iFOD1(const Shared &shared)
       : MethodBase(shared),
         S(shared),
-        source(S.source),
+        source(S.cache()),
         mean_sample_num(0),
         num_sample_runs(0),
         num_truncations(0),
         max_truncation(0.0) {
     calibrate(*this);
+    calibrate_dirs.resize(calibrate_list.size());
   }
 
   ~iFOD1() {
@@ -153,9 +154,13 @@ class iFOD1 : public MethodBase {
     if (!get_data(source))
       return EXIT_IMAGE;
 
+    for (size_t i = 0; i < calibrate_list.size(); ++i)
+      calibrate_dirs[i] = rotate_direction(dir, calibrate_list[i]);
+    FOD(calibrate_dirs, amplitudes);
+
     float max_val = 0.0;
     for (size_t i = 0; i < calibrate_list.size(); ++i) {
-      float val = FOD(rotate_direction(dir, calibrate_list[i]));
+      float val = amplitudes[i];
       if (std::isnan(val))
         return EXIT_IMAGE;
       else if (val > max_val)
@@ -169,6 +174,8 @@ class iFOD1 : public MethodBase {
 
     num_sample_runs++;
 
+    // candidates are drawn and evaluated one at a time, such that no random
+    //   numbers are consumed for candidates that would never be considered
     for (size_t n = 0; n < S.max_trials; n++) {
       Eigen::Vector3f new_dir = rand_dir(dir);
       float val = FOD(new_dir);
@@ -204,16 +211,31 @@ class iFOD1 : public MethodBase {
 
 protected:
   const Shared &S;
-  Interpolator<Image<float>>::type source;
+  SourceCache::Interp source;
   float calibrate_ratio;
   size_t mean_sample_num, num_sample_runs, num_truncations;
   float max_truncation;
   std::vector<Eigen::Vector3f> calibrate_list;
+  std::vector<Eigen::Vector3f> calibrate_dirs;
+  Eigen::VectorXf amplitudes;
+  Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> basis;
 
   float FOD(const Eigen::Vector3f &d) const {
     return (S.precomputer ? S.precomputer.value(values, d) : Math::SH::value(values, d, S.lmax));
   }
 
+  // evaluate the FOD along all directions in dirs at once:
+  void FOD(const std::vector<Eigen::Vector3f> &dirs, Eigen::VectorXf &result) {
+    if (S.precomputer) {
+      S.precomputer.basis(basis, dirs);
+      result.noalias() = basis * values;
+    } else {
+      result.resize(dirs.size());
+      for (size_t n = 0; n < dirs.size(); ++n)
+        result[n] = Math::SH::value(values, dirs[n], S.lmax);
+    }
+  }
+
   Eigen::Vector3f rand_dir(const Eigen::Vector3f &d) {
     return (random_direction(d, S.max_angle_1o, S.sin_max_angle_1o));
   }
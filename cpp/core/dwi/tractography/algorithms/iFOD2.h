@@ -128,7 +128,7 @@ class iFOD2 : public MethodBase {
   iFOD2(const Shared &shared)
       : MethodBase(shared),
         S(shared),
-        source(S.source),
+        source(S.cache()),
         mean_sample_num(0),
         num_sample_runs(0),
         num_truncations(0),
@@ -144,7 +144,7 @@ class iFOD2 : public MethodBase {
   iFOD2(const iFOD2 &that)
       : MethodBase(that.S),
         S(that.S),
-        source(S.source),
+        source(S.cache()),
         calibrate_ratio(that.calibrate_ratio),
         mean_sample_num(0),
         num_sample_runs(0),
@@ -294,7 +294,7 @@ class iFOD2 : public MethodBase {
 
 private:
   const Shared &S;
-  Interpolator<Image<float>>::type source;
+  SourceCache::Interp source;
   float calibrate_ratio, half_log_prob0, last_half_log_probN, half_log_prob0_seed;
   size_t mean_sample_num, num_sample_runs, num_truncations;
   float max_truncation;
@@ -308,6 +308,9 @@ class iFOD2 : public MethodBase {
   //   in the arc - more dense structural image sampling
   size_t sample_idx;
 
+  // SH basis along the tangents of the current path
+  Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> basis;
+
   FORCE_INLINE float FOD(const Eigen::Vector3f &direction) const {
     return (S.precomputer ? S.precomputer.value(values, direction) : Math::SH::value(values, direction, S.lmax));
   }
@@ -333,10 +336,17 @@ class iFOD2 : public MethodBase {
         return 0.0;
     }
 
+    // the SH basis along all tangents of the path is computed in one go, so
+    // that each sample only requires interpolation and a dot product:
+    if (S.precomputer)
+      S.precomputer.basis(basis, tangents);
+
     float log_prob = half_log_prob0;
     for (size_t i = 0; i < S.num_samples; ++i) {
 
-      float fod_amp = FOD(positions[i], tangents[i]);
+      if (!get_data(source, positions[i]))
+        return NaN;
+      float fod_amp = S.precomputer ? basis.row(i).dot(values) : Math::SH::value(values, tangents[i], S.lmax);
       if (std::isnan(fod_amp))
         return NaN;
       if (fod_amp < S.threshold)
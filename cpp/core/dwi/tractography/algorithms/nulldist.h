@@ -41,7 +41,7 @@ class NullDist1 : public MethodBase {
     float sin_max_angle_1o;
   };
 
-  NullDist1(const Shared &shared) : MethodBase(shared), S(shared), source(S.source) {}
+  NullDist1(const Shared &shared) : MethodBase(shared), S(shared), source(S.cache()) {}
 
   bool init() override {
     if (!get_data(source))
@@ -63,7 +63,7 @@ class NullDist1 : public MethodBase {
 
 protected:
   const Shared &S;
-  Interpolator<Image<float>>::type source;
+  SourceCache::Interp source;
 
   Eigen::Vector3f rand_dir(const Eigen::Vector3f &d) {
     return (random_direction(d, S.max_angle_1o, S.sin_max_angle_1o));
@@ -84,7 +84,7 @@ class NullDist2 : public iFOD2 {
   NullDist2(const Shared &shared)
       : iFOD2(shared),
         S(shared),
-        source(S.source),
+        source(S.cache()),
         positions(S.num_samples),
         tangents(S.num_samples),
         sample_idx(S.num_samples) {}
@@ -92,7 +92,7 @@ class NullDist2 : public iFOD2 {
   NullDist2(const NullDist2 &that)
       : iFOD2(that),
         S(that.S),
-        source(S.source),
+        source(S.cache()),
         positions(S.num_samples),
         tangents(S.num_samples),
         sample_idx(S.num_samples) {}
@@ -138,7 +138,7 @@ class NullDist2 : public iFOD2 {
 
 protected:
   const Shared &S;
-  Interpolator<Image<float>>::type source;
+  SourceCache::Interp source;
 
   std::vector<Eigen::Vector3f> positions, tangents;
   size_t sample_idx;
@@ -67,9 +67,9 @@ class SDStream : public MethodBase {
     Math::SH::PrecomputedAL<float> *precomputer;
   };
 
-  SDStream(const Shared &shared) : MethodBase(shared), S(shared), source(S.source) {}
+  SDStream(const Shared &shared) : MethodBase(shared), S(shared), source(S.cache()) {}
 
-  SDStream(const SDStream &that) : MethodBase(that.S), S(that.S), source(S.source) {}
+  SDStream(const SDStream &that) : MethodBase(that.S), S(that.S), source(S.cache()) {}
 
   ~SDStream() {}
 
@@ -114,7 +114,7 @@ class SDStream : public MethodBase {
 
 protected:
   const Shared &S;
-  Interpolator<Image<float>>::type source;
+  SourceCache::Interp source;
 
   float find_peak() {
     float FOD = Math::SH::get_peak(values, S.lmax, dir, S.precomputer);
@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include <optional>
+
 // These lines are to silence deprecation warnings with Eigen & GCC v5
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wdeprecated-declarations"
@@ -66,10 +68,10 @@ class Tensor_Det : public MethodBase {
     Eigen::MatrixXf bmat, binv;
   };
 
-  Tensor_Det(const Shared &shared) : MethodBase(shared), S(shared), source(S.source), eig(3), M(3, 3), dt(6) {}
+  Tensor_Det(const Shared &shared) : MethodBase(shared), S(shared), source(S.cache()), eig(3), M(3, 3), dt(6) {}
 
   bool init() override {
-    if (!get_data(source))
+    if (!get_data(*source))
       return false;
     if (!do_init())
       return false;
@@ -81,21 +83,27 @@ class Tensor_Det : public MethodBase {
   }
 
   term_t next() override {
-    if (!get_data(source))
+    if (!get_data(*source))
       return EXIT_IMAGE;
     return do_next();
   }
 
   float get_metric(const Eigen::Vector3f &position, const Eigen::Vector3f &direction) override {
-    if (!get_data(source, position))
+    if (!get_data(*source, position))
       return 0.0;
     dwi2tensor(dt, S.binv, values);
     return tensor2FA(dt);
   }
 
 protected:
+  struct no_cache_t {};
+
+  // for derived classes that sample the source image themselves, and so
+  // have no need for its in-RAM copy:
+  Tensor_Det(const Shared &shared, no_cache_t) : MethodBase(shared), S(shared), eig(3), M(3, 3), dt(6) {}
+
   const Shared &S;
-  Tracking::Interpolator<Image<float>>::type source;
+  std::optional<Tracking::SourceCache::Interp> source;
   Eigen::SelfAdjointEigenSolver<Eigen::Matrix3f> eig;
   Eigen::Matrix3f M;
   Eigen::VectorXf dt;
@@ -34,6 +34,9 @@ class Tensor_Prob : public Tensor_Det {
     Shared(const std::string &diff_path, DWI::Tractography::Properties &property_set)
         : Tensor_Det::Shared(diff_path, property_set) {
 
+      // the bootstrap resamples the source image directly, rather than its in-RAM copy:
+      source = source.with_direct_io(3);
+
       if (is_act() && act().backtrack())
         throw Exception("Sorry, backtracking not currently enabled for TensorProb algorithm");
 
@@ -46,10 +49,14 @@ class Tensor_Prob : public Tensor_Det {
   };
 
   Tensor_Prob(const Shared &shared)
-      : Tensor_Det(shared), S(shared), source(Bootstrap<Image<float>, WildBootstrap>(S.source, WildBootstrap(S.Hat))) {}
+      : Tensor_Det(shared, no_cache_t()),
+        S(shared),
+        source(Bootstrap<Image<float>, WildBootstrap>(S.source, WildBootstrap(S.Hat))) {}
 
   Tensor_Prob(const Tensor_Prob &F)
-      : Tensor_Det(F.S), S(F.S), source(Bootstrap<Image<float>, WildBootstrap>(S.source, WildBootstrap(S.Hat))) {}
+      : Tensor_Det(F.S, no_cache_t()),
+        S(F.S),
+        source(Bootstrap<Image<float>, WildBootstrap>(S.source, WildBootstrap(S.Hat))) {}
 
   bool init() override {
     source.clear();
@@ -64,6 +71,13 @@ class Tensor_Prob : public Tensor_Det {
     return Tensor_Det::do_next();
   }
 
+  float get_metric(const Eigen::Vector3f &position, const Eigen::Vector3f &direction) override {
+    if (!source.get(position, values))
+      return 0.0;
+    dwi2tensor(dt, S.binv, values);
+    return tensor2FA(dt);
+  }
+
   void truncate_track(GeneratedTrack &tck, const size_t length_to_revert_from, const size_t revert_step) override {
     assert(0);
   }
@@ -0,0 +1,449 @@
+/* Copyright (c) 2008-2024 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "dwi/tractography/compressed_file.h"
+
+#include <sys/stat.h>
+
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <map>
+
+#include <zlib.h>
+
+#include "file/config.h"
+#include "raw.h"
+#include "thread_queue.h"
+
+namespace MR::DWI::Tractography::Compressed {
+
+namespace {
+
+// the uncompressed size at which a block is compressed and written out:
+constexpr size_t block_size = 1 << 20;
+constexpr size_t block_header_size = 16;
+constexpr int compression_level = 6;
+// the trailer: offset of the block index, number of blocks, and magic string
+constexpr size_t trailer_size = 24;
+const char trailer_magic[8] = "TCKZIDX";
+
+void put_varint(std::string &buffer, uint64_t value) {
+  while (value >= 0x80) {
+    buffer.push_back(char(uint8_t(value) | 0x80));
+    value >>= 7;
+  }
+  buffer.push_back(char(value));
+}
+
+void put_float(std::string &buffer, float value) {
+  char bytes[sizeof(float)];
+  Raw::store_LE<float>(value, bytes);
+  buffer.append(bytes, sizeof(float));
+}
+
+inline uint64_t zigzag(int64_t value) { return (uint64_t(value) << 1) ^ uint64_t(value >> 63); }
+inline int64_t unzigzag(uint64_t value) { return int64_t(value >> 1) ^ -int64_t(value & 1); }
+
+class Decoder {
+public:
+  Decoder(const uint8_t *data, size_t size, const std::string &path) : p(data), end(data + size), path(path) {}
+
+  size_t remaining() const { return end - p; }
+
+  uint64_t varint() {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (p == end)
+        error();
+      const uint8_t byte = *p++;
+      value |= uint64_t(byte & 0x7F) << shift;
+      if (!(byte & 0x80))
+        return value;
+    }
+    error();
+    return 0;
+  }
+
+  float get_float() {
+    if (remaining() < sizeof(float))
+      error();
+    const float value = Raw::fetch_LE<float>(p);
+    p += sizeof(float);
+    return value;
+  }
+
+  [[noreturn]] void error() const { throw Exception("corrupt data in compressed track file \"" + path + "\""); }
+
+private:
+  const uint8_t *p, *end;
+  const std::string &path;
+};
+
+} // namespace
+
+// CONF option: TrackCompressionQuantisation
+// CONF default: 0.01
+// CONF The step size (in mm) to which vertex positions are rounded when
+// CONF writing compressed track files (.tckz). The positions read back
+// CONF are within half this distance of those originally written.
+float default_quantisation() {
+  static const float value = File::Config::get_float("TrackCompressionQuantisation", 0.01f);
+  return value;
+}
+
+Writer::Writer(const std::string &file, const Properties &properties, size_t num_scalars, float quantisation)
+    : __WriterBase__<float>(file), nscalars(num_scalars), step(quantisation), data_start(0), streamlines_in_block(0) {
+  if (!std::isfinite(step) || step <= 0.0f)
+    throw Exception("quantisation step for compressed track file must be a positive number");
+
+  try {
+    out.open(name, std::ios::out | std::ios::binary | std::ios::trunc);
+  } catch (Exception &e) {
+    throw Exception(e, "Unable to create output track file");
+  }
+
+  // these are only needed in the header, and are removed again by the reader:
+  Properties &header(const_cast<Properties &>(properties));
+  header["quantisation"] = str(step);
+  if (nscalars)
+    header["scalars"] = str(nscalars);
+  create(out, header, "compressed tracks");
+  header.erase("quantisation");
+  header.erase("scalars");
+
+  data_start = out.tellp();
+  verify_stream(out);
+  open_success = true;
+}
+
+Writer::~Writer() {
+  if (!open_success)
+    return;
+  try {
+    finalise();
+  } catch (Exception &e) {
+    e.display();
+  }
+}
+
+int32_t Writer::quantise(double value) const {
+  const double q = std::round(value / step);
+  if (!(std::abs(q) < double(1 << 30)))
+    throw Exception("vertex position " + str(value) + " cannot be stored in compressed track file \"" + name +
+                    "\" with quantisation step " + str(step));
+  return int32_t(q);
+}
+
+void Writer::append(const int32_t *vertices, size_t num_vertices, float weight, const float *scalars) {
+  put_varint(payload, num_vertices);
+  put_float(payload, weight);
+  for (size_t n = 0; n < num_vertices; ++n) {
+    for (size_t axis = 0; axis < 3; ++axis) {
+      int64_t predicted = 0;
+      if (n == 1)
+        predicted = vertices[axis];
+      else if (n > 1)
+        predicted = 2 * int64_t(vertices[3 * (n - 1) + axis]) - vertices[3 * (n - 2) + axis];
+      put_varint(payload, zigzag(vertices[3 * n + axis] - predicted));
+    }
+  }
+  if (nscalars) {
+    assert(scalars);
+    for (size_t n = 0; n < num_vertices * nscalars; ++n)
+      put_float(payload, scalars[n]);
+  }
+
+  ++count;
+  ++total_count;
+  ++streamlines_in_block;
+  if (payload.size() >= block_size)
+    flush();
+}
+
+void Writer::flush() {
+  if (!streamlines_in_block)
+    return;
+  uLongf compressed_size = compressBound(payload.size());
+  buffer.resize(block_header_size + compressed_size);
+  const Bytef *raw = reinterpret_cast<const Bytef *>(payload.data());
+  if (compress2(buffer.data() + block_header_size, &compressed_size, raw, payload.size(), compression_level) != Z_OK)
+    throw Exception("error compressing streamline data for file \"" + name + "\"");
+  Raw::store_LE<uint32_t>(compressed_size, buffer.data());
+  Raw::store_LE<uint32_t>(payload.size(), buffer.data() + 4);
+  Raw::store_LE<uint32_t>(streamlines_in_block, buffer.data() + 8);
+  Raw::store_LE<uint32_t>(crc32(crc32(0L, Z_NULL, 0), raw, payload.size()), buffer.data() + 12);
+
+  blocks.push_back({uint64_t(int64_t(out.tellp()) - data_start), count - streamlines_in_block});
+  out.write(reinterpret_cast<const char *>(buffer.data()), block_header_size + compressed_size);
+  verify_stream(out);
+  payload.clear();
+  streamlines_in_block = 0;
+}
+
+void Writer::finalise() {
+  flush();
+  buffer.assign(block_header_size, 0);
+  out.write(reinterpret_cast<const char *>(buffer.data()), block_header_size);
+
+  const uint64_t index_offset = int64_t(out.tellp()) - data_start;
+  buffer.resize(16 * blocks.size() + trailer_size);
+  uint8_t *p = buffer.data();
+  for (const auto &block : blocks) {
+    Raw::store_LE<uint64_t>(block.first, p);
+    Raw::store_LE<uint64_t>(block.second, p + 8);
+    p += 16;
+  }
+  Raw::store_LE<uint64_t>(index_offset, p);
+  Raw::store_LE<uint64_t>(blocks.size(), p + 8);
+  memcpy(p + 16, trailer_magic, sizeof(trailer_magic));
+  out.write(reinterpret_cast<const char *>(buffer.data()), buffer.size());
+  verify_stream(out);
+  out.close();
+}
+
+Reader::Reader(const std::string &file, Properties &properties)
+    : nscalars(0),
+      step(0.0f),
+      data(nullptr),
+      size(0),
+      nthreads(0),
+      current_block(0),
+      current(nullptr),
+      position(0) {
+  open(file, "compressed tracks", properties);
+  in.close();
+
+  auto entry = properties.find("quantisation");
+  if (entry == properties.end())
+    throw Exception("no quantisation step specified in compressed track file \"" + file + "\"");
+  step = to<float>(entry->second);
+  properties.erase(entry);
+  entry = properties.find("scalars");
+  if (entry != properties.end()) {
+    nscalars = to<size_t>(entry->second);
+    properties.erase(entry);
+  }
+
+  struct stat sbuf;
+  if (stat(data_file.c_str(), &sbuf))
+    throw Exception("cannot stat track file \"" + data_file + "\": " + strerror(errno));
+  if (sbuf.st_size <= data_offset)
+    return;
+  mmap.reset(new File::MMap(File::Entry(data_file, data_offset)));
+  mmap->set_access(File::MMap::Access::Sequential);
+  data = mmap->address();
+  size = mmap->size();
+  if (!load_index())
+    scan();
+
+  // decide now, since reading may well happen from within a worker thread:
+  if (block_offsets.size() > 1)
+    nthreads = Thread::threads_to_execute();
+}
+
+Reader::~Reader() {}
+
+bool Reader::load_index() {
+  if (size < int64_t(block_header_size + trailer_size))
+    return false;
+  const uint8_t *trailer = data + size - trailer_size;
+  if (memcmp(trailer + 16, trailer_magic, sizeof(trailer_magic)))
+    return false;
+  const uint64_t index_offset = Raw::fetch_LE<uint64_t>(trailer);
+  const uint64_t num_blocks = Raw::fetch_LE<uint64_t>(trailer + 8);
+  if (index_offset < block_header_size || index_offset + 16 * num_blocks != uint64_t(size - trailer_size))
+    return false;
+  block_offsets.resize(num_blocks);
+  for (size_t n = 0; n < num_blocks; ++n) {
+    block_offsets[n] = Raw::fetch_LE<uint64_t>(data + index_offset + 16 * n);
+    if (block_offsets[n] + block_header_size > index_offset || (n && block_offsets[n] <= block_offsets[n - 1])) {
+      block_offsets.clear();
+      return false;
+    }
+  }
+  return true;
+}
+
+void Reader::scan() {
+  DEBUG("no valid block index in compressed track file \"" + data_file + "\" - scanning blocks");
+  int64_t offset = 0;
+  while (offset + int64_t(block_header_size) <= size) {
+    const uint32_t compressed_size = Raw::fetch_LE<uint32_t>(data + offset);
+    if (!compressed_size)
+      return;
+    if (offset + int64_t(block_header_size + compressed_size) > size)
+      break;
+    block_offsets.push_back(offset);
+    offset += block_header_size + compressed_size;
+  }
+  WARN("compressed track file \"" + data_file + "\" is truncated");
+}
+
+void Reader::decode(size_t index, Block &block) const {
+  const int64_t offset = block_offsets[index];
+  const uint8_t *header = data + offset;
+  const uint32_t compressed_size = Raw::fetch_LE<uint32_t>(header);
+  const uint32_t raw_size = Raw::fetch_LE<uint32_t>(header + 4);
+  const uint32_t num_streamlines = Raw::fetch_LE<uint32_t>(header + 8);
+  const uint32_t crc = Raw::fetch_LE<uint32_t>(header + 12);
+  Decoder check(nullptr, 0, data_file);
+  if (offset + int64_t(block_header_size + compressed_size) > size || num_streamlines > raw_size)
+    check.error();
+
+  block.buffer.resize(raw_size);
+  uLongf decompressed_size = raw_size;
+  if (uncompress(block.buffer.data(), &decompressed_size, header + block_header_size, compressed_size) != Z_OK ||
+      decompressed_size != raw_size || crc32(crc32(0L, Z_NULL, 0), block.buffer.data(), raw_size) != crc)
+    check.error();
+
+  Decoder in(block.buffer.data(), raw_size, data_file);
+  block.start.resize(num_streamlines + 1);
+  block.weights.resize(num_streamlines);
+  block.vertices.clear();
+  block.scalars.clear();
+  block.start[0] = 0;
+  for (size_t s = 0; s < num_streamlines; ++s) {
+    const uint64_t num_vertices = in.varint();
+    // every vertex takes at least one byte per axis:
+    if (num_vertices > in.remaining())
+      in.error();
+    block.weights[s] = in.get_float();
+    const size_t first = block.vertices.size();
+    block.vertices.resize(first + 3 * num_vertices);
+    int32_t *v = block.vertices.data() + first;
+    for (size_t n = 0; n < num_vertices; ++n) {
+      for (size_t axis = 0; axis < 3; ++axis) {
+        int64_t predicted = 0;
+        if (n == 1)
+          predicted = v[axis];
+        else if (n > 1)
+          predicted = 2 * int64_t(v[3 * (n - 1) + axis]) - v[3 * (n - 2) + axis];
+        v[3 * n + axis] = int32_t(predicted + unzigzag(in.varint()));
+      }
+    }
+    for (size_t n = 0; n < num_vertices * nscalars; ++n)
+      block.scalars.push_back(in.get_float());
+    block.start[s + 1] = block.start[s] + num_vertices;
+  }
+  if (in.remaining())
+    in.error();
+}
+
+// The decoder threads take successive blocks, and pass them to the reader
+//   via a Thread::Queue once decoded; since these may arrive out of order,
+//   any block received ahead of those preceding it is held back until needed
+class Reader::Decoders {
+public:
+  Decoders(const Reader &reader, const size_t nthreads)
+      : queue("compressed track blocks", 2 * nthreads),
+        queue_reader(queue),
+        in(new Thread::Queue<Block>::Reader::Item(queue_reader)),
+        decoder(reader, queue),
+        threads(Thread::run(Thread::multi(decoder, nthreads), "compressed track decoder threads")) {}
+
+  // once the reader has unregistered from the queue, the decoder threads terminate:
+  ~Decoders() { in.reset(); }
+
+  Block *get(size_t index) {
+    auto it = pending.find(index);
+    if (it != pending.end()) {
+      Block *block = it->second;
+      pending.erase(it);
+      return block;
+    }
+    while (in->read()) {
+      Block *block = in->stash();
+      if (block->index == index)
+        return block;
+      pending[block->index] = block;
+    }
+    return nullptr;
+  }
+
+  void recycle(Block *block) { in->recycle(block); }
+
+protected:
+  class Decoder {
+  public:
+    Decoder(const Reader &reader, Thread::Queue<Block> &queue)
+        : reader(reader), writer(queue), next(new std::atomic<size_t>(0)) {}
+    void execute() {
+      auto out = writer.placeholder();
+      size_t index;
+      while ((index = (*next)++) < reader.block_offsets.size()) {
+        out->error.clear();
+        try {
+          reader.decode(index, *out);
+        } catch (Exception &e) {
+          out->error = e[0];
+        } catch (std::bad_alloc &) {
+          out->error = "out of memory decoding compressed track file \"" + reader.data_file + "\"";
+        }
+        out->index = index;
+        if (!out.write())
+          return;
+      }
+    }
+
+  protected:
+    const Reader &reader;
+    Thread::Queue<Block>::Writer writer;
+    std::shared_ptr<std::atomic<size_t>> next;
+  };
+
+  Thread::Queue<Block> queue;
+  Thread::Queue<Block>::Reader queue_reader;
+  std::unique_ptr<Thread::Queue<Block>::Reader::Item> in;
+  std::map<size_t, Block *> pending;
+  Decoder decoder;
+  decltype(Thread::run(Thread::multi(std::declval<Decoder &>()))) threads;
+};
+
+Reader::Block *Reader::get(size_t index) {
+  if (!nthreads) {
+    decode(index, serial);
+    return &serial;
+  }
+  if (!decoders)
+    decoders.reset(new Decoders(*this, nthreads));
+  Block *block = decoders->get(index);
+  if (!block)
+    throw Exception("missing block in compressed track file \"" + data_file + "\"");
+  if (!block->error.empty())
+    throw Exception(block->error);
+  return block;
+}
+
+const Reader::Block *Reader::next() {
+  while (current_block < block_offsets.size()) {
+    if (!current) {
+      current = get(current_block);
+      position = 0;
+    }
+    if (position < current->weights.size())
+      return current;
+    if (decoders)
+      decoders->recycle(current);
+    current = nullptr;
+    // release the decoder threads as soon as they are no longer needed:
+    if (++current_block == block_offsets.size())
+      decoders.reset();
+  }
+  return nullptr;
+}
+
+} // namespace MR::DWI::Tractography::Compressed
@@ -0,0 +1,200 @@
+/* Copyright (c) 2008-2024 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#pragma once
+
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "dwi/tractography/file_base.h"
+#include "dwi/tractography/properties.h"
+#include "dwi/tractography/streamline.h"
+#include "file/mmap.h"
+#include "file/ofstream.h"
+#include "file/path.h"
+
+namespace MR::DWI::Tractography::Compressed {
+
+/*! \defgroup tckz Compressed track files
+ *
+ * Track files with the .tckz suffix store streamlines in a compact,
+ * compressed form. The text header is the same as that of a .tck file
+ * (with first line "mrtrix compressed tracks"), with two additional
+ * entries: "quantisation", the step size (in mm) to which all vertex
+ * positions are rounded, and "scalars", the number of per-vertex scalar
+ * values stored alongside the vertices (if any).
+ *
+ * The data consist of a sequence of blocks, each of which holds a number
+ * of whole streamlines and is compressed independently using zlib. Each
+ * block starts with four little-endian 32-bit unsigned integers: the size
+ * of the compressed data, the size of the uncompressed data, the number of
+ * streamlines within it, and the CRC-32 of the uncompressed data. Within
+ * the uncompressed data, each streamline is stored as:
+ * - its number of vertices, as a variable-length integer (7 bits per byte,
+ *   least significant first);
+ * - its weight, as a little-endian 32-bit float;
+ * - for each vertex and axis, the difference between the quantised position
+ *   and its linear prediction from the previous two vertices, as a zigzag-
+ *   encoded variable-length integer (the first vertex is stored as is, and
+ *   the second relative to the first);
+ * - the scalar values for each vertex in turn (if any), as little-endian
+ *   32-bit floats.
+ *
+ * The last block is followed by an empty block header (all zeros), then an
+ * index of the blocks (for each, the 64-bit offset of its header relative
+ * to the start of the data, and the index of its first streamline), and
+ * finally a 24-byte trailer holding the offset of the index, the number of
+ * blocks, and the 8-byte magic string "TCKZIDX". Since the blocks are
+ * independent, they can be decoded by several threads at once. */
+
+//! whether \a path refers to a compressed track file
+inline bool is_compressed(const std::string &path) { return Path::has_suffix(path, ".tckz"); }
+
+//! the quantisation step (in mm) to use by default when writing compressed track files
+float default_quantisation();
+
+//! write streamlines to a compressed track file
+/*! \sa tckz for details of the format */
+class Writer : public __WriterBase__<float> {
+public:
+  //! create a new compressed track file, with \a num_scalars values stored per vertex
+  Writer(const std::string &file,
+         const Properties &properties,
+         size_t num_scalars = 0,
+         float quantisation = default_quantisation());
+  //! flush the remaining data, and write the block index and streamline counts
+  ~Writer();
+
+  //! append a streamline (and its \a num_scalars values per vertex, if any)
+  template <typename ValueType> void append(const Streamline<ValueType> &tck, const float *scalars = nullptr) {
+    quantised.resize(3 * tck.size());
+    for (size_t n = 0; n < tck.size(); ++n) {
+      assert(tck[n].allFinite());
+      for (size_t axis = 0; axis < 3; ++axis)
+        quantised[3 * n + axis] = quantise(tck[n][axis]);
+    }
+    append(quantised.data(), tck.size(), tck.weight, scalars);
+  }
+
+  size_t num_scalars() const { return nscalars; }
+  float quantisation() const { return step; }
+
+protected:
+  const size_t nscalars;
+  const float step;
+  File::OFStream out;
+  int64_t data_start;
+  std::string payload;
+  size_t streamlines_in_block;
+  std::vector<uint8_t> buffer;
+  // the offset of each block relative to the start of the data, and its first streamline:
+  std::vector<std::pair<uint64_t, uint64_t>> blocks;
+  std::vector<int32_t> quantised;
+
+  int32_t quantise(double value) const;
+  void append(const int32_t *vertices, size_t num_vertices, float weight, const float *scalars);
+  void flush();
+  void finalise();
+};
+
+//! read streamlines from a compressed track file
+/*! The blocks of the file are decompressed and decoded ahead of time by
+ * background threads (unless multi-threading is disabled, or the reader is
+ * created from within a worker thread), which are launched once reading
+ * starts and stopped once all blocks have been read; the streamlines are
+ * still returned in order. Vertex positions are within half the
+ * quantisation step of those originally written.
+ *
+ * \sa tckz for details of the format */
+class Reader : public __ReaderBase__ {
+public:
+  //! open the \c file for reading and load header into \c properties
+  Reader(const std::string &file, Properties &properties);
+  ~Reader();
+
+  size_t num_scalars() const { return nscalars; }
+  float quantisation() const { return step; }
+
+  //! fetch next track from file, along with its weight as stored in the file
+  /*! if \a scalars is provided, it is filled with the num_scalars() values
+   * for each vertex in turn. */
+  template <typename ValueType> bool operator()(Streamline<ValueType> &tck, TrackScalar<ValueType> *scalars = nullptr) {
+    tck.clear();
+    if (scalars)
+      scalars->clear();
+    const Block *block = next();
+    if (!block)
+      return false;
+    const size_t first = block->start[position];
+    const size_t num_vertices = block->start[position + 1] - first;
+    tck.resize(num_vertices);
+    const int32_t *v = block->vertices.data() + 3 * first;
+    for (size_t n = 0; n < num_vertices; ++n, v += 3)
+      tck[n] = {ValueType(step * v[0]), ValueType(step * v[1]), ValueType(step * v[2])};
+    tck.weight = block->weights[position];
+    tck.set_index(current_index);
+    if (scalars) {
+      scalars->assign(block->scalars.begin() + first * nscalars,
+                      block->scalars.begin() + (first + num_vertices) * nscalars);
+      scalars->set_index(current_index);
+    }
+    ++position;
+    ++current_index;
+    return true;
+  }
+
+protected:
+  class Block {
+  public:
+    size_t index = std::numeric_limits<size_t>::max();
+    // the first vertex of each streamline, followed by one past the last vertex:
+    std::vector<uint32_t> start;
+    std::vector<int32_t> vertices;
+    std::vector<float> weights, scalars;
+    std::vector<uint8_t> buffer;
+    // set if the block could not be decoded:
+    std::string error;
+  };
+
+  // the background threads decoding blocks ahead of time:
+  class Decoders;
+
+  size_t nscalars;
+  float step;
+  std::unique_ptr<File::MMap> mmap;
+  const uint8_t *data;
+  int64_t size;
+  std::vector<int64_t> block_offsets;
+
+  size_t nthreads;
+  Block serial;
+  std::unique_ptr<Decoders> decoders;
+  size_t current_block;
+  Block *current;
+  size_t position;
+
+  bool load_index();
+  void scan();
+  void decode(size_t index, Block &block) const;
+  const Block *next();
+  Block *get(size_t index);
+
+  Reader(const Reader &) = delete;
+};
+
+} // namespace MR::DWI::Tractography::Compressed
@@ -220,6 +220,11 @@ void WriterExtraction::clear() {
   writers.clear();
 }
 
+void WriterExtraction::skip() const {
+  for (size_t i = 0; i != file_count(); ++i)
+    writers[i]->skip();
+}
+
 bool WriterExtraction::operator()(const Connectome::Streamline_nodepair &in) const {
   if (exclusive) {
     // Make sure that both nodes are within the list of nodes of interest;
@@ -83,6 +83,8 @@ class WriterExtraction {
 
   bool operator()(const Connectome::Streamline_nodepair &) const;
   bool operator()(const Connectome::Streamline_nodelist &) const;
+  // For a streamline that was not read, since it could not be written to any file
+  void skip() const;
 
   size_t file_count() const { return writers.size(); }
 
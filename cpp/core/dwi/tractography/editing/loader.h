@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <string>
 
 #include "memory.h"
@@ -23,39 +24,126 @@
 
 #include "dwi/tractography/file.h"
 #include "dwi/tractography/properties.h"
+#include "dwi/tractography/spatial_index.h"
 #include "dwi/tractography/streamline.h"
 
 namespace MR::DWI::Tractography::Editing {
 
+// Where an input file has an up-to-date spatial index (see tckindex), and the
+//   include and / or mask ROIs restrict the streamlines that could be written,
+//   only those streamlines that are candidates according to the index are read
 class Loader {
 
 public:
-  Loader(const std::vector<std::string> &files)
-      : file_list(files), dummy_properties(), reader(new Reader<>(file_list[0], dummy_properties)), file_index(0) {}
+  Loader(const std::vector<std::string> &files, const Properties &properties, const bool ends_only, const bool select)
+      : file_list(files),
+        properties(properties),
+        ends_only(ends_only),
+        select(select),
+        dummy_properties(),
+        file_index(0),
+        next_candidate(0),
+        num_loaded(0),
+        num_unread(0),
+        exhausted(false) {
+    open();
+  }
 
   bool operator()(Streamline<> &);
 
+  //! the number of streamlines that were not read, from those preceding the first \a count streamlines loaded
+  /*! if all streamlines loaded were used, this includes any streamlines not read after the last of them */
+  uint64_t unread(const uint64_t count) const {
+    if (exhausted && count == num_loaded)
+      return num_unread;
+    const auto next = std::upper_bound(unread_before.begin(),
+                                       unread_before.end(),
+                                       count,
+                                       [](const uint64_t n, const std::pair<uint64_t, uint64_t> &u) {
+                                         return n <= u.first;
+                                       });
+    return next == unread_before.begin() ? 0 : (next - 1)->second;
+  }
+
 private:
   const std::vector<std::string> &file_list;
+  const Properties &properties;
+  const bool ends_only, select;
   Properties dummy_properties;
   std::unique_ptr<Reader<>> reader;
   size_t file_index;
+
+  // If a spatial index is in use: the streamlines in the current file to be read
+  std::vector<SpatialIndex::track_t> candidates;
+  size_t next_candidate;
+  // Each time streamlines are skipped over: the number of streamlines loaded beforehand,
+  //   and the total number of streamlines not read so far
+  std::vector<std::pair<uint64_t, uint64_t>> unread_before;
+  uint64_t num_loaded, num_unread;
+  bool exhausted;
+
+  void open();
 };
 
+void Loader::open() {
+  dummy_properties.clear();
+  reader.reset(new Reader<>(file_list[file_index], dummy_properties));
+  candidates.clear();
+  next_candidate = 0;
+  if (!select || (!properties.include.size() && !properties.ordered_include.size() && !properties.mask.size()))
+    return;
+  const std::string &path(file_list[file_index]);
+  if (!SpatialIndex::available(path))
+    return;
+  try {
+    SpatialIndex index(path);
+    if (!reader->load_index())
+      reader->build_index();
+    if (index.num_streamlines() != reader->num_streamlines())
+      throw Exception("number of streamlines in spatial index does not match track file \"" + path + "\"");
+    std::vector<SpatialIndex::track_t> selection;
+    if (!index.select(properties, ends_only, selection))
+      return;
+    candidates = std::move(selection);
+    // Use a sentinel for the end of the file
+    candidates.push_back(reader->num_streamlines());
+    INFO("reading " + str(candidates.size() - 1) + " of " + str(reader->num_streamlines()) +
+         " streamlines from file \"" + path + "\" using its spatial index");
+  } catch (Exception &e) {
+    e.display(2);
+    INFO("ignoring spatial index of track file \"" + path + "\"");
+    candidates.clear();
+  }
+}
+
 bool Loader::operator()(Streamline<> &out) {
   out.clear();
 
-  if ((*reader)(out))
-    return true;
-
-  while (++file_index != file_list.size()) {
-    dummy_properties.clear();
-    reader.reset(new Reader<>(file_list[file_index], dummy_properties));
-    if ((*reader)(out))
-      return true;
+  while (true) {
+    if (candidates.empty()) {
+      if ((*reader)(out)) {
+        ++num_loaded;
+        return true;
+      }
+    } else {
+      // Streamlines skipped over since the previous candidate were not read
+      const size_t previous = next_candidate ? candidates[next_candidate - 1] + 1 : 0;
+      if (candidates[next_candidate] > previous) {
+        num_unread += candidates[next_candidate] - previous;
+        unread_before.emplace_back(num_loaded, num_unread);
+      }
+      if (next_candidate + 1 < candidates.size()) {
+        reader->read(candidates[next_candidate++], out);
+        ++num_loaded;
+        return true;
+      }
+    }
+    if (++file_index == file_list.size()) {
+      exhausted = true;
+      return false;
+    }
+    open();
   }
-
-  return false;
 }
 
 } // namespace MR::DWI::Tractography::Editing
@@ -51,6 +51,11 @@ class Receiver {
 
   bool operator()(const Streamline<> &);
 
+  // The number of input streamlines received
+  uint64_t num_received() const { return total_count; }
+  // Account in the output file header for input streamlines that were never read
+  void add_unread(const uint64_t num) { writer.skip(num); }
+
 private:
   Writer<> writer;
   const uint64_t number;
@@ -19,7 +19,9 @@
 #include <map>
 
 #include "app.h"
+#include "dwi/tractography/compressed_file.h"
 #include "dwi/tractography/file_base.h"
+#include "dwi/tractography/mapped_file.h"
 #include "dwi/tractography/properties.h"
 #include "dwi/tractography/streamline.h"
 #include "file/config.h"
@@ -44,11 +46,27 @@ template <class ValueType> class WriterInterface {
 };
 
 //! A class to read streamlines data
+/*! The streamline data are accessed via a memory-mapping of the file (see
+ * MappedFile). Streamlines can be read in order using operator(); once
+ * the index of streamline offsets has been built using build_index(), any
+ * streamline can also be read directly using read(), which is safe to
+ * invoke from several threads at once.
+ *
+ * Compressed track files (with the .tckz suffix) are also supported, in
+ * which case streamlines can only be read in order (see Compressed::Reader);
+ * the streamline weights stored in such files are used unless overridden
+ * using the -tck_weights_in option. */
 template <class ValueType = float> class Reader : public __ReaderBase__, public ReaderInterface<ValueType> {
 public:
   //! open the \c file for reading and load header into \c properties
-  Reader(const std::string &file, Properties &properties) {
-    open(file, "tracks", properties);
+  Reader(const std::string &file, Properties &properties) : position(0) {
+    if (Compressed::is_compressed(file)) {
+      compressed.reset(new Compressed::Reader(file, properties));
+    } else {
+      open(file, "tracks", properties);
+      in.close();
+      data.reset(new MappedFile(data_file, data_offset, dtype));
+    }
     auto opt = App::get_options("tck_weights_in");
     if (!opt.empty())
       weights = File::Matrix::load_vector<ValueType>(opt[0][0]);
@@ -58,89 +76,128 @@ template <class ValueType = float> class Reader : public __ReaderBase__, public
   bool operator()(Streamline<ValueType> &tck) {
     tck.clear();
 
-    if (!in.is_open())
+    if (compressed)
+      return read_compressed(tck);
+
+    if (!data)
       return false;
 
-    do {
-      auto p = get_next_point();
-      if (std::isinf(p[0])) {
-        in.close();
-        check_excess_weights();
-        return false;
-      }
-      if (in.eof()) {
-        in.close();
-        check_excess_weights();
-        return false;
-      }
+    int64_t count;
+    if (!data->find_end(position, count)) {
+      close();
+      check_excess_weights();
+      return false;
+    }
+
+    if (weights.size() && current_index >= size_t(weights.size())) {
+      WARN("Streamline weights file contains less entries (" + str(weights.size()) +
+           ") than .tck file; "
+           "ceasing reading of streamline data");
+      close();
+      return false;
+    }
+
+    data->decode(position, count, tck);
+    position += count + 1;
+    tck.set_index(current_index);
+    tck.weight = weights.size() ? weights[current_index] : 1.0;
+    ++current_index;
+    return true;
+  }
 
-      if (std::isnan(p[0])) {
-        tck.set_index(current_index++);
+  void close() {
+    data.reset();
+    compressed.reset();
+    __ReaderBase__::close();
+  }
 
-        if (weights.size()) {
+  //! build the index of streamline offsets, allowing random access
+  void build_index() {
+    if (!data || data->indexed())
+      return;
+    data->build_index();
+    check_index_weights();
+  }
+  bool indexed() const { return data && data->indexed(); }
 
-          if (tck.get_index() < size_t(weights.size())) {
-            tck.weight = weights[tck.get_index()];
-          } else {
-            WARN("Streamline weights file contains less entries (" + str(weights.size()) +
-                 ") than .tck file; "
-                 "ceasing reading of streamline data");
-            in.close();
-            tck.clear();
-            return false;
-          }
+  //! load the index of streamline offsets only if it is available alongside the file
+  /*! returns false if no valid up-to-date index is found, in which case
+   * obtaining the index would require a full scan of the file. */
+  bool load_index() {
+    if (!data)
+      return false;
+    if (data->indexed())
+      return true;
+    if (!data->load_index())
+      return false;
+    check_index_weights();
+    return true;
+  }
 
-        } else {
-          tck.weight = 1.0;
-        }
+  //! save the index of streamline offsets alongside the file (requires the index)
+  void save_index() const {
+    assert(indexed());
+    data->save_index();
+  }
 
-        return true;
-      }
+  //! the number of streamlines that can be read (requires the index)
+  size_t num_streamlines() const {
+    assert(indexed());
+    return weights.size() ? std::min(data->num_streamlines(), size_t(weights.size())) : data->num_streamlines();
+  }
 
-      tck.push_back(p);
-    } while (in.good());
+  //! read streamline \a index directly (requires the index)
+  void read(size_t index, Streamline<ValueType> &tck) const {
+    assert(index < num_streamlines());
+    data->decode(data->offset(index), data->length(index), tck);
+    tck.set_index(index);
+    tck.weight = weights.size() ? weights[index] : 1.0;
+  }
 
-    in.close();
-    return false;
+  //! continue reading in order from streamline \a index (requires the index)
+  void seek(size_t index) {
+    assert(index <= num_streamlines());
+    position = data->offset(index);
+    current_index = index;
   }
 
 protected:
   using __ReaderBase__::current_index;
+  using __ReaderBase__::data_file;
+  using __ReaderBase__::data_offset;
   using __ReaderBase__::dtype;
   using __ReaderBase__::in;
 
+  std::unique_ptr<MappedFile> data;
+  std::unique_ptr<Compressed::Reader> compressed;
+  int64_t position;
   Eigen::Matrix<ValueType, Eigen::Dynamic, 1> weights;
 
-  //! takes care of byte ordering issues
-
-  Eigen::Matrix<ValueType, 3, 1> get_next_point() {
-    using namespace ByteOrder;
-    switch (dtype()) {
-    case DataType::Float32LE: {
-      float p[3];
-      in.read((char *)p, sizeof(p));
-      return {ValueType(LE(p[0])), ValueType(LE(p[1])), ValueType(LE(p[2]))};
-    }
-    case DataType::Float32BE: {
-      float p[3];
-      in.read((char *)p, sizeof(p));
-      return {ValueType(BE(p[0])), ValueType(BE(p[1])), ValueType(BE(p[2]))};
-    }
-    case DataType::Float64LE: {
-      double p[3];
-      in.read((char *)p, sizeof(p));
-      return {ValueType(LE(p[0])), ValueType(LE(p[1])), ValueType(LE(p[2]))};
-    }
-    case DataType::Float64BE: {
-      double p[3];
-      in.read((char *)p, sizeof(p));
-      return {ValueType(BE(p[0])), ValueType(BE(p[1])), ValueType(BE(p[2]))};
+  bool read_compressed(Streamline<ValueType> &tck) {
+    if (!(*compressed)(tck)) {
+      close();
+      check_excess_weights();
+      return false;
     }
-    default:
-      assert(0);
-      break;
+    if (weights.size()) {
+      if (current_index >= size_t(weights.size())) {
+        WARN("Streamline weights file contains less entries (" + str(weights.size()) +
+             ") than .tck file; "
+             "ceasing reading of streamline data");
+        close();
+        return false;
+      }
+      tck.weight = weights[current_index];
     }
-    return {NaN, NaN, NaN};
+    ++current_index;
+    return true;
+  }
+
+  //! Check that the weights file contains an entry for every streamline in the index
+  void check_index_weights() const {
+    if (weights.size() && size_t(weights.size()) < data->num_streamlines())
+      WARN("Streamline weights file contains less entries (" + str(weights.size()) + ") than .tck file (" +
+           str(data->num_streamlines()) + "); only the first " + str(weights.size()) + " streamlines will be read");
   }
 
   //! Check that the weights file does not contain excess entries
@@ -167,6 +224,10 @@ template <class ValueType = float> class Reader : public __ReaderBase__, public
  * use cases where a very large number of track files are being written
  * at once. For most applications (where typically one track file is
  * written at a time), the Writer class is more appropriate.
+ *
+ * If \a file has the .tckz suffix, the tracks are instead written in
+ * compressed form via a Compressed::Writer, which keeps the file open
+ * until destruction.
  * */
 template <class ValueType = float>
 class WriterUnbuffered : public __WriterBase__<ValueType>, public WriterInterface<ValueType> {
@@ -185,8 +246,22 @@ class WriterUnbuffered : public __WriterBase__<ValueType>, public WriterInterfac
   //! create a new track file with the specified properties
   WriterUnbuffered(const std::string &file, const Properties &properties) : __WriterBase__<ValueType>(file) {
 
-    if (!Path::has_suffix(name, ".tck"))
-      throw Exception("output track files must use the .tck suffix");
+    const bool is_compressed = Compressed::is_compressed(name);
+    if (!is_compressed && !Path::has_suffix(name, ".tck"))
+      throw Exception("output track files must use the .tck or .tckz suffix");
+
+    const_cast<Properties &>(properties).set_timestamp();
+    const_cast<Properties &>(properties).set_version_info();
+    const_cast<Properties &>(properties).update_command_history();
+
+    auto opt = App::get_options("tck_weights_out");
+    if (!opt.empty())
+      set_weights_path(opt[0][0]);
+
+    if (is_compressed) {
+      compressed.reset(new Compressed::Writer(name, properties));
+      return;
+    }
 
     File::OFStream out;
     try {
@@ -195,10 +270,6 @@ class WriterUnbuffered : public __WriterBase__<ValueType>, public WriterInterfac
       throw Exception(e, "Unable to create output track file");
     }
 
-    const_cast<Properties &>(properties).set_timestamp();
-    const_cast<Properties &>(properties).set_version_info();
-    const_cast<Properties &>(properties).update_command_history();
-
     create(out, properties, "tracks");
     barrier_addr = out.tellp();
 
@@ -208,14 +279,23 @@ class WriterUnbuffered : public __WriterBase__<ValueType>, public WriterInterfac
     if (!out.good())
       throw Exception("error writing tracks file \"" + name + "\": " + strerror(errno));
     open_success = true;
+  }
 
-    auto opt = App::get_options("tck_weights_out");
-    if (!opt.empty())
-      set_weights_path(opt[0][0]);
+  ~WriterUnbuffered() {
+    if (compressed)
+      compressed->total_count = total_count;
   }
 
   //! append track to file
   bool operator()(const Streamline<ValueType> &tck) {
+    if (compressed) {
+      compressed->append(tck);
+      if (!weights_name.empty())
+        write_weights(str(tck.weight) + "\n");
+      ++count;
+      ++total_count;
+      return true;
+    }
     // allocate buffer on the stack for performance:
     NON_POD_VLA(buffer, vector_type, tck.size() + 2);
     for (size_t n = 0; n < tck.size(); ++n) {
@@ -246,6 +326,7 @@ class WriterUnbuffered : public __WriterBase__<ValueType>, public WriterInterfac
 protected:
   std::string weights_name;
   int64_t barrier_addr;
+  std::unique_ptr<Compressed::Writer> compressed;
 
   //! indicates end of track and start of new track
   vector_type delimiter() const { return {ValueType(NaN), ValueType(NaN), ValueType(NaN)}; }
@@ -315,6 +396,7 @@ template <typename ValueType = float> class Writer : public WriterUnbuffered<Val
   using WriterUnbuffered<ValueType>::format_point;
   using WriterUnbuffered<ValueType>::weights_name;
   using WriterUnbuffered<ValueType>::write_weights;
+  using WriterUnbuffered<ValueType>::compressed;
   using vector_type = typename WriterUnbuffered<ValueType>::vector_type;
 
   //! create new RAM-buffered track file with specified properties
@@ -341,14 +423,21 @@ template <typename ValueType = float> class Writer : public WriterUnbuffered<Val
 
   //! append track to file
   bool operator()(const Streamline<ValueType> &tck) {
-    if (buffer_size + tck.size() + 2 > buffer_capacity)
-      commit();
-
-    for (const auto &i : tck) {
-      assert(i.allFinite());
-      add_point(i);
+    if (compressed) {
+      compressed->append(tck);
+      // only the weights need buffering here:
+      if (weights_buffer.size() > buffer_capacity * sizeof(vector_type))
+        commit();
+    } else {
+      if (buffer_size + tck.size() + 2 > buffer_capacity)
+        commit();
+
+      for (const auto &i : tck) {
+        assert(i.allFinite());
+        add_point(i);
+      }
+      add_point(delimiter());
     }
-    add_point(delimiter());
 
     if (weights_name.size())
       weights_buffer += str(tck.weight) + ' ';
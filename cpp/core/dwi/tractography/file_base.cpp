@@ -25,7 +25,7 @@ void __ReaderBase__::open(const std::string &file, const std::string &type, Prop
 
   const std::string firstline("mrtrix " + type);
   File::KeyValue::Reader kv(file, firstline.c_str());
-  std::string data_file;
+  std::string file_spec;
 
   while (kv.next()) {
     const std::string key = lowercase(kv.key());
@@ -41,7 +41,7 @@ void __ReaderBase__::open(const std::string &file, const std::string &type, Prop
     } else if (key == "comment")
       properties.comments.push_back(kv.value());
     else if (key == "file")
-      data_file = kv.value();
+      file_spec = kv.value();
     else if (key == "datatype")
       dtype = DataType::parse(kv.value());
     else
@@ -56,10 +56,10 @@ void __ReaderBase__::open(const std::string &file, const std::string &type, Prop
                     "Float32LE, Float32BE, Float64LE & Float64BE (in " +
                     type + " file \"" + file + "\")");
 
-  if (data_file.empty())
+  if (file_spec.empty())
     throw Exception("missing \"files\" specification for " + type + " file \"" + file + "\"");
 
-  std::istringstream files_stream(data_file);
+  std::istringstream files_stream(file_spec);
   std::string fname;
   files_stream >> fname;
   int64_t offset = 0;
@@ -80,6 +80,8 @@ void __ReaderBase__::open(const std::string &file, const std::string &type, Prop
   if (!in)
     throw Exception("error opening " + type + " data file \"" + fname + "\": " + strerror(errno));
   in.seekg(offset);
+  data_file = fname;
+  data_offset = offset;
 }
 
 } // namespace MR::DWI::Tractography
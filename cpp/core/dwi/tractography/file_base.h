@@ -31,7 +31,7 @@ namespace MR::DWI::Tractography {
 //! \cond skip
 class __ReaderBase__ {
 public:
-  __ReaderBase__() : current_index(0) {}
+  __ReaderBase__() : current_index(0), data_offset(0) {}
   ~__ReaderBase__() {
     if (in.is_open())
       in.close();
@@ -45,6 +45,8 @@ class __ReaderBase__ {
   std::ifstream in;
   DataType dtype;
   uint64_t current_index;
+  std::string data_file;
+  int64_t data_offset;
 };
 
 template <typename ValueType = float> class __WriterBase__ {
@@ -105,7 +107,7 @@ template <typename ValueType = float> class __WriterBase__ {
     out.seekp(data_offset);
   }
 
-  void skip() { ++total_count; }
+  void skip(const uint64_t num = 1) { total_count += num; }
 
   uint64_t count, total_count;
 
@@ -0,0 +1,237 @@
+/* Copyright (c) 2008-2024 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "dwi/tractography/mapped_file.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+
+#include "file/config.h"
+#include "file/ofstream.h"
+#include "file/path.h"
+#include "thread.h"
+
+namespace MR::DWI::Tractography {
+
+namespace {
+const std::string index_magic("mrtrix track index\n");
+} // namespace
+
+MappedFile::MappedFile(const std::string &path, int64_t offset, DataType datatype)
+    : path(path),
+      data_offset(offset),
+      dtype(datatype),
+      bytes_per_vertex(3 * datatype.bytes()),
+      data(nullptr),
+      num_vertices(0) {
+  struct stat sbuf;
+  if (stat(path.c_str(), &sbuf))
+    throw Exception("cannot stat track file \"" + path + "\": " + strerror(errno));
+  if (sbuf.st_size <= offset)
+    return;
+  mmap.reset(new File::MMap(File::Entry(path, offset)));
+  mmap->set_access(File::MMap::Access::Sequential);
+  data = mmap->address();
+  // any incomplete vertex at the end of the file is ignored:
+  num_vertices = mmap->size() / bytes_per_vertex;
+}
+
+template <typename FileType, bool big_endian> bool MappedFile::find_end(int64_t position, int64_t &count) const {
+  const uint8_t *p = data + position * bytes_per_vertex;
+  for (int64_t n = position; n < num_vertices; ++n, p += bytes_per_vertex) {
+    const FileType x = big_endian ? Raw::fetch_BE<FileType>(p) : Raw::fetch_LE<FileType>(p);
+    if (!std::isfinite(x)) {
+      count = n - position;
+      // NaN delimits streamlines; Inf marks the end of the data:
+      return std::isnan(x);
+    }
+  }
+  return false;
+}
+
+bool MappedFile::find_end(int64_t position, int64_t &count) const {
+  if (indexed()) {
+    const auto next = std::upper_bound(offsets.begin(), offsets.end(), position);
+    if (next == offsets.end())
+      return false;
+    count = *next - position - 1;
+    return true;
+  }
+  switch (dtype()) {
+  case DataType::Float32LE:
+    return find_end<float, false>(position, count);
+  case DataType::Float32BE:
+    return find_end<float, true>(position, count);
+  case DataType::Float64LE:
+    return find_end<double, false>(position, count);
+  case DataType::Float64BE:
+    return find_end<double, true>(position, count);
+  default:
+    assert(0);
+    return false;
+  }
+}
+
+template <typename FileType, bool big_endian>
+void MappedFile::scan(int64_t from, int64_t to, std::vector<int64_t> &delimiters, int64_t &barrier) const {
+  const uint8_t *p = data + from * bytes_per_vertex;
+  for (int64_t n = from; n < to; ++n, p += bytes_per_vertex) {
+    const FileType x = big_endian ? Raw::fetch_BE<FileType>(p) : Raw::fetch_LE<FileType>(p);
+    if (!std::isfinite(x)) {
+      if (!std::isnan(x)) {
+        barrier = n;
+        return;
+      }
+      delimiters.push_back(n);
+    }
+  }
+}
+
+void MappedFile::scan(int64_t from, int64_t to, std::vector<int64_t> &delimiters, int64_t &barrier) const {
+  switch (dtype()) {
+  case DataType::Float32LE:
+    return scan<float, false>(from, to, delimiters, barrier);
+  case DataType::Float32BE:
+    return scan<float, true>(from, to, delimiters, barrier);
+  case DataType::Float64LE:
+    return scan<double, false>(from, to, delimiters, barrier);
+  case DataType::Float64BE:
+    return scan<double, true>(from, to, delimiters, barrier);
+  default:
+    assert(0);
+  }
+}
+
+// CONF option: TrackIndexSidecar
+// CONF default: 0 (false)
+// CONF A boolean value to indicate whether the index of streamline offsets
+// CONF built when random or multi-threaded access to a track file is
+// CONF required should be saved alongside that file (as "<file>.idx"), so
+// CONF that subsequent commands operating on the same file can load it
+// CONF rather than scanning the whole file again. Such an index is used
+// CONF whenever it is present and up to date, regardless of this setting.
+void MappedFile::build_index() {
+  if (indexed())
+    return;
+  if (load_index())
+    return;
+
+  // split the file into as many ranges as threads, and find the delimiters within each:
+  const size_t num_ranges = std::max<size_t>(Thread::threads_to_execute(), 1);
+  std::vector<std::vector<int64_t>> delimiters(num_ranges);
+  std::vector<int64_t> barriers(num_ranges, num_vertices);
+
+  if (num_ranges == 1) {
+    scan(0, num_vertices, delimiters[0], barriers[0]);
+  } else {
+    struct Scanner {
+      const MappedFile &file;
+      std::atomic<size_t> &next;
+      std::vector<std::vector<int64_t>> &delimiters;
+      std::vector<int64_t> &barriers;
+      void execute() {
+        const size_t n = next++;
+        const int64_t num_ranges = delimiters.size();
+        file.scan(file.size() * n / num_ranges, file.size() * (n + 1) / num_ranges, delimiters[n], barriers[n]);
+      }
+    };
+    std::atomic<size_t> next(0);
+    Scanner scanner = {*this, next, delimiters, barriers};
+    Thread::run(Thread::multi(scanner, num_ranges), "track index threads").wait();
+  }
+
+  offsets.push_back(0);
+  for (size_t n = 0; n < num_ranges; ++n) {
+    for (const auto d : delimiters[n])
+      offsets.push_back(d + 1);
+    if (barriers[n] < num_vertices)
+      break;
+  }
+  DEBUG("indexed " + str(num_streamlines()) + " streamlines in track file \"" + path + "\"");
+
+  if (File::Config::get_bool("TrackIndexSidecar", false)) {
+    try {
+      save_index();
+    } catch (Exception &e) {
+      e.display(2);
+      WARN("unable to save index for track file \"" + path + "\"");
+    }
+  }
+}
+
+bool MappedFile::load_index() {
+  const std::string name(index_path());
+  if (!Path::exists(name))
+    return false;
+
+  struct stat data_stat, index_stat;
+  if (stat(path.c_str(), &data_stat) || stat(name.c_str(), &index_stat) || index_stat.st_mtime < data_stat.st_mtime) {
+    INFO("ignoring out-of-date index file \"" + name + "\"");
+    return false;
+  }
+
+  std::ifstream in(name, std::ios::in | std::ios::binary);
+  std::string magic(index_magic.size(), '\0');
+  in.read(&magic[0], magic.size());
+  int64_t header[3];
+  in.read(reinterpret_cast<char *>(header), sizeof(header));
+  for (auto &h : header)
+    h = ByteOrder::LE(h);
+  if (!in || magic != index_magic || header[0] != data_offset || header[1] != int64_t(data_stat.st_size) ||
+      header[2] < 0) {
+    INFO("ignoring invalid index file \"" + name + "\"");
+    return false;
+  }
+
+  std::vector<int64_t> loaded(header[2] + 1);
+  in.read(reinterpret_cast<char *>(loaded.data()), loaded.size() * sizeof(int64_t));
+  if (!in) {
+    INFO("ignoring truncated index file \"" + name + "\"");
+    return false;
+  }
+  for (auto &o : loaded)
+    o = ByteOrder::LE(o);
+  offsets = std::move(loaded);
+  DEBUG("loaded index of " + str(num_streamlines()) + " streamlines from file \"" + name + "\"");
+  return true;
+}
+
+void MappedFile::save_index() const {
+  struct stat sbuf;
+  if (stat(path.c_str(), &sbuf))
+    throw Exception("cannot stat track file \"" + path + "\": " + strerror(errno));
+
+  const std::string name(index_path());
+  File::OFStream out(name, std::ios::out | std::ios::binary | std::ios::trunc);
+  out.write(index_magic.c_str(), index_magic.size());
+  const int64_t header[3] = {ByteOrder::LE(data_offset),
+                             ByteOrder::LE(int64_t(sbuf.st_size)),
+                             ByteOrder::LE(int64_t(num_streamlines()))};
+  out.write(reinterpret_cast<const char *>(header), sizeof(header));
+  for (const auto o : offsets) {
+    const int64_t value = ByteOrder::LE(o);
+    out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+  }
+  if (!out.good())
+    throw Exception("error writing index file \"" + name + "\": " + strerror(errno));
+  DEBUG("saved index of " + str(num_streamlines()) + " streamlines to file \"" + name + "\"");
+}
+
+} // namespace MR::DWI::Tractography
@@ -0,0 +1,122 @@
+/* Copyright (c) 2008-2024 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "datatype.h"
+#include "dwi/tractography/streamline.h"
+#include "file/mmap.h"
+#include "raw.h"
+
+namespace MR::DWI::Tractography {
+
+//! memory-mapped access to the streamline vertex data of a track file
+/*! Rather than reading each vertex in turn from a stream, the data are
+ * accessed directly from a read-only memory-mapping of the file, and each
+ * streamline is decoded (and byte-swapped if required) as a whole.
+ *
+ * An index of the offset of every streamline within the file can be built
+ * using build_index(), allowing any streamline to be accessed directly in
+ * constant time, and hence the file to be read by several threads at once.
+ * The file is scanned in parallel to build the index, unless a valid index
+ * is found alongside the file (as "<file>.idx"); if the TrackIndexSidecar
+ * config file option is set, the index is saved there once built for
+ * subsequent use, or can be saved explicitly using save_index(). */
+class MappedFile {
+public:
+  //! map the vertex data of type \a datatype, starting at \a offset bytes into \a path
+  MappedFile(const std::string &path, int64_t offset, DataType datatype);
+
+  //! the total number of vertices (including delimiters) in the file
+  int64_t size() const { return num_vertices; }
+
+  //! find the number of vertices in the streamline starting at vertex \a position
+  /*! returns false if there is no complete streamline from \a position
+   * (i.e. if the end of the data has been reached). */
+  bool find_end(int64_t position, int64_t &count) const;
+
+  //! decode the \a count vertices starting from vertex \a position into \a tck
+  template <typename ValueType> void decode(int64_t position, int64_t count, Streamline<ValueType> &tck) const {
+    static_assert(sizeof(typename Streamline<ValueType>::point_type) == 3 * sizeof(ValueType));
+    tck.resize(count);
+    if (!count)
+      return;
+    ValueType *dest = tck[0].data();
+    const uint8_t *src = data + position * bytes_per_vertex;
+    switch (dtype()) {
+    case DataType::Float32LE:
+      decode_values<float, false>(src, 3 * count, dest);
+      break;
+    case DataType::Float32BE:
+      decode_values<float, true>(src, 3 * count, dest);
+      break;
+    case DataType::Float64LE:
+      decode_values<double, false>(src, 3 * count, dest);
+      break;
+    case DataType::Float64BE:
+      decode_values<double, true>(src, 3 * count, dest);
+      break;
+    default:
+      assert(0);
+    }
+  }
+
+  //! build the index of streamline offsets (or load it from file if available)
+  void build_index();
+  bool indexed() const { return !offsets.empty(); }
+  //! the number of streamlines in the file (requires the index)
+  size_t num_streamlines() const { return offsets.size() - 1; }
+  //! the vertex at which streamline \a index starts (requires the index)
+  int64_t offset(size_t index) const { return offsets[index]; }
+  //! the number of vertices in streamline \a index (requires the index)
+  int64_t length(size_t index) const { return offsets[index + 1] - offsets[index] - 1; }
+
+  //! load the index from alongside the file, returning false if no valid up-to-date index is found there
+  bool load_index();
+  //! save the index alongside the file, as "<file>.idx"
+  void save_index() const;
+
+protected:
+  const std::string path;
+  const int64_t data_offset;
+  const DataType dtype;
+  const size_t bytes_per_vertex;
+  std::unique_ptr<File::MMap> mmap;
+  const uint8_t *data;
+  int64_t num_vertices;
+  // the first vertex of each streamline, followed by one past the delimiter of the last:
+  std::vector<int64_t> offsets;
+
+  // a single loop over all values allows the compiler to vectorise the conversion:
+  template <typename FileType, bool big_endian, typename ValueType>
+  static void decode_values(const uint8_t *src, size_t num, ValueType *dest) {
+    for (size_t n = 0; n < num; ++n)
+      dest[n] = ValueType(big_endian ? Raw::fetch_BE<FileType>(src + n * sizeof(FileType))
+                                     : Raw::fetch_LE<FileType>(src + n * sizeof(FileType)));
+  }
+
+  template <typename FileType, bool big_endian> bool find_end(int64_t position, int64_t &count) const;
+  template <typename FileType, bool big_endian>
+  void scan(int64_t from, int64_t to, std::vector<int64_t> &delimiters, int64_t &barrier) const;
+  void scan(int64_t from, int64_t to, std::vector<int64_t> &delimiters, int64_t &barrier) const;
+
+  std::string index_path() const { return path + ".idx"; }
+};
+
+} // namespace MR::DWI::Tractography
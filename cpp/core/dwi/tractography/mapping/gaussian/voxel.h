@@ -179,61 +179,49 @@ class VoxelTOD : public Mapping::VoxelTOD, public VoxelAddon {
    };
    */
 
-class SetVoxel : public std::set<Voxel>, public Mapping::SetVoxelExtras {
+class SetVoxel : public Mapping::VoxelSet<Voxel>, public Mapping::SetVoxelExtras {
 public:
   using VoxType = Voxel;
 
   inline void insert(const Eigen::Vector3i &v, const default_type l, const default_type f) {
-    const Voxel temp(v, l, f);
-    iterator existing = std::set<Voxel>::find(temp);
-    if (existing == std::set<Voxel>::end())
-      std::set<Voxel>::insert(temp);
-    else
-      (*existing).add(l, f);
+    const auto existing = Mapping::VoxelSet<Voxel>::insert(Voxel(v, l, f));
+    if (!existing.second)
+      existing.first->add(l, f);
   }
 };
 
-class SetVoxelDEC : public std::set<VoxelDEC>, public Mapping::SetVoxelExtras {
+class SetVoxelDEC : public Mapping::VoxelSet<VoxelDEC>, public Mapping::SetVoxelExtras {
 public:
   using VoxType = VoxelDEC;
 
   inline void insert(const Eigen::Vector3i &v, const Eigen::Vector3d &d, const default_type l, const default_type f) {
-    const VoxelDEC temp(v, d, l, f);
-    iterator existing = std::set<VoxelDEC>::find(temp);
-    if (existing == std::set<VoxelDEC>::end())
-      std::set<VoxelDEC>::insert(temp);
-    else
-      (*existing).add(d, l, f);
+    const auto existing = Mapping::VoxelSet<VoxelDEC>::insert(VoxelDEC(v, d, l, f));
+    if (!existing.second)
+      existing.first->add(d, l, f);
   }
 };
 
-class SetDixel : public std::set<Dixel>, public Mapping::SetVoxelExtras {
+class SetDixel : public Mapping::VoxelSet<Dixel>, public Mapping::SetVoxelExtras {
 public:
   using VoxType = Dixel;
   using dir_index_type = Dixel::dir_index_type;
 
   inline void insert(const Eigen::Vector3i &v, const dir_index_type d, const default_type l, const default_type f) {
-    const Dixel temp(v, d, l, f);
-    iterator existing = std::set<Dixel>::find(temp);
-    if (existing == std::set<Dixel>::end())
-      std::set<Dixel>::insert(temp);
-    else
-      (*existing).add(l, f);
+    const auto existing = Mapping::VoxelSet<Dixel>::insert(Dixel(v, d, l, f));
+    if (!existing.second)
+      existing.first->add(l, f);
   }
 };
 
-class SetVoxelTOD : public std::set<VoxelTOD>, public Mapping::SetVoxelExtras {
+class SetVoxelTOD : public Mapping::VoxelSet<VoxelTOD>, public Mapping::SetVoxelExtras {
 public:
   using VoxType = VoxelTOD;
   using vector_type = VoxelTOD::vector_type;
 
   inline void insert(const Eigen::Vector3i &v, const vector_type &t, const default_type l, const default_type f) {
-    const VoxelTOD temp(v, t, l, f);
-    iterator existing = std::set<VoxelTOD>::find(temp);
-    if (existing == std::set<VoxelTOD>::end())
-      std::set<VoxelTOD>::insert(temp);
-    else
-      (*existing).add(t, l, f);
+    const auto existing = Mapping::VoxelSet<VoxelTOD>::insert(VoxelTOD(v, t, l, f));
+    if (!existing.second)
+      existing.first->add(t, l, f);
   }
 };
 
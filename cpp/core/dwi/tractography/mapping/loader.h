@@ -16,42 +16,125 @@
 
 #pragma once
 
+#include <atomic>
+#include <mutex>
+
 #include "dwi/tractography/file.h"
 #include "dwi/tractography/streamline.h"
+#include "file/config.h"
 #include "memory.h"
 #include "progressbar.h"
 #include "thread_queue.h"
 
 namespace MR::DWI::Tractography::Mapping {
 
+//! the source of streamlines for a multi-threaded track mapping pipeline
+/*! A TrackLoader can be used directly as the source of Thread::run_queue(),
+ * in which case the streamlines are read in order by a single thread.
+ * Alternatively, it can be run as multiple threads using
+ * Thread::multi(loader, loader.num_threads()): in this case, the track file
+ * is indexed, and each thread reads successive blocks of streamlines from
+ * wherever in the file they are, so that the streamlines are no longer
+ * provided in order (although each retains its index). */
 class TrackLoader {
 
 public:
   TrackLoader(Reader<> &file, const size_t to_load = 0, const std::string &msg = "mapping tracks to image")
-      : reader(file),
-        tracks_to_load(to_load),
-        progress(!msg.empty() ? new ProgressBar(msg, tracks_to_load) : nullptr) {}
+      : reader(file), tracks_to_load(to_load), shared(new Shared(msg, to_load)), next(0), end(0) {}
+
+  TrackLoader(const TrackLoader &that)
+      : reader(that.reader), tracks_to_load(that.tracks_to_load), shared(that.shared), next(0), end(0) {}
 
   virtual ~TrackLoader() {}
+
+  // CONF option: TrackLoaderThreads
+  // CONF default: 1 for every 8 threads, up to 4
+  // CONF The number of threads used to read streamlines from file
+  // CONF in those commands that map streamlines to images, fixels or
+  // CONF connectomes in parallel (e.g. tckmap, tck2connectome). If
+  // CONF greater than 1, the track file first needs to be indexed
+  // CONF (see :option:`TrackIndexSidecar`).
+  //! the number of threads over which to run the loader
+  /*! If greater than one, the track file is indexed in preparation; this
+   * is always one for files that cannot be indexed (i.e. compressed files). */
+  size_t num_threads() {
+    const size_t default_threads = std::clamp<size_t>(Thread::number_of_threads() / 8, 1, 4);
+    static const size_t nthreads = File::Config::get_int("TrackLoaderThreads", default_threads);
+    if (nthreads <= 1 || Thread::threads_to_execute() == 0)
+      return 1;
+    reader.build_index();
+    // compressed track files can only be read in order:
+    if (!reader.indexed())
+      return 1;
+    const size_t total = tracks_to_load ? std::min(tracks_to_load, reader.num_streamlines()) : reader.num_streamlines();
+    shared->total = total;
+    return nthreads;
+  }
+
   virtual bool operator()(Streamline<> &out) {
+    if (reader.indexed() && shared->total != Shared::unknown)
+      return load_indexed(out);
     if (!reader(out)) {
-      progress.reset();
+      shared->finish();
       return false;
     }
     if (tracks_to_load && out.get_index() >= tracks_to_load) {
       out.clear();
-      progress.reset();
+      shared->finish();
       return false;
     }
-    if (progress)
-      ++(*progress);
+    shared->increment(1);
     return true;
   }
 
 protected:
+  class Shared {
+  public:
+    static constexpr size_t unknown = std::numeric_limits<size_t>::max();
+    Shared(const std::string &msg, size_t to_load)
+        : progress(!msg.empty() ? new ProgressBar(msg, to_load) : nullptr), next(0), total(unknown) {}
+    // the progress bar may be updated and closed by different threads, so is
+    // only ever accessed with the mutex held:
+    void increment(size_t count) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (progress)
+        for (size_t n = 0; n != count; ++n)
+          ++(*progress);
+    }
+    void finish() {
+      std::lock_guard<std::mutex> lock(mutex);
+      progress.reset();
+    }
+
+    std::unique_ptr<ProgressBar> progress;
+    std::mutex mutex;
+    std::atomic<size_t> next;
+    size_t total;
+  };
+
+  // the number of consecutive streamlines read by each thread at a time:
+  static constexpr size_t block_size = 256;
+
   Reader<> &reader;
   const size_t tracks_to_load;
-  std::unique_ptr<ProgressBar> progress;
+  std::shared_ptr<Shared> shared;
+  size_t next, end;
+
+  bool load_indexed(Streamline<> &out) {
+    if (next == end) {
+      next = shared->next.fetch_add(block_size);
+      if (next >= shared->total) {
+        next = end = 0;
+        out.clear();
+        shared->finish();
+        return false;
+      }
+      end = std::min(next + block_size, shared->total);
+      shared->increment(end - next);
+    }
+    reader.read(next++, out);
+    return true;
+  }
 };
 
 } // namespace MR::DWI::Tractography::Mapping
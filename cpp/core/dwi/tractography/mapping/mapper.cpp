@@ -25,7 +25,7 @@ void TrackMapperBase::voxelise(const Streamline<> &tck, SetVoxel &voxels) const
   for (const auto &i : tck) {
     vox = round(scanner2voxel * i);
     if (check(vox, info))
-      voxels.std::set<Voxel>::insert(vox);
+      voxels.VoxelSet<Voxel>::insert(vox);
   }
 }
 
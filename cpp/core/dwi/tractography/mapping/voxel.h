@@ -16,7 +16,8 @@
 
 #pragma once
 
-#include <set>
+#include <algorithm>
+#include <vector>
 
 #include "image.h"
 
@@ -248,6 +249,113 @@ std::ostream &operator<<(std::ostream &, const VoxelDir &);
 std::ostream &operator<<(std::ostream &, const Dixel &);
 std::ostream &operator<<(std::ostream &, const VoxelTOD &);
 
+// Flat container holding the unique elements visited by a streamline
+// This is used in place of std::set as the base of the Set* classes below. Elements
+//   are appended to a single array, with duplicates detected using an open-addressing
+//   hash table; since clear() retains the memory of both, reusing a container across
+//   streamlines requires no further memory allocation once it has grown to a sufficient
+//   size. As with std::set, iteration proceeds in ascending order (the elements are
+//   sorted in place on the first traversal after any insertion), and the elements
+//   cannot be modified other than via their const (mutable) member functions.
+template <class VoxelType> class VoxelSet {
+public:
+  using value_type = VoxelType;
+  using const_iterator = typename std::vector<VoxelType>::const_iterator;
+  using iterator = const_iterator;
+
+  VoxelSet() : stamp(1), indexed(true), sorted(true) {}
+
+  size_t size() const { return elements.size(); }
+  bool empty() const { return elements.empty(); }
+
+  void clear() {
+    elements.clear();
+    if (++stamp == 0) {
+      for (auto &s : slots)
+        s.stamp = 0;
+      stamp = 1;
+    }
+    indexed = sorted = true;
+  }
+
+  const_iterator begin() const {
+    sort();
+    return elements.begin();
+  }
+  const_iterator end() const {
+    sort();
+    return elements.end();
+  }
+
+  // As std::set::insert(): if there is no matching element, insert v;
+  //   return the element in the set, and whether v was inserted
+  std::pair<const_iterator, bool> insert(const VoxelType &v) {
+    Slot &slot = lookup(v);
+    if (slot.stamp == stamp)
+      return {elements.begin() + slot.index, false};
+    slot.stamp = stamp;
+    slot.index = elements.size();
+    elements.push_back(v);
+    sorted = elements.size() == 1;
+    return {elements.end() - 1, true};
+  }
+
+private:
+  class Slot {
+  public:
+    uint32_t stamp, index;
+  };
+
+  mutable std::vector<VoxelType> elements;
+  std::vector<Slot> slots;
+  uint32_t stamp;
+  mutable bool indexed, sorted;
+
+  static size_t hash(const VoxelType &v) {
+    size_t h = (size_t(uint32_t(v[0])) * 73856093u) ^ (size_t(uint32_t(v[1])) * 19349663u) ^
+               (size_t(uint32_t(v[2])) * 83492791u);
+    if constexpr (std::is_base_of<Dixel, VoxelType>::value)
+      h ^= size_t(v.get_dir()) * 2654435761u;
+    return h ^ (h >> 15);
+  }
+
+  // find the slot holding the element matching v, or the empty slot where it belongs
+  Slot &lookup(const VoxelType &v) {
+    // keep the load factor of the table below 0.5:
+    if (!indexed || 2 * (elements.size() + 1) > slots.size())
+      reindex(std::max<size_t>(slots.size(), 64));
+    const size_t mask = slots.size() - 1;
+    size_t n = hash(v) & mask;
+    while (slots[n].stamp == stamp && !(elements[slots[n].index] == v))
+      n = (n + 1) & mask;
+    return slots[n];
+  }
+
+  // rebuild the hash table (e.g. after the elements have been sorted)
+  void reindex(size_t num_slots) {
+    while (2 * (elements.size() + 1) > num_slots)
+      num_slots *= 2;
+    slots.assign(num_slots, {0, 0});
+    stamp = 1;
+    const size_t mask = num_slots - 1;
+    for (size_t i = 0; i != elements.size(); ++i) {
+      size_t n = hash(elements[i]) & mask;
+      while (slots[n].stamp == stamp)
+        n = (n + 1) & mask;
+      slots[n] = {stamp, uint32_t(i)};
+    }
+    indexed = true;
+  }
+
+  void sort() const {
+    if (sorted)
+      return;
+    std::sort(elements.begin(), elements.end());
+    sorted = true;
+    indexed = false;
+  }
+};
+
 class SetVoxelExtras {
 public:
   default_type factor; // For TWI, when contribution to the map is uniform along the length of the track
@@ -257,15 +365,13 @@ class SetVoxelExtras {
 
 // Set classes that give sensible behaviour to the insert() function depending on the base voxel class
 
-class SetVoxel : public std::set<Voxel>, public SetVoxelExtras {
+class SetVoxel : public VoxelSet<Voxel>, public SetVoxelExtras {
 public:
   using VoxType = Voxel;
   inline void insert(const Voxel &v) {
-    iterator existing = std::set<Voxel>::find(v);
-    if (existing == std::set<Voxel>::end())
-      std::set<Voxel>::insert(v);
-    else
-      (*existing) += v.get_length();
+    const auto existing = VoxelSet<Voxel>::insert(v);
+    if (!existing.second)
+      (*existing.first) += v.get_length();
   }
   inline void insert(const Eigen::Vector3i &v, const default_type l) {
     const Voxel temp(v, l);
@@ -273,15 +379,13 @@ class SetVoxel : public std::set<Voxel>, public SetVoxelExtras {
   }
 };
 
-class SetVoxelDEC : public std::set<VoxelDEC>, public SetVoxelExtras {
+class SetVoxelDEC : public VoxelSet<VoxelDEC>, public SetVoxelExtras {
 public:
   using VoxType = VoxelDEC;
   inline void insert(const VoxelDEC &v) {
-    iterator existing = std::set<VoxelDEC>::find(v);
-    if (existing == std::set<VoxelDEC>::end())
-      std::set<VoxelDEC>::insert(v);
-    else
-      existing->add(v.get_colour(), v.get_length());
+    const auto existing = VoxelSet<VoxelDEC>::insert(v);
+    if (!existing.second)
+      existing.first->add(v.get_colour(), v.get_length());
   }
   inline void insert(const Eigen::Vector3i &v, const Eigen::Vector3d &d) {
     const VoxelDEC temp(v, d);
@@ -293,15 +397,13 @@ class SetVoxelDEC : public std::set<VoxelDEC>, public SetVoxelExtras {
   }
 };
 
-class SetVoxelDir : public std::set<VoxelDir>, public SetVoxelExtras {
+class SetVoxelDir : public VoxelSet<VoxelDir>, public SetVoxelExtras {
 public:
   using VoxType = VoxelDir;
   inline void insert(const VoxelDir &v) {
-    iterator existing = std::set<VoxelDir>::find(v);
-    if (existing == std::set<VoxelDir>::end())
-      std::set<VoxelDir>::insert(v);
-    else
-      existing->add(v.get_dir(), v.get_length());
+    const auto existing = VoxelSet<VoxelDir>::insert(v);
+    if (!existing.second)
+      existing.first->add(v.get_dir(), v.get_length());
   }
   inline void insert(const Eigen::Vector3i &v, const Eigen::Vector3d &d) {
     const VoxelDir temp(v, d);
@@ -313,17 +415,15 @@ class SetVoxelDir : public std::set<VoxelDir>, public SetVoxelExtras {
   }
 };
 
-class SetDixel : public std::set<Dixel>, public SetVoxelExtras {
+class SetDixel : public VoxelSet<Dixel>, public SetVoxelExtras {
 public:
   using VoxType = Dixel;
   using dir_index_type = Dixel::dir_index_type;
 
   inline void insert(const Dixel &v) {
-    iterator existing = std::set<Dixel>::find(v);
-    if (existing == std::set<Dixel>::end())
-      std::set<Dixel>::insert(v);
-    else
-      (*existing) += v.get_length();
+    const auto existing = VoxelSet<Dixel>::insert(v);
+    if (!existing.second)
+      (*existing.first) += v.get_length();
   }
   inline void insert(const Eigen::Vector3i &v, const dir_index_type d) {
     const Dixel temp(v, d);
@@ -335,17 +435,15 @@ class SetDixel : public std::set<Dixel>, public SetVoxelExtras {
   }
 };
 
-class SetVoxelTOD : public std::set<VoxelTOD>, public SetVoxelExtras {
+class SetVoxelTOD : public VoxelSet<VoxelTOD>, public SetVoxelExtras {
 public:
   using VoxType = VoxelTOD;
   using vector_type = VoxelTOD::vector_type;
 
   inline void insert(const VoxelTOD &v) {
-    iterator existing = std::set<VoxelTOD>::find(v);
-    if (existing == std::set<VoxelTOD>::end())
-      std::set<VoxelTOD>::insert(v);
-    else
-      (*existing) += v.get_tod();
+    const auto existing = VoxelSet<VoxelTOD>::insert(v);
+    if (!existing.second)
+      (*existing.first) += v.get_tod();
   }
   inline void insert(const Eigen::Vector3i &v, const vector_type &t) {
     const VoxelTOD temp(v, t);
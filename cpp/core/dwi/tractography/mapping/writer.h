@@ -17,6 +17,7 @@
 #pragma once
 
 #include "algo/loop.h"
+#include "algo/threaded_loop.h"
 #include "file/path.h"
 #include "file/utils.h"
 #include "image.h"
@@ -27,6 +28,7 @@
 #include "dwi/tractography/mapping/twi_stats.h"
 #include "dwi/tractography/mapping/voxel.h"
 
+#include <mutex>
 #include <typeinfo>
 
 namespace MR::DWI::Tractography::Mapping {
@@ -64,6 +66,18 @@ class MapWriterBase {
   virtual bool operator()(const Gaussian::SetDixel &) { return false; }
   virtual bool operator()(const Gaussian::SetVoxelTOD &) { return false; }
 
+  // Support for adding the mapped streamlines to the output within the mapping
+  //   threads themselves, rather than funnelling them all to a single writer thread.
+  // Each call to partial() provides a writer for the exclusive use of one thread.
+  //   If a private buffer for each of num_threads threads fits within max_bytes,
+  //   each of these accumulates into its own buffer, and these are all combined
+  //   during finalise(); otherwise, they all write directly into the buffer of
+  //   this writer, with access to each image slice protected by a lock.
+  virtual void set_num_partials(const size_t /*num_threads*/, const size_t /*max_bytes*/) {
+    throw Exception("Multi-threaded accumulation not supported by this writer");
+  }
+  virtual MapWriterBase &partial() { throw Exception("Multi-threaded accumulation not supported by this writer"); }
+
 protected:
   const Header &H;
   const std::string output_image_name;
@@ -85,50 +99,39 @@ template <typename value_type> class MapWriter : public MapWriterBase {
             const vox_stat_t voxel_statistic = V_SUM,
             const writer_dim type = GREYSCALE)
       : MapWriterBase(header, name, voxel_statistic, type),
-        buffer(Image<value_type>::scratch(header, "TWI " + str(writer_dims[type]) + " buffer")) {
-    auto loop = Loop(buffer);
-    if (type == DEC || type == TOD) {
+        buffer(Image<value_type>::scratch(header, "TWI " + str(writer_dims[type]) + " buffer")),
+        slice_locks(nullptr) {
+    initialise();
+  }
 
-      if (voxel_statistic == V_MIN) {
-        for (auto l = loop(buffer); l; ++l)
-          buffer.value() = std::numeric_limits<value_type>::max();
-      }
-      /* shouldn't be needed: scratch IO class memset to zero already:
-                    else {
-                      buffer.zero();
-                    } */
-
-    } else { // Greyscale and dixel
-
-      if (voxel_statistic == V_MIN) {
-        for (auto l = loop(buffer); l; ++l)
-          buffer.value() = std::numeric_limits<value_type>::max();
-      } else if (voxel_statistic == V_MAX) {
-        for (auto l = loop(buffer); l; ++l)
-          buffer.value() = std::numeric_limits<value_type>::lowest();
-      }
-      /* shouldn't be needed: scratch IO class memset to zero already:
-                    else {
-                      buffer.zero();
-                    }*/
-    }
+  MapWriter(const MapWriter &) = delete;
 
-    // With TOD, hijack the counts buffer in voxel statistic min/max mode
-    //   (use to store maximum / minimum factors and hence decide when to update the TOD)
-    if ((type != DEC && voxel_statistic == V_MEAN) ||
-        (type == TOD && (voxel_statistic == V_MIN || voxel_statistic == V_MAX)) ||
-        (type == DEC && voxel_statistic == V_SUM)) {
-      Header H_counts(header);
-      if (type == DEC || type == TOD)
-        H_counts.ndim() = 3;
-      counts.reset(new Image<float>(Image<float>::scratch(H_counts, "TWI streamline count buffer")));
+  void set_num_partials(const size_t num_threads, const size_t max_bytes) override {
+    const size_t bytes_per_buffer =
+        footprint<value_type>(voxel_count(buffer)) + (counts ? voxel_count(*counts) * sizeof(float) : 0);
+    if (num_threads > 1 && num_threads * bytes_per_buffer <= max_bytes) {
+      INFO("accumulating streamline contributions in " + str(num_threads) + " per-thread buffers of " +
+           str(bytes_per_buffer / 1048576.0, 4) + " MB");
+      return;
     }
+    // Image<bool> packs voxels into bits, so neighbouring slices may share bytes:
+    locks.reset(new std::vector<std::mutex>(
+        (num_threads == 1 || std::is_same<value_type, bool>::value) ? 1 : buffer.size(2)));
+    if (num_threads > 1)
+      INFO("per-thread buffers would require " + str(num_threads * bytes_per_buffer / 1048576.0, 4) +
+           " MB; accumulating streamline contributions into a single buffer with per-slice locks");
   }
 
-  MapWriter(const MapWriter &) = delete;
+  MapWriterBase &partial() override {
+    std::lock_guard<std::mutex> lock(partials_mutex);
+    partials.emplace_back(new MapWriter(*this, locks.get()));
+    return *partials.back();
+  }
 
   void finalise() override {
 
+    merge_partials();
+
     auto loop = Loop(buffer, 0, 3);
     switch (voxel_statistic) {
 
@@ -247,6 +250,56 @@ template <typename value_type> class MapWriter : public MapWriterBase {
 private:
   Image<value_type> buffer;
 
+  // Members for multi-threaded accumulation (see MapWriterBase::partial()):
+  //   locks is only set if all threads write into the same buffer;
+  //   slice_locks is the set of locks used by this particular writer
+  std::unique_ptr<std::vector<std::mutex>> locks;
+  std::vector<std::mutex> *slice_locks;
+  std::mutex partials_mutex;
+  std::vector<std::unique_ptr<MapWriter>> partials;
+
+  // Construct a writer for the exclusive use of one thread; this writes into the buffer
+  //   of the master writer if locks are provided, or into its own buffer otherwise
+  MapWriter(const MapWriter &master, std::vector<std::mutex> *locks)
+      : MapWriterBase(master.H, "", master.voxel_statistic, master.type),
+        buffer(locks ? master.buffer
+                     : Image<value_type>::scratch(H, "TWI " + str(writer_dims[type]) + " partial buffer")),
+        slice_locks(locks) {
+    if (!slice_locks)
+      initialise();
+    else if (master.counts)
+      counts.reset(new Image<float>(*master.counts));
+  }
+
+  void initialise();
+  void merge_partials();
+  class Merge;
+
+  // Holds the lock for the slice currently being written to, if required
+  //   (voxels are visited in order of slice, so each lock is acquired at most once per streamline)
+  class SliceLock {
+  public:
+    SliceLock(std::vector<std::mutex> *locks) : locks(locks), current(-1) {}
+    ~SliceLock() {
+      if (current >= 0)
+        (*locks)[current].unlock();
+    }
+    void operator()(const ssize_t slice) {
+      if (!locks)
+        return;
+      const ssize_t index = slice % locks->size();
+      if (index == current)
+        return;
+      if (current >= 0)
+        (*locks)[current].unlock();
+      (*locks)[current = index].lock();
+    }
+
+  private:
+    std::vector<std::mutex> *locks;
+    ssize_t current;
+  };
+
   // Template functions used so that the functors don't have to be written twice
   //   (once for standard TWI and one for Gaussian track-wise statistic)
   template <class Cont> void receive_greyscale(const Cont &);
@@ -290,7 +343,9 @@ template <typename value_type> class MapWriter : public MapWriterBase {
 
 template <typename value_type> template <class Cont> void MapWriter<value_type>::receive_greyscale(const Cont &in) {
   assert(MapWriterBase::type == GREYSCALE);
+  SliceLock lock(slice_locks);
   for (const auto &i : in) {
+    lock(i[2]);
     assign_pos_of(i).to(buffer);
     const default_type factor = get_factor(i, in);
     const default_type weight = in.weight * i.get_length();
@@ -318,7 +373,9 @@ template <typename value_type> template <class Cont> void MapWriter<value_type>:
 
 template <typename value_type> template <class Cont> void MapWriter<value_type>::receive_dec(const Cont &in) {
   assert(type == DEC);
+  SliceLock lock(slice_locks);
   for (const auto &i : in) {
+    lock(i[2]);
     assign_pos_of(i).to(buffer);
     const default_type factor = get_factor(i, in);
     const default_type weight = in.weight * i.get_length();
@@ -351,7 +408,9 @@ template <typename value_type> template <class Cont> void MapWriter<value_type>:
 
 template <typename value_type> template <class Cont> void MapWriter<value_type>::receive_dixel(const Cont &in) {
   assert(type == DIXEL);
+  SliceLock lock(slice_locks);
   for (const auto &i : in) {
+    lock(i[2]);
     assign_pos_of(i, 0, 3).to(buffer);
     buffer.index(3) = i.get_dir();
     const default_type factor = get_factor(i, in);
@@ -382,7 +441,9 @@ template <typename value_type> template <class Cont> void MapWriter<value_type>:
 template <typename value_type> template <class Cont> void MapWriter<value_type>::receive_tod(const Cont &in) {
   assert(type == TOD);
   VoxelTOD::vector_type sh_coefs;
+  SliceLock lock(slice_locks);
   for (const auto &i : in) {
+    lock(i[2]);
     assign_pos_of(i, 0, 3).to(buffer);
     const default_type factor = get_factor(i, in);
     const default_type weight = in.weight * i.get_length();
@@ -427,6 +488,156 @@ template <typename value_type> template <class Cont> void MapWriter<value_type>:
   }
 }
 
+template <typename value_type> void MapWriter<value_type>::initialise() {
+  auto loop = Loop(buffer);
+  if (type == DEC || type == TOD) {
+
+    if (voxel_statistic == V_MIN) {
+      for (auto l = loop(buffer); l; ++l)
+        buffer.value() = std::numeric_limits<value_type>::max();
+    }
+    /* shouldn't be needed: scratch IO class memset to zero already:
+                  else {
+                    buffer.zero();
+                  } */
+
+  } else { // Greyscale and dixel
+
+    if (voxel_statistic == V_MIN) {
+      for (auto l = loop(buffer); l; ++l)
+        buffer.value() = std::numeric_limits<value_type>::max();
+    } else if (voxel_statistic == V_MAX) {
+      for (auto l = loop(buffer); l; ++l)
+        buffer.value() = std::numeric_limits<value_type>::lowest();
+    }
+    /* shouldn't be needed: scratch IO class memset to zero already:
+                  else {
+                    buffer.zero();
+                  }*/
+  }
+
+  // With TOD, hijack the counts buffer in voxel statistic min/max mode
+  //   (use to store maximum / minimum factors and hence decide when to update the TOD)
+  if ((type != DEC && voxel_statistic == V_MEAN) ||
+      (type == TOD && (voxel_statistic == V_MIN || voxel_statistic == V_MAX)) ||
+      (type == DEC && voxel_statistic == V_SUM)) {
+    Header H_counts(H);
+    if (type == DEC || type == TOD)
+      H_counts.ndim() = 3;
+    counts.reset(new Image<float>(Image<float>::scratch(H_counts, "TWI streamline count buffer")));
+  }
+}
+
+// Combines the per-thread partial buffers into the main buffer, one voxel at a time
+template <typename value_type> class MapWriter<value_type>::Merge {
+public:
+  Merge(MapWriter &master) : type(master.type), voxel_statistic(master.voxel_statistic), buffer(master.buffer) {
+    if (master.counts)
+      counts = *master.counts;
+    for (const auto &p : master.partials) {
+      partial_buffers.push_back(p->buffer);
+      if (p->counts)
+        partial_counts.push_back(*p->counts);
+    }
+  }
+
+  void operator()(const Iterator &pos) {
+    assign_pos_of(pos, 0, 3).to(buffer);
+    if (counts.valid())
+      assign_pos_of(pos, 0, 3).to(counts);
+    for (size_t n = 0; n != partial_buffers.size(); ++n) {
+      auto &in = partial_buffers[n];
+      assign_pos_of(pos, 0, 3).to(in);
+      if (counts.valid())
+        assign_pos_of(pos, 0, 3).to(partial_counts[n]);
+      if (type == DEC || type == TOD)
+        merge_vector(in, counts.valid() ? &partial_counts[n] : nullptr);
+      else
+        merge_values(in, counts.valid() ? &partial_counts[n] : nullptr);
+    }
+  }
+
+private:
+  const writer_dim type;
+  const vox_stat_t voxel_statistic;
+  Image<value_type> buffer;
+  Image<float> counts;
+  std::vector<Image<value_type>> partial_buffers;
+  std::vector<Image<float>> partial_counts;
+
+  // Greyscale and dixel: each value is combined independently
+  void merge_values(Image<value_type> &in, Image<float> *in_counts) {
+    const ssize_t num_volumes = buffer.ndim() > 3 ? buffer.size(3) : 1;
+    for (ssize_t v = 0; v != num_volumes; ++v) {
+      if (buffer.ndim() > 3)
+        buffer.index(3) = in.index(3) = v;
+      switch (voxel_statistic) {
+      case V_SUM:
+      case V_MEAN:
+        buffer.value() = buffer.value() + in.value();
+        break;
+      case V_MIN:
+        buffer.value() = std::min(default_type(buffer.value()), default_type(in.value()));
+        break;
+      case V_MAX:
+        buffer.value() = std::max(default_type(buffer.value()), default_type(in.value()));
+        break;
+      default:
+        throw Exception("Unknown / unhandled voxel statistic in MapWriter::Merge");
+      }
+      if (in_counts) {
+        if (counts.ndim() > 3)
+          counts.index(3) = in_counts->index(3) = v;
+        counts.value() += in_counts->value();
+      }
+    }
+  }
+
+  // DEC and TOD: the values in each voxel form a single vector; for TOD
+  //   with the min/max statistic, the counts buffer holds the extremal factor
+  void merge_vector(Image<value_type> &in, Image<float> *in_counts) {
+    bool replace = false;
+    switch (voxel_statistic) {
+    case V_SUM:
+    case V_MEAN:
+      for (auto l = Loop(3)(buffer, in); l; ++l)
+        buffer.value() += in.value();
+      if (in_counts)
+        counts.value() += in_counts->value();
+      return;
+    case V_MIN:
+      replace = (type == TOD) ? (in_counts->value() < counts.value()) : (squared_norm(in) < squared_norm(buffer));
+      break;
+    case V_MAX:
+      replace = (type == TOD) ? (in_counts->value() > counts.value()) : (squared_norm(in) > squared_norm(buffer));
+      break;
+    default:
+      throw Exception("Unknown / unhandled voxel statistic in MapWriter::Merge");
+    }
+    if (replace) {
+      for (auto l = Loop(3)(buffer, in); l; ++l)
+        buffer.value() = in.value();
+      if (in_counts)
+        counts.value() = in_counts->value();
+    }
+  }
+
+  static default_type squared_norm(Image<value_type> &image) {
+    default_type sum = 0.0;
+    for (auto l = Loop(3)(image); l; ++l)
+      sum += Math::pow2(default_type(image.value()));
+    return sum;
+  }
+};
+
+template <typename value_type> void MapWriter<value_type>::merge_partials() {
+  if (partials.empty())
+    return;
+  if (!locks)
+    ThreadedLoop("combining per-thread buffers", buffer, 0, 3).run(Merge(*this));
+  partials.clear();
+}
+
 template <> inline void MapWriter<bool>::add(const default_type weight, const default_type factor) {
   if (weight && factor)
     buffer.value() = true;
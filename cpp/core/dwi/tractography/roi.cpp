@@ -70,6 +70,46 @@ void load_rois(Properties &properties) {
     properties.mask.add(ROI(opt[i][0]));
 }
 
+std::vector<Eigen::AlignedBox3f> ROI::bounds() const {
+  std::vector<Eigen::AlignedBox3f> result;
+  if (!mask) {
+    // allow for rounding errors in the test against the radius:
+    const float extent = radius * (1.0f + 1.0e-5f) + 1.0e-5f;
+    result.emplace_back(pos - Eigen::Vector3f::Constant(extent), pos + Eigen::Vector3f::Constant(extent));
+    return result;
+  }
+  // One box per run of voxels along the first axis;
+  //   each voxel contains those points that round to its position,
+  //   with a little margin to allow for rounding errors in the transformation
+  const float half = 0.51f;
+  Mask temp(*mask);
+  auto add_run = [&](const int x0, const int x1, const int y, const int z) {
+    Eigen::AlignedBox3f box;
+    for (size_t corner = 0; corner != 8; ++corner) {
+      const Eigen::Vector3f v((corner & 1 ? x1 + half : x0 - half),
+                              (corner & 2 ? y + half : y - half),
+                              (corner & 4 ? z + half : z - half));
+      box.extend(*(mask->voxel2scanner) * v);
+    }
+    result.push_back(box);
+  };
+  for (auto l = Loop(1, 3)(temp); l; ++l) {
+    int start = -1;
+    for (temp.index(0) = 0; temp.index(0) != temp.size(0); ++temp.index(0)) {
+      if (temp.value()) {
+        if (start < 0)
+          start = temp.index(0);
+      } else if (start >= 0) {
+        add_run(start, temp.index(0) - 1, temp.index(1), temp.index(2));
+        start = -1;
+      }
+    }
+    if (start >= 0)
+      add_run(start, temp.size(0) - 1, temp.index(1), temp.index(2));
+  }
+  return result;
+}
+
 Image<bool> Mask::__get_mask(const std::string &name) {
   auto data = Image<bool>::open(name);
   std::vector<size_t> bottom(3, 0), top(3, 0);
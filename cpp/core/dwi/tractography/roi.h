@@ -99,6 +99,9 @@ class ROI {
     return (pos - p).squaredNorm() <= radius2;
   }
 
+  //! a set of boxes (in scanner space) that together enclose every point contained within the ROI
+  std::vector<Eigen::AlignedBox3f> bounds() const;
+
   friend inline std::ostream &operator<<(std::ostream &stream, const ROI &roi) {
     stream << roi.shape() << " (" << roi.parameters() << ")";
     return stream;
@@ -0,0 +1,362 @@
+/* Copyright (c) 2008-2024 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "dwi/tractography/spatial_index.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+#include "file/ofstream.h"
+#include "file/path.h"
+#include "progressbar.h"
+#include "thread.h"
+
+namespace MR::DWI::Tractography {
+
+namespace {
+
+const std::string index_magic("mrtrix track spatial index\n");
+// magic (padded to 32 bytes to keep the fields aligned), then 7 64-bit integers & 4 floats:
+constexpr size_t fields_offset = 32;
+constexpr size_t header_size = fields_offset + 7 * sizeof(int64_t) + 4 * sizeof(float);
+constexpr size_t max_bricks = size_t(1) << 22;
+constexpr size_t streamlines_per_chunk = 256;
+
+std::string sidecar_path(const std::string &path) { return path + ".sidx"; }
+
+// invoke func (thread, from, to) for consecutive chunks of the range [0, num) in parallel,
+//   where thread is the index of the invoking thread within [0, num_threads)
+template <class Functor>
+void for_each_chunk(const size_t num, const size_t num_threads, const size_t chunk_size, Functor &&func) {
+  std::atomic<size_t> next(0), started(0);
+  struct Worker {
+    Functor &func;
+    std::atomic<size_t> &next, &started;
+    const size_t num, chunk_size;
+    void execute() {
+      const size_t thread = started++;
+      size_t from;
+      while ((from = next.fetch_add(chunk_size)) < num)
+        func(thread, from, std::min(from + chunk_size, num));
+    }
+  } worker = {func, next, started, num, chunk_size};
+  if (num_threads == 1)
+    worker.execute();
+  else
+    Thread::run(Thread::multi(worker, num_threads), "spatial index threads").wait();
+}
+
+template <typename ValueType> void write_LE(File::OFStream &out, const std::vector<ValueType> &data) {
+  constexpr size_t block = 65536;
+  std::vector<ValueType> buffer;
+  for (size_t from = 0; from < data.size(); from += block) {
+    buffer.assign(data.begin() + from, data.begin() + std::min(from + block, data.size()));
+    for (auto &value : buffer)
+      value = ByteOrder::LE(value);
+    out.write(reinterpret_cast<const char *>(buffer.data()), buffer.size() * sizeof(ValueType));
+  }
+}
+
+} // namespace
+
+SpatialIndex::SpatialIndex(const std::string &path) : origin(0.0f, 0.0f, 0.0f), size(NaN), num_tracks(0) {
+  if (!available(path))
+    throw Exception("no up-to-date spatial index found for track file \"" + path + "\"");
+  const std::string name(sidecar_path(path));
+  struct stat data_stat;
+  if (stat(path.c_str(), &data_stat))
+    throw Exception("cannot stat track file \"" + path + "\": " + strerror(errno));
+
+  // only those parts of the index needed for each query are read:
+  mmap.reset(new File::MMap(File::Entry(name), false, false));
+  mmap->set_access(File::MMap::Access::Random);
+  const uint8_t *data = mmap->address();
+  if (size_t(mmap->size()) < header_size || std::string(data, data + index_magic.size()) != index_magic)
+    throw Exception("invalid spatial index file \"" + name + "\"");
+
+  const uint8_t *fields = data + fields_offset;
+  const int64_t file_size = Raw::fetch_LE<int64_t>(fields, 0);
+  num_tracks = Raw::fetch_LE<int64_t>(fields, 1);
+  for (size_t axis = 0; axis != 3; ++axis)
+    dims[axis] = Raw::fetch_LE<int64_t>(fields, 2 + axis);
+  const uint64_t num_vertex_entries = Raw::fetch_LE<int64_t>(fields, 5);
+  const uint64_t num_endpoint_entries = Raw::fetch_LE<int64_t>(fields, 6);
+  const uint8_t *floats = fields + 7 * sizeof(int64_t);
+  for (size_t axis = 0; axis != 3; ++axis)
+    origin[axis] = Raw::fetch_LE<float>(floats, axis);
+  size = Raw::fetch_LE<float>(floats, 3);
+
+  if (file_size != int64_t(data_stat.st_size))
+    throw Exception("spatial index file \"" + name + "\" does not match track file \"" + path + "\"");
+  const uint64_t expected = header_size + 2 * (num_bricks() + 1) * sizeof(uint64_t) +
+                            (num_vertex_entries + num_endpoint_entries) * sizeof(track_t);
+  if (!(size > 0.0f) || uint64_t(mmap->size()) != expected)
+    throw Exception("invalid spatial index file \"" + name + "\"");
+
+  const uint8_t *p = data + header_size;
+  const uint8_t *vertex_starts = p;
+  p += (num_bricks() + 1) * sizeof(uint64_t);
+  const uint8_t *endpoint_starts = p;
+  p += (num_bricks() + 1) * sizeof(uint64_t);
+  vertices = Table(vertex_starts, p);
+  p += num_vertex_entries * sizeof(track_t);
+  endpoints = Table(endpoint_starts, p);
+  DEBUG("opened spatial index of " + str(num_tracks) + " streamlines from file \"" + name + "\"");
+}
+
+bool SpatialIndex::available(const std::string &path) {
+  const std::string name(sidecar_path(path));
+  if (!Path::exists(name))
+    return false;
+  struct stat data_stat, index_stat;
+  if (stat(path.c_str(), &data_stat) || stat(name.c_str(), &index_stat) || index_stat.st_mtime < data_stat.st_mtime) {
+    INFO("ignoring out-of-date spatial index file \"" + name + "\"");
+    return false;
+  }
+  return true;
+}
+
+void SpatialIndex::build(const std::string &path, const float brick_size) {
+  if (!(brick_size > 0.0f))
+    throw Exception("brick size for spatial index must be positive");
+  if (Compressed::is_compressed(path))
+    throw Exception("cannot build spatial index for compressed track file \"" + path + "\"");
+
+  Properties properties;
+  Reader<float> reader(path, properties);
+  ProgressBar progress("building spatial index of track file \"" + path + "\"", 5);
+
+  // The index of streamline offsets is needed to read the candidates of any query directly
+  if (!reader.load_index()) {
+    reader.build_index();
+    reader.save_index();
+  }
+  const size_t num_tracks = reader.num_streamlines();
+  if (num_tracks > size_t(std::numeric_limits<track_t>::max()))
+    throw Exception("too many streamlines in track file \"" + path + "\" to build spatial index");
+  const size_t num_threads = std::max<size_t>(Thread::threads_to_execute(), 1);
+  ++progress;
+
+  // Find the extent of the tractogram
+  std::vector<Eigen::AlignedBox3f> extents(num_threads);
+  for_each_chunk(num_tracks, num_threads, streamlines_per_chunk, [&](size_t thread, size_t from, size_t to) {
+    Streamline<float> tck;
+    for (size_t n = from; n != to; ++n) {
+      reader.read(n, tck);
+      for (const auto &p : tck)
+        extents[thread].extend(p);
+    }
+  });
+  Eigen::AlignedBox3f extent;
+  for (const auto &e : extents)
+    extent.extend(e);
+  if (extent.isEmpty())
+    extent = Eigen::AlignedBox3f(Eigen::Vector3f::Zero(), Eigen::Vector3f::Zero());
+  ++progress;
+
+  // Divide it into bricks; each brick is indexed as x + dims[0] * (y + dims[1] * z)
+  const Eigen::Vector3f origin(extent.min());
+  float size = brick_size;
+  std::array<size_t, 3> dims;
+  while (true) {
+    for (size_t axis = 0; axis != 3; ++axis)
+      dims[axis] = size_t(std::floor((extent.max()[axis] - origin[axis]) / size)) + 1;
+    if (dims[0] * dims[1] * dims[2] <= max_bricks)
+      break;
+    size *= 2.0f;
+  }
+  if (size != brick_size)
+    WARN("brick size of spatial index increased to " + str(size) + "mm to limit the number of bricks");
+  const size_t num_bricks = dims[0] * dims[1] * dims[2];
+  auto brick = [&](const Eigen::Vector3f &p) {
+    size_t index = 0;
+    for (size_t axis = 3; axis--;)
+      index = index * dims[axis] + size_t(std::floor((p[axis] - origin[axis]) / size));
+    return index;
+  };
+  auto track_bricks = [&](const Streamline<float> &tck,
+                          std::vector<size_t> &in_bricks,
+                          std::vector<size_t> &end_bricks) {
+    in_bricks.clear();
+    end_bricks.clear();
+    if (tck.empty())
+      return;
+    for (const auto &p : tck) {
+      const size_t b = brick(p);
+      if (in_bricks.empty() || in_bricks.back() != b)
+        in_bricks.push_back(b);
+    }
+    std::sort(in_bricks.begin(), in_bricks.end());
+    in_bricks.erase(std::unique(in_bricks.begin(), in_bricks.end()), in_bricks.end());
+    end_bricks.push_back(brick(tck.front()));
+    if (brick(tck.back()) != end_bricks.front())
+      end_bricks.push_back(brick(tck.back()));
+  };
+
+  // Count the entries in each brick
+  std::vector<std::atomic<uint64_t>> vertex_cursors(num_bricks), endpoint_cursors(num_bricks);
+  for (size_t b = 0; b != num_bricks; ++b)
+    vertex_cursors[b] = endpoint_cursors[b] = 0;
+  for_each_chunk(num_tracks, num_threads, streamlines_per_chunk, [&](size_t, size_t from, size_t to) {
+    Streamline<float> tck;
+    std::vector<size_t> in_bricks, end_bricks;
+    for (size_t n = from; n != to; ++n) {
+      reader.read(n, tck);
+      track_bricks(tck, in_bricks, end_bricks);
+      for (const auto b : in_bricks)
+        vertex_cursors[b].fetch_add(1, std::memory_order_relaxed);
+      for (const auto b : end_bricks)
+        endpoint_cursors[b].fetch_add(1, std::memory_order_relaxed);
+    }
+  });
+  std::vector<uint64_t> vertex_starts(num_bricks + 1, 0), endpoint_starts(num_bricks + 1, 0);
+  for (size_t b = 0; b != num_bricks; ++b) {
+    vertex_starts[b + 1] = vertex_starts[b] + vertex_cursors[b];
+    endpoint_starts[b + 1] = endpoint_starts[b] + endpoint_cursors[b];
+    vertex_cursors[b] = vertex_starts[b];
+    endpoint_cursors[b] = endpoint_starts[b];
+  }
+  ++progress;
+
+  // Fill the entries, then sort those within each brick
+  std::vector<track_t> vertex_entries(vertex_starts.back()), endpoint_entries(endpoint_starts.back());
+  for_each_chunk(num_tracks, num_threads, streamlines_per_chunk, [&](size_t, size_t from, size_t to) {
+    Streamline<float> tck;
+    std::vector<size_t> in_bricks, end_bricks;
+    for (size_t n = from; n != to; ++n) {
+      reader.read(n, tck);
+      track_bricks(tck, in_bricks, end_bricks);
+      for (const auto b : in_bricks)
+        vertex_entries[vertex_cursors[b].fetch_add(1, std::memory_order_relaxed)] = n;
+      for (const auto b : end_bricks)
+        endpoint_entries[endpoint_cursors[b].fetch_add(1, std::memory_order_relaxed)] = n;
+    }
+  });
+  for_each_chunk(num_bricks, num_threads, 64, [&](size_t, size_t from, size_t to) {
+    for (size_t b = from; b != to; ++b) {
+      std::sort(vertex_entries.begin() + vertex_starts[b], vertex_entries.begin() + vertex_starts[b + 1]);
+      std::sort(endpoint_entries.begin() + endpoint_starts[b], endpoint_entries.begin() + endpoint_starts[b + 1]);
+    }
+  });
+  ++progress;
+
+  struct stat sbuf;
+  if (stat(path.c_str(), &sbuf))
+    throw Exception("cannot stat track file \"" + path + "\": " + strerror(errno));
+  const std::string name(sidecar_path(path));
+  File::OFStream out(name, std::ios::out | std::ios::binary | std::ios::trunc);
+  alignas(int64_t) std::array<char, header_size> header;
+  header.fill(0);
+  std::copy(index_magic.begin(), index_magic.end(), header.begin());
+  uint8_t *fields = reinterpret_cast<uint8_t *>(header.data()) + fields_offset;
+  Raw::store_LE<int64_t>(sbuf.st_size, fields, 0);
+  Raw::store_LE<int64_t>(num_tracks, fields, 1);
+  for (size_t axis = 0; axis != 3; ++axis)
+    Raw::store_LE<int64_t>(dims[axis], fields, 2 + axis);
+  Raw::store_LE<int64_t>(vertex_entries.size(), fields, 5);
+  Raw::store_LE<int64_t>(endpoint_entries.size(), fields, 6);
+  uint8_t *floats = fields + 7 * sizeof(int64_t);
+  for (size_t axis = 0; axis != 3; ++axis)
+    Raw::store_LE<float>(origin[axis], floats, axis);
+  Raw::store_LE<float>(size, floats, 3);
+  out.write(header.data(), header.size());
+  write_LE(out, vertex_starts);
+  write_LE(out, endpoint_starts);
+  write_LE(out, vertex_entries);
+  write_LE(out, endpoint_entries);
+  if (!out.good())
+    throw Exception("error writing spatial index file \"" + name + "\": " + strerror(errno));
+  ++progress;
+
+  INFO("spatial index of " + str(num_tracks) + " streamlines uses " + str(num_bricks) + " bricks of " + str(size) +
+       "mm, with " + str(vertex_entries.size()) + " entries");
+}
+
+std::vector<SpatialIndex::track_t> SpatialIndex::query(const ROI &roi, const bool ends_only) const {
+  // Find all bricks that overlap the ROI
+  std::vector<size_t> bricks;
+  for (const auto &box : roi.bounds()) {
+    std::array<size_t, 3> lo, hi;
+    bool outside = false;
+    for (size_t axis = 0; axis != 3 && !outside; ++axis) {
+      const float from = std::floor((box.min()[axis] - origin[axis]) / size);
+      const float to = std::floor((box.max()[axis] - origin[axis]) / size);
+      outside = to < 0.0f || from >= float(dims[axis]);
+      lo[axis] = from < 0.0f ? 0 : size_t(from);
+      hi[axis] = std::min(size_t(std::max(to, 0.0f)), dims[axis] - 1);
+    }
+    if (outside)
+      continue;
+    for (size_t z = lo[2]; z <= hi[2]; ++z)
+      for (size_t y = lo[1]; y <= hi[1]; ++y)
+        for (size_t x = lo[0]; x <= hi[0]; ++x)
+          bricks.push_back(x + dims[0] * (y + dims[1] * z));
+  }
+  std::sort(bricks.begin(), bricks.end());
+  bricks.erase(std::unique(bricks.begin(), bricks.end()), bricks.end());
+
+  const Table &table(ends_only ? endpoints : vertices);
+  std::vector<track_t> result;
+  for (const auto b : bricks)
+    for (uint64_t entry = table.start(b); entry != table.start(b + 1); ++entry)
+      result.push_back(table[entry]);
+  std::sort(result.begin(), result.end());
+  result.erase(std::unique(result.begin(), result.end()), result.end());
+  return result;
+}
+
+bool SpatialIndex::select(const Properties &properties, const bool ends_only, std::vector<track_t> &candidates) const {
+  candidates.clear();
+  bool restricted = false;
+  auto restrict = [&](const std::vector<track_t> &subset) {
+    if (!restricted) {
+      candidates = subset;
+      restricted = true;
+      return;
+    }
+    std::vector<track_t> intersection;
+    std::set_intersection(
+        candidates.begin(), candidates.end(), subset.begin(), subset.end(), std::back_inserter(intersection));
+    std::swap(candidates, intersection);
+  };
+
+  // Streamlines must visit every include ROI...
+  for (size_t i = 0; i != properties.include.size(); ++i)
+    restrict(query(properties.include[i], ends_only));
+  for (size_t i = 0; i != properties.ordered_include.size(); ++i)
+    restrict(query(properties.ordered_include[i], ends_only));
+
+  // ... and have at least one vertex within any mask, or nothing of them would remain
+  if (properties.mask.size()) {
+    std::vector<track_t> within_mask;
+    for (size_t i = 0; i != properties.mask.size(); ++i) {
+      const auto subset = query(properties.mask[i]);
+      std::vector<track_t> merged;
+      std::set_union(
+          within_mask.begin(), within_mask.end(), subset.begin(), subset.end(), std::back_inserter(merged));
+      std::swap(within_mask, merged);
+    }
+    restrict(within_mask);
+  }
+
+  return restricted;
+}
+
+} // namespace MR::DWI::Tractography
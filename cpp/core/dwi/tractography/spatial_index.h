@@ -0,0 +1,99 @@
+/* Copyright (c) 2008-2024 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#pragma once
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "file/mmap.h"
+#include "raw.h"
+#include "types.h"
+
+#include "dwi/tractography/file.h"
+#include "dwi/tractography/properties.h"
+#include "dwi/tractography/roi.h"
+
+namespace MR::DWI::Tractography {
+
+//! a spatial index of the streamlines in a track file
+/*! The extent of the tractogram is divided into cubic bricks; for each brick,
+ * the index lists (in increasing order) those streamlines with at least one
+ * vertex within it, and separately those with an endpoint within it. The
+ * streamlines that could possibly visit a ROI can then be found by visiting
+ * only those bricks that overlap it, such that the cost of a query scales
+ * with the number of streamlines in the vicinity of the ROI rather than with
+ * the size of the track file. These candidate streamlines must still be
+ * tested against the ROI as usual; but all other streamlines need not be read
+ * at all, since the index of streamline offsets (see MappedFile) allows the
+ * candidates to be accessed directly.
+ *
+ * The index is built using build() (as invoked by the tckindex command), and
+ * stored alongside the track file as "<file>.sidx". It is accessed via a
+ * memory-mapping, such that only those parts needed for a query are read from
+ * disk. An index that is older than the track file is ignored. */
+class SpatialIndex {
+public:
+  using track_t = uint32_t;
+
+  //! open the spatial index stored alongside track file \a path
+  SpatialIndex(const std::string &path);
+
+  //! whether a valid up-to-date spatial index is stored alongside track file \a path
+  static bool available(const std::string &path);
+  //! build the spatial index of track file \a path using bricks of \a brick_size mm, and save it alongside
+  static void build(const std::string &path, float brick_size);
+
+  size_t num_streamlines() const { return num_tracks; }
+  float brick_size() const { return size; }
+  const std::array<size_t, 3> &dimensions() const { return dims; }
+
+  //! the streamlines that may have a vertex (or, if \a endpoints is set, an endpoint) within \a roi
+  /*! the indices of the streamlines are returned in increasing order */
+  std::vector<track_t> query(const ROI &roi, bool endpoints = false) const;
+
+  //! the streamlines that may satisfy the include, ordered include and mask ROIs in \a properties
+  /*! returns false if there are no such ROIs (in which case every streamline
+   * must be read); if \a ends_only is set, only the endpoints of each
+   * streamline are considered for the include ROIs. */
+  bool select(const Properties &properties, bool ends_only, std::vector<track_t> &candidates) const;
+
+protected:
+  std::unique_ptr<File::MMap> mmap;
+  Eigen::Vector3f origin;
+  float size;
+  std::array<size_t, 3> dims;
+  size_t num_tracks;
+
+  // Each table lists the streamlines within brick b in entries [start(b), start(b+1)),
+  //   with both the offsets and the entries held within the memory-mapping
+  class Table {
+  public:
+    Table() : starts(nullptr), entries(nullptr) {}
+    Table(const uint8_t *starts, const uint8_t *entries) : starts(starts), entries(entries) {}
+    uint64_t start(size_t brick) const { return Raw::fetch_LE<uint64_t>(starts, brick); }
+    track_t operator[](uint64_t entry) const { return Raw::fetch_LE<track_t>(entries, entry); }
+
+  private:
+    const uint8_t *starts, *entries;
+  } vertices, endpoints;
+
+  size_t num_bricks() const { return dims[0] * dims[1] * dims[2]; }
+};
+
+} // namespace MR::DWI::Tractography
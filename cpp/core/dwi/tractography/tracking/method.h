@@ -51,6 +51,16 @@ class MethodBase {
     return !std::isnan(values[0]);
   }
 
+  // the interpolator for the in-RAM copy of the source image blends the rows
+  // of values of the neighbouring voxels directly, rather than interpolating
+  // one volume at a time:
+  FORCE_INLINE bool get_data(SourceCache::Interp &source, const Eigen::Vector3f &position) {
+    if (!source.scanner(position))
+      return false;
+    source.row(3, values);
+    return !std::isnan(values[0]);
+  }
+
   template <class InterpolatorType> FORCE_INLINE bool get_data(InterpolatorType &source) {
     return get_data(source, pos);
   }
@@ -19,7 +19,7 @@
 namespace MR::DWI::Tractography::Tracking {
 
 SharedBase::SharedBase(const std::string &diff_path, Properties &property_set)
-    : source(Image<float>::open(diff_path).with_direct_io(3)),
+    : source(Image<float>::open(diff_path)),
       properties(property_set),
       init_dir({NaN, NaN, NaN}),
       min_num_points_preds(0),
@@ -255,6 +255,11 @@ SharedBase::~SharedBase() {
 #endif
 }
 
+const SourceCache &SharedBase::cache() const {
+  std::call_once(source_cache_flag, [&] { source_cache.reset(new SourceCache(source)); });
+  return *source_cache;
+}
+
 void SharedBase::set_step_and_angle(const float voxel_frac, const float angle, const bool is_higher_order) {
   step_size = voxel_frac * vox();
   properties.set(step_size, "step_size");
@@ -17,11 +17,13 @@
 #pragma once
 
 #include <atomic>
+#include <mutex>
 
 #include "dwi/tractography/ACT/shared.h"
 #include "dwi/tractography/properties.h"
 #include "dwi/tractography/resampling/downsampler.h"
 #include "dwi/tractography/roi.h"
+#include "dwi/tractography/tracking/source_cache.h"
 #include "dwi/tractography/tracking/tractography.h"
 #include "dwi/tractography/tracking/types.h"
 #include "header.h"
@@ -60,6 +62,9 @@ class SharedBase {
   bool is_act() const { return bool(act_shared_additions); }
   const ACT::ACT_Shared_additions &act() const { return *act_shared_additions; }
 
+  // the in-RAM copy of the source image used for interpolation, created on first use
+  const SourceCache &cache() const;
+
   float vox() const { return std::pow(source.spacing(0) * source.spacing(1) * source.spacing(2), float(1.0 / 3.0)); }
 
   void set_step_and_angle(const float stepsize, const float angle, bool is_higher_order);
@@ -85,6 +90,9 @@ class SharedBase {
 
   std::unique_ptr<ACT::ACT_Shared_additions> act_shared_additions;
 
+  mutable std::once_flag source_cache_flag;
+  mutable std::unique_ptr<SourceCache> source_cache;
+
 #ifdef DEBUG_TERMINATIONS
   Header debug_header;
   Image<uint32_t> *debug_images[TERMINATION_REASON_COUNT];
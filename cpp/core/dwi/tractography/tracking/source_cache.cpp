@@ -0,0 +1,169 @@
+/* Copyright (c) 2008-2024 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "dwi/tractography/tracking/source_cache.h"
+
+#include <atomic>
+
+#include "app.h"
+#include "file/config.h"
+#include "math/rng.h"
+#include "thread.h"
+#include "timer.h"
+
+namespace MR::DWI::Tractography::Tracking {
+
+namespace {
+
+// process each layer of bricks (along z) in parallel, so that any given
+// brick is only ever accessed by a single thread:
+template <class Functor> class LayerProcessor {
+public:
+  LayerProcessor(const Image<float> &image, std::atomic<ssize_t> &next, ssize_t num_layers, const Functor &functor)
+      : image(image), next(next), num_layers(num_layers), functor(functor) {}
+
+  void execute() {
+    ssize_t layer;
+    while ((layer = next++) < num_layers) {
+      for (image.index(2) = 4 * layer; image.index(2) < std::min<ssize_t>(4 * (layer + 1), image.size(2));
+           ++image.index(2))
+        for (image.index(1) = 0; image.index(1) < image.size(1); ++image.index(1))
+          for (image.index(0) = 0; image.index(0) < image.size(0); ++image.index(0))
+            functor(image);
+    }
+  }
+
+private:
+  Image<float> image;
+  std::atomic<ssize_t> &next;
+  const ssize_t num_layers;
+  Functor functor;
+};
+
+template <class Functor> void for_each_voxel(const Image<float> &image, ssize_t num_layers, Functor &&functor) {
+  std::atomic<ssize_t> next(0);
+  LayerProcessor<typename std::remove_reference<Functor>::type> processor(image, next, num_layers, functor);
+  Thread::run(Thread::multi(processor), "source cache threads").wait();
+}
+
+template <class InterpType> double sampling_time(InterpType &interp, const std::vector<Eigen::Vector3d> &positions) {
+  Eigen::VectorXf values(interp.size(3));
+  float sum = 0.0;
+  Timer timer;
+  for (const auto &pos : positions) {
+    if (interp.voxel(pos) && !!interp) {
+      interp.row(3, values);
+      sum += values[0];
+    }
+  }
+  const double elapsed = timer.elapsed();
+  // prevent the compiler from optimising the loop away:
+  if (sum == std::numeric_limits<float>::infinity())
+    DEBUG("infinite sum of sampled values");
+  return elapsed;
+}
+
+} // namespace
+
+SourceCache::SourceCache(const Image<float> &image)
+    : T(image),
+      dim{image.size(0), image.size(1), image.size(2)},
+      bricks{(dim[0] + 3) / 4, (dim[1] + 3) / 4, (dim[2] + 3) / 4},
+      num_volumes(image.ndim() > 3 ? image.size(3) : 1) {
+  // CONF option: TrackingSourcePrecision
+  // CONF default: float
+  // CONF The precision with which tckgen holds a copy of the image used
+  // CONF for tracking in memory: float (single precision) or half (half
+  // CONF precision, which halves the memory required at the expense of
+  // CONF some loss of accuracy in the image values).
+  const std::string precision = lowercase(File::Config::get("TrackingSourcePrecision", "float"));
+  if (precision != "float" && precision != "half")
+    throw Exception("invalid value \"" + precision +
+                    "\" for config file entry \"TrackingSourcePrecision\" (must be float or half)");
+  use_half = precision == "half";
+
+  Timer timer;
+  occupancy.assign(bricks[0] * bricks[1] * bricks[2], 0);
+  for_each_voxel(image, bricks[2], [&](Image<float> &vox) {
+    for (vox.index(3) = 0; vox.index(3) < ssize_t(num_volumes); ++vox.index(3)) {
+      if (vox.value()) {
+        occupancy[brick(vox.index(0), vox.index(1), vox.index(2))] |=
+            uint64_t(1) << within_brick(vox.index(0), vox.index(1), vox.index(2));
+        return;
+      }
+    }
+  });
+
+  uint32_t num_stored = 0;
+  brick_index.resize(occupancy.size());
+  for (size_t n = 0; n < occupancy.size(); ++n)
+    brick_index[n] = occupancy[n] ? num_stored++ : empty_brick;
+
+  const size_t num_values = num_stored * brick_voxels * num_volumes;
+  if (use_half)
+    data_half.assign(num_values, half_float::half(0.0f));
+  else
+    data_float.assign(num_values, 0.0f);
+
+  for_each_voxel(image, bricks[2], [&](Image<float> &vox) {
+    if (!occupied(vox.index(0), vox.index(1), vox.index(2)))
+      return;
+    const size_t start = offset(vox.index(0), vox.index(1), vox.index(2));
+    for (vox.index(3) = 0; vox.index(3) < ssize_t(num_volumes); ++vox.index(3)) {
+      if (use_half)
+        data_half[start + vox.index(3)] = half_float::half(float(vox.value()));
+      else
+        data_float[start + vox.index(3)] = vox.value();
+    }
+  });
+
+  INFO("image \"" + image.name() + "\" loaded for tracking in " + str(timer.elapsed(), 3) + " seconds: " +
+       str(num_stored) + " of " + str(occupancy.size()) + " bricks of 4x4x4 voxels stored in " + precision +
+       " precision, using " + str(footprint() / 1048576.0, 4) + " MB (original image: " +
+       str(voxel_count(image) * sizeof(float) / 1048576.0, 4) + " MB)");
+
+  if (App::log_level > 1)
+    report(image);
+}
+
+size_t SourceCache::footprint() const {
+  return brick_index.size() * sizeof(uint32_t) + occupancy.size() * sizeof(uint64_t) +
+         data_float.size() * sizeof(float) + data_half.size() * sizeof(half_float::half);
+}
+
+// compare the speed of interpolation of the image data from this copy with
+// that from the original image, at random positions within the field of
+// view; since sampling the image is the dominant cost of tracking with
+// most algorithms, this provides an estimate of the speed-up in tracking:
+void SourceCache::report(const Image<float> &image) const {
+  constexpr size_t num_samples = 20000;
+  Math::RNG::Uniform<double> uniform;
+  std::vector<Eigen::Vector3d> positions(num_samples);
+  for (auto &pos : positions)
+    pos = {uniform() * (dim[0] - 1), uniform() * (dim[1] - 1), uniform() * (dim[2] - 1)};
+
+  Interpolator<Image<float>>::type original(image);
+  Interp cached(*this);
+  // run each once beforehand to warm up the caches:
+  sampling_time(original, positions);
+  sampling_time(cached, positions);
+  const double original_time = sampling_time(original, positions);
+  const double cached_time = sampling_time(cached, positions);
+  INFO("estimated speed-up in sampling of image data for tracking: " +
+       str(original_time / std::max(cached_time, 1.0e-9), 3) + "x");
+}
+
+} // namespace MR::DWI::Tractography::Tracking
@@ -0,0 +1,185 @@
+/* Copyright (c) 2008-2024 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#pragma once
+
+#include <limits>
+#include <vector>
+
+#include "half.h"
+#include "image.h"
+#include "transform.h"
+#include "types.h"
+
+namespace MR::DWI::Tractography::Tracking {
+
+//! an in-RAM copy of the tracking source image, laid out for interpolation
+/*! The image data are held voxel-contiguous (all volumes of each voxel
+ * stored consecutively), tiled into bricks of 4x4x4 voxels so that the 8
+ * neighbours required for trilinear interpolation are nearly always close
+ * together in memory. Only those bricks that contain at least one non-empty
+ * voxel (i.e. one with any non-zero value) are stored; for a typical FOD
+ * image, this excludes most of the background. Values can be stored in
+ * single or half precision (as determined by the TrackingSourcePrecision
+ * config file option).
+ *
+ * Data are accessed using SourceCache::Interp, which provides the same
+ * values as Interpolator<Image<float>>::type on the original image. */
+class SourceCache {
+public:
+  class Interp;
+
+  SourceCache(const Image<float> &image);
+
+  size_t size(size_t axis) const { return axis < 3 ? dim[axis] : num_volumes; }
+  const Transform &transform() const { return T; }
+  bool half_precision() const { return use_half; }
+
+  //! the amount of memory used to hold the data, in bytes
+  size_t footprint() const;
+
+  //! the offset to the data for voxel [x y z], or -1 if it lies within an empty brick
+  ssize_t offset(ssize_t x, ssize_t y, ssize_t z) const {
+    const uint32_t index = brick_index[brick(x, y, z)];
+    return index == empty_brick ? -1 : ssize_t(index * brick_voxels + within_brick(x, y, z)) * num_volumes;
+  }
+
+  //! whether voxel [x y z] contains any non-zero value
+  bool occupied(ssize_t x, ssize_t y, ssize_t z) const {
+    return (occupancy[brick(x, y, z)] >> within_brick(x, y, z)) & 1u;
+  }
+
+protected:
+  static constexpr uint32_t empty_brick = std::numeric_limits<uint32_t>::max();
+  static constexpr size_t brick_voxels = 64;
+
+  const Transform T;
+  ssize_t dim[3], bricks[3];
+  size_t num_volumes;
+  bool use_half;
+  std::vector<uint32_t> brick_index;
+  std::vector<uint64_t> occupancy;
+  std::vector<float> data_float;
+  std::vector<half_float::half> data_half;
+
+  size_t brick(ssize_t x, ssize_t y, ssize_t z) const {
+    return (x >> 2) + bricks[0] * ((y >> 2) + bricks[1] * (z >> 2));
+  }
+  static size_t within_brick(ssize_t x, ssize_t y, ssize_t z) { return (x & 3) | ((y & 3) << 2) | ((z & 3) << 4); }
+
+  void report(const Image<float> &image) const;
+};
+
+//! trilinear interpolation of the data held in a SourceCache
+/*! This reproduces the behaviour of Interpolator<Image<float>>::type (i.e.
+ * Interp::Masked<Interp::Linear<Image<float>>>) on the original image:
+ * positions outside the field of view, or whose nearest voxel is empty,
+ * are deemed out of bounds, and yield NaN values. */
+class SourceCache::Interp : public Transform {
+public:
+  Interp(const SourceCache &cache)
+      : Transform(cache.transform()),
+        C(&cache),
+        bounds{cache.dim[0] - 0.5, cache.dim[1] - 0.5, cache.dim[2] - 0.5},
+        out_of_bounds(true) {}
+
+  Interp(const Interp &that) = default;
+
+  size_t size(size_t axis) const { return C->size(axis); }
+
+  //! Set the current position to <b>voxel space</b> position \a pos
+  template <class VectorType> bool voxel(const VectorType &pos) {
+    if ((out_of_bounds = (pos[0] <= -0.5 || pos[0] >= bounds[0] || pos[1] <= -0.5 || pos[1] >= bounds[1] ||
+                          pos[2] <= -0.5 || pos[2] >= bounds[2])))
+      return false;
+    if (!C->occupied(std::round(pos[0]), std::round(pos[1]), std::round(pos[2]))) {
+      out_of_bounds = true;
+      return true;
+    }
+
+    ssize_t c[3];
+    float weights[3][2];
+    for (size_t i = 0; i < 3; ++i) {
+      c[i] = std::floor(pos[i]);
+      const default_type f = (pos[i] < 0.0 || pos[i] > bounds[i] - 0.5) ? 0.0 : pos[i] - c[i];
+      weights[i][0] = 1.0 - f;
+      weights[i][1] = f;
+    }
+
+    size_t i = 0;
+    for (ssize_t z = 0; z < 2; ++z) {
+      const ssize_t vz = clamp(c[2] + z, 2);
+      for (ssize_t y = 0; y < 2; ++y) {
+        const ssize_t vy = clamp(c[1] + y, 1);
+        const float partial_weight = weights[1][y] * weights[2][z];
+        for (ssize_t x = 0; x < 2; ++x) {
+          factors[i] = weights[0][x] * partial_weight;
+          offsets[i] = factors[i] < 1.0e-6f ? -1 : C->offset(clamp(c[0] + x, 0), vy, vz);
+          ++i;
+        }
+      }
+    }
+    return true;
+  }
+
+  //! Set the current position to <b>scanner space</b> position \a pos
+  template <class VectorType> FORCE_INLINE bool scanner(const VectorType &pos) {
+    return voxel(Transform::scanner2voxel * pos.template cast<default_type>());
+  }
+
+  //! Read the interpolated values for all volumes into \a values
+  template <class VectorType> void row([[maybe_unused]] size_t axis, VectorType &values) const {
+    assert(axis == 3);
+    values.resize(C->num_volumes);
+    if (out_of_bounds)
+      values.setConstant(std::numeric_limits<float>::quiet_NaN());
+    else if (C->half_precision())
+      blend(C->data_half.data(), values);
+    else
+      blend(C->data_float.data(), values);
+  }
+
+  bool operator!() const { return out_of_bounds; }
+
+protected:
+  const SourceCache *C;
+  default_type bounds[3];
+  bool out_of_bounds;
+  float factors[8];
+  ssize_t offsets[8];
+
+  ssize_t clamp(ssize_t x, size_t axis) const { return x < 0 ? 0 : (x >= C->dim[axis] ? C->dim[axis] - 1 : x); }
+
+  // neighbours with negligible weight, or within empty bricks (i.e. whose
+  // values are all zero), are skipped:
+  template <typename StorageType, class VectorType> void blend(const StorageType *data, VectorType &values) const {
+    const ssize_t num = C->num_volumes;
+    values.setZero();
+    for (size_t i = 0; i < 8; ++i) {
+      if (offsets[i] < 0)
+        continue;
+      if constexpr (std::is_same<StorageType, float>::value) {
+        values.noalias() += factors[i] * Eigen::Map<const Eigen::VectorXf>(data + offsets[i], num);
+      } else {
+        const StorageType *row = data + offsets[i];
+        for (ssize_t n = 0; n < num; ++n)
+          values[n] += factors[i] * float(row[n]);
+      }
+    }
+  }
+};
+
+} // namespace MR::DWI::Tractography::Tracking
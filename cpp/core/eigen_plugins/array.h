@@ -14,15 +14,8 @@
  * For more details, see http://www.mrtrix.org/.
  */
 
-#define MRTRIX_OP(ARG)                                                                                                 \
-  template <class ImageType> inline Array &operator ARG(const MR::Helper::ConstRow<ImageType> &row) {                  \
-    this->resize(row.image.size(row.axis), 1);                                                                         \
-    for (row.image.index(row.axis) = 0; row.image.index(row.axis) < row.image.size(row.axis);                          \
-         ++row.image.index(row.axis))                                                                                  \
-      this->operator()(row.image.index(row.axis), 0) ARG row.image.value();                                            \
-    return *this;                                                                                                      \
-  }
-
-MRTRIX_OP(=)
-
-#undef MRTRIX_OP
+template <class ImageType> inline Array &operator=(const MR::Helper::ConstRow<ImageType> &row) {
+  this->resize(row.image.size(row.axis), 1);
+  row.read(this->data());
+  return *this;
+}
@@ -14,6 +14,20 @@
  * For more details, see http://www.mrtrix.org/.
  */
 
+template <class ImageType> inline Derived &operator=(const MR::Helper::ConstRow<ImageType> &row) {
+  this->resize(row.image.size(row.axis), 1);
+  if constexpr (bool(Flags & DirectAccessBit) && IsVectorAtCompileTime &&
+                internal::inner_stride_at_compile_time<Derived>::ret == 1) {
+    // contiguous storage: read the whole row in one go
+    row.read(derived().data());
+  } else {
+    for (row.image.index(row.axis) = 0; row.image.index(row.axis) < row.image.size(row.axis);
+         ++row.image.index(row.axis))
+      this->operator()(ssize_t(row.image.index(row.axis)), 0) = row.image.value();
+  }
+  return derived();
+}
+
 #define MRTRIX_OP(ARG)                                                                                                 \
   template <class ImageType> inline Derived &operator ARG(const MR::Helper::ConstRow<ImageType> &row) {                \
     this->resize(row.image.size(row.axis), 1);                                                                         \
@@ -23,7 +37,6 @@
     return derived();                                                                                                  \
   }
 
-MRTRIX_OP(=)
 MRTRIX_OP(+=)
 MRTRIX_OP(-=)
 
@@ -157,6 +157,51 @@ void __scale_store_BE(RAMType val, void *data, size_t i, default_type offset, de
   return Raw::store_BE<DiskType>(round_func<DiskType>(scale_to_storage(val, offset, scale)), data, i);
 }
 
+// for contiguous runs of values, with the byte order handled by the
+// relevant policy class:
+
+struct SingleByte {
+  template <typename DiskType> static DiskType fetch(const void *data, size_t i) {
+    return Raw::fetch<DiskType>(data, i);
+  }
+  template <typename DiskType> static void store(DiskType val, void *data, size_t i) {
+    Raw::store<DiskType>(val, data, i);
+  }
+};
+
+struct LittleEndian {
+  template <typename DiskType> static DiskType fetch(const void *data, size_t i) {
+    return Raw::fetch_LE<DiskType>(data, i);
+  }
+  template <typename DiskType> static void store(DiskType val, void *data, size_t i) {
+    Raw::store_LE<DiskType>(val, data, i);
+  }
+};
+
+struct BigEndian {
+  template <typename DiskType> static DiskType fetch(const void *data, size_t i) {
+    return Raw::fetch_BE<DiskType>(data, i);
+  }
+  template <typename DiskType> static void store(DiskType val, void *data, size_t i) {
+    Raw::store_BE<DiskType>(val, data, i);
+  }
+};
+
+template <typename RAMType, typename DiskType, class Order>
+void __fetch_scale_span(
+    RAMType *destination, const void *data, size_t i, size_t count, default_type offset, default_type scale) {
+  for (size_t n = 0; n < count; ++n)
+    destination[n] =
+        round_func<RAMType>(scale_from_storage(Order::template fetch<DiskType>(data, i + n), offset, scale));
+}
+
+template <typename RAMType, typename DiskType, class Order>
+void __scale_store_span(
+    const RAMType *source, void *data, size_t i, size_t count, default_type offset, default_type scale) {
+  for (size_t n = 0; n < count; ++n)
+    Order::template store<DiskType>(round_func<DiskType>(scale_to_storage(source[n], offset, scale)), data, i + n);
+}
+
 } // namespace
 
 template <typename ValueType>
@@ -278,10 +323,10 @@ __set_store_function(const DataType datatype) {
 }
 
 template <typename ValueType>
-typename std::enable_if<is_data_type<ValueType>::value, void>::type __set_fetch_store_scale_functions(
-    std::function<ValueType(const void *, size_t, default_type, default_type)> &fetch_func,
-    std::function<void(ValueType, void *, size_t, default_type, default_type)> &store_func,
-    const DataType datatype) {
+typename std::enable_if<is_data_type<ValueType>::value, void>::type
+__set_fetch_store_scale_functions(FetchScaleFunction<ValueType> &fetch_func,
+                                  StoreScaleFunction<ValueType> &store_func,
+                                  const DataType datatype) {
 
   switch (datatype()) {
   case DataType::Bit:
@@ -389,14 +434,127 @@ typename std::enable_if<is_data_type<ValueType>::value, void>::type __set_fetch_
   }
 }
 
+template <typename ValueType>
+typename std::enable_if<is_data_type<ValueType>::value, void>::type
+__set_fetch_store_scale_span_functions(FetchScaleSpanFunction<ValueType> &fetch_func,
+                                       StoreScaleSpanFunction<ValueType> &store_func,
+                                       const DataType datatype) {
+
+  switch (datatype()) {
+  case DataType::Bit:
+    fetch_func = __fetch_scale_span<ValueType, bool, SingleByte>;
+    store_func = __scale_store_span<ValueType, bool, SingleByte>;
+    return;
+  case DataType::Int8:
+    fetch_func = __fetch_scale_span<ValueType, int8_t, SingleByte>;
+    store_func = __scale_store_span<ValueType, int8_t, SingleByte>;
+    return;
+  case DataType::UInt8:
+    fetch_func = __fetch_scale_span<ValueType, uint8_t, SingleByte>;
+    store_func = __scale_store_span<ValueType, uint8_t, SingleByte>;
+    return;
+  case DataType::Int16LE:
+    fetch_func = __fetch_scale_span<ValueType, int16_t, LittleEndian>;
+    store_func = __scale_store_span<ValueType, int16_t, LittleEndian>;
+    return;
+  case DataType::UInt16LE:
+    fetch_func = __fetch_scale_span<ValueType, uint16_t, LittleEndian>;
+    store_func = __scale_store_span<ValueType, uint16_t, LittleEndian>;
+    return;
+  case DataType::Int16BE:
+    fetch_func = __fetch_scale_span<ValueType, int16_t, BigEndian>;
+    store_func = __scale_store_span<ValueType, int16_t, BigEndian>;
+    return;
+  case DataType::UInt16BE:
+    fetch_func = __fetch_scale_span<ValueType, uint16_t, BigEndian>;
+    store_func = __scale_store_span<ValueType, uint16_t, BigEndian>;
+    return;
+  case DataType::Int32LE:
+    fetch_func = __fetch_scale_span<ValueType, int32_t, LittleEndian>;
+    store_func = __scale_store_span<ValueType, int32_t, LittleEndian>;
+    return;
+  case DataType::UInt32LE:
+    fetch_func = __fetch_scale_span<ValueType, uint32_t, LittleEndian>;
+    store_func = __scale_store_span<ValueType, uint32_t, LittleEndian>;
+    return;
+  case DataType::Int32BE:
+    fetch_func = __fetch_scale_span<ValueType, int32_t, BigEndian>;
+    store_func = __scale_store_span<ValueType, int32_t, BigEndian>;
+    return;
+  case DataType::UInt32BE:
+    fetch_func = __fetch_scale_span<ValueType, uint32_t, BigEndian>;
+    store_func = __scale_store_span<ValueType, uint32_t, BigEndian>;
+    return;
+  case DataType::Int64LE:
+    fetch_func = __fetch_scale_span<ValueType, int64_t, LittleEndian>;
+    store_func = __scale_store_span<ValueType, int64_t, LittleEndian>;
+    return;
+  case DataType::UInt64LE:
+    fetch_func = __fetch_scale_span<ValueType, uint64_t, LittleEndian>;
+    store_func = __scale_store_span<ValueType, uint64_t, LittleEndian>;
+    return;
+  case DataType::Int64BE:
+    fetch_func = __fetch_scale_span<ValueType, int64_t, BigEndian>;
+    store_func = __scale_store_span<ValueType, int64_t, BigEndian>;
+    return;
+  case DataType::UInt64BE:
+    fetch_func = __fetch_scale_span<ValueType, uint64_t, BigEndian>;
+    store_func = __scale_store_span<ValueType, uint64_t, BigEndian>;
+    return;
+  case DataType::Float16LE:
+    fetch_func = __fetch_scale_span<ValueType, half_float::half, LittleEndian>;
+    store_func = __scale_store_span<ValueType, half_float::half, LittleEndian>;
+    return;
+  case DataType::Float16BE:
+    fetch_func = __fetch_scale_span<ValueType, half_float::half, BigEndian>;
+    store_func = __scale_store_span<ValueType, half_float::half, BigEndian>;
+    return;
+  case DataType::Float32LE:
+    fetch_func = __fetch_scale_span<ValueType, float, LittleEndian>;
+    store_func = __scale_store_span<ValueType, float, LittleEndian>;
+    return;
+  case DataType::Float32BE:
+    fetch_func = __fetch_scale_span<ValueType, float, BigEndian>;
+    store_func = __scale_store_span<ValueType, float, BigEndian>;
+    return;
+  case DataType::Float64LE:
+    fetch_func = __fetch_scale_span<ValueType, double, LittleEndian>;
+    store_func = __scale_store_span<ValueType, double, LittleEndian>;
+    return;
+  case DataType::Float64BE:
+    fetch_func = __fetch_scale_span<ValueType, double, BigEndian>;
+    store_func = __scale_store_span<ValueType, double, BigEndian>;
+    return;
+  case DataType::CFloat32LE:
+    fetch_func = __fetch_scale_span<ValueType, cfloat, LittleEndian>;
+    store_func = __scale_store_span<ValueType, cfloat, LittleEndian>;
+    return;
+  case DataType::CFloat32BE:
+    fetch_func = __fetch_scale_span<ValueType, cfloat, BigEndian>;
+    store_func = __scale_store_span<ValueType, cfloat, BigEndian>;
+    return;
+  case DataType::CFloat64LE:
+    fetch_func = __fetch_scale_span<ValueType, cdouble, LittleEndian>;
+    store_func = __scale_store_span<ValueType, cdouble, LittleEndian>;
+    return;
+  case DataType::CFloat64BE:
+    fetch_func = __fetch_scale_span<ValueType, cdouble, BigEndian>;
+    store_func = __scale_store_span<ValueType, cdouble, BigEndian>;
+    return;
+  default:
+    throw Exception("invalid data type in image header");
+  }
+}
+
 // explicit instantiation of fetch/store methods for all types:
 #define __DEFINE_FETCH_STORE_FUNCTIONS_FOR_TYPE(ValueType)                                                             \
   template std::function<ValueType(const void *, size_t)> __set_fetch_function<ValueType>(const DataType datatype);    \
   template std::function<void(ValueType, void *, size_t)> __set_store_function<ValueType>(const DataType datatype);    \
   template void __set_fetch_store_scale_functions<ValueType>(                                                          \
-      std::function<ValueType(const void *, size_t, default_type, default_type)> & fetch_func,                         \
-      std::function<void(ValueType, void *, size_t, default_type, default_type)> & store_func,                         \
-      const DataType datatype)
+      FetchScaleFunction<ValueType> & fetch_func, StoreScaleFunction<ValueType> & store_func, const DataType datatype);\
+  template void __set_fetch_store_scale_span_functions<ValueType>(FetchScaleSpanFunction<ValueType> & fetch_func,      \
+                                                                  StoreScaleSpanFunction<ValueType> & store_func,      \
+                                                                  const DataType datatype)
 
 __DEFINE_FETCH_STORE_FUNCTIONS_FOR_TYPE(bool);
 __DEFINE_FETCH_STORE_FUNCTIONS_FOR_TYPE(uint8_t);
@@ -35,16 +35,45 @@ template <typename ValueType>
 typename std::enable_if<is_data_type<ValueType>::value, std::function<void(ValueType, void *, size_t)>>::type
 __set_store_function(const DataType datatype);
 
+//! per-voxel conversion functions between the on-disk and in-RAM data types, with scaling
 template <typename ValueType>
-typename std::enable_if<!is_data_type<ValueType>::value, void>::type __set_fetch_store_scale_functions(
-    std::function<ValueType(const void *, size_t, default_type, default_type)> & /*fetch_func*/,
-    std::function<void(ValueType, void *, size_t, default_type, default_type)> & /*store_func*/,
-    const DataType /*datatype*/) {}
+using FetchScaleFunction = ValueType (*)(const void *, size_t, default_type, default_type);
+template <typename ValueType>
+using StoreScaleFunction = void (*)(ValueType, void *, size_t, default_type, default_type);
+
+//! bulk conversion functions between the on-disk and in-RAM data types, with scaling
+/*! These convert a contiguous run of \a count values starting at offset
+ * \a i (in voxels) from \a data in a single call, so that the type
+ * dispatch, byte swapping and intensity scaling can be hoisted out of, and
+ * vectorised within, the loop over voxels. They produce exactly the same
+ * values as the corresponding per-voxel functions. */
+template <typename ValueType>
+using FetchScaleSpanFunction = void (*)(ValueType *, const void *, size_t, size_t, default_type, default_type);
+template <typename ValueType>
+using StoreScaleSpanFunction = void (*)(const ValueType *, void *, size_t, size_t, default_type, default_type);
+
+template <typename ValueType>
+typename std::enable_if<!is_data_type<ValueType>::value, void>::type
+__set_fetch_store_scale_functions(FetchScaleFunction<ValueType> & /*fetch_func*/,
+                                  StoreScaleFunction<ValueType> & /*store_func*/,
+                                  const DataType /*datatype*/) {}
+
+template <typename ValueType>
+typename std::enable_if<is_data_type<ValueType>::value, void>::type
+__set_fetch_store_scale_functions(FetchScaleFunction<ValueType> &fetch_func,
+                                  StoreScaleFunction<ValueType> &store_func,
+                                  const DataType datatype);
+
+template <typename ValueType>
+typename std::enable_if<!is_data_type<ValueType>::value, void>::type
+__set_fetch_store_scale_span_functions(FetchScaleSpanFunction<ValueType> & /*fetch_func*/,
+                                       StoreScaleSpanFunction<ValueType> & /*store_func*/,
+                                       const DataType /*datatype*/) {}
 
 template <typename ValueType>
-typename std::enable_if<is_data_type<ValueType>::value, void>::type __set_fetch_store_scale_functions(
-    std::function<ValueType(const void *, size_t, default_type, default_type)> &fetch_func,
-    std::function<void(ValueType, void *, size_t, default_type, default_type)> &store_func,
-    const DataType datatype);
+typename std::enable_if<is_data_type<ValueType>::value, void>::type
+__set_fetch_store_scale_span_functions(FetchScaleSpanFunction<ValueType> &fetch_func,
+                                       StoreScaleSpanFunction<ValueType> &store_func,
+                                       const DataType datatype);
 
 } // namespace MR
@@ -0,0 +1,461 @@
+/* Copyright (c) 2008-2024 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <sys/stat.h>
+
+#include "app.h"
+#include "file/bgzf.h"
+#include "file/path.h"
+#include "file/utils.h"
+#include "mutexprotected.h"
+#include "ordered_thread_queue.h"
+#include "progressbar.h"
+#include "raw.h"
+#include "thread.h"
+
+// size of the gzip member header, including the 'BC' extra subfield
+#define BGZF_HEADER_SIZE 18
+// size of the gzip member footer (CRC32 + ISIZE)
+#define BGZF_FOOTER_SIZE 8
+// maximum total size of a single gzip member
+#define BGZF_MAX_BLOCK_SIZE 0x10000
+
+namespace MR::File::BGZF {
+
+namespace {
+
+// the empty block used to signal the end of a BGZF file:
+constexpr uint8_t eof_marker[] = {0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x06, 0x00, 0x42, 0x43,
+                                  0x02, 0x00, 0x1b, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+
+// check for the gzip magic number & FEXTRA flag, and parse the extra field
+// for the 'BC' subfield. Returns the total size of the member, or zero if
+// this is not a BGZF member:
+size_t member_size(const uint8_t *p, size_t available) {
+  if (available < BGZF_HEADER_SIZE)
+    return 0;
+  if (p[0] != 0x1f || p[1] != 0x8b || p[2] != Z_DEFLATED || !(p[3] & 0x04))
+    return 0;
+  const size_t xlen = Raw::fetch_LE<uint16_t>(p + 10);
+  if (12 + xlen > available)
+    return 0;
+  const uint8_t *field = p + 12;
+  const uint8_t *end = field + xlen;
+  while (field + 4 <= end) {
+    const size_t slen = Raw::fetch_LE<uint16_t>(field + 2);
+    if (field[0] == 'B' && field[1] == 'C' && slen == 2 && field + 6 <= end)
+      return size_t(Raw::fetch_LE<uint16_t>(field + 4)) + 1;
+    field += 4 + slen;
+  }
+  return 0;
+}
+
+} // namespace
+
+// per-thread decompression state, reused across blocks:
+class Inflater {
+public:
+  Inflater() : initialised(false) {}
+  Inflater(const Inflater &) : initialised(false) {}
+  ~Inflater() {
+    if (initialised)
+      inflateEnd(&strm);
+  }
+
+  void operator()(const std::string &filename, const uint8_t *member, const Block &block, uint8_t *destination) {
+    if (!initialised) {
+      memset(&strm, 0, sizeof(strm));
+      if (inflateInit2(&strm, -MAX_WBITS) != Z_OK)
+        throw Exception("error initialising zlib decompression for file \"" + filename + "\"");
+      initialised = true;
+    } else
+      inflateReset(&strm);
+
+    const size_t xlen = Raw::fetch_LE<uint16_t>(member + 10);
+    strm.next_in = const_cast<Bytef *>(member + 12 + xlen);
+    strm.avail_in = block.size - 12 - xlen - BGZF_FOOTER_SIZE;
+    strm.next_out = destination;
+    strm.avail_out = block.data_size;
+    if (inflate(&strm, Z_FINISH) != Z_STREAM_END || strm.avail_out)
+      throw Exception("error uncompressing block at offset " + str(block.offset) + " of file \"" + filename + "\"" +
+                      (strm.msg ? std::string(": ") + strm.msg : std::string()));
+    const uint32_t crc = Raw::fetch_LE<uint32_t>(member + block.size - BGZF_FOOTER_SIZE);
+    if (crc32(crc32(0L, Z_NULL, 0), destination, block.data_size) != crc)
+      throw Exception("CRC mismatch for block at offset " + str(block.offset) + " of file \"" + filename + "\"");
+  }
+
+private:
+  z_stream strm;
+  bool initialised;
+};
+
+namespace {
+
+// per-thread compression state, reused across blocks:
+class Deflater {
+public:
+  Deflater(int level) : level(level), initialised(false) {}
+  Deflater(const Deflater &that) : level(that.level), initialised(false) {}
+  ~Deflater() {
+    if (initialised)
+      deflateEnd(&strm);
+  }
+
+  void operator()(const uint8_t *data, size_t size, std::vector<uint8_t> &block) {
+    if (!initialised) {
+      init(strm, level);
+      initialised = true;
+    } else
+      deflateReset(&strm);
+
+    block.resize(BGZF_MAX_BLOCK_SIZE);
+    size_t compressed_size = 0;
+    if (!deflate_into(strm, data, size, block, compressed_size)) {
+      // incompressible data: store as-is, which is guaranteed to fit
+      z_stream stored;
+      init(stored, Z_NO_COMPRESSION);
+      const bool ok = deflate_into(stored, data, size, block, compressed_size);
+      deflateEnd(&stored);
+      if (!ok)
+        throw Exception("error compressing BGZF block");
+    }
+
+    const size_t total = BGZF_HEADER_SIZE + compressed_size + BGZF_FOOTER_SIZE;
+    memcpy(block.data(), eof_marker, BGZF_HEADER_SIZE);
+    Raw::store_LE<uint16_t>(total - 1, block.data() + 16);
+    Raw::store_LE<uint32_t>(crc32(crc32(0L, Z_NULL, 0), data, size), block.data() + total - BGZF_FOOTER_SIZE);
+    Raw::store_LE<uint32_t>(size, block.data() + total - 4);
+    block.resize(total);
+  }
+
+private:
+  const int level;
+  z_stream strm;
+  bool initialised;
+
+  static void init(z_stream &s, int compression_level) {
+    memset(&s, 0, sizeof(s));
+    if (deflateInit2(&s, compression_level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+      throw Exception("error initialising zlib compression");
+  }
+
+  static bool
+  deflate_into(z_stream &s, const uint8_t *data, size_t size, std::vector<uint8_t> &block, size_t &compressed_size) {
+    s.next_in = const_cast<Bytef *>(data);
+    s.avail_in = size;
+    s.next_out = block.data() + BGZF_HEADER_SIZE;
+    s.avail_out = BGZF_MAX_BLOCK_SIZE - BGZF_HEADER_SIZE - BGZF_FOOTER_SIZE;
+    if (deflate(&s, Z_FINISH) != Z_STREAM_END)
+      return false;
+    compressed_size = s.total_out;
+    return true;
+  }
+};
+
+} // namespace
+
+bool is_bgzf(const std::string &filename) {
+  std::ifstream in(filename, std::ios::in | std::ios::binary);
+  if (!in)
+    return false;
+  uint8_t header[BGZF_HEADER_SIZE];
+  in.read(reinterpret_cast<char *>(header), BGZF_HEADER_SIZE);
+  if (in.gcount() != BGZF_HEADER_SIZE)
+    return false;
+  return member_size(header, BGZF_HEADER_SIZE);
+}
+
+Reader::Reader(const std::string &filename) : filename(filename) {
+  mmap.reset(new MMap(Entry(filename)));
+  if (!load_index())
+    scan(0, 0);
+  DEBUG("BGZF file \"" + filename + "\" contains " + str(index.size()) + " blocks (" + str(size()) +
+        " bytes uncompressed)");
+}
+
+bool Reader::load_index() {
+  const std::string index_file = index_name(filename);
+  struct stat data_stat, index_stat;
+  if (stat(filename.c_str(), &data_stat) || stat(index_file.c_str(), &index_stat))
+    return false;
+  // an index older than the file it refers to cannot be trusted:
+  if (index_stat.st_mtime < data_stat.st_mtime) {
+    DEBUG("ignoring out of date BGZF index file \"" + index_file + "\"");
+    return false;
+  }
+
+  try {
+    std::ifstream in(index_file, std::ios::in | std::ios::binary);
+    uint8_t buffer[16];
+    if (!in.read(reinterpret_cast<char *>(buffer), 8))
+      throw Exception("unexpected end of file");
+    const uint64_t count = Raw::fetch_LE<uint64_t>(buffer);
+    if (int64_t(8 + 16 * count) != int64_t(index_stat.st_size))
+      throw Exception("file size does not match number of entries");
+
+    int64_t offset = 0, data_offset = 0;
+    for (uint64_t n = 0; n < count; ++n) {
+      if (!in.read(reinterpret_cast<char *>(buffer), 16))
+        throw Exception("unexpected end of file");
+      const int64_t next_offset = Raw::fetch_LE<uint64_t>(buffer);
+      const int64_t next_data_offset = Raw::fetch_LE<uint64_t>(buffer + 8);
+      if (next_offset <= offset || next_offset - offset > BGZF_MAX_BLOCK_SIZE || next_offset >= int64_t(mmap->size()) ||
+          next_data_offset < data_offset || next_data_offset - data_offset > BGZF_MAX_BLOCK_SIZE)
+        throw Exception("invalid entry " + str(n));
+      if (next_data_offset > data_offset)
+        index.push_back({offset, uint32_t(next_offset - offset), data_offset, uint32_t(next_data_offset - data_offset)});
+      offset = next_offset;
+      data_offset = next_data_offset;
+    }
+    // the index does not record the size of the last block(s):
+    scan(offset, data_offset);
+  } catch (Exception &E) {
+    DEBUG("ignoring invalid BGZF index file \"" + index_file + "\": " + E[0]);
+    index.clear();
+    return false;
+  }
+
+  DEBUG("loaded BGZF index file \"" + index_file + "\"");
+  return true;
+}
+
+void Reader::scan(int64_t offset, int64_t data_offset) {
+  const uint8_t *data = mmap->address();
+  const int64_t file_size = mmap->size();
+  while (offset < file_size) {
+    const size_t size = member_size(data + offset, file_size - offset);
+    if (!size || offset + int64_t(size) > file_size)
+      throw Exception("file \"" + filename + "\" is not a valid BGZF file (at offset " + str(offset) + ")");
+    const uint32_t data_size = Raw::fetch_LE<uint32_t>(data + offset + size - 4);
+    if (data_size)
+      index.push_back({offset, uint32_t(size), data_offset, data_size});
+    offset += size;
+    data_offset += data_size;
+  }
+}
+
+std::pair<size_t, size_t> Reader::block_range(int64_t offset, int64_t size) const {
+  auto compare = [](const Block &block, int64_t pos) { return block.data_offset + block.data_size <= pos; };
+  const size_t first = std::lower_bound(index.begin(), index.end(), offset, compare) - index.begin();
+  const size_t last = std::lower_bound(index.begin() + first, index.end(), offset + size - 1, compare) - index.begin();
+  return {first, std::min(last + 1, index.size())};
+}
+
+size_t Reader::num_blocks(int64_t offset, int64_t size) const {
+  if (size <= 0)
+    return 0;
+  const auto range = block_range(offset, size);
+  return range.second - range.first;
+}
+
+void Reader::read(uint8_t *destination, int64_t offset, int64_t size, ProgressBar *progress) const {
+  if (size <= 0)
+    return;
+  if (offset < 0 || offset + size > this->size())
+    throw Exception("attempt to read beyond end of BGZF file \"" + filename + "\"");
+
+  const auto range = block_range(offset, size);
+
+  if (Thread::threads_to_execute() == 0) {
+    Inflater inflater;
+    std::vector<uint8_t> buffer;
+    for (size_t n = range.first; n < range.second; ++n) {
+      inflate_into(inflater, buffer, n, destination, offset, size);
+      if (progress)
+        ++(*progress);
+    }
+    return;
+  }
+
+  ProgressBar::SwitchToMultiThreaded progress_functions;
+
+  struct Shared {
+    size_t current;
+    const size_t end;
+    ProgressBar *progress;
+    bool next(size_t &n) {
+      if (current >= end)
+        return false;
+      n = current++;
+      if (progress)
+        ++(*progress);
+      return true;
+    }
+  };
+  MutexProtected<Shared> shared(range.first, range.second, progress);
+
+  struct PerThread {
+    const Reader &reader;
+    MutexProtected<Shared> &shared;
+    uint8_t *destination;
+    const int64_t offset, size;
+    Inflater inflater;
+    std::vector<uint8_t> buffer;
+    void execute() {
+      size_t n;
+      while (shared.lock()->next(n))
+        reader.inflate_into(inflater, buffer, n, destination, offset, size);
+    }
+  } loop_thread = {*this, shared, destination, offset, size, Inflater(), {}};
+
+  auto threads = Thread::run(Thread::multi(loop_thread), "BGZF decompression threads");
+  if (progress)
+    progress->run_update_thread(threads);
+  threads.wait();
+}
+
+void Reader::read_serial(uint8_t *destination, int64_t offset, int64_t size) const {
+  if (size <= 0)
+    return;
+  if (offset < 0 || offset + size > this->size())
+    throw Exception("attempt to read beyond end of BGZF file \"" + filename + "\"");
+  const auto range = block_range(offset, size);
+  Inflater inflater;
+  std::vector<uint8_t> buffer;
+  for (size_t n = range.first; n < range.second; ++n)
+    inflate_into(inflater, buffer, n, destination, offset, size);
+}
+
+void Reader::inflate_into(Inflater &inflater,
+                          std::vector<uint8_t> &buffer,
+                          size_t n,
+                          uint8_t *destination,
+                          int64_t offset,
+                          int64_t size) const {
+  const Block &block = index[n];
+  const uint8_t *member = mmap->address() + block.offset;
+  // guard against a stale or corrupt index file:
+  if (member_size(member, block.size) != block.size)
+    throw Exception("invalid BGZF block at offset " + str(block.offset) + " of file \"" + filename + "\"");
+  const int64_t block_end = block.data_offset + block.data_size;
+  if (block.data_offset >= offset && block_end <= offset + size) {
+    inflater(filename, member, block, destination + (block.data_offset - offset));
+  } else {
+    // block only partially overlaps with requested range:
+    buffer.resize(block.data_size);
+    inflater(filename, member, block, buffer.data());
+    const int64_t from = std::max(offset, block.data_offset);
+    const int64_t to = std::min(offset + size, block_end);
+    memcpy(destination + (from - offset), buffer.data() + (from - block.data_offset), to - from);
+  }
+}
+
+Writer::Writer(const std::string &filename, int compression_level, bool write_index)
+    : filename(filename),
+      out(filename, std::ios::out | std::ios::binary | std::ios::trunc),
+      level(compression_level),
+      write_index(write_index),
+      offset(0),
+      data_offset(0) {
+  if (!out)
+    throw Exception("error opening output file \"" + filename + "\": " + std::strerror(errno));
+}
+
+Writer::~Writer() {
+  try {
+    close();
+  } catch (Exception &E) {
+    E.display();
+    App::exit_error_code = 1;
+  }
+}
+
+void Writer::write(const uint8_t *data, int64_t size, ProgressBar *progress) {
+  if (size <= 0)
+    return;
+  if (!out.is_open())
+    throw Exception("attempt to write to closed BGZF file \"" + filename + "\"");
+
+  struct Chunk {
+    const uint8_t *data;
+    size_t size;
+  };
+
+  struct Source {
+    const uint8_t *data, *end;
+    bool operator()(Chunk &item) {
+      if (data >= end)
+        return false;
+      item.data = data;
+      item.size = std::min(size_t(end - data), block_data_size);
+      data += item.size;
+      return true;
+    }
+  } source = {data, data + size};
+
+  struct Compressor {
+    Deflater deflater;
+    bool operator()(const Chunk &in, std::vector<uint8_t> &out) {
+      deflater(in.data, in.size, out);
+      return true;
+    }
+  } compressor = {Deflater(level)};
+
+  struct Sink {
+    Writer &writer;
+    ProgressBar *progress;
+    bool operator()(const std::vector<uint8_t> &block) {
+      writer.out.write(reinterpret_cast<const char *>(block.data()), block.size());
+      if (!writer.out.good())
+        throw Exception("error writing to BGZF file \"" + writer.filename + "\": " + std::strerror(errno));
+      writer.offset += block.size();
+      writer.data_offset += Raw::fetch_LE<uint32_t>(block.data() + block.size() - 4);
+      writer.restart_points.push_back({uint64_t(writer.offset), uint64_t(writer.data_offset)});
+      if (progress)
+        ++(*progress);
+      return true;
+    }
+  } sink = {*this, progress};
+
+  Thread::run_ordered_queue(source, Chunk(), Thread::multi(compressor), std::vector<uint8_t>(), sink);
+}
+
+void Writer::close() {
+  if (!out.is_open())
+    return;
+  out.write(reinterpret_cast<const char *>(eof_marker), sizeof(eof_marker));
+  out.close();
+  if (out.fail())
+    throw Exception("error writing to BGZF file \"" + filename + "\": " + std::strerror(errno));
+
+  const std::string index_file = index_name(filename);
+  if (!write_index) {
+    if (Path::exists(index_file))
+      File::remove(index_file);
+    return;
+  }
+
+  // the last restart point is the position of the EOF marker, which
+  // holds no data and need not be indexed:
+  if (restart_points.size())
+    restart_points.pop_back();
+  std::ofstream index_out(index_file, std::ios::out | std::ios::binary | std::ios::trunc);
+  uint8_t buffer[16];
+  Raw::store_LE<uint64_t>(restart_points.size(), buffer);
+  index_out.write(reinterpret_cast<const char *>(buffer), 8);
+  for (const auto &entry : restart_points) {
+    Raw::store_LE<uint64_t>(entry.first, buffer);
+    Raw::store_LE<uint64_t>(entry.second, buffer + 8);
+    index_out.write(reinterpret_cast<const char *>(buffer), 16);
+  }
+  index_out.close();
+  if (index_out.fail())
+    throw Exception("error writing BGZF index file \"" + index_file + "\": " + std::strerror(errno));
+}
+
+} // namespace MR::File::BGZF
@@ -0,0 +1,149 @@
+/* Copyright (c) 2008-2024 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#pragma once
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+#include "file/mmap.h"
+#include "types.h"
+
+namespace MR {
+class ProgressBar;
+}
+
+namespace MR::File::BGZF {
+
+class Inflater;
+
+/*! \brief functions and classes to handle block-compressed gzip files
+ *
+ * A BGZF file is a series of concatenated gzip members, each holding at most
+ * 64kB of uncompressed data, with the compressed size of each member stored
+ * in a 'BC' extra field of its gzip header. The result is a perfectly valid
+ * gzip stream that any gzip-compatible tool can read serially, but since
+ * each member can be located and inflated independently, both compression
+ * and decompression can be distributed over multiple threads.
+ *
+ * This is the same layout as used by the SAMtools / HTSlib suite of tools.
+ */
+
+//! the maximum number of uncompressed bytes stored in each block
+constexpr size_t block_data_size = 0xff00;
+
+//! the location of a single compressed block within a BGZF file
+class Block {
+public:
+  int64_t offset;      //!< position of the gzip member within the file
+  uint32_t size;       //!< size of the gzip member, including header and footer
+  int64_t data_offset; //!< position of the first uncompressed byte within the uncompressed stream
+  uint32_t data_size;  //!< number of uncompressed bytes held in the block
+};
+
+//! check whether the file \a filename begins with a BGZF block header
+bool is_bgzf(const std::string &filename);
+
+//! the name of the index sidecar file associated with BGZF file \a filename
+/*! The index uses the same format as the HTSlib '.gzi' index: a
+ * little-endian 64-bit count, followed by that many pairs of 64-bit
+ * (compressed, uncompressed) offsets, one for each block after the first. */
+inline std::string index_name(const std::string &filename) { return filename + ".gzi"; }
+
+//! random-access, multi-threaded decompression of a BGZF file
+/*! The file is memory-mapped, and the location of all compressed blocks is
+ * determined up-front, either from the index sidecar file if present and up
+ * to date (see index_name()), or otherwise by scanning through the gzip
+ * member headers (which does not require any decompression). Any range of
+ * the uncompressed stream can then be inflated in parallel, decompressing
+ * only those blocks that overlap with the requested range. */
+class Reader {
+public:
+  Reader(const std::string &filename);
+
+  const std::string &name() const { return filename; }
+  const std::vector<Block> &blocks() const { return index; }
+
+  //! the total size of the uncompressed stream
+  int64_t size() const { return index.empty() ? 0 : index.back().data_offset + index.back().data_size; }
+
+  //! the number of blocks that need to be inflated to access the specified range
+  size_t num_blocks(int64_t offset, int64_t size) const;
+
+  //! inflate \a size bytes starting at \a offset into the uncompressed stream
+  /*! If \a progress is provided, it will be incremented once per block. */
+  void read(uint8_t *destination, int64_t offset, int64_t size, ProgressBar *progress = nullptr) const;
+
+  //! as read(), but inflating all blocks within the calling thread
+  /*! This is intended for use from within threads that are already
+   * running concurrently, e.g. when loading data on demand. */
+  void read_serial(uint8_t *destination, int64_t offset, int64_t size) const;
+
+protected:
+  std::string filename;
+  std::unique_ptr<MMap> mmap;
+  std::vector<Block> index;
+
+  bool load_index();
+  void scan(int64_t offset, int64_t data_offset);
+  std::pair<size_t, size_t> block_range(int64_t offset, int64_t size) const;
+  void inflate_into(Inflater &inflater,
+                    std::vector<uint8_t> &buffer,
+                    size_t n,
+                    uint8_t *destination,
+                    int64_t offset,
+                    int64_t size) const;
+};
+
+//! multi-threaded compression of data into a BGZF file
+/*! Each call to write() starts a new block, so that the data passed in
+ * each call can subsequently be accessed without needing to decompress any
+ * of the data written in other calls (e.g. the image header and the image
+ * data). The BGZF end-of-file marker is written on close(), along with the
+ * index sidecar file if \a write_index is set (any pre-existing index for
+ * this file is otherwise deleted, since it would no longer be valid).
+ *
+ * \note any existing file will be truncated: it is the responsibility of the
+ * caller to check for permission to overwrite beforehand (as is done by the
+ * various image format handlers when creating the image). */
+class Writer {
+public:
+  Writer(const std::string &filename, int compression_level = Z_DEFAULT_COMPRESSION, bool write_index = false);
+  ~Writer();
+
+  //! compress \a size bytes from \a data and append to the file
+  /*! If \a progress is provided, it will be incremented once per block. */
+  void write(const uint8_t *data, int64_t size, ProgressBar *progress = nullptr);
+
+  void close();
+
+  //! the number of blocks required to store \a size bytes
+  static size_t num_blocks(int64_t size) { return (size + block_data_size - 1) / block_data_size; }
+
+protected:
+  std::string filename;
+  std::ofstream out;
+  const int level;
+  const bool write_index;
+  int64_t offset, data_offset;
+  std::vector<std::pair<uint64_t, uint64_t>> restart_points;
+};
+
+} // namespace MR::File::BGZF
@@ -29,6 +29,7 @@
 #include <windows.h>
 #else
 #include <sys/mman.h>
+#include <sys/resource.h>
 #endif
 
 #include "app.h"
@@ -36,13 +37,14 @@
 #include "file/mmap.h"
 #include "file/ofstream.h"
 #include "file/path.h"
+#include "file/prefetch.h"
 
 #include "debug.h"
 
 namespace MR::File {
 
 MMap::MMap(const Entry &entry, bool readwrite, bool preload, int64_t mapped_size)
-    : Entry(entry), addr(NULL), first(NULL), msize(mapped_size), readwrite(readwrite) {
+    : Entry(entry), addr(NULL), first(NULL), msize(mapped_size), readwrite(readwrite), prefetch(false) {
   DEBUG("memory-mapping file \"" + Entry::name + "\"...");
 
   struct stat sbuf;
@@ -183,11 +185,13 @@ MMap::~MMap() {
   if (!first)
     return;
   if (addr) {
+    if (prefetch)
+      Prefetch::remove(first);
     DEBUG("unmapping file \"" + Entry::name + "\"");
 #ifdef MRTRIX_WINDOWS
     if (!UnmapViewOfFile((LPVOID)addr))
 #else
-    if (munmap(addr, msize))
+    if (munmap(addr, start + msize))
 #endif
       WARN("error unmapping file \"" + Entry::name + "\": " + strerror(errno));
     close(fd);
@@ -209,6 +213,35 @@ MMap::~MMap() {
   }
 }
 
+void MMap::set_access(Access access, int64_t block_size) {
+  if (!addr)
+    return;
+
+#ifndef MRTRIX_WINDOWS
+  int advice = MADV_NORMAL;
+  if (access == Access::Sequential)
+    advice = MADV_SEQUENTIAL;
+  else if (access == Access::Random)
+    advice = MADV_RANDOM;
+  if (madvise(addr, start + msize, advice))
+    DEBUG("unable to set access pattern for file \"" + Entry::name + "\": " + strerror(errno));
+#ifdef POSIX_FADV_SEQUENTIAL
+  const int file_advice = access == Access::Sequential ? POSIX_FADV_SEQUENTIAL
+                          : access == Access::Random   ? POSIX_FADV_RANDOM
+                                                       : POSIX_FADV_NORMAL;
+  posix_fadvise(fd, start, msize, file_advice);
+#endif
+#endif
+
+  if (prefetch)
+    Prefetch::remove(first);
+  prefetch = access != Access::Random && Prefetch::enabled();
+  if (prefetch) {
+    Prefetch::add(first, msize, access == Access::Volume && block_size > 0 ? block_size : msize);
+    DEBUG("file \"" + Entry::name + "\" registered for background prefetching");
+  }
+}
+
 bool MMap::changed() const {
   assert(fd >= 0);
   struct stat sbuf;
@@ -221,4 +254,16 @@ bool MMap::changed() const {
   return false;
 }
 
+void report_page_faults() {
+#ifndef MRTRIX_WINDOWS
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage))
+    return;
+  std::string msg = "page faults: " + str(usage.ru_majflt) + " major, " + str(usage.ru_minflt) + " minor";
+  if (Prefetch::pages_read())
+    msg += " (" + str(Prefetch::pages_read()) + " pages read ahead by prefetch thread)";
+  INFO(msg);
+#endif
+}
+
 } // namespace MR::File
@@ -27,6 +27,16 @@ namespace MR::File {
 
 class MMap : protected Entry {
 public:
+  //! the expected pattern of access to the mapped data
+  /*! - \c Normal: no particular pattern (the system default);
+   * - \c Sequential: the data will be accessed in order;
+   * - \c Volume: the data consist of consecutive blocks (typically image
+   *   volumes), and corresponding portions of each block will be accessed
+   *   together (e.g. when looping over the voxels of a 4D image stored
+   *   with the volumes contiguous);
+   * - \c Random: the data will be accessed in no predictable order. */
+  enum class Access { Normal, Sequential, Volume, Random };
+
   //! create a new memory-mapping to file in \a entry
   /*! map file in \a entry at the offset in \a entry. By default, the
    * file will be mapped read-only. If \a readwrite is set to true,
@@ -59,6 +69,15 @@ class MMap : protected Entry {
   bool is_read_write() const { return readwrite; }
   bool changed() const;
 
+  //! advise the system of the expected pattern of access to the data
+  /*! This sets the readahead policy of the kernel for the mapped region
+   * (where supported), and registers the region for reading ahead by the
+   * background prefetch thread if enabled (see File::Prefetch). For \c
+   * Volume access, \a block_size should be set to the size of each block
+   * in bytes. Has no effect for files held in RAM using the delayed
+   * write-back mechanism. */
+  void set_access(Access access, int64_t block_size = 0);
+
   friend std::ostream &operator<<(std::ostream &stream, const MMap &m) {
     stream << "File::MMap { " << m.name() << " [" << m.fd << "], size: " << m.size() << ", mapped "
            << (m.readwrite ? "RW" : "RO") << " at " << (void *)m.address() << ", offset " << m.start << " }";
@@ -71,14 +90,21 @@ class MMap : protected Entry {
   uint8_t *first; /**< The address in memory to the start of the region of interest. */
   int64_t msize;  /**< The size of the file. */
   time_t mtime;   /**< The modification time of the file at the last check. */
-  bool readwrite;
+  bool readwrite, prefetch;
 
   void map();
 
 private:
-  MMap(const MMap &mmap) : Entry(mmap), fd(0), addr(NULL), first(NULL), msize(0), mtime(0), readwrite(false) {
+  MMap(const MMap &mmap)
+      : Entry(mmap), fd(0), addr(NULL), first(NULL), msize(0), mtime(0), readwrite(false), prefetch(false) {
     assert(0);
   }
 };
 
+//! report the number of page faults incurred by the command so far
+/*! This is displayed at the end of each command at the INFO level, to
+ * help identify commands that stall waiting for data to be read in from
+ * storage (major page faults). */
+void report_page_faults();
+
 } // namespace MR::File
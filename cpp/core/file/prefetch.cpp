@@ -0,0 +1,192 @@
+/* Copyright (c) 2008-2024 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifndef MRTRIX_WINDOWS
+#include <sys/mman.h>
+#endif
+
+#include "file/config.h"
+#include "file/prefetch.h"
+
+namespace MR::File::Prefetch {
+
+namespace {
+
+constexpr int64_t page_size = 4096;
+// the maximum number of bytes read ahead per block for each request:
+constexpr int64_t max_request_size = 64 << 20;
+// the number of bytes read in before checking whether the region is still registered:
+constexpr int64_t step_size = 1 << 20;
+// requests not yet serviced beyond this number are discarded, oldest first:
+constexpr size_t max_pending_requests = 64;
+
+std::atomic<size_t> num_regions(0);
+std::atomic<uint64_t> num_pages_read(0);
+
+class Region {
+public:
+  const uint8_t *address;
+  int64_t size, period;
+};
+
+class Worker {
+public:
+  Worker() : stop(false), thread([this] { execute(); }) {}
+  ~Worker() {
+    {
+      std::lock_guard<std::mutex> lock(requests_mutex);
+      stop = true;
+    }
+    condition.notify_one();
+    thread.join();
+  }
+
+  void add(const Region &region) {
+    std::lock_guard<std::mutex> lock(regions_mutex);
+    regions.push_back(region);
+    ++num_regions;
+  }
+
+  void remove(const uint8_t *address) {
+    std::lock_guard<std::mutex> lock(regions_mutex);
+    auto it = std::find_if(regions.begin(), regions.end(), [address](const Region &r) { return r.address == address; });
+    if (it != regions.end()) {
+      regions.erase(it);
+      --num_regions;
+    }
+  }
+
+  void request(double from, double to) {
+    {
+      std::lock_guard<std::mutex> lock(requests_mutex);
+      if (requests.size() >= max_pending_requests)
+        requests.pop_front();
+      requests.emplace_back(from, to);
+    }
+    condition.notify_one();
+  }
+
+private:
+  std::mutex regions_mutex, requests_mutex;
+  std::condition_variable condition;
+  std::vector<Region> regions;
+  std::deque<std::pair<double, double>> requests;
+  std::atomic<bool> stop;
+  std::thread thread;
+
+  void execute() {
+    while (true) {
+      std::pair<double, double> range;
+      {
+        std::unique_lock<std::mutex> lock(requests_mutex);
+        condition.wait(lock, [this] { return stop || !requests.empty(); });
+        if (stop)
+          return;
+        range = requests.front();
+        requests.pop_front();
+      }
+      std::vector<Region> snapshot;
+      {
+        std::lock_guard<std::mutex> lock(regions_mutex);
+        snapshot = regions;
+      }
+      for (const auto &region : snapshot)
+        read_ahead(region, range.first, range.second);
+    }
+  }
+
+  void read_ahead(const Region &region, double from, double to) {
+    const int64_t period = region.period > 0 ? std::min(region.period, region.size) : region.size;
+    const int64_t begin = std::max<int64_t>(from * period, 0);
+    const int64_t end = std::min<int64_t>(std::min<int64_t>(to * period, period), begin + max_request_size);
+    for (int64_t block = 0; block < region.size; block += period) {
+      const int64_t last = std::min(block + end, region.size);
+      for (int64_t offset = block + begin; offset < last; offset += step_size) {
+        if (stop)
+          return;
+        // the region must not be unmapped while its pages are being accessed:
+        std::lock_guard<std::mutex> lock(regions_mutex);
+        if (std::find_if(regions.begin(), regions.end(), [&](const Region &r) {
+              return r.address == region.address;
+            }) == regions.end())
+          return;
+        touch(region.address + offset, std::min(step_size, last - offset));
+      }
+    }
+  }
+
+  static void touch(const uint8_t *address, int64_t size) {
+    const uintptr_t first = reinterpret_cast<uintptr_t>(address) & ~uintptr_t(page_size - 1);
+    const uintptr_t last = reinterpret_cast<uintptr_t>(address + size);
+#ifdef MADV_WILLNEED
+    madvise(reinterpret_cast<void *>(first), last - first, MADV_WILLNEED);
+#endif
+    uint8_t sum = 0;
+    for (uintptr_t page = first; page < last; page += page_size)
+      sum ^= *reinterpret_cast<const volatile uint8_t *>(page);
+    (void)sum;
+    num_pages_read += (last - first + page_size - 1) / page_size;
+  }
+};
+
+Worker &worker() {
+  static Worker instance;
+  return instance;
+}
+
+} // namespace
+
+bool enabled() {
+  // CONF option: MMapPrefetch
+  // CONF default: 0 (false)
+  // CONF A boolean value to indicate whether a background thread should be
+  // CONF used to read ahead of the current processing position within
+  // CONF memory-mapped input images. This prevents the processing threads
+  // CONF from stalling while the data are read in from storage, and is
+  // CONF mostly beneficial for large images residing on networked or
+  // CONF otherwise slow storage. See also ImageAccessProfile.
+  static const bool prefetch = File::Config::get_bool("MMapPrefetch", false);
+  return prefetch;
+}
+
+bool active() { return num_regions.load(std::memory_order_relaxed); }
+
+void add(const uint8_t *address, int64_t size, int64_t period) {
+  if (enabled() && size > 0)
+    worker().add({address, size, period});
+}
+
+void remove(const uint8_t *address) {
+  if (active())
+    worker().remove(address);
+}
+
+void request(double from, double to) {
+  if (active())
+    worker().request(from, to);
+}
+
+uint64_t pages_read() { return num_pages_read; }
+
+} // namespace MR::File::Prefetch
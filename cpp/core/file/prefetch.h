@@ -0,0 +1,65 @@
+/* Copyright (c) 2008-2024 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+namespace MR::File::Prefetch {
+
+/*! \brief read ahead of the current processing position within memory-mapped files
+ *
+ * When enabled via the MMapPrefetch config file option, memory-mapped input
+ * files (see File::MMap::set_access()) are registered with a single
+ * background thread. The threads of a ThreadedLoop() then announce the
+ * portion of the outer loop that they are about to process, as a fraction
+ * of the full extent of the loop, via request(). The background thread
+ * faults in the corresponding range of each registered file, so that the
+ * loop threads do not stall on synchronous page faults, which is
+ * particularly beneficial when the data reside on networked or otherwise
+ * slow storage.
+ *
+ * Each registered region is split into consecutive blocks of \a period
+ * bytes, and the requested fraction of each block is read in. For images
+ * stored with the volumes contiguous in the file, setting the period to
+ * the size of one volume ensures that the same slab is read from every
+ * volume, matching the way a loop over the three spatial axes accesses the
+ * data. For a period equal to the size of the region, the file is
+ * simply read ahead sequentially. */
+
+//! whether background prefetching is enabled (see the MMapPrefetch config file option)
+bool enabled();
+
+//! whether any regions are currently registered for prefetching
+bool active();
+
+//! register a memory-mapped region for prefetching
+void add(const uint8_t *address, int64_t size, int64_t period);
+
+//! unregister a memory-mapped region
+/*! This waits until the background thread is no longer accessing the
+ * region, and must be invoked before it is unmapped. */
+void remove(const uint8_t *address);
+
+//! request that the portion [\a from, \a to) of all registered regions be read ahead
+/*! The range is expressed as fractions of the period of each region (see
+ * above). This returns immediately: the data are read in asynchronously. */
+void request(double from, double to);
+
+//! the number of pages read in by the background thread so far
+uint64_t pages_read();
+
+} // namespace MR::File::Prefetch
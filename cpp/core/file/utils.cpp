@@ -19,6 +19,10 @@
 #include <fcntl.h>
 #include <unistd.h>
 
+#ifndef MRTRIX_WINDOWS
+#include <sys/statvfs.h>
+#endif
+
 #include "app.h"
 #include "exception.h"
 #include "file/config.h"
@@ -111,6 +115,72 @@ const std::string &tmpfile_prefix() {
   return __tmpfile_prefix;
 }
 
+// CONF option: PipeSharedMemory
+// CONF default: 1 (true)
+// CONF A boolean value to indicate whether images piped between commands
+// CONF should be held in shared memory (/dev/shm, where available), so
+// CONF that the receiving command maps the very same memory pages as the
+// CONF command that produced the image, without its data ever being
+// CONF written to or read back from a filesystem. If shared memory is not
+// CONF available, or has insufficient space left for the image, the
+// CONF temporary file is created in :option:`TmpFileDir` as usual.
+const std::string __get_shared_memory_dir() {
+#ifdef MRTRIX_WINDOWS
+  return std::string();
+#else
+  if (!File::Config::get_bool("PipeSharedMemory", true))
+    return std::string();
+  const std::string dir("/dev/shm");
+  if (!Path::is_dir(dir) || access(dir.c_str(), W_OK | X_OK)) {
+    DEBUG("shared memory not available - piped images will be stored in \"" + tmpfile_dir() + "\"");
+    return std::string();
+  }
+  return dir;
+#endif
+}
+
+const std::string &shared_memory_dir() {
+  static const std::string __shared_memory_dir = __get_shared_memory_dir();
+  return __shared_memory_dir;
+}
+
+int64_t space_available(const std::string &dir) {
+#ifdef MRTRIX_WINDOWS
+  return 0;
+#else
+  struct statvfs fsbuf;
+  if (statvfs(dir.c_str(), &fsbuf))
+    return 0;
+  return int64_t(fsbuf.f_bavail) * int64_t(fsbuf.f_frsize);
+#endif
+}
+
+std::string create_tempfile_in(const std::string &dir, int64_t size, const char *suffix) {
+  DEBUG("creating temporary file of size " + str(size) + " in \"" + dir + "\"");
+
+  std::string filename(Path::join(dir, tmpfile_prefix()) + "XXXXXX.");
+  const int rand_index = filename.size() - 7;
+  if (suffix != nullptr)
+    filename += suffix;
+
+  int fid(0);
+  do {
+    for (int n = 0; n < 6; n++)
+      filename[rand_index + n] = random_char();
+    fid = open(filename.c_str(), O_CREAT | O_RDWR | O_EXCL, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
+  } while (fid < 0 && errno == EEXIST);
+
+  if (fid < 0)
+    throw Exception(std::string("error creating temporary file in directory \"" + dir + "\": ") + strerror(errno));
+
+  const int status = size == 0 ? 0 : ftruncate(fid, size);
+  close(fid);
+  if (status)
+    throw Exception("cannot resize file \"" + filename + "\": " + strerror(errno));
+
+  return filename;
+}
+
 } // namespace
 
 void remove(const std::string &file) {
@@ -170,30 +240,19 @@ bool is_tempfile(const std::string &name, const char *suffix) {
 }
 
 std::string create_tempfile(int64_t size, const char *suffix) {
-  DEBUG("creating temporary file of size " + str(size));
-
-  std::string filename(Path::join(tmpfile_dir(), tmpfile_prefix()) + "XXXXXX.");
-  const int rand_index = filename.size() - 7;
-  if (suffix != nullptr)
-    filename += suffix;
-
-  int fid(0);
-  do {
-    for (int n = 0; n < 6; n++)
-      filename[rand_index + n] = random_char();
-    fid = open(filename.c_str(), O_CREAT | O_RDWR | O_EXCL, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
-  } while (fid < 0 && errno == EEXIST);
-
-  if (fid < 0)
-    throw Exception(std::string("error creating temporary file in directory \"" + tmpfile_dir() + "\": ") +
-                    strerror(errno));
-
-  const int status = size == 0 ? 0 : ftruncate(fid, size);
-  close(fid);
-  if (status)
-    throw Exception("cannot resize file \"" + filename + "\": " + strerror(errno));
+  return create_tempfile_in(tmpfile_dir(), size, suffix);
+}
 
-  return filename;
+std::string create_pipe_tempfile(int64_t expected_size, const char *suffix) {
+  const std::string &shm_dir(shared_memory_dir());
+  if (!shm_dir.empty()) {
+    // leave some headroom for the image header and for other processes:
+    if (space_available(shm_dir) > expected_size + (expected_size >> 4) + (int64_t(1) << 20))
+      return create_tempfile_in(shm_dir, 0, suffix);
+    INFO("insufficient shared memory to hold piped image of " + str(expected_size) + " bytes - using \"" +
+         tmpfile_dir() + "\" instead");
+  }
+  return create_tempfile(0, suffix);
 }
 
 void mkdir(const std::string &folder) {
@@ -25,6 +25,7 @@ void create(const std::string &filename, int64_t size = 0);
 void resize(const std::string &filename, int64_t size);
 bool is_tempfile(const std::string &name, const char *suffix = NULL);
 std::string create_tempfile(int64_t size = 0, const char *suffix = NULL);
+std::string create_pipe_tempfile(int64_t expected_size, const char *suffix = NULL);
 void mkdir(const std::string &folder);
 void rmdir(const std::string &folder, bool recursive = false);
 
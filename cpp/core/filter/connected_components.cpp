@@ -16,10 +16,12 @@
 
 #include "filter/connected_components.h"
 
+#include <numeric>
+
 namespace MR::Filter {
 
 void Connector::Adjacency::initialise(const Header &header, const Voxel2Vector &v2v) {
-  data.clear();
+  clear();
   // Simplify handling of 4D images: don't need to keep checking
   //   size of axes against number of image dimensions
   if (header.ndim() < 3)
@@ -65,11 +67,12 @@ void Connector::Adjacency::initialise(const Header &header, const Voxel2Vector &
   // This may appear different to previous code, given the use of the Voxel2Vector class
   std::vector<index_t> pos(header.ndim());
   std::vector<int> neighbour(header.ndim());
-  data.reserve(v2v.size());
+  row_offsets.reserve(v2v.size() + 1);
+  neighbours.reserve(v2v.size() * offsets.size());
+  row_offsets.push_back(0);
   for (size_t i = 0; i != v2v.size(); ++i) {
     pos = v2v[i];
-    std::vector<index_t> indices;
-    for (auto o : offsets) {
+    for (const auto &o : offsets) {
       for (size_t axis = 0; axis != header.ndim(); ++axis)
         neighbour[axis] = pos[axis] + o[axis];
       // Is this a valid neighbour position, i.e. within the mask?
@@ -77,57 +80,84 @@ void Connector::Adjacency::initialise(const Header &header, const Voxel2Vector &
       //   index of this neighbouring element
       const index_t j = v2v(neighbour);
       if (j != v2v.invalid)
-        indices.push_back(j);
+        neighbours.push_back(j);
     }
-    data.push_back(indices);
+    row_offsets.push_back(neighbours.size());
   }
-  DEBUG("Adjacency data for " + str(data.size()) + " voxels initialised");
+  neighbours.shrink_to_fit();
+  DEBUG("Adjacency data for " + str(size()) + " voxels initialised: " + str(neighbours.size()) +
+        " neighbour entries, occupying " + str(bytes() / 1048576.0, 3) + " MB");
 }
 
-void Connector::run(std::vector<Cluster> &clusters, std::vector<uint32_t> &labels) const {
-  assert(adjacency.size());
-  labels.resize(adjacency.size(), 0);
-  uint32_t current_label = 0;
-  for (uint32_t i = 0; i < labels.size(); i++) {
-    // This node has not been already clustered
-    if (!labels[i]) {
-      Cluster cluster(++current_label);
-      depth_first_search(i, cluster, labels);
-      clusters.push_back(cluster);
-    }
+size_t Connector::Adjacency::bandwidth() const {
+  size_t result = 0;
+  for (index_t i = 0; i != size(); ++i) {
+    for (const auto n : (*this)[i])
+      result = std::max(result, size_t(n > i ? n - i : i - n));
   }
-  if (clusters.size() > std::numeric_limits<uint32_t>::max())
-    throw Exception("The number of clusters is larger than can be labelled with an unsigned 32bit integer.");
+  return result;
 }
 
-bool Connector::next_neighbour(uint32_t &node, std::vector<uint32_t> &labels) const {
-  for (auto n : adjacency[node]) {
-    if (!labels[n]) {
-      node = n;
-      return true;
+std::vector<Connector::Adjacency::index_t> Connector::Adjacency::reverse_cuthill_mckee() const {
+  auto degree = [&](const index_t i) { return row_offsets[i + 1] - row_offsets[i]; };
+  // Each connected component is traversed starting from its element of
+  //   lowest degree, as an approximation to a peripheral element
+  std::vector<index_t> seeds(size());
+  std::iota(seeds.begin(), seeds.end(), 0);
+  std::stable_sort(seeds.begin(), seeds.end(), [&](const index_t a, const index_t b) { return degree(a) < degree(b); });
+  std::vector<index_t> order;
+  order.reserve(size());
+  std::vector<bool> visited(size(), false);
+  std::vector<index_t> children;
+  for (const auto seed : seeds) {
+    if (visited[seed])
+      continue;
+    visited[seed] = true;
+    order.push_back(seed);
+    // Breadth-first traversal, appending the unvisited neighbours of
+    //   each element in order of increasing degree
+    for (size_t head = order.size() - 1; head != order.size(); ++head) {
+      children.clear();
+      for (const auto n : (*this)[order[head]]) {
+        if (!visited[n]) {
+          visited[n] = true;
+          children.push_back(n);
+        }
+      }
+      std::stable_sort(
+          children.begin(), children.end(), [&](const index_t a, const index_t b) { return degree(a) < degree(b); });
+      order.insert(order.end(), children.begin(), children.end());
     }
   }
-  return false;
+  std::reverse(order.begin(), order.end());
+  return order;
 }
 
-void Connector::depth_first_search(const uint32_t root, Cluster &cluster, std::vector<uint32_t> &labels) const {
-  uint32_t node = root;
-  std::stack<uint32_t> stack;
-  while (true) {
-    labels[node] = cluster.label;
-    stack.push(node);
-    cluster.size++;
-    if (next_neighbour(node, labels)) {
-      continue;
-    } else {
-      do {
-        if (stack.top() == root)
-          return;
-        stack.pop();
-        node = stack.top();
-      } while (!next_neighbour(node, labels));
-    }
+void Connector::Adjacency::reorder(const std::vector<index_t> &order) {
+  assert(order.size() == size());
+  std::vector<index_t> new_index(size());
+  for (index_t i = 0; i != size(); ++i)
+    new_index[order[i]] = i;
+  std::vector<size_t> new_offsets;
+  new_offsets.reserve(row_offsets.size());
+  std::vector<index_t> new_neighbours;
+  new_neighbours.reserve(neighbours.size());
+  new_offsets.push_back(0);
+  for (const auto i : order) {
+    for (const auto n : (*this)[i])
+      new_neighbours.push_back(new_index[n]);
+    std::sort(new_neighbours.begin() + new_offsets.back(), new_neighbours.end());
+    new_offsets.push_back(new_neighbours.size());
   }
+  std::swap(row_offsets, new_offsets);
+  std::swap(neighbours, new_neighbours);
+}
+
+void Connector::run(std::vector<Cluster> &clusters, std::vector<uint32_t> &labels) const {
+  assert(adjacency.size());
+  std::vector<Adjacency::index_t> queue(adjacency.size());
+  labels.resize(adjacency.size(), 0);
+  label(clusters, labels, queue.data(), [](const Adjacency::index_t) { return true; });
 }
 
 } // namespace MR::Filter
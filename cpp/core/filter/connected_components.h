@@ -24,7 +24,7 @@
 #include "misc/voxel2vector.h"
 
 #include <iostream>
-#include <stack>
+#include <limits>
 
 namespace MR::Filter {
 
@@ -34,6 +34,12 @@ class Connector {
   // A class that pre-computes and stores, for each voxel, a
   //   list of voxels (represented as indices) that are adjacent
   //
+  // The neighbours of all elements are stored contiguously in
+  //   compressed sparse row (CSR) format: those of element i occupy
+  //   the range [row_offsets[i], row_offsets[i+1]) of a single array, so that
+  //   traversal involves neither a heap allocation per element nor
+  //   any pointer chasing.
+  //
   // If we were to re-implement dixel-wise connectivity, it would
   //   be done using an alternative initialise() function for this
   //   class, to define the volumes on the fourth axis that
@@ -42,39 +48,75 @@ class Connector {
   public:
     typedef Voxel2Vector::index_t index_t;
 
+    // The indices of the elements adjacent to a particular element
+    class Neighbours {
+    public:
+      Neighbours(const index_t *first, const index_t *last) : first(first), last(last) {}
+      const index_t *begin() const { return first; }
+      const index_t *end() const { return last; }
+      size_t size() const { return last - first; }
+
+    private:
+      const index_t *first, *last;
+    };
+
     Adjacency() : use_26_neighbours(false), enabled_axes(3, true) {}
 
     void toggle_axis(const size_t axis, const bool value) {
       if (axis > enabled_axes.size())
         enabled_axes.resize(axis + 1, false);
       enabled_axes[axis] = value;
-      data.clear();
+      clear();
     }
 
     void set_axes(const std::vector<bool> &i) {
       enabled_axes = i;
-      data.clear();
+      clear();
     }
 
     void initialise(const Header &, const Voxel2Vector &);
 
-    const std::vector<index_t> &operator[](const size_t index) const {
+    Neighbours operator[](const size_t index) const {
       assert(size());
       assert(index < size());
-      return data[index];
+      return {neighbours.data() + row_offsets[index], neighbours.data() + row_offsets[index + 1]};
     }
 
     void set_26_adjacency(const bool i) {
       use_26_neighbours = i;
-      data.clear();
+      clear();
     }
 
-    size_t size() const { return data.size(); }
+    size_t size() const { return row_offsets.empty() ? 0 : row_offsets.size() - 1; }
+
+    // The memory occupied by the adjacency data, in bytes
+    size_t bytes() const { return row_offsets.size() * sizeof(size_t) + neighbours.size() * sizeof(index_t); }
+
+    // The largest difference in index between any two adjacent elements
+    size_t bandwidth() const;
+
+    // Compute a reverse Cuthill-McKee ordering of the elements:
+    //   a permutation that reduces the bandwidth of the adjacency, so that
+    //   adjacent elements are more likely to be close together in memory.
+    //   Entry i of the returned vector is the current index of the element
+    //   that is to be moved to index i.
+    std::vector<index_t> reverse_cuthill_mckee() const;
+
+    // Apply a permutation of the elements, as returned by reverse_cuthill_mckee()
+    //   (the same permutation must be applied to the Voxel2Vector mapping used
+    //   to construct the adjacency, and hence to any data vectorised using it)
+    void reorder(const std::vector<index_t> &order);
 
   private:
     bool use_26_neighbours;
     std::vector<bool> enabled_axes;
-    std::vector<std::vector<index_t>> data;
+    std::vector<size_t> row_offsets;
+    std::vector<index_t> neighbours;
+
+    void clear() {
+      row_offsets.clear();
+      neighbours.clear();
+    }
   } adjacency;
 
   class Cluster {
@@ -93,17 +135,22 @@ class Connector {
   void run(std::vector<Cluster> &, std::vector<uint32_t> &) const;
   template <class VectorType>
   void run(std::vector<Cluster> &, std::vector<uint32_t> &, const VectorType &, const float) const;
-
-private:
-  // Utility functions that perform the actual connected
-  //   components functionality
-  bool next_neighbour(uint32_t &, std::vector<uint32_t> &) const;
+  // As above, but making use of a caller-provided scratch buffer; if the
+  //   same vectors are re-used across calls, labelling proceeds without
+  //   any memory allocation once they have grown to the requisite size
   template <class VectorType>
-  bool next_neighbour(uint32_t &, std::vector<uint32_t> &, const VectorType &, const float) const;
+  void run(std::vector<Cluster> &,
+           std::vector<uint32_t> &,
+           std::vector<Adjacency::index_t> &,
+           const VectorType &,
+           const float) const;
 
-  void depth_first_search(const uint32_t, Cluster &, std::vector<uint32_t> &) const;
-  template <class VectorType>
-  void depth_first_search(const uint32_t, Cluster &, std::vector<uint32_t> &, const VectorType &, const float) const;
+private:
+  // The labelling kernel: a breadth-first search from each unlabelled
+  //   element for which active(index) is true, using queue as storage
+  //   for the elements of the current cluster
+  template <class Functor>
+  void label(std::vector<Cluster> &, std::vector<uint32_t> &, Adjacency::index_t *queue, Functor &&active) const;
 };
 
 template <class VectorType>
@@ -112,55 +159,50 @@ void Connector::run(std::vector<Cluster> &clusters,
                     const VectorType &data,
                     const float threshold) const {
   assert(adjacency.size());
+  std::vector<Adjacency::index_t> queue(adjacency.size());
   labels.resize(adjacency.size(), 0);
-  uint32_t current_label = 0;
-  for (uint32_t i = 0; i < labels.size(); i++) {
-    // This node has not been already clustered and is above threshold
-    if (!labels[i] && data[i] > threshold) {
-      Cluster cluster(++current_label);
-      depth_first_search(i, cluster, labels, data, threshold);
-      clusters.push_back(cluster);
-    }
-  }
-  if (clusters.size() > std::numeric_limits<uint32_t>::max())
-    throw Exception("The number of clusters is larger than can be labelled with an unsigned 32bit integer.");
+  label(clusters, labels, queue.data(), [&](const Adjacency::index_t i) { return data[i] > threshold; });
 }
 
 template <class VectorType>
-bool Connector::next_neighbour(uint32_t &node,
-                               std::vector<uint32_t> &labels,
-                               const VectorType &data,
-                               const float threshold) const {
-  for (auto n : adjacency[node]) {
-    if (!labels[n] && data[n] > threshold) {
-      node = n;
-      return true;
-    }
-  }
-  return false;
+void Connector::run(std::vector<Cluster> &clusters,
+                    std::vector<uint32_t> &labels,
+                    std::vector<Adjacency::index_t> &queue,
+                    const VectorType &data,
+                    const float threshold) const {
+  assert(adjacency.size());
+  clusters.clear();
+  labels.assign(adjacency.size(), 0);
+  queue.resize(adjacency.size());
+  label(clusters, labels, queue.data(), [&](const Adjacency::index_t i) { return data[i] > threshold; });
 }
 
-template <class VectorType>
-void Connector::depth_first_search(const uint32_t root,
-                                   Cluster &cluster,
-                                   std::vector<uint32_t> &labels,
-                                   const VectorType &data,
-                                   const float threshold) const {
-  uint32_t node = root;
-  std::stack<uint32_t> stack;
-  while (true) {
-    labels[node] = cluster.label;
-    stack.push(node);
-    cluster.size++;
-    if (next_neighbour(node, labels, data, threshold)) {
-      continue;
-    } else {
-      do {
-        if (stack.top() == root)
-          return;
-        stack.pop();
-        node = stack.top();
-      } while (!next_neighbour(node, labels, data, threshold));
+template <class Functor>
+void Connector::label(std::vector<Cluster> &clusters,
+                      std::vector<uint32_t> &labels,
+                      Adjacency::index_t *queue,
+                      Functor &&active) const {
+  uint32_t current_label = 0;
+  for (Adjacency::index_t i = 0; i < labels.size(); i++) {
+    // This node has not been already clustered and is above threshold
+    if (!labels[i] && active(i)) {
+      if (current_label == std::numeric_limits<uint32_t>::max())
+        throw Exception("The number of clusters is larger than can be labelled with an unsigned 32bit integer.");
+      Cluster cluster(++current_label);
+      // Each element is labelled as it is queued, so that it cannot be queued twice
+      labels[i] = cluster.label;
+      queue[0] = i;
+      size_t tail = 1;
+      for (size_t head = 0; head != tail; ++head) {
+        for (const auto n : adjacency[queue[head]]) {
+          if (!labels[n] && active(n)) {
+            labels[n] = cluster.label;
+            queue[tail++] = n;
+          }
+        }
+      }
+      cluster.size = tail;
+      clusters.push_back(cluster);
     }
   }
 }
@@ -20,6 +20,7 @@
 #include "file/utils.h"
 #include "formats/list.h"
 #include "header.h"
+#include "image_helpers.h"
 #include "image_io/pipe.h"
 #include "signal_handler.h"
 
@@ -56,7 +57,7 @@ bool Pipe::check(Header &H, size_t num_axes) const {
   if (isatty(STDOUT_FILENO))
     throw Exception("attempt to pipe image to standard output (this will leave temporary files behind)");
 
-  H.name() = File::create_tempfile(0, "mif");
+  H.name() = File::create_pipe_tempfile(footprint(H), "mif");
 
   SignalHandler::mark_file_for_deletion(H.name());
 
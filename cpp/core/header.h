@@ -324,6 +324,8 @@ class Header {
   void reset_intensity_scaling() { set_intensity_scaling(); }
 
   bool is_file_backed() const { return valid() ? io->is_file_backed() : false; }
+  //! the handler responsible for accessing the image data (null if not valid())
+  const ImageIO::Base *get_io() const { return io.get(); }
 
   //! make header self-consistent
   void sanitise() {
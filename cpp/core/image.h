@@ -97,6 +97,38 @@ template <typename ValueType> class Image : public ImageBase<Image<ValueType>, V
       buffer->set_value(data_offset, val);
   }
 
+  //! read \a count consecutive values along \a axis, starting from the current position
+  /*! This produces the same values as reading each voxel in turn, but
+   * where the values are contiguous on file, they are converted as a
+   * single run, avoiding the per-voxel function call overhead. The current
+   * position is left unchanged. */
+  void get_values(size_t axis, ValueType *data, ssize_t count) const {
+    const ssize_t step = stride(axis);
+    if (data_pointer) {
+      for (ssize_t n = 0; n < count; ++n)
+        data[n] = Raw::fetch_native<ValueType>(data_pointer, data_offset + n * step);
+    } else if (step == 1) {
+      buffer->get_values(data_offset, data, count);
+    } else {
+      for (ssize_t n = 0; n < count; ++n)
+        data[n] = buffer->get_value(data_offset + n * step);
+    }
+  }
+  //! write \a count consecutive values along \a axis, starting from the current position
+  /*! \sa get_values() */
+  void set_values(size_t axis, const ValueType *data, ssize_t count) {
+    const ssize_t step = stride(axis);
+    if (data_pointer) {
+      for (ssize_t n = 0; n < count; ++n)
+        Raw::store_native<ValueType>(data[n], data_pointer, data_offset + n * step);
+    } else if (step == 1) {
+      buffer->set_values(data_offset, data, count);
+    } else {
+      for (ssize_t n = 0; n < count; ++n)
+        buffer->set_value(data_offset + n * step, data[n]);
+    }
+  }
+
   //! use for debugging
   friend std::ostream &operator<<(std::ostream &stream, const Image &V) {
     stream << "\"" << V.name() << "\", datatype " << DataType::from<Image::value_type>().specifier() << ", index [ ";
@@ -224,7 +256,12 @@ template <typename ValueType> class Image<ValueType>::Buffer : public Header {
   Buffer(Buffer &&) = default;
   Buffer &operator=(const Buffer &) = delete;
   Buffer &operator=(Buffer &&) = default;
-  Buffer(const Buffer &b) : Header(b), fetch_func(b.fetch_func), store_func(b.store_func) {}
+  Buffer(const Buffer &b)
+      : Header(b),
+        fetch_func(b.fetch_func),
+        store_func(b.store_func),
+        fetch_span_func(b.fetch_span_func),
+        store_span_func(b.store_span_func) {}
 
   FORCE_INLINE ValueType get_value(size_t offset) const {
     ssize_t nseg = offset / io->segment_size();
@@ -236,18 +273,63 @@ template <typename ValueType> class Image<ValueType>::Buffer : public Header {
     store_func(val, io->segment(nseg), offset - nseg * io->segment_size(), intensity_offset(), intensity_scale());
   }
 
-  std::unique_ptr<uint8_t[]> data_buffer;
+  //! convert \a count values stored contiguously from \a offset onwards
+  void get_values(size_t offset, ValueType *data, size_t count) const {
+    const size_t segsize = io->segment_size();
+    while (count) {
+      const size_t nseg = offset / segsize;
+      const size_t start = offset - nseg * segsize;
+      const size_t n = std::min(count, segsize - start);
+      fetch_span_func(data, io->segment(nseg), start, n, intensity_offset(), intensity_scale());
+      offset += n;
+      data += n;
+      count -= n;
+    }
+  }
+
+  //! convert and store \a count values contiguously from \a offset onwards
+  void set_values(size_t offset, const ValueType *data, size_t count) const {
+    const size_t segsize = io->segment_size();
+    while (count) {
+      const size_t nseg = offset / segsize;
+      const size_t start = offset - nseg * segsize;
+      const size_t n = std::min(count, segsize - start);
+      store_span_func(data, io->segment(nseg), start, n, intensity_offset(), intensity_scale());
+      offset += n;
+      data += n;
+      count -= n;
+    }
+  }
+
+  ImageIO::MemoryBlock data_buffer;
   void *get_data_pointer();
 
   FORCE_INLINE ImageIO::Base *get_io() const { return io.get(); }
 
 protected:
-  std::function<ValueType(const void *, size_t, default_type, default_type)> fetch_func;
-  std::function<void(ValueType, void *, size_t, default_type, default_type)> store_func;
-
-  void set_fetch_store_functions() { __set_fetch_store_scale_functions(fetch_func, store_func, datatype()); }
+  FetchScaleFunction<ValueType> fetch_func = nullptr;
+  StoreScaleFunction<ValueType> store_func = nullptr;
+  FetchScaleSpanFunction<ValueType> fetch_span_func = nullptr;
+  StoreScaleSpanFunction<ValueType> store_span_func = nullptr;
+
+  void set_fetch_store_functions() {
+    __set_fetch_store_scale_functions(fetch_func, store_func, datatype());
+    __set_fetch_store_scale_span_functions(fetch_span_func, store_span_func, datatype());
+  }
 };
 
+//! read \a count consecutive values along \a axis, converting contiguous runs at once
+template <typename ValueType>
+FORCE_INLINE void get_values(Image<ValueType> &image, size_t axis, ValueType *data, ssize_t count) {
+  image.get_values(axis, data, count);
+}
+
+//! write \a count consecutive values along \a axis, converting contiguous runs at once
+template <typename ValueType>
+FORCE_INLINE void set_values(Image<ValueType> &image, size_t axis, const ValueType *data, ssize_t count) {
+  image.set_values(axis, data, count);
+}
+
 //! \cond skip
 
 namespace {
@@ -378,11 +460,11 @@ template <typename ValueType> Image<ValueType> Image<ValueType>::with_direct_io(
 
   // the buffer into which to copy the data:
   const auto buffer_size = footprint<ValueType>(voxel_count(*this));
-  buffer->data_buffer = std::unique_ptr<uint8_t[]>(new uint8_t[buffer_size]);
+  buffer->data_buffer = ImageIO::allocate(buffer_size);
 
   if (buffer->get_io()->is_image_new()) {
     // no need to preload if data is zero anyway:
-    memset(buffer->data_buffer.get(), 0, buffer_size);
+    ImageIO::fill_zero(buffer->data_buffer.get(), buffer_size);
   } else {
     auto src(*this);
     TmpImage<ValueType> dest = {*buffer,
@@ -437,6 +437,73 @@ template <class HeaderType> inline void squeeze_dim(HeaderType &in, size_t from_
   in.ndim() = n;
 }
 
+//! read \a count consecutive values along \a axis, starting from the current position of \a image
+/*! The position of \a image is left unchanged. This generic version simply
+ * reads each value in turn; overloads are provided for those image types
+ * that can convert whole runs of values at once (see Image::get_values()). */
+template <class ImageType>
+inline void get_values(ImageType &image, size_t axis, typename ImageType::value_type *data, ssize_t count) {
+  const ssize_t pos = image.index(axis);
+  for (ssize_t n = 0; n < count; ++n, ++image.index(axis))
+    data[n] = image.value();
+  image.index(axis) = pos;
+}
+
+//! write \a count consecutive values along \a axis, starting from the current position of \a image
+/*! \sa get_values() */
+template <class ImageType>
+inline void set_values(ImageType &image, size_t axis, const typename ImageType::value_type *data, ssize_t count) {
+  const ssize_t pos = image.index(axis);
+  for (ssize_t n = 0; n < count; ++n, ++image.index(axis))
+    image.value() = data[n];
+  image.index(axis) = pos;
+}
+
+namespace Helper {
+//! scratch storage for a row of values, reused across calls
+/*! This is used in preference to std::vector since it also needs to
+ * support bool, and to allow copies (e.g. when a functor is duplicated
+ * across threads) to each allocate their own storage. */
+template <typename ValueType> class RowBuffer {
+public:
+  RowBuffer() : capacity(0) {}
+  RowBuffer(const RowBuffer &) : capacity(0) {}
+  RowBuffer &operator=(const RowBuffer &) { return *this; }
+
+  ValueType *data(size_t size) {
+    if (size > capacity) {
+      buffer.reset(new ValueType[size]);
+      capacity = size;
+    }
+    return buffer.get();
+  }
+
+private:
+  std::unique_ptr<ValueType[]> buffer;
+  size_t capacity;
+};
+} // namespace Helper
+
+//! copy the row of values along \a axis from the current position of \a in to that of \a out
+template <class InputImageType, class OutputImageType>
+inline void copy_row(InputImageType &in,
+                     OutputImageType &out,
+                     size_t axis,
+                     Helper::RowBuffer<typename InputImageType::value_type> &in_row,
+                     Helper::RowBuffer<typename OutputImageType::value_type> &out_row) {
+  const ssize_t size = in.size(axis);
+  auto *in_data = in_row.data(size);
+  get_values(in, axis, in_data, size);
+  if constexpr (std::is_same<typename InputImageType::value_type, typename OutputImageType::value_type>::value) {
+    set_values(out, axis, in_data, size);
+  } else {
+    auto *out_data = out_row.data(size);
+    for (ssize_t n = 0; n < size; ++n)
+      out_data[n] = in_data[n];
+    set_values(out, axis, out_data, size);
+  }
+}
+
 namespace Helper {
 
 template <class ImageType> class Index {
@@ -526,6 +593,16 @@ template <class ImageType> class ConstRow {
     image.index(axis) = n;
     return image.value();
   }
+  //! copy all values along the row into \a data
+  template <typename ValueType> void read(ValueType *data) const {
+    image.index(axis) = 0;
+    if constexpr (std::is_same<ValueType, typename ImageType::value_type>::value) {
+      get_values(image, axis, data, size());
+    } else {
+      for (; image.index(axis) < size(); ++image.index(axis))
+        data[image.index(axis)] = image.value();
+    }
+  }
   const size_t axis;
 
 protected:
@@ -0,0 +1,164 @@
+/* Copyright (c) 2008-2024 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#ifndef MRTRIX_WINDOWS
+#include <sys/mman.h>
+#endif
+
+#include "file/config.h"
+#include "image_io/allocate.h"
+#include "mrtrix.h"
+#include "thread.h"
+
+namespace MR::ImageIO {
+
+namespace {
+
+constexpr size_t page_size = 4096;
+constexpr size_t huge_page_size = 2U << 20;
+
+// smaller blocks are allocated using regular pages:
+constexpr size_t min_huge_page_allocation = 4 * huge_page_size;
+// smaller blocks are initialised by the calling thread:
+constexpr size_t min_parallel_size = 16U << 20;
+
+inline size_t round_up(size_t size, size_t multiple) { return multiple * ((size + multiple - 1) / multiple); }
+
+enum class HugePages { None, Transparent, Explicit };
+
+HugePages huge_pages() {
+  // CONF option: ImageHugePages
+  // CONF default: transparent
+  // CONF The type of memory pages used to hold large images in RAM (e.g.
+  // CONF scratch images, compressed images, or images preloaded for direct
+  // CONF access). Valid values are: none (regular pages), transparent
+  // CONF (request transparent huge pages from the kernel), or explicit (use
+  // CONF the huge pages reserved by the system administrator, falling back
+  // CONF to transparent huge pages if none are available). Huge pages are
+  // CONF currently only supported on Linux.
+  static const HugePages type = []() {
+    const std::string spec = lowercase(File::Config::get("ImageHugePages", "transparent"));
+    if (spec == "none")
+      return HugePages::None;
+    if (spec == "transparent")
+      return HugePages::Transparent;
+    if (spec == "explicit")
+      return HugePages::Explicit;
+    WARN("invalid specifier \"" + spec + "\" for config file entry \"ImageHugePages\"");
+    return HugePages::Transparent;
+  }();
+  return type;
+}
+
+bool parallel_first_touch() {
+  // CONF option: ImageParallelFirstTouch
+  // CONF default: 1 (true)
+  // CONF A boolean value to indicate whether large images held in RAM
+  // CONF should be initialised using multiple threads, each writing to a
+  // CONF contiguous portion of the image. On systems with multiple memory
+  // CONF nodes (NUMA), this spreads the image across all nodes, rather than
+  // CONF placing it on the node of the main thread.
+  static const bool parallel = File::Config::get_bool("ImageParallelFirstTouch", true);
+  return parallel;
+}
+
+// invoke func (from, to) over contiguous, page-aligned slices of [0, size):
+template <class Functor> void for_each_slice(size_t size, Functor &&func) {
+  const size_t nthreads = parallel_first_touch() && size >= min_parallel_size ? Thread::threads_to_execute() : 0;
+  if (nthreads < 2) {
+    func(size_t(0), size);
+    return;
+  }
+
+  struct Slice {
+    typename std::remove_reference<Functor>::type &func;
+    std::atomic<size_t> &next;
+    const size_t size, slice;
+    void execute() {
+      const size_t from = std::min(next++ * slice, size);
+      func(from, std::min(from + slice, size));
+    }
+  };
+  std::atomic<size_t> next(0);
+  Slice slice = {func, next, size, round_up((size + nthreads - 1) / nthreads, page_size)};
+  Thread::run(Thread::multi(slice, nthreads), "first touch threads").wait();
+}
+
+} // namespace
+
+void Deallocator::operator()(uint8_t *address) const {
+  switch (type) {
+  case Type::Array:
+    delete[] address;
+    break;
+  case Type::Aligned:
+    free(address);
+    break;
+  case Type::Mapped:
+#ifndef MRTRIX_WINDOWS
+    munmap(address, size);
+#endif
+    break;
+  case Type::None:
+    break;
+  }
+}
+
+MemoryBlock allocate(size_t size) {
+  [[maybe_unused]] const HugePages type = size >= min_huge_page_allocation ? huge_pages() : HugePages::None;
+
+#ifdef MAP_HUGETLB
+  if (type == HugePages::Explicit) {
+    const size_t mapped_size = round_up(size, huge_page_size);
+    void *address =
+        mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (address != MAP_FAILED)
+      return MemoryBlock(reinterpret_cast<uint8_t *>(address), Deallocator(Deallocator::Type::Mapped, mapped_size));
+    DEBUG("unable to allocate " + str(mapped_size) + " bytes of explicit huge pages (" + strerror(errno) +
+          ") - falling back to transparent huge pages");
+  }
+#endif
+
+#ifdef MADV_HUGEPAGE
+  if (type != HugePages::None) {
+    void *address = nullptr;
+    if (posix_memalign(&address, huge_page_size, size))
+      throw std::bad_alloc();
+    if (madvise(address, size - size % huge_page_size, MADV_HUGEPAGE))
+      DEBUG("request for transparent huge pages failed: " + std::string(strerror(errno)));
+    return MemoryBlock(reinterpret_cast<uint8_t *>(address), Deallocator(Deallocator::Type::Aligned, size));
+  }
+#endif
+
+  return MemoryBlock(new uint8_t[size]);
+}
+
+void fill_zero(uint8_t *address, size_t size) {
+  for_each_slice(size, [address](size_t from, size_t to) { memset(address + from, 0, to - from); });
+}
+
+void copy(uint8_t *destination, const uint8_t *source, size_t size) {
+  for_each_slice(size, [destination, source](size_t from, size_t to) {
+    memcpy(destination + from, source + from, to - from);
+  });
+}
+
+} // namespace MR::ImageIO
@@ -0,0 +1,74 @@
+/* Copyright (c) 2008-2024 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace MR::ImageIO {
+
+//! the deleter used for blocks of memory holding image data
+/*! A default-constructed Deallocator releases memory obtained via `new
+ * uint8_t[]`, so that the behaviour of a MemoryBlock is then identical to
+ * that of a `std::unique_ptr<uint8_t[]>`. Blocks obtained from allocate()
+ * carry the information needed to release them appropriately. */
+class Deallocator {
+public:
+  enum class Type : uint8_t { Array, Aligned, Mapped, None };
+
+  Deallocator() = default;
+  Deallocator(Type type, size_t size) : type(type), size(size) {}
+
+  void operator()(uint8_t *address) const;
+
+  Type type = Type::Array;
+  size_t size = 0;
+};
+
+using MemoryBlock = std::unique_ptr<uint8_t[], Deallocator>;
+
+//! allocate \a size bytes of uninitialised memory to hold image data
+/*! Depending on the ImageHugePages config file option, large blocks will be
+ * backed by transparent huge pages (the default), by explicitly reserved
+ * huge pages, or by regular pages. Using huge pages reduces the number of
+ * TLB misses incurred when accessing large images in a non-sequential
+ * order (e.g. along the slowest-varying axis).
+ *
+ * The memory is not touched at this stage: use fill_zero() or copy() to
+ * initialise it, so that its pages are faulted in by the threads that will
+ * subsequently process it. */
+MemoryBlock allocate(size_t size);
+
+//! a non-owning MemoryBlock, e.g. for segments within a larger block
+inline MemoryBlock borrow(uint8_t *address) { return MemoryBlock(address, Deallocator(Deallocator::Type::None, 0)); }
+
+//! set \a size bytes from \a address to zero
+/*! For large blocks, the work is distributed over multiple threads, each
+ * handling a contiguous slice of the block. On systems with multiple memory
+ * nodes (NUMA), pages are placed on the node of the thread that first
+ * touches them, so that the image ends up spread across all nodes rather
+ * than concentrated on that of the main thread (see the
+ * ImageParallelFirstTouch config file option). */
+void fill_zero(uint8_t *address, size_t size);
+
+//! copy \a size bytes from \a source to \a destination
+/*! As with fill_zero(), large copies are distributed over multiple
+ * threads. */
+void copy(uint8_t *destination, const uint8_t *source, size_t size);
+
+} // namespace MR::ImageIO
@@ -40,6 +40,20 @@ void Base::close(const Header &header) {
   unload(header);
   DEBUG("image \"" + header.name() + "\" unloaded");
   addresses.clear();
+  deferred.reset();
+}
+
+uint8_t *Base::deferred_segment(size_t n) const {
+  DeferredSegment &entry = deferred[n];
+  if (!entry.loaded.load(std::memory_order_acquire)) {
+    std::call_once(entry.once, [&] { entry.data = load_segment(n); });
+    entry.loaded.store(true, std::memory_order_release);
+  }
+  return entry.data.get();
+}
+
+std::unique_ptr<uint8_t[]> Base::load_segment(size_t) const {
+  throw Exception("deferred loading not supported for this image type");
 }
 
 } // namespace MR::ImageIO
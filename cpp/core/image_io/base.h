@@ -16,11 +16,14 @@
 
 #pragma once
 
+#include <atomic>
 #include <cassert>
 #include <cstdint>
+#include <mutex>
 #include <unistd.h>
 
 #include "file/entry.h"
+#include "image_io/allocate.h"
 #include "memory.h"
 #include "mrtrix.h"
 #include "types.h"
@@ -67,6 +70,8 @@ class Base {
 
   uint8_t *segment(size_t n) const {
     assert(n < addresses.size());
+    if (deferred)
+      return deferred_segment(n);
     return addresses[n].get();
   }
   size_t nsegments() const { return addresses.size(); }
@@ -92,12 +97,28 @@ class Base {
 
 protected:
   size_t segsize;
-  std::vector<std::unique_ptr<uint8_t[]>> addresses;
+  std::vector<MemoryBlock> addresses;
   bool is_new, writable;
 
+  // handlers can defer loading of the data until each segment is first
+  // accessed, by resizing addresses to the number of segments (leaving them
+  // unallocated) and invoking defer_loading() from within load(). Each
+  // segment is then obtained from load_segment() in a thread-safe manner.
+  class DeferredSegment {
+  public:
+    std::atomic<bool> loaded{false};
+    std::once_flag once;
+    std::unique_ptr<uint8_t[]> data;
+  };
+  std::unique_ptr<DeferredSegment[]> deferred;
+
   void check() const { assert(addresses.size()); }
+  void defer_loading() { deferred.reset(new DeferredSegment[addresses.size()]); }
+  uint8_t *deferred_segment(size_t n) const;
+
   virtual void load(const Header &header, size_t buffer_size) = 0;
   virtual void unload(const Header &header) = 0;
+  virtual std::unique_ptr<uint8_t[]> load_segment(size_t n) const;
 };
 
 } // namespace ImageIO
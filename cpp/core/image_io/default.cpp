@@ -17,12 +17,64 @@
 #include <limits>
 
 #include "app.h"
+#include "file/config.h"
 #include "file/ofstream.h"
 #include "header.h"
 #include "image_io/default.h"
+#include "stride.h"
 
 namespace MR::ImageIO {
 
+namespace {
+
+// the number of bytes per volume if the volumes are stored contiguously, zero otherwise:
+int64_t bytes_per_volume(const Header &header) {
+  if (header.ndim() <= 3 || header.datatype().bits() < 8)
+    return 0;
+  const auto strides = Stride::get(header);
+  ssize_t max_spatial = 0, min_other = std::numeric_limits<ssize_t>::max();
+  int64_t voxels = 1;
+  for (size_t axis = 0; axis < header.ndim(); ++axis) {
+    if (axis < 3) {
+      max_spatial = std::max(max_spatial, std::abs(strides[axis]));
+      voxels *= header.size(axis);
+    } else if (header.size(axis) > 1) {
+      min_other = std::min(min_other, std::abs(strides[axis]));
+    }
+  }
+  return min_other > max_spatial ? voxels * header.datatype().bytes() : 0;
+}
+
+void set_access(File::MMap &mmap, const Header &header) {
+  // CONF option: ImageAccessProfile
+  // CONF default: normal
+  // CONF The pattern of access to memory-mapped images to advise the system
+  // CONF of, which determines how data are read ahead from storage. Valid
+  // CONF values are: normal (use the system defaults), sequential (read
+  // CONF ahead aggressively), volume (read ahead the same portion of each
+  // CONF volume, suitable for processing 4D images voxel-wise when they are
+  // CONF stored with the volumes contiguous, as is usual for NIfTI images),
+  // CONF random (disable read-ahead), or auto (volume for images stored
+  // CONF with volumes contiguous, sequential otherwise). See also
+  // CONF MMapPrefetch.
+  static const std::string profile = lowercase(File::Config::get("ImageAccessProfile", "normal"));
+  const int64_t block_size = bytes_per_volume(header);
+  if (profile == "normal")
+    mmap.set_access(File::MMap::Access::Normal);
+  else if (profile == "auto")
+    mmap.set_access(block_size ? File::MMap::Access::Volume : File::MMap::Access::Sequential, block_size);
+  else if (profile == "sequential")
+    mmap.set_access(File::MMap::Access::Sequential);
+  else if (profile == "volume")
+    mmap.set_access(File::MMap::Access::Volume, block_size);
+  else if (profile == "random")
+    mmap.set_access(File::MMap::Access::Random);
+  else
+    WARN("invalid specifier \"" + profile + "\" for config file entry \"ImageAccessProfile\"");
+}
+
+} // namespace
+
 void Default::load(const Header &header, size_t) {
   if (files.empty())
     throw Exception("no files specified in header for image \"" + header.name() + "\"");
@@ -70,6 +122,8 @@ void Default::map_files(const Header &header) {
   addresses.resize(mmaps.size());
   for (size_t n = 0; n < files.size(); n++) {
     mmaps[n].reset(new File::MMap(files[n], writable, !is_new, bytes_per_segment));
+    if (!is_new)
+      set_access(*mmaps[n], header);
     addresses[n].reset(mmaps[n]->address());
   }
 }
@@ -78,22 +132,22 @@ void Default::copy_to_mem(const Header &header) {
   DEBUG("loading image \"" + header.name() + "\"...");
   addresses.resize(
       files.size() > 1 && header.datatype().bits() * segsize != 8 * size_t(bytes_per_segment) ? files.size() : 1);
-  addresses[0].reset(new uint8_t[files.size() * bytes_per_segment]);
+  addresses[0] = allocate(files.size() * bytes_per_segment);
   if (!addresses[0])
     throw Exception("failed to allocate memory for image \"" + header.name() + "\"");
 
   if (is_new)
-    memset(addresses[0].get(), 0, files.size() * bytes_per_segment);
+    fill_zero(addresses[0].get(), files.size() * bytes_per_segment);
   else {
     for (size_t n = 0; n < files.size(); n++) {
       File::MMap file(files[n], false, false, bytes_per_segment);
-      memcpy(addresses[0].get() + n * bytes_per_segment, file.address(), bytes_per_segment);
+      copy(addresses[0].get() + n * bytes_per_segment, file.address(), bytes_per_segment);
     }
   }
 
   if (addresses.size() > 1)
     for (size_t n = 1; n < addresses.size(); n++)
-      addresses[n].reset(addresses[0].get() + n * bytes_per_segment);
+      addresses[n] = borrow(addresses[0].get() + n * bytes_per_segment);
   else
     segsize = std::numeric_limits<size_t>::max();
 }
@@ -17,12 +17,16 @@
 #include <limits>
 
 #include "app.h"
+#include "file/bgzf.h"
+#include "file/config.h"
 #include "file/gz.h"
 #include "header.h"
 #include "image_io/gz.h"
 #include "progressbar.h"
+#include "stride.h"
 
 #define BYTES_PER_ZCALL 524288
+#define BYTES_PER_DEFERRED_SEGMENT 4194304
 
 namespace MR::ImageIO {
 
@@ -36,20 +40,66 @@ void GZ::load(const Header &header, size_t) {
     throw Exception("image \"" + header.name() + "\" is larger than maximum accessible memory");
 
   DEBUG("loading image \"" + header.name() + "\"...");
+
+  // files written as independently compressed blocks can be uncompressed
+  // in parallel; anything else goes through zlib's serial gzip interface:
+  std::vector<std::unique_ptr<File::BGZF::Reader>> blocked(files.size());
+  if (!is_new) {
+    for (size_t n = 0; n < files.size(); n++) {
+      if (File::BGZF::is_bgzf(files[n].name)) {
+        try {
+          blocked[n].reset(new File::BGZF::Reader(files[n].name));
+        } catch (Exception &E) {
+          DEBUG("unable to use parallel decompression for file \"" + files[n].name + "\": " + E[0]);
+        }
+      }
+    }
+  }
+
+  // for read-only access to a single block-compressed file, only
+  // uncompress each chunk of the data when it is first accessed:
+  if (!writable && files.size() == 1 && blocked[0] && header.datatype().bits() >= 8) {
+    const int64_t bytes_per_voxel = header.datatype().bytes();
+    int64_t voxels = 1;
+    for (const auto axis : Stride::order(header)) {
+      if (voxels > 1 && voxels * header.size(axis) * bytes_per_voxel > BYTES_PER_DEFERRED_SEGMENT)
+        break;
+      voxels *= header.size(axis);
+    }
+    const size_t num_segments = (segsize + voxels - 1) / voxels;
+    if (num_segments > 1) {
+      reader = std::move(blocked[0]);
+      segsize = voxels;
+      bytes_per_deferred_segment = voxels * bytes_per_voxel;
+      addresses.resize(num_segments);
+      defer_loading();
+      DEBUG("image \"" + header.name() + "\" will be uncompressed on demand in " + str(num_segments) + " segments");
+      return;
+    }
+  }
+
   addresses.resize(header.datatype().bits() == 1 && files.size() > 1 ? files.size() : 1);
-  addresses[0].reset(new uint8_t[files.size() * bytes_per_segment]);
+  addresses[0] = allocate(files.size() * bytes_per_segment);
   if (!addresses[0])
     throw Exception("failed to allocate memory for image \"" + header.name() + "\"");
 
   if (is_new)
-    memset(addresses[0].get(), 0, files.size() * bytes_per_segment);
+    fill_zero(addresses[0].get(), files.size() * bytes_per_segment);
   else {
-    ProgressBar progress("uncompressing image \"" + header.name() + "\"",
-                         files.size() * bytes_per_segment / BYTES_PER_ZCALL);
+    size_t progress_target = 0;
+    for (size_t n = 0; n < files.size(); n++)
+      progress_target += blocked[n] ? blocked[n]->num_blocks(files[n].start, bytes_per_segment)
+                                    : bytes_per_segment / BYTES_PER_ZCALL;
+
+    ProgressBar progress("uncompressing image \"" + header.name() + "\"", progress_target);
     for (size_t n = 0; n < files.size(); n++) {
+      uint8_t *address = addresses[0].get() + n * bytes_per_segment;
+      if (blocked[n]) {
+        blocked[n]->read(address, files[n].start, bytes_per_segment, &progress);
+        continue;
+      }
       File::GZ zf(files[n].name, "rb");
       zf.seek(files[n].start);
-      uint8_t *address = addresses[0].get() + n * bytes_per_segment;
       uint8_t *last = address + bytes_per_segment - BYTES_PER_ZCALL;
       while (address < last) {
         zf.read(reinterpret_cast<char *>(address), BYTES_PER_ZCALL);
@@ -62,26 +112,65 @@ void GZ::load(const Header &header, size_t) {
   }
 
   if (addresses.size() > 1)
-    // TODO this looks like it needs to be handled explicitly in unload()...
     for (size_t n = 1; n < addresses.size(); n++)
-      addresses[n].reset(addresses[0].get() + n * bytes_per_segment);
+      addresses[n] = borrow(addresses[0].get() + n * bytes_per_segment);
   else
     segsize = std::numeric_limits<size_t>::max();
 }
 
+std::unique_ptr<uint8_t[]> GZ::load_segment(size_t n) const {
+  assert(reader);
+  const int64_t offset = n * bytes_per_deferred_segment;
+  const int64_t size = std::min(bytes_per_deferred_segment, bytes_per_segment - offset);
+  std::unique_ptr<uint8_t[]> data(new uint8_t[size]);
+  // this may be invoked concurrently from multiple processing threads,
+  //   so inflate the blocks serially within the calling thread:
+  reader->read_serial(data.get(), files[0].start + offset, size);
+  return data;
+}
+
 void GZ::unload(const Header &header) {
-  if (!addresses.empty()) {
+  reader.reset();
+  // deferred images are read-only, with their data held in Base::deferred:
+  if (!addresses.empty() && !deferred) {
     assert(addresses[0]);
 
     if (writable) {
+      // CONF option: ImageCompressionBGZF
+      // CONF default: 1 (true)
+      // CONF A boolean value to indicate whether compressed images (e.g.
+      // CONF .nii.gz, .mif.gz, .mgz) should be written as a series of
+      // CONF independently compressed blocks (BGZF format). The output
+      // CONF remains a valid gzip file, but can be compressed and
+      // CONF uncompressed using multiple threads. Set to false to revert to
+      // CONF a single conventional gzip stream.
+      const bool use_bgzf = File::Config::get_bool("ImageCompressionBGZF", true);
+      // CONF option: ImageCompressionIndex
+      // CONF default: 0 (false)
+      // CONF A boolean value to indicate whether an index file (with the
+      // CONF same name as the image, with a .gzi suffix appended) should be
+      // CONF written alongside compressed images stored in BGZF format (see
+      // CONF ImageCompressionBGZF). This allows the location of the
+      // CONF compressed blocks to be determined without scanning through the
+      // CONF entire file, which speeds up access to subsets of large images.
+      const bool write_index = use_bgzf && File::Config::get_bool("ImageCompressionIndex", false);
+      const size_t blocks_per_file = File::BGZF::Writer::num_blocks(bytes_per_segment);
       ProgressBar progress("compressing image \"" + header.name() + "\"",
-                           files.size() * bytes_per_segment / BYTES_PER_ZCALL);
+                           files.size() * (use_bgzf ? blocks_per_file : bytes_per_segment / BYTES_PER_ZCALL));
       for (size_t n = 0; n < files.size(); n++) {
         assert(files[n].start == int64_t(lead_in_size));
+        uint8_t *address = addresses[0].get() + n * bytes_per_segment;
+        if (use_bgzf) {
+          File::BGZF::Writer zf(files[n].name, Z_DEFAULT_COMPRESSION, write_index);
+          zf.write(lead_in.get(), lead_in_size);
+          zf.write(address, bytes_per_segment, &progress);
+          zf.write(lead_out.get(), lead_out_size);
+          zf.close();
+          continue;
+        }
         File::GZ zf(files[n].name, "wb");
         if (lead_in)
           zf.write(reinterpret_cast<const char *>(lead_in.get()), lead_in_size);
-        uint8_t *address = addresses[0].get() + n * bytes_per_segment;
         uint8_t *last = address + bytes_per_segment - BYTES_PER_ZCALL;
         while (address < last) {
           zf.write(reinterpret_cast<const char *>(address), BYTES_PER_ZCALL);
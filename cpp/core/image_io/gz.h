@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include "file/bgzf.h"
 #include "file/mmap.h"
 #include "image_io/base.h"
 
@@ -36,12 +37,14 @@ class GZ : public Base {
   uint8_t *tailer() { return lead_out.get(); }
 
 protected:
-  int64_t bytes_per_segment;
+  int64_t bytes_per_segment, bytes_per_deferred_segment;
   size_t lead_in_size, lead_out_size;
   std::unique_ptr<uint8_t[]> lead_in, lead_out;
+  std::unique_ptr<File::BGZF::Reader> reader;
 
   virtual void load(const Header &, size_t);
   virtual void unload(const Header &);
+  virtual std::unique_ptr<uint8_t[]> load_segment(size_t n) const;
 };
 
 } // namespace MR::ImageIO
@@ -0,0 +1,191 @@
+/* Copyright (c) 2008-2024 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <typeinfo>
+
+#include "file/bgzf.h"
+#include "file/gz.h"
+#include "image_io/default.h"
+#include "image_io/gz.h"
+#include "image_io/pipe.h"
+#include "image_io/slab_reader.h"
+#include "stride.h"
+
+namespace MR::ImageIO {
+
+namespace {
+// the maximum number of bytes requested in each call to gzread():
+constexpr size_t max_bytes_per_zcall = 1U << 28;
+} // namespace
+
+SlabReaderBase::SlabReaderBase(Header &&header, size_t axis)
+    : H(std::move(header)), axis(axis), raw(false), voxels_per_file(0), compressed(false), current_file(0) {
+  const ImageIO::Base *io = H.get_io();
+  if (!io)
+    throw Exception("FIXME: SlabReader requires a valid Header, as obtained from Header::open()");
+  if (io->files.empty())
+    return;
+  compressed = typeid(*io) == typeid(ImageIO::GZ);
+  raw = compressed || typeid(*io) == typeid(ImageIO::Default) || typeid(*io) == typeid(ImageIO::Pipe);
+  if (!raw) {
+    DEBUG("image \"" + H.name() + "\" cannot be read in slabs - loading in its entirety");
+    return;
+  }
+  for (const auto &entry : io->files)
+    files.push_back(entry);
+  voxels_per_file = voxel_count(H) / files.size();
+  current_file = files.size();
+}
+
+SlabReaderBase::~SlabReaderBase() {}
+
+Header SlabReaderBase::slab_header(size_t from, size_t to) const {
+  Header slab(H);
+  slab.reset_intensity_scaling();
+  if (axis < slab.ndim()) {
+    slab.size(axis) = to - from;
+    if (axis < 3)
+      slab.transform().translation() += slab.transform().linear().col(axis) * (from * slab.spacing(axis));
+  }
+  return slab;
+}
+
+std::vector<SlabReaderBase::Block> SlabReaderBase::blocks(size_t from, size_t to) const {
+  auto strides = Stride::get_actual(H);
+  int64_t start = Stride::offset(strides, H);
+  int64_t count = 1;
+  ssize_t slice_stride = 1;
+  if (axis < H.ndim()) {
+    slice_stride = strides[axis];
+    start += slice_stride < 0 ? slice_stride * ssize_t(to - 1) : slice_stride * ssize_t(from);
+    slice_stride = std::abs(slice_stride);
+    count = slice_stride * (to - from);
+  }
+
+  // all axes with a larger stride than the slab axis contribute one block
+  // per position; those with a smaller stride are covered by each block:
+  std::vector<size_t> outer;
+  for (size_t n = 0; n < H.ndim(); ++n) {
+    if (n == axis || H.size(n) == 1)
+      continue;
+    if (std::abs(strides[n]) > slice_stride || axis >= H.ndim())
+      outer.push_back(n);
+    else if (strides[n] < 0)
+      start += strides[n] * (H.size(n) - 1);
+  }
+  if (axis >= H.ndim()) {
+    outer.clear();
+    count = voxel_count(H);
+    start = 0;
+  }
+
+  std::vector<Block> result;
+  std::vector<ssize_t> index(outer.size(), 0);
+  while (true) {
+    int64_t offset = start;
+    for (size_t n = 0; n < outer.size(); ++n)
+      offset += strides[outer[n]] * index[n];
+    result.push_back({offset, count});
+    size_t n = 0;
+    for (; n < outer.size(); ++n) {
+      if (++index[n] < H.size(outer[n]))
+        break;
+      index[n] = 0;
+    }
+    if (n == outer.size())
+      break;
+  }
+  std::sort(result.begin(), result.end(), [](const Block &a, const Block &b) { return a.offset < b.offset; });
+
+  // blocks must not straddle files:
+  std::vector<Block> split;
+  for (auto block : result) {
+    while (block.count) {
+      const int64_t n = std::min(block.count, voxels_per_file - block.offset % voxels_per_file);
+      split.push_back({block.offset, n});
+      block.offset += n;
+      block.count -= n;
+    }
+  }
+  return split;
+}
+
+void SlabReaderBase::open(size_t file) {
+  if (file == current_file)
+    return;
+  in.reset();
+  gz.reset();
+  bgzf.reset();
+  current_file = file;
+  const std::string &name = files[file].name;
+  if (compressed) {
+    if (File::BGZF::is_bgzf(name)) {
+      try {
+        bgzf.reset(new File::BGZF::Reader(name));
+        return;
+      } catch (Exception &E) {
+        DEBUG("unable to use random access decompression for file \"" + name + "\": " + E[0]);
+      }
+    }
+    gz.reset(new File::GZ(name, "rb"));
+  } else {
+    in.reset(new std::ifstream(name, std::ios::in | std::ios::binary));
+    if (!*in)
+      throw Exception("failed to open file \"" + name + "\": " + strerror(errno));
+  }
+}
+
+size_t SlabReaderBase::read(const Block &block) {
+  const size_t file = block.offset / voxels_per_file;
+  const int64_t voxel = block.offset - file * voxels_per_file;
+  const size_t bits = H.datatype().bits();
+  const int64_t offset = files[file].start + (voxel * bits) / 8;
+  const size_t first = (voxel * bits) % 8 / std::max<size_t>(bits, 1);
+  const size_t size = (first * bits + block.count * bits + 7) / 8;
+  buffer.resize(size);
+
+  open(file);
+  if (bgzf) {
+    bgzf->read(buffer.data(), offset, size);
+  } else if (gz) {
+    gz->seek(offset);
+    for (size_t n = 0; n < size; n += max_bytes_per_zcall) {
+      const size_t nbytes = std::min(size - n, max_bytes_per_zcall);
+      if (gz->read(reinterpret_cast<char *>(buffer.data() + n), nbytes) != int(nbytes))
+        throw Exception("unexpected end of file while reading \"" + files[file].name + "\"");
+    }
+  } else {
+    in->seekg(offset, in->beg);
+    in->read(reinterpret_cast<char *>(buffer.data()), size);
+    if (!in->good())
+      throw Exception("error reading from file \"" + files[file].name + "\": " + strerror(errno));
+  }
+  return first;
+}
+
+size_t slab_thickness(size_t max_bytes, size_t bytes_per_slice, size_t num_slices, size_t slabs_in_flight) {
+  const size_t bytes_per_slab = std::max<size_t>(bytes_per_slice, 1) * slabs_in_flight;
+  const size_t thickness = std::clamp<size_t>(max_bytes / bytes_per_slab, 1, std::max<size_t>(num_slices, 1));
+  if (bytes_per_slab > max_bytes)
+    WARN("memory limit of " + str(max_bytes >> 20) + " MB too small to hold " + str(slabs_in_flight) +
+         " slabs of one slice each; memory usage will exceed this limit");
+  INFO("processing images in slabs of " + str(thickness) + " slices");
+  return thickness;
+}
+
+} // namespace MR::ImageIO
@@ -0,0 +1,144 @@
+/* Copyright (c) 2008-2024 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#pragma once
+
+#include <iosfwd>
+#include <memory>
+#include <vector>
+
+#include "adapter/subset.h"
+#include "algo/copy.h"
+#include "fetch_store.h"
+#include "header.h"
+#include "image.h"
+
+namespace MR::File {
+class GZ;
+namespace BGZF {
+class Reader;
+}
+} // namespace MR::File
+
+namespace MR::ImageIO {
+
+//! \cond skip
+class SlabReaderBase {
+public:
+  SlabReaderBase(Header &&header, size_t axis);
+  ~SlabReaderBase();
+
+  const Header &header() const { return H; }
+  size_t size() const { return axis < H.ndim() ? H.size(axis) : 1; }
+
+  //! header for the slab [from, to), with the same strides as the image on file
+  Header slab_header(size_t from, size_t to) const;
+
+protected:
+  Header H;
+  const size_t axis;
+  bool raw;
+  std::vector<File::Entry> files;
+  int64_t voxels_per_file;
+  std::vector<uint8_t> buffer;
+
+  class Block {
+  public:
+    int64_t offset, count;
+  };
+  // the contiguous runs of voxels on file that make up the slab, in order:
+  std::vector<Block> blocks(size_t from, size_t to) const;
+  // read the raw data for the voxels in block into buffer, and return the
+  // index of the first voxel within it:
+  size_t read(const Block &block);
+
+private:
+  bool compressed;
+  size_t current_file;
+  std::unique_ptr<std::ifstream> in;
+  std::unique_ptr<File::GZ> gz;
+  std::unique_ptr<File::BGZF::Reader> bgzf;
+
+  void open(size_t file);
+};
+//! \endcond
+
+//! read the data of an image stored on file in slabs along one of its axes
+/*! This allows images to be processed out-of-core: only the data for the
+ * slab requested (by default, a range of slices along the z axis) are read
+ * from file, and converted into a scratch image of the corresponding size.
+ * For images stored as a single array of values on file (possibly
+ * compressed), the amount of memory required is therefore proportional to
+ * the size of the slab, rather than that of the whole image.
+ *
+ * Compressed images in BGZF format are accessed at random, decompressing
+ * only those blocks that are needed; other compressed images are
+ * decompressed on the fly, which is efficient as long as the slabs are read
+ * in order (reading an earlier slab requires decompression to restart from
+ * the beginning of the file). Images stored in any other way (e.g. DICOM
+ * mosaics) are loaded in their entirety on construction.
+ *
+ * The values obtained are identical to those obtained by accessing the
+ * corresponding voxels of the full image using Image<ValueType>. */
+template <typename ValueType> class SlabReader : public SlabReaderBase {
+public:
+  SlabReader(Header &&header, size_t axis = 2) : SlabReaderBase(std::move(header), axis) {
+    if (raw) {
+      StoreScaleSpanFunction<ValueType> store_func;
+      __set_fetch_store_scale_span_functions<ValueType>(fetch_func, store_func, H.datatype());
+    } else {
+      image = H.get_image<ValueType>();
+    }
+  }
+
+  //! read slices [\a from, \a to) into a new scratch image
+  Image<ValueType> read(size_t from, size_t to) {
+    assert(from < to && to <= size());
+    auto slab = Image<ValueType>::scratch(slab_header(from, to), "slab of \"" + H.name() + "\"");
+    if (!raw) {
+      std::vector<ssize_t> offset(image.ndim(), 0), extent(image.ndim());
+      for (size_t n = 0; n < image.ndim(); ++n)
+        extent[n] = image.size(n);
+      if (axis < image.ndim()) {
+        offset[axis] = from;
+        extent[axis] = to - from;
+      }
+      Adapter::Subset<Image<ValueType>> source(image, offset, extent);
+      copy(source, slab);
+      return slab;
+    }
+
+    ValueType *data = reinterpret_cast<ValueType *>(slab.buffer->get_data_pointer());
+    for (const auto &block : blocks(from, to)) {
+      const size_t first = SlabReaderBase::read(block);
+      fetch_func(data, buffer.data(), first, block.count, H.intensity_offset(), H.intensity_scale());
+      data += block.count;
+    }
+    return slab;
+  }
+
+protected:
+  FetchScaleSpanFunction<ValueType> fetch_func = nullptr;
+  Image<ValueType> image;
+};
+
+//! the number of slices per slab for out-of-core processing
+/*! This returns the largest number of slices (up to \a num_slices) such that
+ * \a slabs_in_flight slabs of \a bytes_per_slice bytes per slice fit within
+ * \a max_bytes, issuing a warning if even single-slice slabs do not fit. */
+size_t slab_thickness(size_t max_bytes, size_t bytes_per_slice, size_t num_slices, size_t slabs_in_flight);
+
+} // namespace MR::ImageIO
@@ -223,6 +223,51 @@ class LinearInterp<ImageType, LinearInterpProcessingType::Value>
     return coeff_matrix * factors;
   }
 
+  //! Read interpolated values from volumes along axis >= 3 into \a values
+  /*! This is equivalent to row(axis), but writes into an existing vector.
+   * If the image data are held in RAM with the values along \a axis
+   * stored contiguously (e.g. for an Image opened with
+   * Image::with_direct_io(axis)), the rows of values of the 8 neighbouring
+   * voxels are read directly, and blended in a single vectorised pass,
+   * rather than gathered one value at a time. */
+  template <class VectorType> void row(size_t axis, VectorType &values) {
+    if (Base<ImageType>::out_of_bounds) {
+      values.setConstant(Base<ImageType>::out_of_bounds_value);
+      return;
+    }
+
+    if constexpr (std::is_same<ImageType, Image<value_type>>::value) {
+      if (ImageType::data_pointer && ImageType::stride(axis) == 1) {
+        using RowType = Eigen::Map<const Eigen::Matrix<value_type, Eigen::Dynamic, 1>>;
+        ssize_t c[] = {ssize_t(std::floor(P[0])), ssize_t(std::floor(P[1])), ssize_t(std::floor(P[2]))};
+        const ssize_t num = ImageType::size(axis);
+        const value_type *rows[8];
+
+        ImageType::index(axis) = 0;
+        size_t i(0);
+        for (ssize_t z = 0; z < 2; ++z) {
+          ImageType::index(2) = clamp(c[2] + z, ImageType::size(2));
+          for (ssize_t y = 0; y < 2; ++y) {
+            ImageType::index(1) = clamp(c[1] + y, ImageType::size(1));
+            for (ssize_t x = 0; x < 2; ++x) {
+              ImageType::index(0) = clamp(c[0] + x, ImageType::size(0));
+              rows[i++] = ImageType::address();
+            }
+          }
+        }
+
+        values.resize(num);
+        values.noalias() = factors[0] * RowType(rows[0], num) + factors[1] * RowType(rows[1], num) +
+                           factors[2] * RowType(rows[2], num) + factors[3] * RowType(rows[3], num) +
+                           factors[4] * RowType(rows[4], num) + factors[5] * RowType(rows[5], num) +
+                           factors[6] * RowType(rows[6], num) + factors[7] * RowType(rows[7], num);
+        return;
+      }
+    }
+
+    values = row(axis);
+  }
+
 protected:
   Eigen::Matrix<coef_type, 8, 1> factors;
 };
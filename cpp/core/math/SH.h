@@ -412,6 +412,45 @@ template <typename ValueType> class PrecomputedAL {
     return v;
   }
 
+  //! compute the values of the SH basis functions along \a unit_dir into \a dest
+  /*! \a dest must have room for NforL(lmax) values; the amplitude of an SH
+   * series along this direction is then the dot product of these values
+   * with its coefficients. */
+  template <class UnitVectorType> void basis(ValueType *dest, const UnitVectorType &unit_dir) const {
+    PrecomputedFraction<ValueType> f;
+    set(f, std::acos(unit_dir[2]));
+    ValueType rxy = std::sqrt(pow2(unit_dir[1]) + pow2(unit_dir[0]));
+    ValueType cp = (rxy) ? unit_dir[0] / rxy : 1.0;
+    ValueType sp = (rxy) ? unit_dir[1] / rxy : 0.0;
+    for (int l = 0; l <= lmax; l += 2)
+      dest[index(l, 0)] = get(f, l, 0);
+    ValueType c0(1.0), s0(0.0);
+    for (int m = 1; m <= lmax; m++) {
+      ValueType c = c0 * cp - s0 * sp;
+      ValueType s = s0 * cp + c0 * sp;
+      for (int l = ((m & 1) ? m + 1 : m); l <= lmax; l += 2) {
+        const ValueType AL_lm = get(f, l, m) * Math::sqrt2;
+        dest[index(l, m)] = AL_lm * c;
+        dest[index(l, -m)] = AL_lm * s;
+      }
+      c0 = c;
+      s0 = s;
+    }
+  }
+
+  //! compute the values of the SH basis functions along each of \a unit_dirs into the rows of \a B
+  /*! This allows the amplitudes of an SH series along many directions to be
+   * computed as a single matrix-vector product (B * coefficients), or those of
+   * a different SH series along each direction as the row-wise dot products
+   * with the coefficients. \a B must be a row-major matrix; it is resized as
+   * required. */
+  template <class MatrixType, class DirectionList> void basis(MatrixType &B, const DirectionList &unit_dirs) const {
+    static_assert(MatrixType::IsRowMajor, "SH basis matrix must be row-major");
+    B.resize(unit_dirs.size(), NforL(lmax));
+    for (ssize_t n = 0; n < ssize_t(unit_dirs.size()); ++n)
+      basis(&B(n, 0), unit_dirs[n]);
+  }
+
 protected:
   int lmax, ndir, nAL;
   ValueType inc;
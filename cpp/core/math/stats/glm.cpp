@@ -30,6 +30,14 @@
 
 namespace MR::Math::Stats::GLM {
 
+namespace {
+// Target size of the shuffled data for each tile of image elements when
+//   processing a block of shuffles, such that these remain resident within
+//   a typical L2 / L3 cache
+constexpr size_t shuffle_tile_bytes = 4 * 1024 * 1024;
+constexpr size_t shuffle_tile_alignment = 16;
+} // namespace
+
 const char *const column_ones_description =
     "In some software packages, a column of ones is automatically added to the "
     "GLM design matrix; the purpose of this column is to estimate the \"global "
@@ -523,9 +531,23 @@ matrix_type Hypothesis::check_rank(const matrix_type &in, const index_type index
   return result;
 }
 
-void TestBase::operator()(const matrix_type &shuffling_matrix, matrix_type &output) const {
+void TestBase::operator()(const Shuffle &shuffle, matrix_type &output) const {
   matrix_type temp;
-  (*this)(shuffling_matrix, temp, output);
+  (*this)(shuffle, temp, output);
+}
+
+void TestBase::operator()(const std::vector<Shuffle> &shuffles, std::vector<matrix_type> &output) const {
+  std::vector<matrix_type> temp;
+  (*this)(shuffles, temp, output);
+}
+
+void TestBase::operator()(const std::vector<Shuffle> &shuffles,
+                          std::vector<matrix_type> &stats,
+                          std::vector<matrix_type> &zstats) const {
+  stats.resize(shuffles.size());
+  zstats.resize(shuffles.size());
+  for (size_t k = 0; k != shuffles.size(); ++k)
+    (*this)(shuffles[k], stats[k], zstats[k]);
 }
 
 // #define GLM_TEST_DEBUG
@@ -540,89 +562,133 @@ TestFixedHomoscedastic::TestFixedHomoscedastic(const matrix_type &measurements,
   // When the design matrix is fixed, we can pre-calculate the model partitioning for each hypothesis
   for (const auto &h : hypotheses) {
     partitions.emplace_back(h.partition(design));
+    Rzy.emplace_back(partitions.back().Rz * y);
     XtX.emplace_back(partitions.back().X.transpose() * partitions.back().X);
     one_over_dof.push_back(1.0 / (num_inputs() - partitions.back().rank_x - partitions.back().rank_z));
   }
 }
 
-void TestFixedHomoscedastic::operator()(const matrix_type &shuffling_matrix,
-                                        matrix_type &stats,
-                                        matrix_type &zstats) const {
-  assert(index_type(shuffling_matrix.rows()) == num_inputs());
-  stats.resize(num_elements(), num_hypotheses());
-  zstats.resize(num_elements(), num_hypotheses());
+void TestFixedHomoscedastic::operator()(const Shuffle &shuffle, matrix_type &stats, matrix_type &zstats) const {
+  std::vector<matrix_type> block_stats, block_zstats;
+  (*this)(std::vector<Shuffle>(1, shuffle), block_stats, block_zstats);
+  stats = std::move(block_stats[0]);
+  zstats = std::move(block_zstats[0]);
+}
+
+void TestFixedHomoscedastic::operator()(const std::vector<Shuffle> &shuffles,
+                                        std::vector<matrix_type> &stats,
+                                        std::vector<matrix_type> &zstats) const {
+  stats.resize(shuffles.size());
+  zstats.resize(shuffles.size());
+  for (size_t k = 0; k != shuffles.size(); ++k) {
+    assert(shuffles[k].rows() == num_inputs());
+    stats[k].resize(num_elements(), num_hypotheses());
+    zstats[k].resize(num_elements(), num_hypotheses());
+  }
 
   matrix_type Sy, lambdas, residuals, beta;
   vector_type sse;
 
-  // Freedman-Lane for fixed design matrix case
-  // Each hypothesis needs to be handled explicitly on its own
-  for (index_type ih = 0; ih != c.size(); ++ih) {
-
-    // First, we perform permutation of the input data
-    // In Freedman-Lane, the initial 'effective' regression against the nuisance
-    //   variables, and permutation of the data, are done in a single step
+  // The image elements are processed in tiles, such that the shuffled data
+  //   for the whole block of shuffles remain resident in cache
+  const index_type tile = tile_size(shuffles.size());
+  for (index_type first = 0; first < num_elements(); first += tile) {
+    const index_type count = std::min(tile, num_elements() - first);
+
+    // Freedman-Lane for fixed design matrix case
+    // Each hypothesis needs to be handled explicitly on its own
+    for (index_type ih = 0; ih != c.size(); ++ih) {
+
+      // First, we perform permutation of the input data
+      // In Freedman-Lane, the initial 'effective' regression against the nuisance
+      //   variables has already been performed in the constructor;
+      //   permutation of the data then only involves shuffling rows
+      // The data for all shuffles in the block are placed side-by-side,
+      //   so that all of the regressions below are performed in a single product
 #ifdef GLM_TEST_DEBUG
-    VAR(shuffling_matrix.rows());
-    VAR(shuffling_matrix.cols());
-    VAR(partitions[ih].Rz.rows());
-    VAR(partitions[ih].Rz.cols());
-    VAR(y.rows());
-    VAR(y.cols());
+      VAR(shuffles.size());
+      VAR(Rzy[ih].rows());
+      VAR(Rzy[ih].cols());
 #endif
-    Sy.noalias() = shuffling_matrix * partitions[ih].Rz * y;
+      shuffle_data(shuffles, ih, first, count, Sy);
 #ifdef GLM_TEST_DEBUG
-    VAR(Sy.rows());
-    VAR(Sy.cols());
-    VAR(pinvM.rows());
-    VAR(pinvM.cols());
+      VAR(Sy.rows());
+      VAR(Sy.cols());
+      VAR(pinvM.rows());
+      VAR(pinvM.cols());
 #endif
-    // Now, we regress this shuffled data against the full model
-    lambdas.noalias() = pinvM * Sy;
+      // Now, we regress this shuffled data against the full model
+      lambdas.noalias() = pinvM * Sy;
 #ifdef GLM_TEST_DEBUG
-    VAR(lambdas.rows());
-    VAR(lambdas.cols());
-    // VAR (matrix_type(c[ih]).rows());
-    // VAR (matrix_type(c[ih]).cols());
-    VAR(Rm.rows());
-    VAR(Rm.cols());
-    VAR(XtX[ih].rows());
-    VAR(XtX[ih].cols());
-    VAR(one_over_dof);
+      VAR(lambdas.rows());
+      VAR(lambdas.cols());
+      // VAR (matrix_type(c[ih]).rows());
+      // VAR (matrix_type(c[ih]).cols());
+      VAR(Rm.rows());
+      VAR(Rm.cols());
+      VAR(XtX[ih].rows());
+      VAR(XtX[ih].cols());
+      VAR(one_over_dof);
 #endif
-    const index_type dof = num_inputs() - partitions[ih].rank_x - partitions[ih].rank_z;
-    const default_type one_over_dof = 1.0 / default_type(dof);
-    sse = (Rm * Sy).colwise().squaredNorm();
+      const index_type dof = num_inputs() - partitions[ih].rank_x - partitions[ih].rank_z;
+      const default_type one_over_dof = 1.0 / default_type(dof);
+      sse = (Rm * Sy).colwise().squaredNorm();
 #ifdef GLM_TEST_DEBUG
-    VAR(dof);
-    VAR(one_over_dof);
-    VAR(sse.size());
+      VAR(dof);
+      VAR(one_over_dof);
+      VAR(sse.size());
 #endif
-    for (index_type ie = 0; ie != num_elements(); ++ie) {
-      beta.noalias() = c[ih].matrix() * lambdas.col(ie);
-      const default_type F = ((beta.transpose() * XtX[ih] * beta)(0, 0) / c[ih].rank()) / (one_over_dof * sse[ie]);
-      if (!std::isfinite(F)) {
-        stats(ie, ih) = zstats(ie, ih) = value_type(0);
-      } else if (c[ih].is_F()) {
-        stats(ie, ih) = F;
+      for (index_type col = 0; col != index_type(Sy.cols()); ++col) {
+        const index_type k = col / count;
+        const index_type ie = first + col % count;
+        beta.noalias() = c[ih].matrix() * lambdas.col(col);
+        const default_type F = ((beta.transpose() * XtX[ih] * beta)(0, 0) / c[ih].rank()) / (one_over_dof * sse[col]);
+        if (!std::isfinite(F)) {
+          stats[k](ie, ih) = zstats[k](ie, ih) = value_type(0);
+        } else if (c[ih].is_F()) {
+          stats[k](ie, ih) = F;
 #ifdef MRTRIX_USE_ZSTATISTIC_LOOKUP
-        zstats(ie, ih) = stat2z->F2z(F, c[ih].rank(), dof);
+          zstats[k](ie, ih) = stat2z->F2z(F, c[ih].rank(), dof);
 #else
-        zstats(ie, ih) = Math::F2z(F, c[ih].rank(), dof);
+          zstats[k](ie, ih) = Math::F2z(F, c[ih].rank(), dof);
 #endif
-      } else {
-        assert(beta.rows() == 1);
-        stats(ie, ih) = std::sqrt(F) * (beta.sum() > 0.0 ? 1.0 : -1.0);
+        } else {
+          assert(beta.rows() == 1);
+          stats[k](ie, ih) = std::sqrt(F) * (beta.sum() > 0.0 ? 1.0 : -1.0);
 #ifdef MRTRIX_USE_ZSTATISTIC_LOOKUP
-        zstats(ie, ih) = stat2z->t2z(stats(ie, ih), dof);
+          zstats[k](ie, ih) = stat2z->t2z(stats[k](ie, ih), dof);
 #else
-        zstats(ie, ih) = Math::t2z(stats(ie, ih), dof);
+          zstats[k](ie, ih) = Math::t2z(stats[k](ie, ih), dof);
 #endif
+        }
       }
     }
   }
 }
 
+index_type TestFixedHomoscedastic::tile_size(const size_t num_shuffles) const {
+  // The unshuffled data for the tile are read again for each shuffle, so are included in the budget
+  const size_t bytes_per_element = (num_shuffles + 1) * size_t(num_inputs()) * sizeof(value_type);
+  // Tiles are a multiple of the column width of the matrix product kernels, such that
+  //   tile boundaries do not change the order of floating-point operations for any element
+  size_t tile = shuffle_tile_bytes / bytes_per_element;
+  tile = std::max(tile - tile % shuffle_tile_alignment, shuffle_tile_alignment);
+  return index_type(std::min(tile, size_t(num_elements())));
+}
+
+void TestFixedHomoscedastic::shuffle_data(const std::vector<Shuffle> &shuffles,
+                                          const index_type ih,
+                                          const index_type first,
+                                          const index_type count,
+                                          matrix_type &Sy) const {
+  Sy.resize(num_inputs(), shuffles.size() * count);
+  const auto data = Rzy[ih].middleCols(first, count);
+  for (size_t k = 0; k != shuffles.size(); ++k) {
+    auto block = Sy.middleCols(k * count, count);
+    shuffles[k].apply(data, block);
+  }
+}
+
 TestFixedHeteroscedastic::TestFixedHeteroscedastic(const matrix_type &measurements,
                                                    const matrix_type &design,
                                                    const std::vector<Hypothesis> &hypotheses,
@@ -659,114 +725,136 @@ TestFixedHeteroscedastic::TestFixedHeteroscedastic(const matrix_type &measuremen
 #endif
 }
 
-void TestFixedHeteroscedastic::operator()(const matrix_type &shuffling_matrix,
-                                          matrix_type &stats,
-                                          matrix_type &zstats) const {
-  assert(index_type(shuffling_matrix.rows()) == num_inputs());
-  stats.resize(num_elements(), num_hypotheses());
-  zstats.resize(num_elements(), num_hypotheses());
+void TestFixedHeteroscedastic::operator()(const Shuffle &shuffle, matrix_type &stats, matrix_type &zstats) const {
+  std::vector<matrix_type> block_stats, block_zstats;
+  (*this)(std::vector<Shuffle>(1, shuffle), block_stats, block_zstats);
+  stats = std::move(block_stats[0]);
+  zstats = std::move(block_zstats[0]);
+}
+
+void TestFixedHeteroscedastic::operator()(const std::vector<Shuffle> &shuffles,
+                                          std::vector<matrix_type> &stats,
+                                          std::vector<matrix_type> &zstats) const {
+  stats.resize(shuffles.size());
+  zstats.resize(shuffles.size());
+  for (size_t k = 0; k != shuffles.size(); ++k) {
+    assert(shuffles[k].rows() == num_inputs());
+    stats[k].resize(num_elements(), num_hypotheses());
+    zstats[k].resize(num_elements(), num_hypotheses());
+  }
 
   matrix_type Sy, lambdas;
   Eigen::Array<default_type, Eigen::Dynamic, Eigen::Dynamic> sq_residuals, sse, Wterms;
   Eigen::Matrix<default_type, Eigen::Dynamic, 1> W(num_inputs());
 #ifdef GLM_TEST_DEBUG
-  VAR(shuffling_matrix);
+  for (const auto &shuffle : shuffles) {
+    VAR(shuffle.permutation);
+    VAR(shuffle.sign);
+  }
 #endif
 
-  for (index_type ih = 0; ih != c.size(); ++ih) {
-    // First two steps are identical to the homoscedastic case
-    Sy.noalias() = shuffling_matrix * partitions[ih].Rz * y;
+  // As in the homoscedastic case, the image elements are processed in tiles
+  const index_type tile = tile_size(shuffles.size());
+  for (index_type first = 0; first < num_elements(); first += tile) {
+    const index_type count = std::min(tile, num_elements() - first);
+    for (index_type ih = 0; ih != c.size(); ++ih) {
+      // First two steps are identical to the homoscedastic case
+      shuffle_data(shuffles, ih, first, count, Sy);
 #ifdef GLM_TEST_DEBUG
-    VAR(Sy);
+      VAR(Sy);
 #endif
-    lambdas.noalias() = pinvM * Sy;
+      lambdas.noalias() = pinvM * Sy;
 #ifdef GLM_TEST_DEBUG
-    VAR(lambdas);
+      VAR(lambdas);
 #endif
-    // Compute sum of residuals per VG immediately
-    // Variance groups appear across rows, and one column per element tested
-    // Immediately calculate squared residuals; simplifies summation over variance groups
-    sq_residuals = (Rm * Sy).array().square();
+      // Compute sum of residuals per VG immediately
+      // Variance groups appear across rows, and one column per element tested
+      // Immediately calculate squared residuals; simplifies summation over variance groups
+      sq_residuals = (Rm * Sy).array().square();
 #ifdef GLM_TEST_DEBUG
-    VAR(sq_residuals);
-    VAR(sq_residuals.rows());
-    VAR(sq_residuals.cols());
+      VAR(sq_residuals);
+      VAR(sq_residuals.rows());
+      VAR(sq_residuals.cols());
 #endif
-    sse = matrix_type::Zero(num_variance_groups(), num_elements());
-    for (index_type input = 0; input != num_inputs(); ++input)
-      sse.row(VG[input]) += sq_residuals.row(input);
+      sse = matrix_type::Zero(num_variance_groups(), Sy.cols());
+      for (index_type input = 0; input != num_inputs(); ++input)
+        sse.row(VG[input]) += sq_residuals.row(input);
 #ifdef GLM_TEST_DEBUG
-    VAR(sse);
-    VAR(sse.rows());
-    VAR(sse.cols());
+      VAR(sse);
+      VAR(sse.rows());
+      VAR(sse.cols());
 #endif
-    // These terms are what appears in the weighting matrix based on the VG to which each input belongs;
-    //   one row per variance group, one column per element to be tested
-    Wterms = sse.array().inverse().colwise() * Rnn_sums;
-    for (index_type col = 0; col != num_elements(); ++col) {
-      for (index_type row = 0; row != num_vgs; ++row) {
-        if (!std::isfinite(Wterms(row, col)))
-          Wterms(row, col) = 0.0;
+      // These terms are what appears in the weighting matrix based on the VG to which each input belongs;
+      //   one row per variance group, one column per element to be tested (for each shuffle)
+      Wterms = sse.array().inverse().colwise() * Rnn_sums;
+      for (index_type col = 0; col != index_type(Sy.cols()); ++col) {
+        for (index_type row = 0; row != num_vgs; ++row) {
+          if (!std::isfinite(Wterms(row, col)))
+            Wterms(row, col) = 0.0;
+        }
       }
-    }
 #ifdef GLM_TEST_DEBUG
-    VAR(Wterms);
-    VAR(Wterms.rows());
-    VAR(Wterms.cols());
+      VAR(Wterms);
+      VAR(Wterms.rows());
+      VAR(Wterms.cols());
 #endif
-    for (index_type ie = 0; ie != num_elements(); ++ie) {
-      // Need to construct the weights diagonal matrix; is unique for each element
-      default_type W_trace(0.0);
-      for (index_type input = 0; input != num_inputs(); ++input) {
-        W[input] = Wterms(VG[input], ie);
-        W_trace += W[input];
-      }
+      for (index_type col = 0; col != index_type(Sy.cols()); ++col) {
+        const index_type k = col / count;
+        const index_type ie = first + col % count;
+        // Need to construct the weights diagonal matrix; is unique for each element
+        default_type W_trace(0.0);
+        for (index_type input = 0; input != num_inputs(); ++input) {
+          W[input] = Wterms(VG[input], col);
+          W_trace += W[input];
+        }
 #ifdef GLM_TEST_DEBUG
-      VAR(W_trace);
+        VAR(W_trace);
 #endif
-      const default_type numerator =
-          lambdas.col(ie).transpose() * c[ih].matrix().transpose() *
-          (c[ih].matrix() * (M.transpose() * W.asDiagonal() * M).inverse() * c[ih].matrix().transpose()).inverse() *
-          c[ih].matrix() * lambdas.col(ie);
+        const default_type numerator =
+            lambdas.col(col).transpose() * c[ih].matrix().transpose() *
+            (c[ih].matrix() * (M.transpose() * W.asDiagonal() * M).inverse() * c[ih].matrix().transpose()).inverse() *
+            c[ih].matrix() * lambdas.col(col);
 #ifdef GLM_TEST_DEBUG
-      VAR(numerator);
+        VAR(numerator);
 #endif
-      default_type gamma(0.0);
-      for (index_type vg_index = 0; vg_index != num_vgs; ++vg_index)
-        // Since Wnn is the same for every n in the variance group, can compute that summation as the product of:
-        //   - the value inserted in W for that particular VG
-        //   - the number of inputs that are a part of that VG
-        gamma +=
-            inv_Rnn_sums[vg_index] * Math::pow2(1.0 - ((Wterms(vg_index, ie) * inputs_per_vg[vg_index]) / W_trace));
-      gamma = 1.0 + (gamma_weights[ih] * gamma);
+        default_type gamma(0.0);
+        for (index_type vg_index = 0; vg_index != num_vgs; ++vg_index)
+          // Since Wnn is the same for every n in the variance group, can compute that summation as the product of:
+          //   - the value inserted in W for that particular VG
+          //   - the number of inputs that are a part of that VG
+          gamma +=
+              inv_Rnn_sums[vg_index] * Math::pow2(1.0 - ((Wterms(vg_index, col) * inputs_per_vg[vg_index]) / W_trace));
+        gamma = 1.0 + (gamma_weights[ih] * gamma);
 #ifdef GLM_TEST_DEBUG
-      VAR(gamma);
+        VAR(gamma);
 #endif
-      const default_type denominator = gamma * c[ih].rank();
-      const default_type G = numerator / denominator;
-      if (!std::isfinite(G)) {
-        stats(ie, ih) = zstats(ie, ih) = value_type(0);
-      } else {
-        stats(ie, ih) = c[ih].is_F() ? G : std::sqrt(G) * ((c[ih].matrix() * lambdas.col(ie)).sum() > 0.0 ? 1.0 : -1.0);
-        if (c[ih].is_F() && c[ih].rank() > 1) {
-          const default_type dof = 2.0 * default_type(c[ih].rank() - 1) / (3.0 * (gamma - 1.0));
+        const default_type denominator = gamma * c[ih].rank();
+        const default_type G = numerator / denominator;
+        if (!std::isfinite(G)) {
+          stats[k](ie, ih) = zstats[k](ie, ih) = value_type(0);
+        } else {
+          stats[k](ie, ih) =
+              c[ih].is_F() ? G : std::sqrt(G) * ((c[ih].matrix() * lambdas.col(col)).sum() > 0.0 ? 1.0 : -1.0);
+          if (c[ih].is_F() && c[ih].rank() > 1) {
+            const default_type dof = 2.0 * default_type(c[ih].rank() - 1) / (3.0 * (gamma - 1.0));
 #ifdef GLM_TEST_DEBUG
-          VAR(dof);
+            VAR(dof);
 #endif
-          zstats(ie, ih) = stat2z->F2z(G, c[ih].rank(), dof);
-        } else {
-          const default_type dof = Math::welch_satterthwaite(Wterms.col(ie).inverse(), inputs_per_vg);
+            zstats[k](ie, ih) = stat2z->F2z(G, c[ih].rank(), dof);
+          } else {
+            const default_type dof = Math::welch_satterthwaite(Wterms.col(col).inverse(), inputs_per_vg);
 #ifdef GLM_TEST_DEBUG
-          VAR(dof);
+            VAR(dof);
 #endif
-          zstats(ie, ih) = c[ih].is_F() ?
+            zstats[k](ie, ih) = c[ih].is_F() ?
 #ifdef MRTRIX_USE_ZSTATISTIC_LOOKUP
-                                        stat2z->G2z(G, c[ih].rank(), dof)
-                                        : stat2z->v2z(stats(ie, ih), dof);
+                                             stat2z->G2z(G, c[ih].rank(), dof)
+                                             : stat2z->v2z(stats[k](ie, ih), dof);
 #else
-                                        Math::F2z(G, c[ih].rank(), dof)
-                                        : Math::t2z(stats(ie, ih), dof);
+                                             Math::F2z(G, c[ih].rank(), dof)
+                                             : Math::t2z(stats[k](ie, ih), dof);
 #endif
+          }
         }
       }
     }
@@ -788,17 +876,16 @@ TestVariableHomoscedastic::TestVariableHomoscedastic(const std::vector<CohortDat
   assert(index_type(hypotheses[0].cols()) == index_type(M.cols()) + importers.size());
 }
 
-void TestVariableHomoscedastic::operator()(const matrix_type &shuffling_matrix,
-                                           matrix_type &stats,
-                                           matrix_type &zstats) const {
+void TestVariableHomoscedastic::operator()(const Shuffle &shuffle, matrix_type &stats, matrix_type &zstats) const {
   stats.resize(num_elements(), num_hypotheses());
   zstats.resize(num_elements(), num_hypotheses());
 
   matrix_type dof(num_elements(), num_hypotheses());
   matrix_type extra_column_data(num_inputs(), importers.size());
   BitSet element_mask(num_inputs());
-  matrix_type shuffling_matrix_masked, Mfull_masked, pinvMfull_masked, Rm;
-  vector_type y_masked, Sy, lambda;
+  Shuffle shuffle_masked;
+  matrix_type Mfull_masked, pinvMfull_masked, Rm;
+  vector_type y_masked, Rzy_masked, Sy, lambda;
   matrix_type XtX, beta;
 
   // Let's loop over elements first, then hypotheses in the inner loop
@@ -820,7 +907,7 @@ void TestVariableHomoscedastic::operator()(const matrix_type &shuffling_matrix,
     //
     // Note that this is going to have to operate slightly differently to
     //   how it used to be done, i.e. via the permutation labelling vector,
-    //   if we are to support taking the shuffling matrix as input to this functor
+    //   if we are to support taking the shuffle as input to this functor
     // I think the approach will have to be:
     //   - Both NaNs in design matrix and NaNs in input data need to be removed
     //     in order to perform the initial regression against nuisance variables
@@ -842,10 +929,10 @@ void TestVariableHomoscedastic::operator()(const matrix_type &shuffling_matrix,
     } else {
       apply_mask(element_mask,
                  y.col(ie),
-                 shuffling_matrix,
+                 shuffle,
                  extra_column_data,
                  Mfull_masked,
-                 shuffling_matrix_masked,
+                 shuffle_masked,
                  y_masked);
       assert(Mfull_masked.allFinite());
 
@@ -864,7 +951,7 @@ void TestVariableHomoscedastic::operator()(const matrix_type &shuffling_matrix,
 
         Rm.noalias() = matrix_type::Identity(finite_count, finite_count) - (Mfull_masked * pinvMfull_masked);
 
-        // We now have our permutation (shuffling) matrix and design matrix prepared,
+        // We now have our shuffle and design matrix prepared,
         //   and can commence regressing the partitioned model of each hypothesis
         for (index_type ih = 0; ih != num_hypotheses(); ++ih) {
 
@@ -879,7 +966,8 @@ void TestVariableHomoscedastic::operator()(const matrix_type &shuffling_matrix,
             // Now that we have the individual hypothesis model partition for these data,
             //   the rest of this function should proceed similarly to the fixed
             //   design matrix case
-            Sy = shuffling_matrix_masked * partition.Rz * y_masked.matrix();
+            Rzy_masked = partition.Rz * y_masked.matrix();
+            shuffle_masked.apply(Rzy_masked, Sy);
             lambda = pinvMfull_masked * Sy.matrix();
             beta.noalias() = c[ih].matrix() * lambda.matrix();
             const default_type sse = (Rm * Sy.matrix()).squaredNorm();
@@ -935,10 +1023,10 @@ void TestVariableHomoscedastic::get_mask(const index_type ie, BitSet &mask, cons
 
 void TestVariableHomoscedastic::apply_mask(const BitSet &mask,
                                            matrix_type::ConstColXpr data,
-                                           const matrix_type &shuffling_matrix,
+                                           const Shuffle &shuffle,
                                            const matrix_type &extra_column_data,
                                            matrix_type &Mfull_masked,
-                                           matrix_type &shuffling_matrix_masked,
+                                           Shuffle &shuffle_masked,
                                            vector_type &data_masked) const {
   const index_type finite_count = mask.count();
   // Do we need to reduce the size of our matrices / vectors
@@ -948,48 +1036,39 @@ void TestVariableHomoscedastic::apply_mask(const BitSet &mask,
     Mfull_masked.resize(num_inputs(), num_factors());
     Mfull_masked.block(0, 0, num_inputs(), M.cols()) = M;
     Mfull_masked.block(0, M.cols(), num_inputs(), extra_column_data.cols()) = extra_column_data;
-    shuffling_matrix_masked = shuffling_matrix;
+    shuffle_masked = shuffle;
     data_masked = data;
 
   } else {
 
     Mfull_masked.resize(finite_count, num_factors());
     data_masked.resize(finite_count);
-    BitSet perm_matrix_mask(num_inputs(), true);
+    // Index of each retained input after masking
+    std::vector<index_type> masked_index(num_inputs(), num_inputs());
     index_type out_index = 0;
     for (index_type in_index = 0; in_index != num_inputs(); ++in_index) {
       if (mask[in_index]) {
         Mfull_masked.block(out_index, 0, 1, M.cols()) = M.row(in_index);
         Mfull_masked.block(out_index, M.cols(), 1, extra_column_data.cols()) = extra_column_data.row(in_index);
-        data_masked[out_index++] = data[in_index];
-      } else {
-        // Any row in the permutation matrix that contains a non-zero entry
-        //   in the column corresponding to in_row needs to be removed
-        //   from the permutation matrix
-        for (index_type perm_row = 0; perm_row != index_type(shuffling_matrix.rows()); ++perm_row) {
-          if (shuffling_matrix(perm_row, in_index))
-            perm_matrix_mask[perm_row] = false;
-        }
+        data_masked[out_index] = data[in_index];
+        masked_index[in_index] = out_index++;
       }
     }
     assert(out_index == finite_count);
-    assert(perm_matrix_mask.count() == finite_count);
     assert(data_masked.allFinite());
-    // Only after we've reduced the design matrix do we now reduce the shuffling matrix
-    // Step 1: Remove rows that contain non-zero entries in columns to be removed
-    matrix_type temp(finite_count, num_inputs());
+    // Only after we've reduced the design matrix do we now reduce the shuffle:
+    //   any row of the shuffle that draws from an input that has been removed
+    //   must itself be removed, and the remaining rows must draw from the
+    //   indices of those inputs after masking
+    shuffle_masked.index = shuffle.index;
+    shuffle_masked.permutation.resize(finite_count);
+    shuffle_masked.sign.resize(finite_count);
     out_index = 0;
-    for (index_type in_index = 0; in_index != num_inputs(); ++in_index) {
-      if (perm_matrix_mask[in_index])
-        temp.row(out_index++) = shuffling_matrix.row(in_index);
-    }
-    assert(out_index == finite_count);
-    // Step 2: Remove columns
-    shuffling_matrix_masked.resize(finite_count, finite_count);
-    out_index = 0;
-    for (index_type in_index = 0; in_index != num_inputs(); ++in_index) {
-      if (mask[in_index])
-        shuffling_matrix_masked.col(out_index++) = temp.col(in_index);
+    for (index_type row = 0; row != num_inputs(); ++row) {
+      if (mask[shuffle.permutation[row]]) {
+        shuffle_masked.permutation[out_index] = masked_index[shuffle.permutation[row]];
+        shuffle_masked.sign[out_index++] = shuffle.sign[row];
+      }
     }
     assert(out_index == finite_count);
   }
@@ -1012,18 +1091,17 @@ TestVariableHeteroscedastic::TestVariableHeteroscedastic(const std::vector<Cohor
   }
 }
 
-void TestVariableHeteroscedastic::operator()(const matrix_type &shuffling_matrix,
-                                             matrix_type &stats,
-                                             matrix_type &zstats) const {
+void TestVariableHeteroscedastic::operator()(const Shuffle &shuffle, matrix_type &stats, matrix_type &zstats) const {
   stats.resize(num_elements(), num_hypotheses());
   zstats.resize(num_elements(), num_hypotheses());
 
   matrix_type extra_column_data(num_inputs(), importers.size());
   BitSet element_mask(num_inputs());
-  matrix_type Mfull_masked, shuffling_matrix_masked, pinvMfull_masked, Rm;
+  Shuffle shuffle_masked;
+  matrix_type Mfull_masked, pinvMfull_masked, Rm;
   Eigen::Matrix<default_type, Eigen::Dynamic, 1> W;
   index_array_type VG_masked, VG_counts;
-  vector_type y_masked, Sy, lambda, sq_residuals, sse, Rnn_sums, Wterms;
+  vector_type y_masked, Rzy_masked, Sy, lambda, sq_residuals, sse, Rnn_sums, Wterms;
 
   for (index_type ie = 0; ie != num_elements(); ++ie) {
     // Common ground to the TestVariableHomoscedastic case
@@ -1037,10 +1115,10 @@ void TestVariableHeteroscedastic::operator()(const matrix_type &shuffling_matrix
     } else {
       apply_mask(element_mask,
                  y.col(ie),
-                 shuffling_matrix,
+                 shuffle,
                  extra_column_data,
                  Mfull_masked,
-                 shuffling_matrix_masked,
+                 shuffle_masked,
                  y_masked);
       const default_type condition_number = Math::condition_number(Mfull_masked);
       if (!std::isfinite(condition_number) || condition_number > 1e5) {
@@ -1059,7 +1137,8 @@ void TestVariableHeteroscedastic::operator()(const matrix_type &shuffling_matrix
 
             // At this point the implementation diverges from the TestVariableHomoscedastic case,
             //   more closely mimicing the TestFixedHeteroscedastic case
-            Sy = shuffling_matrix_masked * partition.Rz * y_masked.matrix();
+            Rzy_masked = partition.Rz * y_masked.matrix();
+            shuffle_masked.apply(Rzy_masked, Sy);
             lambda = pinvMfull_masked * Sy.matrix();
             sq_residuals = (Rm * Sy.matrix()).array().square();
             sse = vector_type::Zero(num_variance_groups());
@@ -22,6 +22,7 @@
 #include "math/condition_number.h"
 #include "math/least_squares.h"
 #include "math/stats/import.h"
+#include "math/stats/shuffle.h"
 #include "math/stats/typedefs.h"
 #include "math/zstatistic.h"
 
@@ -199,20 +200,38 @@ class TestBase {
   virtual ~TestBase() {}
 
   /*! Compute Z-statistics
-   * @param shuffling_matrix a matrix to permute / sign flip the residuals (for permutation testing)
+   * @param shuffle the permutation / sign flips to apply to the residuals (for permutation testing)
    * @param output the matrix containing the output statistics (one column per hypothesis)
    *
    * This version ignores the statistics values themselves, and only exports Z-statistics
    *   (as these are what is used for statistical enhancement)
    */
-  virtual void operator()(const matrix_type &shuffling_matrix, matrix_type &output) const;
+  virtual void operator()(const Shuffle &shuffle, matrix_type &output) const;
 
   /*! Compute the statistics, including conversion to Z-score
-   * @param shuffling_matrix a matrix to permute / sign flip the residuals (for permutation testing)
+   * @param shuffle the permutation / sign flips to apply to the residuals (for permutation testing)
    * @param stat the matrix containing the output statistics (one column per hypothesis)
    * @param zstat the matrix containing the Z-transformed statistics (one column per hypothesis)
    */
-  virtual void operator()(const matrix_type &shuffling_matrix, matrix_type &stat, matrix_type &zstat) const = 0;
+  virtual void operator()(const Shuffle &shuffle, matrix_type &stat, matrix_type &zstat) const = 0;
+
+  /*! Compute Z-statistics for a block of shuffles
+   * @param shuffles the permutations / sign flips to apply to the residuals (for permutation testing)
+   * @param output the matrices containing the output statistics (one per shuffle)
+   */
+  virtual void operator()(const std::vector<Shuffle> &shuffles, std::vector<matrix_type> &output) const;
+
+  /*! Compute the statistics for a block of shuffles, including conversion to Z-score
+   * @param shuffles the permutations / sign flips to apply to the residuals (for permutation testing)
+   * @param stat the matrices containing the output statistics (one per shuffle)
+   * @param zstat the matrices containing the Z-transformed statistics (one per shuffle)
+   *
+   * By default, this processes each shuffle in turn; derived classes for which
+   * the design matrix is fixed instead process the whole block at once.
+   */
+  virtual void operator()(const std::vector<Shuffle> &shuffles,
+                          std::vector<matrix_type> &stat,
+                          std::vector<matrix_type> &zstat) const;
 
   index_type num_inputs() const { return M.rows(); }
   index_type num_elements() const { return y.cols(); }
@@ -249,19 +268,46 @@ class TestFixedHomoscedastic : public TestBase {
                          const std::vector<Hypothesis> &hypotheses);
 
   /*! Compute the statistics
-   * @param shuffling_matrix a matrix to permute / sign flip the residuals (for permutation testing)
+   * @param shuffle the permutation / sign flips to apply to the residuals (for permutation testing)
    * @param stats the vector containing the output statistics (one column per hypothesis)
    * @param zstats the vector containing the Z-transformed output statistics (one column per hypothesis)
    */
-  void operator()(const matrix_type &shuffling_matrix, matrix_type &stats, matrix_type &zstats) const override;
+  void operator()(const Shuffle &shuffle, matrix_type &stats, matrix_type &zstats) const override;
+
+  /*! Compute the statistics for a block of shuffles
+   * @param shuffles the permutations / sign flips to apply to the residuals (for permutation testing)
+   * @param stats the output statistics for each shuffle (one column per hypothesis)
+   * @param zstats the Z-transformed output statistics for each shuffle (one column per hypothesis)
+   *
+   * The shuffled data for all shuffles are concatenated, such that the regression
+   * for the whole block is performed using a small number of wide matrix products;
+   * this is done for tiles of image elements in turn, sized such that the shuffled
+   * data for each tile remain resident in cache.
+   */
+  void operator()(const std::vector<Shuffle> &shuffles,
+                  std::vector<matrix_type> &stats,
+                  std::vector<matrix_type> &zstats) const override;
 
 protected:
   // New classes to store information relevant to Freedman-Lane implementation
   std::vector<Hypothesis::Partition> partitions;
+  // Data after regression against the nuisance regressors of each hypothesis;
+  //   each shuffle then only needs to permute / sign-flip the rows of these
+  std::vector<matrix_type> Rzy;
   const matrix_type pinvM;
   const matrix_type Rm;
   std::vector<matrix_type> XtX;
   std::vector<default_type> one_over_dof;
+
+  // The number of image elements to process at a time for a block of shuffles
+  index_type tile_size(const size_t num_shuffles) const;
+  // Concatenate the shuffled data for hypothesis ih across a block of shuffles,
+  //   for the tile of count image elements starting at first
+  void shuffle_data(const std::vector<Shuffle> &shuffles,
+                    const index_type ih,
+                    const index_type first,
+                    const index_type count,
+                    matrix_type &Sy) const;
 };
 //! @}
 
@@ -293,11 +339,20 @@ class TestFixedHeteroscedastic : public TestFixedHomoscedastic {
   index_type num_variance_groups() const { return num_vgs; }
 
   /*! Compute the statistics
-   * @param shuffling_matrix a matrix to permute / sign flip the residuals (for permutation testing)
+   * @param shuffle the permutation / sign flips to apply to the residuals (for permutation testing)
    * @param stats the vector containing the output statistics (one column per hypothesis)
    * @param zstats the vector containing the Z-transformed output statistics (one column per hypothesis)
    */
-  void operator()(const matrix_type &shuffling_matrix, matrix_type &stats, matrix_type &zstats) const override;
+  void operator()(const Shuffle &shuffle, matrix_type &stats, matrix_type &zstats) const override;
+
+  /*! Compute the statistics for a block of shuffles
+   * @param shuffles the permutations / sign flips to apply to the residuals (for permutation testing)
+   * @param stats the output statistics for each shuffle (one column per hypothesis)
+   * @param zstats the Z-transformed output statistics for each shuffle (one column per hypothesis)
+   */
+  void operator()(const std::vector<Shuffle> &shuffles,
+                  std::vector<matrix_type> &stats,
+                  std::vector<matrix_type> &zstats) const override;
 
 protected:
   // Variance group assignments
@@ -341,14 +396,14 @@ class TestVariableHomoscedastic : public TestBase {
                             const bool nans_in_columns);
 
   /*! Compute the statistics
-   * @param shuffling_matrix a matrix to permute / sign flip the residuals (for permutation testing)
+   * @param shuffle the permutation / sign flips to apply to the residuals (for permutation testing)
    * @param stat the vector containing the native output statistics (one column per hypothesis)
    * @param zstat the vector containing the Z-transformed output statistics (one column per hypothesis)
    *
    * In TestVariable* classes, this function additionally needs to import the
    * extra external data individually for each element tested.
    */
-  void operator()(const matrix_type &shuffling_matrix, matrix_type &stat, matrix_type &zstat) const override;
+  void operator()(const Shuffle &shuffle, matrix_type &stat, matrix_type &zstat) const override;
 
   index_type num_factors() const override { return M.cols() + importers.size(); }
 
@@ -359,10 +414,10 @@ class TestVariableHomoscedastic : public TestBase {
   void get_mask(const index_type ie, BitSet &, const matrix_type &extra_columns) const;
   void apply_mask(const BitSet &mask,
                   matrix_type::ConstColXpr data,
-                  const matrix_type &shuffling_matrix,
+                  const Shuffle &shuffle,
                   const matrix_type &extra_column_data,
                   matrix_type &Mfull_masked,
-                  matrix_type &shuffling_matrix_masked,
+                  Shuffle &shuffle_masked,
                   vector_type &y_masked) const;
 };
 
@@ -392,14 +447,14 @@ class TestVariableHeteroscedastic : public TestVariableHomoscedastic {
                               const bool nans_in_columns);
 
   /*! Compute the statistics
-   * @param shuffling_matrix a matrix to permute / sign flip the residuals (for permutation testing)
+   * @param shuffle the permutation / sign flips to apply to the residuals (for permutation testing)
    * @param stat the vector containing the native output statistics (one column per hypothesis)
    * @param zstat the vector containing the Z-transformed output statistics (one column per hypothesis)
    *
    * In TestVariable* classes, this function additionally needs to import the
    * extra external data individually for each element tested.
    */
-  void operator()(const matrix_type &shuffling_matrix, matrix_type &stat, matrix_type &zstat) const override;
+  void operator()(const Shuffle &shuffle, matrix_type &stat, matrix_type &zstat) const override;
 
   index_type num_factors() const override { return M.cols() + importers.size(); }
   index_type num_variance_groups() const { return num_vgs; }
@@ -27,6 +27,13 @@ namespace MR::Math::Stats {
 
 std::vector<std::string> error_types = {"ee", "ise", "both"};
 
+matrix_type Shuffle::matrix() const {
+  matrix_type result(matrix_type::Zero(rows(), rows()));
+  for (index_type r = 0; r != rows(); ++r)
+    result(r, permutation[r]) = sign[r];
+  return result;
+}
+
 App::OptionGroup shuffle_options(const bool include_nonstationarity, const default_type default_skew) {
   using namespace App;
 
@@ -190,26 +197,16 @@ bool Shuffler::operator()(Shuffle &output) {
   if (counter >= nshuffles) {
     if (progress)
       progress.reset(nullptr);
-    output.data.resize(0, 0);
+    output.permutation.resize(0);
+    output.sign.resize(0);
     return false;
   }
+  output.permutation.resize(rows);
+  output.sign.resize(rows);
   // TESTME Think I need to adjust the signflips application based on the permutations
-  if (!permutations.empty()) {
-    output.data = matrix_type::Zero(rows, rows);
-    for (index_type i = 0; i != rows; ++i)
-      output.data(i, permutations[counter][i]) = 1.0;
-  } else {
-    output.data = matrix_type::Identity(rows, rows);
-  }
-  if (!signflips.empty()) {
-    for (index_type r = 0; r != rows; ++r) {
-      if (signflips[counter][r]) {
-        for (index_type c = 0; c != rows; ++c) {
-          if (output.data(r, c))
-            output.data(r, c) *= -1.0;
-        }
-      }
-    }
+  for (index_type r = 0; r != rows; ++r) {
+    output.permutation[r] = permutations.empty() ? r : permutations[counter][r];
+    output.sign[r] = (!signflips.empty() && signflips[counter][r]) ? -1.0 : 1.0;
   }
   ++counter;
   if (progress)
@@ -39,10 +39,39 @@ namespace MR::Math::Stats {
 extern std::vector<std::string> error_types;
 App::OptionGroup shuffle_options(const bool include_nonstationarity, const default_type default_skew = 1.0);
 
+// A single shuffle, stored as a signed permutation of the inputs:
+//   row r of the shuffled data is row permutation[r] of the original data,
+//   multiplied by sign[r] (either +1 or -1).
+// This is equivalent to pre-multiplying the data by a shuffling matrix
+//   with a single non-zero entry per row, but can be applied as a gather
+//   in O(rows) rather than O(rows^2) per column of data.
 class Shuffle {
 public:
+  Shuffle() : index(0) {}
+  // Identity shuffle (i.e. the default permutation)
+  explicit Shuffle(const index_type num_rows)
+      : index(0),
+        permutation(index_array_type::LinSpaced(num_rows, 0, num_rows - 1)),
+        sign(vector_type::Ones(num_rows)) {}
+
   index_type index;
-  matrix_type data;
+  index_array_type permutation;
+  vector_type sign;
+
+  index_type rows() const { return permutation.size(); }
+
+  // Explicit shuffling matrix equivalent to this shuffle
+  matrix_type matrix() const;
+
+  // Shuffle the rows of the input data
+  template <class InType, class OutType> void apply(const InType &in, OutType &out) const {
+    assert(index_type(in.rows()) == rows());
+    out.resize(in.rows(), in.cols());
+    for (ssize_t c = 0; c != in.cols(); ++c) {
+      for (index_type r = 0; r != rows(); ++r)
+        out(r, c) = sign[r] * in(permutation[r], c);
+    }
+  }
 };
 
 class Shuffler {
@@ -67,6 +67,20 @@ class Voxel2Vector {
     return temp.value();
   }
 
+  // Permute the order of the elements: entry i of order is the current
+  //   index of the element that is to be moved to index i
+  void reorder(const std::vector<index_t> &order) {
+    assert(order.size() == size());
+    std::vector<std::vector<index_t>> permuted;
+    permuted.reserve(size());
+    for (size_t i = 0; i != order.size(); ++i) {
+      permuted.push_back(std::move(reverse[order[i]]));
+      assign_pos_of(permuted.back()).to(forward);
+      forward.value() = i;
+    }
+    std::swap(reverse, permuted);
+  }
+
 private:
   Image<index_t> forward;
   std::vector<std::vector<index_t>> reverse;
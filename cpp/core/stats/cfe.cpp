@@ -16,6 +16,10 @@
 
 #include "stats/cfe.h"
 
+#include <limits>
+
+#include "progressbar.h"
+
 namespace MR::Stats {
 
 CFE::CFE(const Fixel::Matrix::Reader &connectivity_matrix,
@@ -23,16 +27,27 @@ CFE::CFE(const Fixel::Matrix::Reader &connectivity_matrix,
          const value_type E,
          const value_type H,
          const value_type C,
-         const bool norm)
-    : matrix(connectivity_matrix), dh(dh), E(E), H(H), C(C), normalise(norm) {}
+         const bool norm,
+         const bool quantise)
+    : dh(dh), E(E), H(H), C(C), normalise(norm) {
+  const size_t num_fixels = connectivity_matrix.size();
+  size_t max_connections = 0;
+  for (size_t fixel = 0; fixel != num_fixels; ++fixel)
+    max_connections += connectivity_matrix.size(fixel);
+  offsets.reserve(num_fixels + 1);
+  offsets.push_back(0);
+  fixels.reserve(max_connections);
+  if (quantise) {
+    quantised_values.reserve(max_connections);
+    scale_factors.reserve(num_fixels);
+  } else {
+    values.reserve(max_connections);
+  }
+  norm_multipliers.reserve(num_fixels);
 
-void CFE::operator()(in_column_type stats, out_column_type enhanced_stats) const {
-  enhanced_stats.setZero();
-  std::vector<default_type> connected_stats;
-  for (size_t fixel = 0; fixel < matrix.size(); ++fixel) {
-    if (stats[fixel] < dh)
-      continue;
-    auto connections = matrix[fixel];
+  ProgressBar progress("pre-loading fixel-fixel connectivity", num_fixels);
+  for (size_t fixel = 0; fixel != num_fixels; ++fixel) {
+    auto connections = connectivity_matrix[fixel];
     // Need to re-normalise based on the value of the power C
     if (C != 1.0) {
       default_type sum = 0.0;
@@ -42,31 +57,78 @@ void CFE::operator()(in_column_type stats, out_column_type enhanced_stats) const
       }
       connections.normalise(Fixel::Matrix::connectivity_value_type(sum));
     }
-    // Rather than allocating data for the stats and then looping over dh,
-    //   divide statistic by dh to determine the number of cluster sizes that should
+    norm_multipliers.push_back(connections.norm_multiplier);
+    for (const auto &c : connections)
+      fixels.push_back(c.index());
+    if (quantise) {
+      Fixel::Matrix::connectivity_value_type max_value(0);
+      for (const auto &c : connections)
+        max_value = std::max(max_value, c.value());
+      const value_type scale = value_type(max_value) / std::numeric_limits<uint16_t>::max();
+      scale_factors.push_back(scale);
+      for (const auto &c : connections)
+        quantised_values.push_back(scale ? uint16_t(std::round(c.value() / scale)) : 0);
+    } else {
+      for (const auto &c : connections)
+        values.push_back(c.value());
+    }
+    offsets.push_back(fixels.size());
+    ++progress;
+  }
+  INFO("Fixel-fixel connectivity loaded: " + str(fixels.size()) + " connections, occupying " +
+       str(bytes() / 1048576.0, 3) + " MB" + (quantise ? " (16-bit quantised)" : ""));
+}
+
+size_t CFE::bytes() const {
+  return offsets.size() * sizeof(size_t) + fixels.size() * sizeof(Fixel::Matrix::fixel_index_type) +
+         values.size() * sizeof(Fixel::Matrix::connectivity_value_type) + quantised_values.size() * sizeof(uint16_t) +
+         (scale_factors.size() + norm_multipliers.size()) * sizeof(value_type);
+}
+
+void CFE::operator()(in_column_type stats, out_column_type enhanced_stats) const {
+  if (quantised_values.size())
+    enhance(quantised_values.data(), stats, enhanced_stats);
+  else
+    enhance(values.data(), stats, enhanced_stats);
+}
+
+template <typename ValueType>
+void CFE::enhance(const ValueType *connectivity, in_column_type stats, out_column_type enhanced_stats) const {
+  enhanced_stats.setZero();
+  if (!stats.size() || !(stats.maxCoeff() >= dh))
+    return;
+  // Determine up-front, for every fixel, the number of cluster sizes to which it
+  //   contributes; any fixel with a statistic not exceeding dh contributes to none
+  std::vector<uint32_t> levels(stats.size());
+  for (ssize_t fixel = 0; fixel != stats.size(); ++fixel)
+    levels[fixel] = stats[fixel] > dh ? uint32_t(std::floor(stats[fixel] / dh)) : 0;
+  const size_t max_levels = std::floor(stats.maxCoeff() / dh);
+  // Pre-calculate h^H
+  std::vector<value_type> h_pow_H(max_levels);
+  for (size_t ih = 0; ih != max_levels; ++ih)
+    h_pow_H[ih] = std::pow(dh * (ih + 1), H);
+
+  std::vector<Fixel::Matrix::connectivity_value_type> extents(max_levels);
+  for (size_t fixel = 0; fixel < size_t(stats.size()); ++fixel) {
+    if (stats[fixel] < dh)
+      continue;
+    // Rather than looping over dh, determine the number of cluster sizes that should
     //   be incremented, and dynamically increment all cluster sizes for that
     //   particular connected fixel
-    std::vector<Fixel::Matrix::connectivity_value_type> extents(std::floor(stats[fixel] / dh),
-                                                                Fixel::Matrix::connectivity_value_type(0));
-    for (const auto &connection : connections) {
-      const default_type connection_stat = stats[connection.index()];
-      if (connection_stat > dh) {
-        const size_t cluster_count = std::min(extents.size(), size_t(std::floor(connection_stat / dh)));
-        for (size_t cluster_index = 0; cluster_index != cluster_count; ++cluster_index)
-          extents[cluster_index] += connection.value();
-      }
-    }
-    // Pre-calculate h^H
-    if (h_pow_H.size() < extents.size()) {
-      const size_t old_size = h_pow_H.size();
-      h_pow_H.resize(extents.size());
-      for (size_t ih = old_size; ih != h_pow_H.size(); ++ih)
-        h_pow_H[ih] = std::pow(dh * (ih + 1), H);
+    const size_t num_levels = std::floor(stats[fixel] / dh);
+    std::fill(extents.begin(), extents.begin() + num_levels, Fixel::Matrix::connectivity_value_type(0));
+    const value_type scale = scale_factors.empty() ? 1.0 : scale_factors[fixel];
+    for (size_t i = offsets[fixel]; i != offsets[fixel + 1]; ++i) {
+      const size_t cluster_count = std::min(num_levels, size_t(levels[fixels[i]]));
+      const Fixel::Matrix::connectivity_value_type value =
+          std::is_floating_point<ValueType>::value ? connectivity[i] : scale * connectivity[i];
+      for (size_t cluster_index = 0; cluster_index != cluster_count; ++cluster_index)
+        extents[cluster_index] += value;
     }
-    for (size_t cluster_index = 0; cluster_index != extents.size(); ++cluster_index)
+    for (size_t cluster_index = 0; cluster_index != num_levels; ++cluster_index)
       enhanced_stats[fixel] += std::pow(extents[cluster_index], E) * h_pow_H[cluster_index];
     if (normalise)
-      enhanced_stats[fixel] *= connections.norm_multiplier;
+      enhanced_stats[fixel] *= norm_multipliers[fixel];
   }
 }
 
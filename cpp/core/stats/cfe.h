@@ -29,22 +29,42 @@ using direction_type = Eigen::Matrix<value_type, 3, 1>;
 
 class CFE : public Stats::EnhancerBase {
 public:
+  // The fixel-fixel connectivity is loaded into RAM on construction;
+  //   if quantise is set, connectivity values are stored using 16 bits
+  //   (relative to the strongest connection of each fixel) rather than 32
   CFE(const Fixel::Matrix::Reader &connectivity_matrix,
       const value_type dh,
       const value_type E,
       const value_type H,
       const value_type C,
-      const bool norm);
+      const bool norm,
+      const bool quantise = false);
   virtual ~CFE() {}
 
+  // The memory occupied by the connectivity data, in bytes
+  size_t bytes() const;
+
 protected:
-  Fixel::Matrix::Reader matrix;
   const value_type dh, E, H, C;
   const bool normalise;
 
-  mutable std::vector<value_type> h_pow_H;
+  // Connectivity in compressed sparse row format: the connections of
+  //   fixel i occupy the range [offsets[i], offsets[i+1]) of fixels and of
+  //   either values or quantised_values. Values have already been raised
+  //   to the power C; quantised values must additionally be multiplied by
+  //   the scale factor of the fixel. The normalisation factor of each fixel
+  //   is stored separately, as the extent is raised to the power E before
+  //   it is applied.
+  std::vector<size_t> offsets;
+  std::vector<Fixel::Matrix::fixel_index_type> fixels;
+  std::vector<Fixel::Matrix::connectivity_value_type> values;
+  std::vector<uint16_t> quantised_values;
+  std::vector<value_type> scale_factors;
+  std::vector<value_type> norm_multipliers;
 
   void operator()(in_column_type, out_column_type) const override;
+
+  template <typename ValueType> void enhance(const ValueType *, in_column_type, out_column_type) const;
 };
 
 } // namespace MR::Stats
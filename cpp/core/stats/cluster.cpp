@@ -19,12 +19,32 @@
 namespace MR::Stats::Cluster {
 
 void ClusterSize::operator()(in_column_type input, const value_type T, out_column_type output) const {
-  std::vector<Filter::Connector::Cluster> clusters;
-  std::vector<uint32_t> labels(input.size(), 0);
-  connector.run(clusters, labels, input, T);
+  // Scratch storage is retained by each thread across invocations (i.e. across
+  //   permutations), so that no memory is allocated once it has grown to size
+  thread_local std::vector<Filter::Connector::Cluster> clusters;
+  thread_local std::vector<uint32_t> labels;
+  thread_local std::vector<Filter::Connector::Adjacency::index_t> queue;
+  connector.run(clusters, labels, queue, input, T);
   output.resize(input.size());
   for (size_t i = 0; i < size_t(input.size()); ++i)
     output[i] = labels[i] ? clusters[labels[i] - 1].size : 0.0;
 }
 
+bool ClusterSize::integrate(in_column_type input,
+                            const std::vector<value_type> &thresholds,
+                            const value_type E,
+                            const value_type H,
+                            out_column_type output) const {
+  TFCE::integrate_clusters(
+      input,
+      thresholds,
+      E,
+      H,
+      // Filter::Connector::run() compares against the threshold at single precision
+      [](const value_type value, const value_type T) { return value > float(T); },
+      [&](const uint32_t index) { return connector.adjacency[index]; },
+      output);
+  return true;
+}
+
 } // namespace MR::Stats::Cluster
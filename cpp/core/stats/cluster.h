@@ -43,6 +43,12 @@ class ClusterSize : public Stats::TFCE::EnhancerBase {
   void operator()(in_column_type in, out_column_type out) const override { (*this)(in, threshold, out); }
 
   void operator()(in_column_type, const value_type, out_column_type) const override;
+
+  bool integrate(in_column_type,
+                 const std::vector<value_type> &,
+                 const value_type,
+                 const value_type,
+                 out_column_type) const override;
 };
 //! @}
 
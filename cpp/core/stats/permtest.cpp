@@ -18,6 +18,36 @@
 
 namespace MR::Stats::PermTest {
 
+namespace {
+// Upper limit on the size of the statistics computed for each block of shuffles,
+//   which are held in full by each processing thread; the GLM itself processes
+//   each block in tiles of image elements sized to fit within cache
+constexpr size_t shuffle_block_bytes = 64 * 1024 * 1024;
+constexpr size_t max_shuffle_block_size = 64;
+} // namespace
+
+ShuffleBlockSource::ShuffleBlockSource(Math::Stats::Shuffler &shuffler,
+                                       const Math::Stats::GLM::TestBase &stats_calculator)
+    : shuffler(shuffler), num(1) {
+  // both the statistics and Z-statistics are stored for each shuffle
+  const size_t bytes_per_shuffle =
+      2 * size_t(stats_calculator.num_elements()) * size_t(stats_calculator.num_hypotheses()) * sizeof(value_type);
+  num = std::min(max_shuffle_block_size, shuffle_block_bytes / std::max(bytes_per_shuffle, size_t(1)));
+  // Retain enough blocks to keep all threads occupied
+  const size_t num_threads = std::max(Thread::threads_to_execute(), size_t(1));
+  num = std::max(std::min(num, size_t(shuffler.size()) / (4 * num_threads)), size_t(1));
+  DEBUG("Processing shuffles in blocks of " + str(num));
+}
+
+bool ShuffleBlockSource::operator()(std::vector<Math::Stats::Shuffle> &block) {
+  block.resize(num);
+  size_t count = 0;
+  while (count != num && shuffler(block[count]))
+    ++count;
+  block.resize(count);
+  return count;
+}
+
 PreProcessor::PreProcessor(const std::shared_ptr<Math::Stats::GLM::TestBase> stats_calculator,
                            const std::shared_ptr<EnhancerBase> enhancer,
                            const default_type skew,
@@ -30,7 +60,6 @@ PreProcessor::PreProcessor(const std::shared_ptr<Math::Stats::GLM::TestBase> sta
       global_enhanced_count(global_enhanced_count),
       enhanced_sum(matrix_type::Zero(stats_calculator->num_elements(), stats_calculator->num_hypotheses())),
       enhanced_count(count_matrix_type::Zero(stats_calculator->num_elements(), stats_calculator->num_hypotheses())),
-      stats(global_enhanced_sum.rows(), global_enhanced_sum.cols()),
       enhanced_stats(global_enhanced_sum.rows(), global_enhanced_sum.cols()),
       mutex(new std::mutex()) {
   assert(stats_calculator);
@@ -43,16 +72,18 @@ PreProcessor::~PreProcessor() {
   global_enhanced_count += enhanced_count;
 }
 
-bool PreProcessor::operator()(const Math::Stats::Shuffle &shuffle) {
-  if (!shuffle.data.rows())
+bool PreProcessor::operator()(const std::vector<Math::Stats::Shuffle> &shuffles) {
+  if (shuffles.empty())
     return false;
-  (*stats_calculator)(shuffle.data, stats);
-  (*enhancer)(stats, enhanced_stats);
-  for (size_t ih = 0; ih != stats_calculator->num_hypotheses(); ++ih) {
-    for (size_t ie = 0; ie != stats_calculator->num_elements(); ++ie) {
-      if (enhanced_stats(ie, ih) > 0.0) {
-        enhanced_sum(ie, ih) += std::pow(enhanced_stats(ie, ih), skew);
-        enhanced_count(ie, ih)++;
+  (*stats_calculator)(shuffles, stats);
+  for (const auto &shuffle_stats : stats) {
+    (*enhancer)(shuffle_stats, enhanced_stats);
+    for (size_t ih = 0; ih != stats_calculator->num_hypotheses(); ++ih) {
+      for (size_t ie = 0; ie != stats_calculator->num_elements(); ++ie) {
+        if (enhanced_stats(ie, ih) > 0.0) {
+          enhanced_sum(ie, ih) += std::pow(enhanced_stats(ie, ih), skew);
+          enhanced_count(ie, ih)++;
+        }
       }
     }
   }
@@ -70,7 +101,6 @@ Processor::Processor(const std::shared_ptr<Math::Stats::GLM::TestBase> stats_cal
       enhancer(enhancer),
       empirical_enhanced_statistics(empirical_enhanced_statistics),
       default_enhanced_statistics(default_enhanced_statistics),
-      statistics(stats_calculator->num_elements(), stats_calculator->num_hypotheses()),
       enhanced_statistics(stats_calculator->num_elements(), stats_calculator->num_hypotheses()),
       null_dist(perm_dist),
       global_null_dist_contributions(perm_dist_contributions),
@@ -89,32 +119,35 @@ Processor::~Processor() {
   global_null_dist_contributions += null_dist_contribution_counter;
 }
 
-bool Processor::operator()(const Math::Stats::Shuffle &shuffle) {
-  (*stats_calculator)(shuffle.data, statistics);
-  if (enhancer)
-    (*enhancer)(statistics, enhanced_statistics);
-  else
-    enhanced_statistics = statistics;
-
-  if (empirical_enhanced_statistics.size())
-    enhanced_statistics.array() /= empirical_enhanced_statistics.array();
-
-  if (null_dist.cols() == 1) { // strong fwe control
-    ssize_t max_element, max_hypothesis;
-    null_dist(shuffle.index, 0) = enhanced_statistics.maxCoeff(&max_element, &max_hypothesis);
-    null_dist_contribution_counter(max_element, max_hypothesis)++;
-  } else { // weak fwe control
-    ssize_t max_index;
-    for (ssize_t ih = 0; ih != enhanced_statistics.cols(); ++ih) {
-      null_dist(shuffle.index, ih) = enhanced_statistics.col(ih).maxCoeff(&max_index);
-      null_dist_contribution_counter(max_index, ih)++;
+bool Processor::operator()(const std::vector<Math::Stats::Shuffle> &shuffles) {
+  (*stats_calculator)(shuffles, statistics);
+  for (size_t k = 0; k != shuffles.size(); ++k) {
+    const Math::Stats::index_type index = shuffles[k].index;
+    if (enhancer)
+      (*enhancer)(statistics[k], enhanced_statistics);
+    else
+      enhanced_statistics = statistics[k];
+
+    if (empirical_enhanced_statistics.size())
+      enhanced_statistics.array() /= empirical_enhanced_statistics.array();
+
+    if (null_dist.cols() == 1) { // strong fwe control
+      ssize_t max_element, max_hypothesis;
+      null_dist(index, 0) = enhanced_statistics.maxCoeff(&max_element, &max_hypothesis);
+      null_dist_contribution_counter(max_element, max_hypothesis)++;
+    } else { // weak fwe control
+      ssize_t max_index;
+      for (ssize_t ih = 0; ih != enhanced_statistics.cols(); ++ih) {
+        null_dist(index, ih) = enhanced_statistics.col(ih).maxCoeff(&max_index);
+        null_dist_contribution_counter(max_index, ih)++;
+      }
     }
-  }
 
-  for (ssize_t ih = 0; ih != enhanced_statistics.cols(); ++ih) {
-    for (ssize_t ie = 0; ie != enhanced_statistics.rows(); ++ie) {
-      if (default_enhanced_statistics(ie, ih) > enhanced_statistics(ie, ih))
-        uncorrected_pvalue_counter(ie, ih)++;
+    for (ssize_t ih = 0; ih != enhanced_statistics.cols(); ++ih) {
+      for (ssize_t ie = 0; ie != enhanced_statistics.rows(); ++ie) {
+        if (default_enhanced_statistics(ie, ih) > enhanced_statistics(ie, ih))
+          uncorrected_pvalue_counter(ie, ih)++;
+      }
     }
   }
 
@@ -132,8 +165,9 @@ void precompute_empirical_stat(const std::shared_ptr<Math::Stats::GLM::TestBase>
   {
     Math::Stats::Shuffler shuffler(
         stats_calculator->num_inputs(), true, "Pre-computing empirical statistic for non-stationarity correction");
+    ShuffleBlockSource source(shuffler, *stats_calculator);
     PreProcessor preprocessor(stats_calculator, enhancer, skew, empirical_statistic, global_enhanced_count);
-    Thread::run_queue(shuffler, Math::Stats::Shuffle(), Thread::multi(preprocessor));
+    Thread::run_queue(source, std::vector<Math::Stats::Shuffle>(), Thread::multi(preprocessor));
   }
   for (size_t contrast = 0; contrast != stats_calculator->num_hypotheses(); ++contrast) {
     for (size_t ie = 0; ie != stats_calculator->num_elements(); ++ie) {
@@ -159,8 +193,7 @@ void precompute_default_permutation(const std::shared_ptr<Math::Stats::GLM::Test
   output_statistics.resize(stats_calculator->num_elements(), stats_calculator->num_hypotheses());
   output_zstats.resize(stats_calculator->num_elements(), stats_calculator->num_hypotheses());
   output_enhanced.resize(stats_calculator->num_elements(), stats_calculator->num_hypotheses());
-  const matrix_type default_shuffle(
-      matrix_type::Identity(stats_calculator->num_inputs(), stats_calculator->num_inputs()));
+  const Math::Stats::Shuffle default_shuffle(stats_calculator->num_inputs());
   ++progress;
 
   (*stats_calculator)(default_shuffle, output_statistics, output_zstats);
@@ -200,7 +233,8 @@ void run_permutations(const std::shared_ptr<Math::Stats::GLM::TestBase> stats_ca
                         null_dist,
                         null_dist_contributions,
                         global_uncorrected_pvalue_count);
-    Thread::run_queue(shuffler, Math::Stats::Shuffle(), Thread::multi(processor));
+    ShuffleBlockSource source(shuffler, *stats_calculator);
+    Thread::run_queue(source, std::vector<Math::Stats::Shuffle>(), Thread::multi(processor));
   }
   uncorrected_pvalues = global_uncorrected_pvalue_count.cast<default_type>() / default_type(shuffler.size());
 }
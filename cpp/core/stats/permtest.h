@@ -41,6 +41,24 @@ using vector_type = Math::Stats::vector_type;
 using matrix_type = Math::Stats::matrix_type;
 using count_matrix_type = Eigen::Array<uint32_t, Eigen::Dynamic, Eigen::Dynamic>;
 
+/*! A class to deliver shuffles to the processing threads in blocks
+ * This allows the GLM to be evaluated for multiple shuffles at once;
+ * the number of shuffles per block is limited by the memory required to
+ * hold the resulting statistics, while retaining enough blocks to keep all
+ * threads busy. */
+class ShuffleBlockSource {
+public:
+  ShuffleBlockSource(Math::Stats::Shuffler &shuffler, const Math::Stats::GLM::TestBase &stats_calculator);
+
+  bool operator()(std::vector<Math::Stats::Shuffle> &);
+
+  size_t block_size() const { return num; }
+
+protected:
+  Math::Stats::Shuffler &shuffler;
+  size_t num;
+};
+
 /*! A class to pre-compute the empirical enhanced statistic image for non-stationarity correction */
 class PreProcessor {
 public:
@@ -52,7 +70,7 @@ class PreProcessor {
 
   ~PreProcessor();
 
-  bool operator()(const Math::Stats::Shuffle &);
+  bool operator()(const std::vector<Math::Stats::Shuffle> &);
 
 protected:
   std::shared_ptr<Math::Stats::GLM::TestBase> stats_calculator;
@@ -62,7 +80,7 @@ class PreProcessor {
   count_matrix_type &global_enhanced_count;
   matrix_type enhanced_sum;
   count_matrix_type enhanced_count;
-  matrix_type stats;
+  std::vector<matrix_type> stats;
   matrix_type enhanced_stats;
   std::shared_ptr<std::mutex> mutex;
 };
@@ -80,14 +98,14 @@ class Processor {
 
   ~Processor();
 
-  bool operator()(const Math::Stats::Shuffle &);
+  bool operator()(const std::vector<Math::Stats::Shuffle> &);
 
 protected:
   std::shared_ptr<Math::Stats::GLM::TestBase> stats_calculator;
   std::shared_ptr<EnhancerBase> enhancer;
   const matrix_type &empirical_enhanced_statistics;
   const matrix_type &default_enhanced_statistics;
-  matrix_type statistics;
+  std::vector<matrix_type> statistics;
   matrix_type enhanced_statistics;
   matrix_type &null_dist;
   count_matrix_type &global_null_dist_contributions;
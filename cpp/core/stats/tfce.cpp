@@ -42,8 +42,14 @@ const OptionGroup Options(const default_type default_dh, const default_type defa
 void Wrapper::operator()(in_column_type in, out_column_type out) const {
   out.setZero();
   const value_type max_input_value = in.maxCoeff();
-  for (value_type h = dH; (h - dH) < max_input_value; h += dH) {
-    matrix_type temp(in.size(), 1);
+  std::vector<value_type> thresholds;
+  for (value_type h = dH; (h - dH) < max_input_value; h += dH)
+    thresholds.push_back(h);
+  // Single-pass integration relies on elements below threshold making no contribution
+  if (E > 0.0 && enhancer->integrate(in, thresholds, E, H, out))
+    return;
+  matrix_type temp(in.size(), 1);
+  for (const auto h : thresholds) {
     (*enhancer)(in, h, temp.col(0));
     const value_type h_multiplier = std::pow(h, H);
     for (size_t index = 0; index != size_t(in.size()); ++index)
@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include <algorithm>
+
 #include "filter/connected_components.h"
 #include "math/stats/typedefs.h"
 #include "thread_queue.h"
@@ -29,6 +31,106 @@ const App::OptionGroup Options(const default_type, const default_type, const def
 using value_type = Math::Stats::value_type;
 using matrix_type = Math::Stats::matrix_type;
 
+// Compute the TFCE integral in a single pass, for enhancers where the extent
+//   of each element at any threshold is the size of the cluster to which it belongs
+// Rather than repeating connected-component labelling at every threshold, elements
+//   are sorted by statistic once, and the thresholds are then swept from high to low,
+//   merging clusters using a union-find structure as elements exceed each threshold.
+//   The contribution of each cluster is only accumulated when its size changes
+//   (using a prefix sum of the height weights across thresholds), and is propagated
+//   to its constituent elements via offsets stored along the union-find hierarchy.
+// - active(value, threshold) determines whether a statistic value exceeds a threshold
+// - neighbours(index) provides the indices of the elements adjacent to an element
+template <class ActiveFunctor, class NeighbourFunctor>
+void integrate_clusters(matrix_type::ConstColXpr in,
+                        const std::vector<value_type> &thresholds,
+                        const value_type E,
+                        const value_type H,
+                        ActiveFunctor &&active,
+                        NeighbourFunctor &&neighbours,
+                        matrix_type::ColXpr out) {
+  const uint32_t num_elements = in.size();
+  constexpr uint32_t inactive = std::numeric_limits<uint32_t>::max();
+  out.setZero();
+  if (thresholds.empty())
+    return;
+
+  // weight_sums[j] is the sum of height weights for thresholds [0, j)
+  std::vector<value_type> weight_sums(thresholds.size() + 1, 0.0);
+  for (size_t j = 0; j != thresholds.size(); ++j)
+    weight_sums[j + 1] = weight_sums[j] + std::pow(thresholds[j], H);
+
+  // Only those elements exceeding the lowest threshold need to be considered
+  std::vector<uint32_t> order;
+  for (uint32_t index = 0; index != num_elements; ++index) {
+    if (active(in[index], thresholds.front()))
+      order.push_back(index);
+  }
+  std::sort(order.begin(), order.end(), [&](const uint32_t a, const uint32_t b) { return in[a] > in[b]; });
+
+  std::vector<uint32_t> parent(num_elements, inactive), size(num_elements, 0), since(num_elements, 0);
+  // For a cluster root, the integral accumulated by the cluster so far;
+  //   for any other element, the difference between its integral and that of its parent
+  std::vector<value_type> integral(num_elements, 0.0);
+  std::vector<uint32_t> path;
+
+  auto find = [&](const uint32_t index) {
+    uint32_t root = index;
+    path.clear();
+    while (parent[root] != root) {
+      path.push_back(root);
+      root = parent[root];
+    }
+    // Compress the path; the last element in the path is already a child of the root
+    for (ssize_t n = ssize_t(path.size()) - 2; n >= 0; --n) {
+      integral[path[n]] += integral[parent[path[n]]];
+      parent[path[n]] = root;
+    }
+    return root;
+  };
+
+  // Accumulate the contribution of a cluster across thresholds [first, since)
+  auto update = [&](const uint32_t root, const uint32_t first) {
+    integral[root] += std::pow(value_type(size[root]), E) * (weight_sums[since[root]] - weight_sums[first]);
+    since[root] = first;
+  };
+
+  size_t next = 0;
+  for (size_t j = thresholds.size(); j--;) {
+    for (; next != order.size() && active(in[order[next]], thresholds[j]); ++next) {
+      const uint32_t index = order[next];
+      parent[index] = index;
+      size[index] = 1;
+      since[index] = j + 1;
+      for (const auto n : neighbours(index)) {
+        if (parent[n] == inactive)
+          continue;
+        uint32_t a = find(index), b = find(n);
+        if (a == b)
+          continue;
+        update(a, j + 1);
+        update(b, j + 1);
+        if (size[a] < size[b])
+          std::swap(a, b);
+        parent[b] = a;
+        integral[b] -= integral[a];
+        size[a] += size[b];
+      }
+    }
+  }
+
+  for (uint32_t index = 0; index != num_elements; ++index) {
+    if (parent[index] == index)
+      update(index, 0);
+  }
+  for (uint32_t index = 0; index != num_elements; ++index) {
+    if (parent[index] != inactive) {
+      const uint32_t root = find(index);
+      out[index] = index == root ? integral[root] : integral[index] + integral[root];
+    }
+  }
+}
+
 class EnhancerBase : public Stats::EnhancerBase {
 public:
   virtual ~EnhancerBase() {}
@@ -39,6 +141,16 @@ class EnhancerBase : public Stats::EnhancerBase {
   virtual void operator()(in_column_type /*input_statistics*/,
                           const value_type /*threshold*/,
                           out_column_type /*enhanced_statistics*/) const = 0;
+  // Compute the TFCE integral across all thresholds in a single pass, if supported
+  //   by the enhancer (e.g. using integrate_clusters()); if this returns false,
+  //   the enhancer is instead invoked separately for each threshold
+  virtual bool integrate(in_column_type /*input_statistics*/,
+                         const std::vector<value_type> & /*thresholds*/,
+                         const value_type /*E*/,
+                         const value_type /*H*/,
+                         out_column_type /*enhanced_statistics*/) const {
+    return false;
+  }
   // While we don't use this function, it reassures the compiler that we are not accidentally
   //   hiding the virutal function of the base class using the function above
   using Stats::EnhancerBase::operator();
@@ -74,6 +74,23 @@ nthreads_t type_nthreads() { return __nthreads_type; }
 
 size_t threads_to_execute() { return (__Backend::valid() ? 0 : number_of_threads()); }
 
+bool lock_free_queues() {
+#ifdef MRTRIX_QUEUE_LOCK_FREE
+  constexpr bool default_lock_free = true;
+#else
+  constexpr bool default_lock_free = false;
+#endif
+  // CONF option: ThreadQueueLockFree
+  // CONF default: 0 (false), unless compiled with MRTRIX_QUEUE_LOCK_FREE
+  // CONF A boolean value to indicate whether the queues used to pass data
+  // CONF between threads in multi-threaded pipelines (e.g. tckgen, tckmap,
+  // CONF tcksift) should use a lock-free ring buffer, rather than a single
+  // CONF mutex per queue. This can reduce contention when running with
+  // CONF large numbers of threads.
+  static const bool lock_free = File::Config::get_bool("ThreadQueueLockFree", default_lock_free);
+  return lock_free;
+}
+
 void (*__Backend::previous_print_func)(const std::string &msg) = nullptr;
 void (*__Backend::previous_report_to_user_func)(const std::string &msg, int type) = nullptr;
 
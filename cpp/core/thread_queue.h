@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <condition_variable>
 #include <stack>
 
@@ -25,6 +26,8 @@
 
 #define MRTRIX_QUEUE_DEFAULT_CAPACITY 128
 #define MRTRIX_QUEUE_DEFAULT_BATCH_SIZE 128
+#define MRTRIX_QUEUE_SPIN_COUNT 64
+#define MRTRIX_QUEUE_CACHE_LINE_SIZE 64
 
 namespace MR::Thread {
 
@@ -52,10 +55,92 @@ template <class X> class __job<__Multi<X>> {
   }
 };
 
+// bounded multi-producer multi-consumer ring buffer of pointers, using a
+// sequence number per slot to hand over ownership of each slot without
+// locking (after D. Vyukov's bounded MPMC queue). The read and write
+// positions are kept on separate cache lines to avoid false sharing
+// between producers and consumers.
+template <class T> class __RingBuffer {
+public:
+  __RingBuffer(size_t size) : slots(new Slot[size]), capacity(size), write_pos(0), read_pos(0) {
+    for (size_t n = 0; n < capacity; ++n)
+      slots[n].sequence.store(n, std::memory_order_relaxed);
+  }
+
+  bool push(T *item) {
+    size_t pos = write_pos.load(std::memory_order_relaxed);
+    while (true) {
+      Slot &slot = slots[pos % capacity];
+      const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+      const ssize_t diff = ssize_t(sequence) - ssize_t(pos);
+      if (diff == 0) {
+        if (write_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          slot.item = item;
+          slot.sequence.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = write_pos.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool pop(T *&item) {
+    size_t pos = read_pos.load(std::memory_order_relaxed);
+    while (true) {
+      Slot &slot = slots[pos % capacity];
+      const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+      const ssize_t diff = ssize_t(sequence) - ssize_t(pos + 1);
+      if (diff == 0) {
+        if (read_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          item = slot.item;
+          slot.sequence.store(pos + capacity, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = read_pos.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // these may report spurious availability if another thread got there
+  // first, but will never miss a slot made available before the call:
+  bool can_push() const {
+    const size_t pos = write_pos.load();
+    return ssize_t(slots[pos % capacity].sequence.load()) - ssize_t(pos) >= 0;
+  }
+  bool can_pop() const {
+    const size_t pos = read_pos.load();
+    return ssize_t(slots[pos % capacity].sequence.load()) - ssize_t(pos + 1) >= 0;
+  }
+
+  size_t size() const { return write_pos.load() - read_pos.load(); }
+
+private:
+  struct Slot {
+    std::atomic<size_t> sequence;
+    T *item;
+  };
+  std::unique_ptr<Slot[]> slots;
+  const size_t capacity;
+  alignas(MRTRIX_QUEUE_CACHE_LINE_SIZE) std::atomic<size_t> write_pos;
+  alignas(MRTRIX_QUEUE_CACHE_LINE_SIZE) std::atomic<size_t> read_pos;
+};
+
 } // namespace
 
 //! \endcond
 
+//! whether Thread::Queue objects use the lock-free backend by default
+/*! This is determined by the ThreadQueueLockFree config file option, or if
+ * not set, by whether MRtrix3 was compiled with MRTRIX_QUEUE_LOCK_FREE
+ * defined. */
+bool lock_free_queues();
+
 /** \addtogroup thread_classes
  * @{ */
 
@@ -321,16 +406,31 @@ template <class T> class Queue {
    * queue already contains this number of items, the thread will block until
    * at least one item has been popped.  By default, the buffer size is
    * MRTRIX_QUEUE_DEFAULT_CAPACITY items.
+   * \param use_lock_free whether to use the lock-free backend (see
+   * lock_free_queues()). Rather than serialising every push and pop on a
+   * single mutex, this uses a ring buffer that threads can push to and
+   * pop from concurrently, spinning briefly when the queue is full (or
+   * empty) before blocking. This reduces contention when many threads
+   * exchange small items through the same queue.
    */
-  Queue(const std::string &description = "unnamed", size_t buffer_size = MRTRIX_QUEUE_DEFAULT_CAPACITY)
+  Queue(const std::string &description = "unnamed",
+        size_t buffer_size = MRTRIX_QUEUE_DEFAULT_CAPACITY,
+        bool use_lock_free = lock_free_queues())
       : buffer(new T *[buffer_size]),
         front(buffer),
         back(buffer),
         capacity(buffer_size),
+        lock_free(use_lock_free),
         writer_count(0),
         reader_count(0),
+        waiting_writers(0),
+        waiting_readers(0),
         name(description) {
     assert(capacity > 0);
+    if (lock_free) {
+      ring.reset(new __RingBuffer<T>(capacity));
+      spare.reset(new __RingBuffer<T>(2 * capacity));
+    }
   }
 
   Queue(const Queue &) = delete;
@@ -468,7 +568,7 @@ template <class T> class Queue {
     std::lock_guard<std::mutex> lock(mutex);
     std::cerr << "Thread::Queue \"" + name + "\": " << writer_count << " writer" << (writer_count > 1 ? "s" : "")
               << ", " << reader_count << " reader" << (reader_count > 1 ? "s" : "") << ", items waiting: " << size()
-              << "\n";
+              << (lock_free ? " (lock-free)" : "") << "\n";
   }
 
 private:
@@ -478,7 +578,10 @@ template <class T> class Queue {
   T **front;
   T **back;
   size_t capacity;
-  size_t writer_count, reader_count;
+  const bool lock_free;
+  std::unique_ptr<__RingBuffer<T>> ring, spare;
+  std::atomic<size_t> writer_count, reader_count;
+  std::atomic<size_t> waiting_writers, waiting_readers;
   std::stack<T *, std::vector<T *>> item_stack;
   std::vector<std::unique_ptr<T>> items;
   std::string name;
@@ -512,7 +615,9 @@ template <class T> class Queue {
 
   FORCE_INLINE bool empty() const { return (front == back); }
   FORCE_INLINE bool full() const { return (inc(back) == front); }
-  FORCE_INLINE size_t size() const { return ((back < front ? back + capacity : back) - front); }
+  FORCE_INLINE size_t size() const {
+    return lock_free ? ring->size() : ((back < front ? back + capacity : back) - front);
+  }
 
   FORCE_INLINE T *get_item() {
     std::lock_guard<std::mutex> lock(mutex);
@@ -521,7 +626,11 @@ template <class T> class Queue {
     return item;
   }
 
-  FORCE_INLINE bool push(T *&item) {
+  FORCE_INLINE bool push(T *&item) { return lock_free ? push_lock_free(item) : push_locked(item); }
+  FORCE_INLINE bool pop(T *&item) { return lock_free ? pop_lock_free(item) : pop_locked(item); }
+  FORCE_INLINE void recycle(T *&item) { return lock_free ? recycle_lock_free(item) : recycle_locked(item); }
+
+  bool push_locked(T *&item) {
     std::unique_lock<std::mutex> lock(mutex);
     more_space.wait(lock, [this] { return !(full() && reader_count); });
     if (!reader_count)
@@ -539,7 +648,7 @@ template <class T> class Queue {
     return true;
   }
 
-  FORCE_INLINE bool pop(T *&item) {
+  bool pop_locked(T *&item) {
     std::unique_lock<std::mutex> lock(mutex);
     if (item)
       item_stack.push(item);
@@ -553,12 +662,88 @@ template <class T> class Queue {
     return true;
   }
 
-  FORCE_INLINE void recycle(T *&item) {
+  void recycle_locked(T *&item) {
     std::unique_lock<std::mutex> lock(mutex);
     if (item)
       item_stack.push(item);
   }
 
+  // The lock-free backend only takes the mutex to block when there is
+  // nothing to do after spinning for a while, or to wake up threads that
+  // have done so. The waiting_* counters are incremented before checking
+  // the state of the queue, and read after modifying it, with sequentially
+  // consistent ordering on both sides, so that either the waiting thread
+  // sees the change, or the other thread sees that it needs waking.
+
+  bool push_lock_free(T *&item) {
+    if (!reader_count)
+      return false;
+    for (size_t n = 0; !ring->push(item); ++n) {
+      if (!reader_count)
+        return false;
+      if (n < MRTRIX_QUEUE_SPIN_COUNT) {
+        std::this_thread::yield();
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(mutex);
+      ++waiting_writers;
+      more_space.wait(lock, [this] { return ring->can_push() || !reader_count; });
+      --waiting_writers;
+    }
+    wake(waiting_readers, more_data);
+    item = get_spare_item();
+    return true;
+  }
+
+  bool pop_lock_free(T *&item) {
+    recycle_lock_free(item);
+    for (size_t n = 0; !ring->pop(item); ++n) {
+      if (!writer_count) // the last writer may have pushed just before unregistering
+        return ring->pop(item);
+      if (n < MRTRIX_QUEUE_SPIN_COUNT) {
+        std::this_thread::yield();
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(mutex);
+      ++waiting_readers;
+      more_data.wait(lock, [this] { return ring->can_pop() || !writer_count; });
+      --waiting_readers;
+    }
+    wake(waiting_writers, more_space);
+    return true;
+  }
+
+  void recycle_lock_free(T *&item) {
+    if (item && !spare->push(item)) {
+      std::lock_guard<std::mutex> lock(mutex);
+      item_stack.push(item);
+    }
+    item = nullptr;
+  }
+
+  T *get_spare_item() {
+    T *item;
+    if (spare->pop(item))
+      return item;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (item_stack.empty()) {
+      item = new T;
+      items.push_back(std::unique_ptr<T>(item));
+    } else {
+      item = item_stack.top();
+      item_stack.pop();
+    }
+    return item;
+  }
+
+  void wake(const std::atomic<size_t> &waiting, std::condition_variable &condition) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiting.load(std::memory_order_relaxed)) {
+      std::lock_guard<std::mutex> lock(mutex);
+      condition.notify_one();
+    }
+  }
+
   FORCE_INLINE T **inc(T **p) const {
     ++p;
     if (p >= buffer + capacity)
@@ -0,0 +1,192 @@
+/* Copyright (c) 2008-2024 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include <random>
+
+#include "command.h"
+#include "file/utils.h"
+#include "fixel/matrix.h"
+#include "math/stats/typedefs.h"
+#include "timer.h"
+
+#include "stats/cfe.h"
+
+using namespace MR;
+using namespace App;
+using Math::Stats::matrix_type;
+using Math::Stats::value_type;
+
+// clang-format off
+void usage() {
+  AUTHOR = "MRtrix3 contributors";
+
+  SYNOPSIS = "Measure the memory usage and speed of connectivity-based fixel enhancement";
+
+  DESCRIPTION
+  + "Random fixel statistics, smoothed using the fixel-fixel connectivity, are enhanced using "
+    "CFE with the connectivity held in RAM at both 32-bit and 16-bit precision, and by "
+    "reading the connectivity of each fixel from the matrix on file as it is required. "
+    "The time taken per permutation (i.e. per enhanced statistic vector) is reported for "
+    "each, along with the maximal difference in the enhanced statistics relative to the "
+    "latter."
+    " If no connectivity matrix is provided, one is generated in a temporary directory from "
+    "random walks through a cubic lattice of fixels.";
+
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+
+  OPTIONS
+  + Option ("matrix", "the fixel-fixel connectivity matrix directory to use.")
+    + Argument ("path").type_directory_in()
+
+  + Option ("size", "the number of fixels along each axis of the lattice, "
+                    "if no connectivity matrix is provided (default: 32).")
+    + Argument ("number").type_integer(4)
+
+  + Option ("repeat", "the number of times to repeat each measurement (default: 3).")
+    + Argument ("number").type_integer(1);
+
+}
+// clang-format on
+
+constexpr value_type dh = 0.1, E = 2.0, H = 3.0, C = 0.5;
+
+// Enhancement reading the connectivity from file, as required, for each fixel
+void reference(const Fixel::Matrix::Reader &matrix, const matrix_type &stats, matrix_type &enhanced_stats) {
+  enhanced_stats.setZero();
+  std::vector<value_type> h_pow_H;
+  for (size_t fixel = 0; fixel < matrix.size(); ++fixel) {
+    if (stats(fixel, 0) < dh)
+      continue;
+    auto connections = matrix[fixel];
+    default_type sum = 0.0;
+    for (auto &c : connections) {
+      c.exponentiate(C);
+      sum += c.value();
+    }
+    connections.normalise(Fixel::Matrix::connectivity_value_type(sum));
+    std::vector<Fixel::Matrix::connectivity_value_type> extents(std::floor(stats(fixel, 0) / dh),
+                                                                Fixel::Matrix::connectivity_value_type(0));
+    for (const auto &connection : connections) {
+      const default_type connection_stat = stats(connection.index(), 0);
+      if (connection_stat > dh) {
+        const size_t cluster_count = std::min(extents.size(), size_t(std::floor(connection_stat / dh)));
+        for (size_t cluster_index = 0; cluster_index != cluster_count; ++cluster_index)
+          extents[cluster_index] += connection.value();
+      }
+    }
+    if (h_pow_H.size() < extents.size()) {
+      const size_t old_size = h_pow_H.size();
+      h_pow_H.resize(extents.size());
+      for (size_t ih = old_size; ih != h_pow_H.size(); ++ih)
+        h_pow_H[ih] = std::pow(dh * (ih + 1), H);
+    }
+    for (size_t cluster_index = 0; cluster_index != extents.size(); ++cluster_index)
+      enhanced_stats(fixel, 0) += std::pow(extents[cluster_index], E) * h_pow_H[cluster_index];
+    enhanced_stats(fixel, 0) *= connections.norm_multiplier;
+  }
+}
+
+// Streamlines as random walks through a lattice of fixels, each fixel
+//   being connected to all others traversed by the same streamline
+std::string generate(const size_t size) {
+  std::mt19937 rng(0);
+  std::uniform_int_distribution<int> step(-1, 1);
+  std::uniform_int_distribution<size_t> start(0, size - 1);
+  const size_t num_fixels = size * size * size;
+  Fixel::Matrix::InitMatrixUnweighted matrix(num_fixels);
+  for (size_t n = 0; n != 4 * num_fixels; ++n) {
+    std::array<int, 3> pos{int(start(rng)), int(start(rng)), int(start(rng))};
+    Fixel::Matrix::MappedTrack track;
+    for (size_t length = 0; length != 40; ++length) {
+      track.push_back((pos[2] * size + pos[1]) * size + pos[0]);
+      for (auto &p : pos)
+        p = std::min(std::max(p + step(rng), 0), int(size) - 1);
+    }
+    std::sort(track.begin(), track.end());
+    track.erase(std::unique(track.begin(), track.end()), track.end());
+    for (const auto fixel : track)
+      matrix[fixel].add(track);
+  }
+  std::string path = File::create_tempfile(0, "dir");
+  File::remove(path);
+  Fixel::Matrix::Writer<Fixel::Matrix::InitMatrixUnweighted>(matrix, 0.01).save(path);
+  return path;
+}
+
+void run() {
+  const size_t repeats = get_option_value("repeat", 3);
+  auto opt = get_options("matrix");
+  const std::string path = opt.empty() ? generate(get_option_value("size", 32)) : std::string(opt[0][0]);
+
+  try {
+    const Fixel::Matrix::Reader matrix(path);
+    const size_t num_fixels = matrix.size();
+    size_t num_connections = 0;
+    for (size_t fixel = 0; fixel != num_fixels; ++fixel)
+      num_connections += matrix.size(fixel);
+
+    // Random noise, smoothed using the connectivity
+    std::mt19937 rng(0);
+    std::normal_distribution<value_type> normal;
+    const matrix_type noise = matrix_type::NullaryExpr(num_fixels, 1, [&]() { return normal(rng); });
+    matrix_type stats(num_fixels, 1);
+    for (size_t fixel = 0; fixel != num_fixels; ++fixel) {
+      const auto connections = matrix[fixel];
+      value_type sum = 0.0;
+      for (const auto &c : connections)
+        sum += c.value() * noise(c.index(), 0);
+      stats(fixel, 0) = 1.0 + 4.0 * sum * connections.norm_multiplier;
+    }
+
+    auto time = [&](auto &&functor, matrix_type &output) {
+      double best = std::numeric_limits<double>::infinity();
+      for (size_t r = 0; r != repeats; ++r) {
+        Timer timer;
+        functor(output);
+        best = std::min(best, timer.elapsed());
+      }
+      return 1e3 * best;
+    };
+
+    matrix_type expected(num_fixels, 1), result32(num_fixels, 1), result16(num_fixels, 1);
+    const double time_file = time([&](matrix_type &output) { reference(matrix, stats, output); }, expected);
+    const Stats::CFE cfe32(matrix, dh, E, H, C, true, false);
+    const double time32 =
+        time([&](matrix_type &output) { static_cast<const Stats::EnhancerBase &>(cfe32)(stats, output); }, result32);
+    const Stats::CFE cfe16(matrix, dh, E, H, C, true, true);
+    const double time16 =
+        time([&](matrix_type &output) { static_cast<const Stats::EnhancerBase &>(cfe16)(stats, output); }, result16);
+
+    auto max_rel_diff = [&](const matrix_type &result) {
+      return ((result - expected).array().abs() / expected.array().abs().max(1e-12)).maxCoeff();
+    };
+
+    std::cout << "fixels\tconnections\tmax level\n";
+    std::cout << num_fixels << "\t" << num_connections << "\t" << size_t(std::floor(stats.maxCoeff() / dh)) << "\n\n";
+    std::cout << "connectivity\tRAM (MB)\ttime (ms per permutation)\tmax rel. diff\n";
+    std::cout << "file\t-\t" << str(time_file, 4) << "\t-\n";
+    std::cout << "32-bit\t" << str(cfe32.bytes() / 1048576.0, 4) << "\t" << str(time32, 4) << "\t"
+              << str(max_rel_diff(result32), 3) << "\n";
+    std::cout << "16-bit\t" << str(cfe16.bytes() / 1048576.0, 4) << "\t" << str(time16, 4) << "\t"
+              << str(max_rel_diff(result16), 3) << "\n";
+  } catch (...) {
+    if (opt.empty())
+      File::rmdir(path, true);
+    throw;
+  }
+  if (opt.empty())
+    File::rmdir(path, true);
+}
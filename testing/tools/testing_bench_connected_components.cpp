@@ -0,0 +1,163 @@
+/* Copyright (c) 2008-2024 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include <random>
+
+#include "command.h"
+#include "header.h"
+#include "timer.h"
+
+#include "filter/connected_components.h"
+#include "math/stats/typedefs.h"
+#include "misc/voxel2vector.h"
+
+using namespace MR;
+using namespace App;
+using Math::Stats::matrix_type;
+using Math::Stats::value_type;
+
+// clang-format off
+void usage() {
+  AUTHOR = "MRtrix3 contributors";
+
+  SYNOPSIS = "Measure the memory usage and throughput of connected-component labelling";
+
+  DESCRIPTION
+  + "A spherical mask is defined within a cubic voxel grid, and the adjacency of the voxels "
+    "within it is computed. Spatially smooth random data within the mask are then labelled "
+    "repeatedly at a fixed threshold, both in the order in which voxels are stored in the image "
+    "and following reverse Cuthill-McKee reordering. Reported are the memory occupied by the "
+    "compressed adjacency data (along with an estimate of that required to store a separately "
+    "allocated list of neighbours per voxel), the adjacency bandwidth, and the labelling "
+    "throughput in millions of voxels per second.";
+
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+
+  OPTIONS
+  + Option ("size", "the number of voxels along each axis of the grid (default: 96).")
+    + Argument ("number").type_integer(3)
+
+  + Option ("threshold", "the cluster-forming threshold (default: 1.0).")
+    + Argument ("value").type_float()
+
+  + Option ("connectivity", "use 26-nearest-neighbour connectivity rather than 6")
+
+  + Option ("repeat", "the number of times to repeat each measurement (default: 10).")
+    + Argument ("number").type_integer(1);
+
+}
+// clang-format on
+
+void run() {
+  const size_t size = get_option_value("size", 96);
+  const float threshold = get_option_value("threshold", 1.0);
+  const size_t repeats = get_option_value("repeat", 10);
+
+  Header header;
+  header.ndim() = 3;
+  for (size_t axis = 0; axis != 3; ++axis) {
+    header.size(axis) = size;
+    header.spacing(axis) = 1.0;
+    header.stride(axis) = axis + 1;
+  }
+  header.transform().setIdentity();
+  header.datatype() = DataType::Bit;
+  auto mask = Image<bool>::scratch(header, "spherical mask");
+  const default_type centre = 0.5 * (size - 1), radius = 0.5 * size;
+  for (auto l = Loop(mask)(mask); l; ++l)
+    mask.value() = Math::pow2(mask.index(0) - centre) + Math::pow2(mask.index(1) - centre) +
+                       Math::pow2(mask.index(2) - centre) <=
+                   Math::pow2(radius);
+  Voxel2Vector v2v(mask, header);
+  const size_t num_voxels = v2v.size();
+
+  Filter::Connector connector;
+  connector.adjacency.set_26_adjacency(!get_options("connectivity").empty());
+  Timer timer;
+  connector.adjacency.initialise(header, v2v);
+  const double initialise_time = timer.elapsed();
+
+  size_t num_neighbours = 0;
+  // glibc malloc: 8 bytes of overhead per allocation, 16-byte granularity, minimum 32 bytes
+  size_t nested_bytes = num_voxels * sizeof(std::vector<Filter::Connector::Adjacency::index_t>);
+  for (size_t i = 0; i != num_voxels; ++i) {
+    const size_t count = connector.adjacency[i].size();
+    num_neighbours += count;
+    if (count)
+      nested_bytes +=
+          std::max(size_t(32), (count * sizeof(Filter::Connector::Adjacency::index_t) + 8 + 15) & ~size_t(15));
+  }
+
+  // Box-filtered Gaussian noise
+  std::mt19937 rng(0);
+  std::normal_distribution<value_type> normal;
+  const matrix_type noise = matrix_type::NullaryExpr(num_voxels, 1, [&]() { return normal(rng); });
+  matrix_type data(matrix_type::Zero(num_voxels, 1));
+  for (size_t i = 0; i != num_voxels; ++i) {
+    const auto &pos = v2v[i];
+    size_t count = 0;
+    for (int dx = -1; dx <= 1; ++dx) {
+      for (int dy = -1; dy <= 1; ++dy) {
+        for (int dz = -1; dz <= 1; ++dz) {
+          const auto j = v2v(std::vector<int>{int(pos[0]) + dx, int(pos[1]) + dy, int(pos[2]) + dz});
+          if (j != Voxel2Vector::invalid) {
+            data(i, 0) += noise(j, 0);
+            ++count;
+          }
+        }
+      }
+    }
+    data(i, 0) *= 4.0 / std::sqrt(value_type(count));
+  }
+
+  std::vector<Filter::Connector::Cluster> clusters;
+  std::vector<uint32_t> labels;
+  std::vector<Filter::Connector::Adjacency::index_t> queue;
+  auto throughput = [&](const matrix_type &values) {
+    double best = std::numeric_limits<double>::infinity();
+    for (size_t r = 0; r != repeats; ++r) {
+      timer.start();
+      connector.run(clusters, labels, queue, values.col(0), threshold);
+      best = std::min(best, timer.elapsed());
+    }
+    return 1e-6 * num_voxels / best;
+  };
+
+  const size_t raster_bandwidth = connector.adjacency.bandwidth();
+  const double raster_throughput = throughput(data);
+  const size_t num_clusters = clusters.size();
+
+  timer.start();
+  const auto order = connector.adjacency.reverse_cuthill_mckee();
+  v2v.reorder(order);
+  connector.adjacency.reorder(order);
+  const double reorder_time = timer.elapsed();
+  matrix_type reordered_data(num_voxels, 1);
+  for (size_t i = 0; i != num_voxels; ++i)
+    reordered_data(i, 0) = data(order[i], 0);
+  const size_t reordered_bandwidth = connector.adjacency.bandwidth();
+  const double reordered_throughput = throughput(reordered_data);
+  if (clusters.size() != num_clusters)
+    throw Exception("number of clusters differs following reordering");
+
+  std::cout << "voxels\tneighbours\tclusters\tinitialise (ms)\treorder (ms)\tCSR (MB)\tnested (MB, est.)\n";
+  std::cout << num_voxels << "\t" << num_neighbours << "\t" << num_clusters << "\t" << str(1e3 * initialise_time, 4)
+            << "\t" << str(1e3 * reorder_time, 4) << "\t" << str(connector.adjacency.bytes() / 1048576.0, 4) << "\t"
+            << str(nested_bytes / 1048576.0, 4) << "\n\n";
+  std::cout << "order\tbandwidth\tthroughput (Mvoxels/s)\n";
+  std::cout << "raster\t" << raster_bandwidth << "\t" << str(raster_throughput, 4) << "\n";
+  std::cout << "RCM\t" << reordered_bandwidth << "\t" << str(reordered_throughput, 4) << "\n";
+}
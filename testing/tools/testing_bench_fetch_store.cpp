@@ -0,0 +1,129 @@
+/* Copyright (c) 2008-2024 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "command.h"
+#include "datatype.h"
+#include "fetch_store.h"
+#include "timer.h"
+
+using namespace MR;
+using namespace App;
+
+const std::vector<std::string> type_choices = {"uint8", "int16", "int32", "float32", "float64"};
+
+// clang-format off
+void usage() {
+  AUTHOR = "MRtrix3 contributors";
+
+  SYNOPSIS = "Compare the throughput of per-voxel and bulk conversion of image data between on-disk and in-RAM types";
+
+  DESCRIPTION
+  + "For each on-disk data type, the time taken to fetch and store a contiguous run of values "
+    "into a buffer of the requested type is reported, using either one function call per voxel "
+    "(as for random access), or a single call for the whole run (as used when copying whole rows).";
+
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+
+  OPTIONS
+  + Option ("type", "the in-RAM data type (default: float32); one of: " + join(type_choices, ", ") + ".")
+    + Argument ("name").type_choice(type_choices)
+
+  + Option ("size", "the number of values to convert (default: 16777216).")
+    + Argument ("number").type_integer(1)
+
+  + Option ("repeat", "the number of times to repeat each measurement (default: 3).")
+    + Argument ("number").type_integer(1);
+
+}
+// clang-format on
+
+const std::vector<DataType> datatypes = {
+    DataType::Bit,        DataType::Int8,       DataType::UInt8,     DataType::Int16LE,   DataType::Int16BE,
+    DataType::Int32LE,    DataType::Int32BE,    DataType::Int64LE,   DataType::Int64BE,   DataType::Float16LE,
+    DataType::Float16BE,  DataType::Float32LE,  DataType::Float32BE, DataType::Float64LE, DataType::Float64BE,
+    DataType::CFloat32LE, DataType::CFloat32BE, DataType::CFloat64LE, DataType::CFloat64BE};
+
+template <class Functor> double best_of(size_t repeats, Functor &&functor) {
+  double best = std::numeric_limits<double>::infinity();
+  for (size_t r = 0; r < repeats; ++r) {
+    Timer timer;
+    functor();
+    best = std::min(best, timer.elapsed());
+  }
+  return best;
+}
+
+template <typename ValueType>
+void run_benchmark(size_t size, size_t repeats, const default_type offset, const default_type scale) {
+  std::vector<ValueType> values(size);
+  for (size_t n = 0; n < size; ++n)
+    values[n] = ValueType(n % 100);
+
+  std::cout << "disk type\tper-voxel fetch\tbulk fetch\tper-voxel store\tbulk store\t(millions of values/s)\n";
+  for (const auto datatype : datatypes) {
+    std::vector<uint8_t> data((size * datatype.bits() + 7) / 8);
+
+    FetchScaleFunction<ValueType> fetch_func;
+    StoreScaleFunction<ValueType> store_func;
+    FetchScaleSpanFunction<ValueType> fetch_span_func;
+    StoreScaleSpanFunction<ValueType> store_span_func;
+    __set_fetch_store_scale_functions(fetch_func, store_func, datatype);
+    __set_fetch_store_scale_span_functions(fetch_span_func, store_span_func, datatype);
+
+    const double store_time = best_of(repeats, [&]() {
+      for (size_t n = 0; n < size; ++n)
+        store_func(values[n], data.data(), n, offset, scale);
+    });
+    const double store_span_time =
+        best_of(repeats, [&]() { store_span_func(values.data(), data.data(), 0, size, offset, scale); });
+    const double fetch_time = best_of(repeats, [&]() {
+      for (size_t n = 0; n < size; ++n)
+        values[n] = fetch_func(data.data(), n, offset, scale);
+    });
+    const double fetch_span_time =
+        best_of(repeats, [&]() { fetch_span_func(values.data(), data.data(), 0, size, offset, scale); });
+
+    auto rate = [&](double time) { return str(size / (1.0e6 * time), 4); };
+    std::cout << datatype.specifier() << "\t" << rate(fetch_time) << "\t" << rate(fetch_span_time) << "\t"
+              << rate(store_time) << "\t" << rate(store_span_time) << "\n";
+  }
+}
+
+void run() {
+  const size_t size = get_option_value("size", 16777216);
+  const size_t repeats = get_option_value("repeat", 3);
+  // use non-trivial scaling to exercise the full conversion:
+  const default_type offset = 1.0, scale = 0.5;
+
+  auto opt = get_options("type");
+  switch (opt.empty() ? 3 : int(opt[0][0])) {
+  case 0:
+    run_benchmark<uint8_t>(size, repeats, offset, scale);
+    break;
+  case 1:
+    run_benchmark<int16_t>(size, repeats, offset, scale);
+    break;
+  case 2:
+    run_benchmark<int32_t>(size, repeats, offset, scale);
+    break;
+  case 3:
+    run_benchmark<float>(size, repeats, offset, scale);
+    break;
+  case 4:
+    run_benchmark<double>(size, repeats, offset, scale);
+    break;
+  }
+}
@@ -0,0 +1,115 @@
+/* Copyright (c) 2008-2024 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include <cstring>
+
+#include "command.h"
+#include "file/bgzf.h"
+#include "file/gz.h"
+#include "file/utils.h"
+#include "image.h"
+#include "thread.h"
+#include "timer.h"
+
+#define BYTES_PER_ZCALL 524288
+
+using namespace MR;
+using namespace App;
+
+// clang-format off
+void usage() {
+
+  AUTHOR = "MRtrix3 contributors";
+
+  SYNOPSIS = "Compare the throughput of serial and block-parallel gzip compression of image data";
+
+  ARGUMENTS
+  + Argument ("input", "the image whose data will be compressed.").type_image_in();
+
+  OPTIONS
+  + Option ("repeat", "the number of times to repeat each measurement (default: 3).")
+    + Argument ("number").type_integer(1);
+
+}
+// clang-format on
+
+size_t file_size(const std::string &filename) {
+  std::ifstream in(filename, std::ios::binary | std::ios::ate);
+  return in.tellg();
+}
+
+void report(const std::string &label, size_t bytes, size_t compressed, double write_time, double read_time) {
+  std::cout << label << ": compressed size " << compressed << " bytes (ratio " << float(bytes) / float(compressed)
+            << "), compression " << bytes / (1.0e6 * write_time) << " MB/s, decompression "
+            << bytes / (1.0e6 * read_time) << " MB/s\n";
+}
+
+void run() {
+  auto in = Image<float>::open(argument[0]);
+  std::vector<float> data(voxel_count(in));
+  size_t n = 0;
+  for (auto l = Loop(in)(in); l; ++l)
+    data[n++] = in.value();
+  const size_t bytes = data.size() * sizeof(float);
+  const uint8_t *source = reinterpret_cast<const uint8_t *>(data.data());
+  std::vector<uint8_t> buffer(bytes);
+
+  const size_t repeats = get_option_value("repeat", 3);
+  const std::string filename = File::create_tempfile(0, "gz");
+  std::cout << "compressing " << bytes << " bytes of data using " << Thread::number_of_threads() << " threads\n";
+
+  double write_time = std::numeric_limits<double>::infinity();
+  double read_time = std::numeric_limits<double>::infinity();
+  for (size_t r = 0; r < repeats; ++r) {
+    Timer timer;
+    {
+      File::GZ zf(filename, "wb");
+      for (size_t offset = 0; offset < bytes; offset += BYTES_PER_ZCALL)
+        zf.write(reinterpret_cast<const char *>(source + offset), std::min<size_t>(BYTES_PER_ZCALL, bytes - offset));
+    }
+    write_time = std::min(write_time, timer.elapsed());
+    timer.start();
+    {
+      File::GZ zf(filename, "rb");
+      for (size_t offset = 0; offset < bytes; offset += BYTES_PER_ZCALL)
+        zf.read(reinterpret_cast<char *>(buffer.data() + offset), std::min<size_t>(BYTES_PER_ZCALL, bytes - offset));
+    }
+    read_time = std::min(read_time, timer.elapsed());
+  }
+  if (memcmp(buffer.data(), source, bytes))
+    throw Exception("serial gzip round-trip does not match original data");
+  report("serial gzip", bytes, file_size(filename), write_time, read_time);
+
+  write_time = read_time = std::numeric_limits<double>::infinity();
+  for (size_t r = 0; r < repeats; ++r) {
+    memset(buffer.data(), 0, bytes);
+    Timer timer;
+    {
+      File::BGZF::Writer zf(filename);
+      zf.write(source, bytes);
+    }
+    write_time = std::min(write_time, timer.elapsed());
+    timer.start();
+    File::BGZF::Reader zf(filename);
+    zf.read(buffer.data(), 0, bytes);
+    read_time = std::min(read_time, timer.elapsed());
+  }
+  if (memcmp(buffer.data(), source, bytes))
+    throw Exception("BGZF round-trip does not match original data");
+  report("block-parallel gzip", bytes, file_size(filename), write_time, read_time);
+
+  File::remove(filename);
+}
@@ -0,0 +1,208 @@
+/* Copyright (c) 2008-2024 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "command.h"
+#include "dwi/tractography/algorithms/iFOD1.h"
+#include "dwi/tractography/algorithms/iFOD2.h"
+#include "dwi/tractography/properties.h"
+#include "dwi/tractography/seeding/basic.h"
+#include "dwi/tractography/tracking/exec.h"
+#include "file/utils.h"
+#include "image.h"
+#include "math/SH.h"
+#include "math/rng.h"
+#include "timer.h"
+
+using namespace MR;
+using namespace App;
+using namespace MR::DWI::Tractography;
+
+// clang-format off
+void usage() {
+
+  AUTHOR = "MRtrix3 contributors";
+
+  SYNOPSIS = "Measure the throughput of FOD sampling and of probabilistic FOD-based tractography";
+
+  DESCRIPTION
+  + "A synthetic FOD image containing two crossing fibre populations is generated for each lmax requested. "
+    "For each, the throughput of trilinear interpolation of the SH coefficients is reported for "
+    "per-volume interpolation, blending of whole rows of coefficients, and blending of rows from the "
+    "brick-tiled in-RAM copy of the image used by tckgen, as is that of the evaluation "
+    "of the FOD amplitude along batches of directions, either one at a time or as a matrix product. "
+    "Finally, the number of streamlines generated per second by the iFOD1 and iFOD2 algorithms is reported.";
+
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+
+  OPTIONS
+  + Option ("lmax", "the values of lmax to test, as a comma-separated list (default: 8,10).")
+    + Argument ("list").type_sequence_int()
+
+  + Option ("samples", "the number of samples for the interpolation and SH evaluation benchmarks (default: 1000000).")
+    + Argument ("number").type_integer(1)
+
+  + Option ("select", "the number of streamlines to generate with each algorithm (default: 5000).")
+    + Argument ("number").type_integer(1);
+
+}
+// clang-format on
+
+constexpr size_t image_size = 40;
+constexpr size_t batch_size = 8;
+
+// two orthogonal fibre populations, with a volume fraction that varies along z:
+std::string generate_fods(int lmax) {
+  Header header;
+  header.ndim() = 4;
+  for (size_t n = 0; n < 3; ++n) {
+    header.size(n) = image_size;
+    header.spacing(n) = 2.0;
+  }
+  header.size(3) = Math::SH::NforL(lmax);
+  header.spacing(3) = 1.0;
+  header.transform().setIdentity();
+  header.datatype() = DataType::Float32;
+  header.stride(0) = 2;
+  header.stride(1) = 3;
+  header.stride(2) = 4;
+  header.stride(3) = 1;
+
+  Eigen::VectorXf along_x(header.size(3)), along_y(header.size(3));
+  Math::SH::delta(along_x, Eigen::Vector3f(1.0f, 0.0f, 0.0f), lmax);
+  Math::SH::delta(along_y, Eigen::Vector3f(0.0f, 1.0f, 0.0f), lmax);
+
+  const std::string path = File::create_tempfile(0, "mif");
+  File::remove(path);
+  auto fod = Image<float>::create(path, header);
+  for (auto l = Loop(fod, 0, 3)(fod); l; ++l) {
+    const float fraction = (fod.index(2) + 0.5f) / image_size;
+    fod.row(3) = 0.2f * (fraction * along_x + (1.0f - fraction) * along_y);
+  }
+  return path;
+}
+
+void bench_sampling(const std::string &path, int lmax, size_t num_samples) {
+  auto image = Image<float>::open(path).with_direct_io(3);
+  Tracking::Interpolator<Image<float>>::type interp(image);
+  Math::SH::PrecomputedAL<float> precomputer(lmax);
+  Math::RNG::Uniform<float> uniform;
+  Math::RNG::Normal<float> normal;
+
+  std::vector<Eigen::Vector3f> positions(num_samples);
+  for (auto &p : positions)
+    p = {uniform() * 2.0f * (image_size - 1), uniform() * 2.0f * (image_size - 1), uniform() * 2.0f * (image_size - 1)};
+  std::vector<Eigen::Vector3f> dirs(num_samples);
+  for (auto &d : dirs)
+    d = Eigen::Vector3f(normal(), normal(), normal()).normalized();
+
+  Eigen::VectorXf values(image.size(3)), reference(image.size(3));
+  double sum_per_volume = 0.0, sum_row = 0.0;
+  Timer timer;
+  for (const auto &p : positions) {
+    interp.scanner(p);
+    for (auto l = Loop(3)(interp); l; ++l)
+      reference[interp.index(3)] = interp.value();
+    sum_per_volume += reference[0];
+  }
+  const double per_volume_time = timer.elapsed();
+  timer.start();
+  for (const auto &p : positions) {
+    interp.scanner(p);
+    interp.row(3, values);
+    sum_row += values[0];
+  }
+  const double row_time = timer.elapsed();
+  if (std::abs(sum_row - sum_per_volume) > 1.0e-4 * std::abs(sum_per_volume))
+    throw Exception("interpolation of rows of coefficients does not match per-volume interpolation");
+
+  Tracking::SourceCache cache(image);
+  Tracking::SourceCache::Interp cached(cache);
+  double sum_cached = 0.0;
+  timer.start();
+  for (const auto &p : positions) {
+    cached.scanner(p);
+    cached.row(3, values);
+    sum_cached += values[0];
+  }
+  const double cached_time = timer.elapsed();
+  if (std::abs(sum_cached - sum_per_volume) > (cache.half_precision() ? 1.0e-2 : 1.0e-4) * std::abs(sum_per_volume))
+    throw Exception("interpolation from in-RAM copy of image does not match per-volume interpolation");
+
+  values.setRandom();
+  Eigen::VectorXf amplitudes(batch_size);
+  Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> basis;
+  std::vector<Eigen::Vector3f> batch(batch_size);
+  double sum_single = 0.0, sum_batch = 0.0;
+  timer.start();
+  for (const auto &d : dirs)
+    sum_single += precomputer.value(values, d);
+  const double single_time = timer.elapsed();
+  timer.start();
+  for (size_t n = 0; n + batch_size <= dirs.size(); n += batch_size) {
+    std::copy(dirs.begin() + n, dirs.begin() + n + batch_size, batch.begin());
+    precomputer.basis(basis, batch);
+    amplitudes.noalias() = basis * values;
+    sum_batch += amplitudes.sum();
+  }
+  const double batch_time = timer.elapsed();
+  if (dirs.size() % batch_size == 0 && std::abs(sum_batch - sum_single) > 1.0e-3 * (1.0 + std::abs(sum_single)))
+    throw Exception("batched evaluation of SH amplitudes does not match single evaluation");
+
+  std::cout << "  interpolation: per-volume " << num_samples / (1.0e6 * per_volume_time) << ", row-wise "
+            << num_samples / (1.0e6 * row_time) << ", in-RAM copy ("
+            << cache.footprint() / 1048576.0 << " MB) " << num_samples / (1.0e6 * cached_time) << " Msamples/s\n"
+            << "  SH amplitude: single " << num_samples / (1.0e6 * single_time) << ", batches of " << batch_size
+            << " " << num_samples / (1.0e6 * batch_time) << " Mdirections/s\n";
+}
+
+template <class Method> void bench_tracking(const std::string &name, const std::string &path, size_t num_tracks) {
+  Properties properties;
+  properties.seeds.add(new Seeding::Sphere(str(image_size) + "," + str(image_size) + "," + str(image_size) + ",10"));
+  properties["max_num_tracks"] = str(num_tracks);
+  const std::string output = File::create_tempfile(0, "tck");
+  File::remove(output);
+  Timer timer;
+  Tracking::Exec<Method>::run(path, output, properties);
+  const double elapsed = timer.elapsed();
+  File::remove(output);
+  std::cout << "  " << name << ": " << num_tracks / elapsed << " tracks/s\n";
+}
+
+void run() {
+  std::vector<int> lmax_list = {8, 10};
+  auto opt = get_options("lmax");
+  if (!opt.empty())
+    lmax_list = parse_ints<int>(opt[0][0]);
+  const size_t num_samples = get_option_value("samples", 1000000);
+  const size_t num_tracks = get_option_value("select", 5000);
+
+  for (const auto lmax : lmax_list) {
+    if (lmax < 2 || lmax % 2)
+      throw Exception("lmax must be a positive even number");
+    const std::string path = generate_fods(lmax);
+    std::cout << "lmax " << lmax << " (" << Math::SH::NforL(lmax) << " coefficients), "
+              << Thread::number_of_threads() << " threads:\n";
+    try {
+      bench_sampling(path, lmax, num_samples);
+      bench_tracking<Algorithms::iFOD1>("iFOD1", path, num_tracks);
+      bench_tracking<Algorithms::iFOD2>("iFOD2", path, num_tracks);
+    } catch (...) {
+      File::remove(path);
+      throw;
+    }
+    File::remove(path);
+  }
+}
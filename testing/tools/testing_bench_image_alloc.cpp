@@ -0,0 +1,150 @@
+/* Copyright (c) 2008-2024 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include <numeric>
+#include <random>
+
+#include "command.h"
+#include "image_io/allocate.h"
+#include "thread.h"
+#include "timer.h"
+
+using namespace MR;
+using namespace App;
+
+// clang-format off
+void usage() {
+  AUTHOR = "MRtrix3 contributors";
+
+  SYNOPSIS = "Measure the memory bandwidth achieved with the buffers used to hold images in RAM";
+
+  DESCRIPTION
+  + "For each buffer size requested, a buffer is obtained either using a plain 'new uint8_t[]' "
+    "followed by a serial memset (the baseline), or using the ImageIO::allocate() and "
+    "ImageIO::fill_zero() functions used for scratch and in-RAM images. For each, the time "
+    "taken to allocate and initialise the buffer is reported, along with the bandwidth achieved "
+    "when reading through the buffer sequentially using all threads (each handling a contiguous "
+    "slice, as in a ThreadedLoop), and when reading one value per 4kB page in random order "
+    "(which stresses the TLB, as happens when looping along the slowest-varying axis of an image)."
+
+  + "The allocation strategy used can be modified using the ImageHugePages and "
+    "ImageParallelFirstTouch config file options, e.g. by passing "
+    "'-config ImageHugePages none' on the command line.";
+
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+
+  OPTIONS
+  + Option ("sizes", "the buffer sizes to test in MB, as a comma-separated list "
+                     "(default: 64,256,1024).")
+    + Argument ("list").type_sequence_int()
+
+  + Option ("repeat", "the number of times to repeat each measurement (default: 3).")
+    + Argument ("number").type_integer(1);
+
+}
+// clang-format on
+
+constexpr size_t page_size = 4096;
+
+struct Timings {
+  double init = std::numeric_limits<double>::infinity();
+  double sequential = std::numeric_limits<double>::infinity();
+  double random = std::numeric_limits<double>::infinity();
+};
+
+class SequentialReader {
+public:
+  SequentialReader(const uint64_t *data, size_t count, std::atomic<size_t> &next, std::atomic<uint64_t> &sum)
+      : data(data), count(count), next(next), sum(sum) {}
+
+  void execute() {
+    const size_t nthreads = std::max<size_t>(Thread::number_of_threads(), 1);
+    const size_t slice = (count + nthreads - 1) / nthreads;
+    const size_t from = std::min(next++ * slice, count);
+    sum += std::accumulate(data + from, data + std::min(from + slice, count), uint64_t(0));
+  }
+
+private:
+  const uint64_t *data;
+  const size_t count;
+  std::atomic<size_t> &next;
+  std::atomic<uint64_t> &sum;
+};
+
+template <class AllocateFunctor> void run_once(size_t size, AllocateFunctor &&allocate, Timings &timings) {
+  Timer timer;
+  auto buffer = allocate(size);
+  timings.init = std::min(timings.init, timer.elapsed());
+
+  const uint64_t *data = reinterpret_cast<const uint64_t *>(buffer.get());
+  const size_t count = size / sizeof(uint64_t);
+  std::atomic<size_t> next(0);
+  std::atomic<uint64_t> sum(0);
+  timer.start();
+  SequentialReader reader(data, count, next, sum);
+  Thread::run(Thread::multi(reader, std::max<size_t>(Thread::number_of_threads(), 1)), "reader threads").wait();
+  timings.sequential = std::min(timings.sequential, timer.elapsed());
+
+  std::vector<size_t> pages(size / page_size);
+  std::iota(pages.begin(), pages.end(), size_t(0));
+  std::shuffle(pages.begin(), pages.end(), std::mt19937_64(pages.size()));
+  uint64_t random_sum = 0;
+  timer.start();
+  for (const auto page : pages)
+    random_sum += data[page * (page_size / sizeof(uint64_t))];
+  timings.random = std::min(timings.random, timer.elapsed());
+
+  if (sum + random_sum != 0)
+    throw Exception("buffer of size " + str(size) + " not initialised to zero");
+}
+
+void run() {
+  std::vector<int32_t> sizes = {64, 256, 1024};
+  auto opt = get_options("sizes");
+  if (!opt.empty())
+    sizes = parse_ints<int32_t>(opt[0][0]);
+  const size_t repeats = get_option_value("repeat", 3);
+
+  auto baseline = [](size_t size) {
+    std::unique_ptr<uint8_t[]> buffer(new uint8_t[size]);
+    memset(buffer.get(), 0, size);
+    return buffer;
+  };
+  auto image_io = [](size_t size) {
+    auto buffer = ImageIO::allocate(size);
+    ImageIO::fill_zero(buffer.get(), size);
+    return buffer;
+  };
+
+  std::cout << "size (MB)\tmethod\tinit (GB/s)\tsequential (GB/s)\trandom pages (Mpages/s)\n";
+  for (const auto megabytes : sizes) {
+    if (megabytes < 1)
+      throw Exception("buffer sizes must be positive");
+    const size_t size = size_t(megabytes) << 20;
+    for (const bool use_image_io : {false, true}) {
+      Timings timings;
+      for (size_t r = 0; r < repeats; ++r) {
+        if (use_image_io)
+          run_once(size, image_io, timings);
+        else
+          run_once(size, baseline, timings);
+      }
+      std::cout << megabytes << "\t" << (use_image_io ? "ImageIO" : "new[]") << "\t"
+                << str(size / (1.0e9 * timings.init), 4) << "\t" << str(size / (1.0e9 * timings.sequential), 4) << "\t"
+                << str(size / page_size / (1.0e6 * timings.random), 4) << "\n";
+    }
+  }
+}
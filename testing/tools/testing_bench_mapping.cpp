@@ -0,0 +1,157 @@
+/* Copyright (c) 2008-2024 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "command.h"
+#include "dwi/directions/set.h"
+#include "dwi/tractography/mapping/mapper.h"
+#include "dwi/tractography/mapping/voxel.h"
+#include "dwi/tractography/streamline.h"
+#include "header.h"
+#include "math/SH.h"
+#include "math/rng.h"
+#include "timer.h"
+
+using namespace MR;
+using namespace App;
+using namespace MR::DWI::Tractography;
+using namespace MR::DWI::Tractography::Mapping;
+
+// clang-format off
+void usage() {
+  AUTHOR = "MRtrix3 contributors";
+
+  SYNOPSIS = "Measure the throughput of streamline-to-voxel mapping for each mapping mode";
+
+  DESCRIPTION
+  + "A set of random smoothly-curving streamlines is generated within a synthetic image, "
+    "and mapped to the voxels of that image (using a single thread) with each of the supported "
+    "mapping mechanisms and containers: voxels, precise voxel lengths, streamline endpoints, "
+    "DEC colours, mean directions, dixels and TODs. For each, the number of streamlines mapped per "
+    "second and the mean number of elements per streamline are reported. The elements in each "
+    "container are also checked to be unique and in ascending order.";
+
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+
+  OPTIONS
+  + Option ("streamlines", "the number of streamlines to map (default: 20000).")
+    + Argument ("number").type_integer(1)
+
+  + Option ("upsample", "the upsampling ratio to apply to the streamlines before mapping (default: 3).")
+    + Argument ("factor").type_integer(1)
+
+  + Option ("lmax", "the maximum spherical harmonic degree for TOD mapping (default: 8).")
+    + Argument ("value").type_integer(2, 20);
+
+}
+// clang-format on
+
+constexpr size_t image_size = 100;
+constexpr float step_size = 0.5f;
+constexpr size_t max_num_points = 400;
+
+// random walks with a slowly-varying direction, until they leave the field of view:
+std::vector<Streamline<>> generate_streamlines(size_t num_streamlines) {
+  Math::RNG::Uniform<float> uniform;
+  Math::RNG::Normal<float> normal;
+  std::vector<Streamline<>> tracks(num_streamlines);
+  for (auto &tck : tracks) {
+    Eigen::Vector3f pos(uniform(), uniform(), uniform());
+    pos = (0.2f + 0.6f * pos.array()) * float(image_size);
+    Eigen::Vector3f dir = Eigen::Vector3f(normal(), normal(), normal()).normalized();
+    while (tck.size() < max_num_points && (pos.array() >= 0.0f).all() && (pos.array() <= image_size - 1.0f).all()) {
+      tck.push_back(pos);
+      dir = (dir + 0.05f * Eigen::Vector3f(normal(), normal(), normal())).normalized();
+      pos += step_size * dir;
+    }
+  }
+  return tracks;
+}
+
+template <class SetType>
+void bench(const std::string &name, const TrackMapperBase &mapper, const std::vector<Streamline<>> &tracks) {
+  SetType set;
+  size_t num_elements = 0;
+  Timer timer;
+  for (const auto &tck : tracks) {
+    mapper(tck, set);
+    num_elements += set.size();
+  }
+  const double elapsed = timer.elapsed();
+
+  for (const auto &tck : tracks) {
+    mapper(tck, set);
+    size_t count = 0;
+    auto previous = set.begin();
+    for (auto i = set.begin(); i != set.end(); ++i, ++count) {
+      if (i != set.begin() && !(*previous < *i))
+        throw Exception("elements of " + name + " container are not unique and in ascending order");
+      previous = i;
+    }
+    if (count != set.size())
+      throw Exception("size of " + name + " container does not match number of elements");
+  }
+
+  std::cout << name << "\t" << str(tracks.size() / (1.0e3 * elapsed), 4) << "\t"
+            << str(num_elements / double(tracks.size()), 4) << "\n";
+}
+
+void run() {
+  const size_t num_streamlines = get_option_value("streamlines", 20000);
+  const size_t upsample_ratio = get_option_value("upsample", 3);
+  const size_t lmax = get_option_value("lmax", 8);
+
+  Header header;
+  header.ndim() = 3;
+  for (size_t n = 0; n < 3; ++n) {
+    header.size(n) = image_size;
+    header.spacing(n) = 1.0;
+  }
+  header.transform().setIdentity();
+
+  const auto tracks = generate_streamlines(num_streamlines);
+  DWI::Directions::FastLookupSet dirs(300);
+
+  std::cout << "mode\tkstreamlines/s\telements/streamline\n";
+  {
+    TrackMapperBase mapper(header);
+    mapper.set_upsample_ratio(upsample_ratio);
+    bench<SetVoxel>("voxel", mapper, tracks);
+    bench<SetVoxelDEC>("dec", mapper, tracks);
+    bench<SetVoxelDir>("dir", mapper, tracks);
+  }
+  {
+    TrackMapperBase mapper(header);
+    mapper.set_upsample_ratio(upsample_ratio);
+    mapper.set_use_precise_mapping(true);
+    bench<SetVoxel>("precise", mapper, tracks);
+  }
+  {
+    TrackMapperBase mapper(header);
+    mapper.set_map_ends_only(true);
+    bench<SetVoxel>("ends", mapper, tracks);
+  }
+  {
+    TrackMapperBase mapper(header, dirs);
+    mapper.set_upsample_ratio(upsample_ratio);
+    bench<SetDixel>("dixel", mapper, tracks);
+  }
+  {
+    TrackMapperBase mapper(header);
+    mapper.set_upsample_ratio(upsample_ratio);
+    mapper.create_tod_plugin(Math::SH::NforL(lmax));
+    bench<SetVoxelTOD>("tod", mapper, tracks);
+  }
+}
@@ -0,0 +1,143 @@
+/* Copyright (c) 2008-2024 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "command.h"
+#include "thread.h"
+#include "thread_queue.h"
+#include "timer.h"
+
+using namespace MR;
+using namespace App;
+
+// clang-format off
+void usage() {
+  AUTHOR = "MRtrix3 contributors";
+
+  SYNOPSIS = "Compare the throughput of the mutex-based and lock-free Thread::Queue backends";
+
+  DESCRIPTION
+  + "For each number of threads requested, that many writer threads push items onto a single queue, "
+    "while the same number of reader threads pop them off. Each item carries a value, and the "
+    "readers check that every value pushed was received exactly once, so that this also serves as "
+    "a stress test of each backend.";
+
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+
+  OPTIONS
+  + Option ("threads", "the numbers of writer (and reader) threads to test, as a comma-separated list "
+                       "(default: powers of two up to the number of threads available).")
+    + Argument ("list").type_sequence_int()
+
+  + Option ("items", "the total number of items to send through the queue (default: 1000000).")
+    + Argument ("number").type_integer(1)
+
+  + Option ("capacity", "the capacity of the queue (default: " + str(MRTRIX_QUEUE_DEFAULT_CAPACITY) + ").")
+    + Argument ("number").type_integer(1)
+
+  + Option ("repeat", "the number of times to repeat each measurement (default: 3).")
+    + Argument ("number").type_integer(1);
+
+}
+// clang-format on
+
+using ItemQueue = Thread::Queue<size_t>;
+
+class Sender {
+public:
+  Sender(ItemQueue &queue, std::atomic<size_t> &next, size_t num_items)
+      : writer(queue), next(next), num_items(num_items) {}
+
+  void execute() {
+    ItemQueue::Writer::Item item(writer);
+    while ((*item = next++) < num_items)
+      if (!item.write())
+        throw Exception("queue closed before all items were written");
+  }
+
+private:
+  ItemQueue::Writer writer;
+  std::atomic<size_t> &next;
+  const size_t num_items;
+};
+
+class Receiver {
+public:
+  Receiver(ItemQueue &queue, std::vector<std::atomic<uint8_t>> &received) : reader(queue), received(received) {}
+
+  void execute() {
+    ItemQueue::Reader::Item item(reader);
+    while (item.read())
+      ++received[*item];
+  }
+
+private:
+  ItemQueue::Reader reader;
+  std::vector<std::atomic<uint8_t>> &received;
+};
+
+double run_once(bool lock_free, size_t nthreads, size_t num_items, size_t capacity) {
+  ItemQueue queue("benchmark", capacity, lock_free);
+  std::atomic<size_t> next(0);
+  std::vector<std::atomic<uint8_t>> received(num_items);
+  for (auto &r : received)
+    r = 0;
+
+  Timer timer;
+  {
+    Sender sender(queue, next, num_items);
+    Receiver receiver(queue, received);
+    auto senders = Thread::run(Thread::multi(sender, nthreads), "senders");
+    auto receivers = Thread::run(Thread::multi(receiver, nthreads), "receivers");
+    senders.wait();
+    receivers.wait();
+  }
+  const double elapsed = timer.elapsed();
+
+  for (size_t n = 0; n < num_items; ++n)
+    if (received[n] != 1)
+      throw Exception(std::string(lock_free ? "lock-free" : "mutex-based") + " queue with " + str(nthreads) +
+                      " threads: item " + str(n) + " received " + str(int(received[n])) + " times");
+  return elapsed;
+}
+
+void run() {
+  const size_t num_items = get_option_value("items", 1000000);
+  const size_t capacity = get_option_value("capacity", MRTRIX_QUEUE_DEFAULT_CAPACITY);
+  const size_t repeats = get_option_value("repeat", 3);
+
+  std::vector<int32_t> thread_counts;
+  auto opt = get_options("threads");
+  if (opt.empty()) {
+    for (size_t n = 1; n <= std::max<size_t>(Thread::number_of_threads(), 1); n *= 2)
+      thread_counts.push_back(n);
+  } else {
+    thread_counts = parse_ints<int32_t>(opt[0][0]);
+  }
+
+  std::cout << "threads\tmutex-based\tlock-free\t(millions of items/s)\n";
+  for (const auto nthreads : thread_counts) {
+    if (nthreads < 1)
+      throw Exception("number of threads must be positive");
+    std::cout << nthreads;
+    for (const bool lock_free : {false, true}) {
+      double best = std::numeric_limits<double>::infinity();
+      for (size_t r = 0; r < repeats; ++r)
+        best = std::min(best, run_once(lock_free, nthreads, num_items, capacity));
+      std::cout << "\t" << str(num_items / (1.0e6 * best), 4);
+    }
+    std::cout << "\n";
+  }
+}
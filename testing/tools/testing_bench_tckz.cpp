@@ -0,0 +1,166 @@
+/* Copyright (c) 2008-2024 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "command.h"
+#include "dwi/tractography/compressed_file.h"
+#include "dwi/tractography/file.h"
+#include "file/utils.h"
+#include "math/rng.h"
+#include "thread.h"
+#include "timer.h"
+
+using namespace MR;
+using namespace App;
+using namespace MR::DWI::Tractography;
+
+// clang-format off
+void usage() {
+
+  AUTHOR = "MRtrix3 contributors";
+
+  SYNOPSIS = "Compare the size and throughput of compressed (.tckz) and uncompressed (.tck) track files";
+
+  DESCRIPTION
+  + "The streamlines are written to and read back from temporary files in each format,"
+    " and the largest error in vertex position after the round-trip through the compressed format"
+    " is checked to be no more than half the quantisation step."
+    " If no input track file is provided, smooth random streamlines are generated instead.";
+
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+
+  OPTIONS
+  + Option ("tracks", "the input track file (.tck) to use.")
+    + Argument ("file").type_tracks_in()
+
+  + Option ("number", "the number of streamlines to generate if no input track file is provided (default: 100000).")
+    + Argument ("number").type_integer(1)
+
+  + Option ("quantisation", "the quantisation step size in mm (default: "
+                            "as set by the TrackCompressionQuantisation config file option).")
+    + Argument ("step").type_float(0.0)
+
+  + Option ("repeat", "the number of times to repeat each measurement (default: 3).")
+    + Argument ("number").type_integer(1);
+
+}
+// clang-format on
+
+using TrackList = std::vector<Streamline<float>>;
+
+size_t file_size(const std::string &filename) {
+  std::ifstream in(filename, std::ios::binary | std::ios::ate);
+  return in.tellg();
+}
+
+// random walks with slowly varying direction, sampled every 0.5mm:
+TrackList generate(size_t num_tracks) {
+  Math::RNG::Normal<float> rng;
+  TrackList tracks(num_tracks);
+  for (auto &tck : tracks) {
+    Eigen::Vector3f pos(20.0f * rng(), 20.0f * rng(), 20.0f * rng());
+    Eigen::Vector3f dir = Eigen::Vector3f(rng(), rng(), rng()).normalized();
+    const size_t length = 50 + size_t(std::abs(100.0f * rng()));
+    for (size_t n = 0; n < length; ++n) {
+      tck.push_back(pos);
+      dir = (dir + 0.05f * Eigen::Vector3f(rng(), rng(), rng())).normalized();
+      pos += 0.5f * dir;
+    }
+  }
+  return tracks;
+}
+
+template <class WriterType> double write(WriterType &&writer, const TrackList &tracks) {
+  Timer timer;
+  for (const auto &tck : tracks)
+    writer(tck);
+  return timer.elapsed();
+}
+
+double read(const std::string &filename, TrackList &tracks) {
+  Properties properties;
+  Timer timer;
+  Reader<float> reader(filename, properties);
+  for (auto &tck : tracks)
+    if (!reader(tck))
+      throw Exception("track file \"" + filename + "\" contains fewer streamlines than written");
+  return timer.elapsed();
+}
+
+void run() {
+  TrackList tracks;
+  auto opt = get_options("tracks");
+  if (opt.empty()) {
+    tracks = generate(get_option_value("number", 100000));
+  } else {
+    Properties properties;
+    Reader<float> reader(opt[0][0], properties);
+    Streamline<float> tck;
+    while (reader(tck))
+      tracks.push_back(tck);
+  }
+  size_t num_vertices = 0;
+  for (const auto &tck : tracks)
+    num_vertices += tck.size();
+
+  const float step = get_option_value("quantisation", Compressed::default_quantisation());
+  const size_t repeats = get_option_value("repeat", 3);
+  std::cout << "streamlines: " << tracks.size() << ", vertices: " << num_vertices << ", quantisation: " << step
+            << " mm, threads: " << Thread::number_of_threads() << "\n";
+
+  TrackList decoded(tracks.size());
+  float max_error = 0.0f;
+  size_t raw_size = 0;
+  for (const bool compressed : {false, true}) {
+    const std::string filename = File::create_tempfile(0, compressed ? "tckz" : "tck");
+    double write_time = std::numeric_limits<double>::infinity();
+    double read_time = std::numeric_limits<double>::infinity();
+    for (size_t r = 0; r < repeats; ++r) {
+      File::remove(filename);
+      Properties properties;
+      if (compressed) {
+        Compressed::Writer writer(filename, properties, 0, step);
+        write_time = std::min(write_time, write([&](const Streamline<float> &tck) { writer.append(tck); }, tracks));
+      } else {
+        Writer<float> writer(filename, properties);
+        write_time = std::min(write_time, write(writer, tracks));
+      }
+      read_time = std::min(read_time, read(filename, decoded));
+    }
+
+    const size_t size = file_size(filename);
+    if (compressed) {
+      for (size_t n = 0; n < tracks.size(); ++n) {
+        if (decoded[n].size() != tracks[n].size())
+          throw Exception("number of vertices differs for streamline " + str(n));
+        for (size_t v = 0; v < tracks[n].size(); ++v)
+          max_error = std::max(max_error, (decoded[n][v] - tracks[n][v]).lpNorm<Eigen::Infinity>());
+      }
+    } else {
+      raw_size = size;
+    }
+    std::cout << (compressed ? "compressed  " : "uncompressed") << ": " << size << " bytes";
+    if (compressed)
+      std::cout << " (ratio " << float(raw_size) / float(size) << ")";
+    std::cout << ", write " << num_vertices / (1.0e6 * write_time) << " Mvertices/s, read "
+              << num_vertices / (1.0e6 * read_time) << " Mvertices/s\n";
+    File::remove(filename);
+  }
+
+  std::cout << "maximum error in vertex position: " << max_error << " mm\n";
+  // allow for the rounding error of single-precision floating-point:
+  if (max_error > 0.5f * step * (1.0f + 1.0e-3f) + 1.0e-5f)
+    throw Exception("round-trip error exceeds half the quantisation step");
+}
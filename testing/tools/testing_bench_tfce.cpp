@@ -0,0 +1,141 @@
+/* Copyright (c) 2008-2024 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include <random>
+
+#include "command.h"
+#include "header.h"
+#include "timer.h"
+
+#include "filter/connected_components.h"
+#include "math/stats/typedefs.h"
+#include "misc/voxel2vector.h"
+#include "stats/cluster.h"
+#include "stats/tfce.h"
+
+using namespace MR;
+using namespace App;
+using Math::Stats::matrix_type;
+using Math::Stats::value_type;
+
+// clang-format off
+void usage() {
+  AUTHOR = "MRtrix3 contributors";
+
+  SYNOPSIS = "Compare the speed of single-pass and per-threshold TFCE enhancement";
+
+  DESCRIPTION
+  + "Spatially smooth random statistics are generated on a cubic voxel grid, and enhanced using "
+    "both the single-pass union-find TFCE integration and the explicit integration in which "
+    "connected-component labelling is repeated at each threshold. The time taken per "
+    "permutation (i.e. per enhanced statistic image) is reported for each, along with the "
+    "maximal relative difference between their outputs.";
+
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+
+  OPTIONS
+  + Option ("size", "the number of voxels along each axis of the grid (default: 48).")
+    + Argument ("number").type_integer(3)
+
+  + Option ("dh", "the height increment used in the TFCE integration (default: 0.1).")
+    + Argument ("value").type_float(1e-6)
+
+  + Option ("connectivity", "use 26-nearest-neighbour connectivity rather than 6")
+
+  + Option ("repeat", "the number of times to repeat each measurement (default: 3).")
+    + Argument ("number").type_integer(1);
+
+}
+// clang-format on
+
+void run() {
+  const size_t size = get_option_value("size", 48);
+  const value_type dH = get_option_value("dh", 0.1);
+  const size_t repeats = get_option_value("repeat", 3);
+  const value_type E = 0.5, H = 2.0;
+
+  const Header header = [&] {
+    Header H;
+    H.ndim() = 3;
+    for (size_t axis = 0; axis != 3; ++axis) {
+      H.size(axis) = size;
+      H.spacing(axis) = 1.0;
+      H.stride(axis) = axis + 1;
+    }
+    H.transform().setIdentity();
+    H.datatype() = DataType::Float32;
+    return H;
+  }();
+  const Voxel2Vector v2v(header);
+  const size_t num_voxels = v2v.size();
+
+  Filter::Connector connector;
+  connector.adjacency.set_26_adjacency(!get_options("connectivity").empty());
+  connector.adjacency.initialise(header, v2v);
+
+  // Box-filtered Gaussian noise, so that non-trivial clusters form
+  std::mt19937 rng(0);
+  std::normal_distribution<value_type> normal;
+  const matrix_type noise = matrix_type::NullaryExpr(num_voxels, 1, [&]() { return normal(rng); });
+  matrix_type input(matrix_type::Zero(num_voxels, 1));
+  for (size_t i = 0; i != num_voxels; ++i) {
+    const auto &pos = v2v[i];
+    size_t count = 0;
+    for (int dx = -1; dx <= 1; ++dx) {
+      for (int dy = -1; dy <= 1; ++dy) {
+        for (int dz = -1; dz <= 1; ++dz) {
+          const auto j = v2v(std::vector<int>{int(pos[0]) + dx, int(pos[1]) + dy, int(pos[2]) + dz});
+          if (j != Voxel2Vector::invalid) {
+            input(i, 0) += noise(j, 0);
+            ++count;
+          }
+        }
+      }
+    }
+    input(i, 0) *= 4.0 / std::sqrt(value_type(count));
+  }
+  const auto in = std::as_const(input).col(0);
+
+  const Stats::TFCE::Wrapper wrapper(std::make_shared<Stats::Cluster::ClusterSize>(connector, 0.0), dH, E, H);
+  matrix_type single_pass(num_voxels, 1), per_threshold(num_voxels, 1);
+
+  double best_single_pass = std::numeric_limits<double>::infinity();
+  double best_per_threshold = std::numeric_limits<double>::infinity();
+  for (size_t r = 0; r != repeats; ++r) {
+    Timer timer;
+    static_cast<const Stats::EnhancerBase &>(wrapper)(input, single_pass);
+    best_single_pass = std::min(best_single_pass, timer.elapsed());
+
+    timer.start();
+    per_threshold.setZero();
+    for (value_type h = dH; (h - dH) < in.maxCoeff(); h += dH) {
+      std::vector<Filter::Connector::Cluster> clusters;
+      std::vector<uint32_t> labels(num_voxels, 0);
+      connector.run(clusters, labels, in, h);
+      const value_type h_multiplier = std::pow(h, H);
+      for (size_t i = 0; i != num_voxels; ++i)
+        per_threshold(i, 0) += std::pow(labels[i] ? clusters[labels[i] - 1].size : 0.0, E) * h_multiplier;
+    }
+    best_per_threshold = std::min(best_per_threshold, timer.elapsed());
+  }
+
+  const value_type max_rel_diff =
+      ((single_pass - per_threshold).array().abs() / per_threshold.array().abs().max(1.0)).maxCoeff();
+
+  std::cout << "elements\tthresholds\tper-threshold (ms)\tsingle-pass (ms)\tmax rel. diff\n";
+  std::cout << num_voxels << "\t" << size_t(std::ceil(in.maxCoeff() / dH)) << "\t" << str(1e3 * best_per_threshold, 4)
+            << "\t" << str(1e3 * best_single_pass, 4) << "\t" << str(max_rel_diff, 3) << "\n";
+}
@@ -0,0 +1,171 @@
+/* Copyright (c) 2008-2024 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include <numeric>
+#include <random>
+
+#include "command.h"
+#include "exception.h"
+#include "header.h"
+#include "types.h"
+
+#include "filter/connected_components.h"
+#include "misc/voxel2vector.h"
+
+using namespace MR;
+using namespace App;
+
+#define GRID_SIZE 20
+
+// clang-format off
+void usage() {
+  AUTHOR = "MRtrix3 contributors";
+  SYNOPSIS = "Verify connected-component labelling, including following reordering of the elements";
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+}
+// clang-format on
+
+void run() {
+  std::vector<std::string> failed_tests;
+  std::mt19937 rng(42);
+  std::normal_distribution<float> normal;
+
+  Header header;
+  header.ndim() = 3;
+  for (size_t axis = 0; axis != 3; ++axis) {
+    header.size(axis) = GRID_SIZE;
+    header.spacing(axis) = 1.0;
+    header.stride(axis) = axis + 1;
+  }
+  header.transform().setIdentity();
+  header.datatype() = DataType::Bit;
+  // A spherical mask, so that voxels at the edge of the mask have fewer neighbours
+  auto mask = Image<bool>::scratch(header, "spherical mask");
+  for (auto l = Loop(mask)(mask); l; ++l)
+    mask.value() = Math::pow2(mask.index(0) - 9.5) + Math::pow2(mask.index(1) - 9.5) +
+                       Math::pow2(mask.index(2) - 9.5) <=
+                   Math::pow2(GRID_SIZE / 2);
+
+  for (const bool use_26_neighbours : {false, true}) {
+    const std::string connectivity = use_26_neighbours ? "26-connectivity" : "6-connectivity";
+    Voxel2Vector v2v(mask, header);
+    const size_t num_voxels = v2v.size();
+    Filter::Connector connector;
+    connector.adjacency.set_26_adjacency(use_26_neighbours);
+    connector.adjacency.initialise(header, v2v);
+
+    // Adjacency must be consistent with the spatial positions of the elements
+    for (Filter::Connector::Adjacency::index_t i = 0; i != num_voxels; ++i) {
+      size_t expected = 0;
+      for (int dx = -1; dx <= 1; ++dx) {
+        for (int dy = -1; dy <= 1; ++dy) {
+          for (int dz = -1; dz <= 1; ++dz) {
+            const int distance = std::abs(dx) + std::abs(dy) + std::abs(dz);
+            if (distance && (use_26_neighbours || distance == 1) &&
+                v2v(std::vector<int>{int(v2v[i][0]) + dx, int(v2v[i][1]) + dy, int(v2v[i][2]) + dz}) !=
+                    Voxel2Vector::invalid)
+              ++expected;
+          }
+        }
+      }
+      if (connector.adjacency[i].size() != expected) {
+        failed_tests.push_back("Adjacency; " + connectivity + "; element " + str(i) + " has " +
+                               str(connector.adjacency[i].size()) + " neighbours, expected " + str(expected));
+        break;
+      }
+    }
+
+    // Thresholded random data: every cluster must be a maximal set of connected supra-threshold elements
+    std::vector<float> data(num_voxels);
+    for (auto &value : data)
+      value = normal(rng);
+    const float threshold = 0.5;
+    auto check = [&](const std::vector<float> &values, const std::string &msg) {
+      std::vector<Filter::Connector::Cluster> clusters;
+      std::vector<uint32_t> labels;
+      std::vector<Filter::Connector::Adjacency::index_t> queue;
+      connector.run(clusters, labels, queue, values, threshold);
+      std::vector<uint32_t> sizes(clusters.size(), 0);
+      for (Filter::Connector::Adjacency::index_t i = 0; i != num_voxels; ++i) {
+        if ((values[i] > threshold) != bool(labels[i])) {
+          failed_tests.push_back(msg + ": element " + str(i) + " incorrectly labelled");
+          return std::vector<uint32_t>();
+        }
+        if (!labels[i])
+          continue;
+        ++sizes[labels[i] - 1];
+        for (const auto n : connector.adjacency[i]) {
+          if (labels[n] && labels[n] != labels[i]) {
+            failed_tests.push_back(msg + ": adjacent elements " + str(i) + " and " + str(n) +
+                                   " assigned to different clusters");
+            return std::vector<uint32_t>();
+          }
+        }
+      }
+      for (size_t c = 0; c != clusters.size(); ++c) {
+        if (clusters[c].label != c + 1 || clusters[c].size != sizes[c]) {
+          failed_tests.push_back(msg + ": cluster " + str(c + 1) + " of size " + str(clusters[c].size) +
+                                 " contains " + str(sizes[c]) + " elements");
+          return std::vector<uint32_t>();
+        }
+      }
+      std::vector<uint32_t> result(num_voxels, 0);
+      for (size_t i = 0; i != num_voxels; ++i)
+        result[i] = labels[i] ? clusters[labels[i] - 1].size : 0;
+      return result;
+    };
+    const auto cluster_sizes = check(data, "Labelling; " + connectivity);
+
+    // Reordering must yield a permutation, and leave the cluster to which each element belongs unchanged
+    const auto order = connector.adjacency.reverse_cuthill_mckee();
+    std::vector<Filter::Connector::Adjacency::index_t> sorted(order);
+    std::sort(sorted.begin(), sorted.end());
+    std::vector<Filter::Connector::Adjacency::index_t> identity(num_voxels);
+    std::iota(identity.begin(), identity.end(), 0);
+    if (sorted != identity) {
+      failed_tests.push_back("Reverse Cuthill-McKee; " + connectivity + ": ordering is not a permutation");
+      continue;
+    }
+    v2v.reorder(order);
+    connector.adjacency.reorder(order);
+    std::vector<float> reordered_data(num_voxels);
+    for (size_t i = 0; i != num_voxels; ++i) {
+      reordered_data[i] = data[order[i]];
+      if (v2v(v2v[i]) != i) {
+        failed_tests.push_back("Reordering; " + connectivity + ": voxel-to-vector mapping is inconsistent");
+        break;
+      }
+    }
+    const auto reordered_cluster_sizes = check(reordered_data, "Reordered labelling; " + connectivity);
+    if (cluster_sizes.empty() || reordered_cluster_sizes.empty())
+      continue;
+    for (size_t i = 0; i != num_voxels; ++i) {
+      if (reordered_cluster_sizes[i] != cluster_sizes[order[i]]) {
+        failed_tests.push_back("Reordering; " + connectivity + ": cluster size of element " + str(order[i]) +
+                               " changed from " + str(cluster_sizes[order[i]]) + " to " +
+                               str(reordered_cluster_sizes[i]));
+        break;
+      }
+    }
+  }
+
+  if (!failed_tests.empty()) {
+    Exception e(str(failed_tests.size()) + " tests of connected-component labelling failed:");
+    for (auto s : failed_tests)
+      e.push_back(s);
+    throw e;
+  }
+}
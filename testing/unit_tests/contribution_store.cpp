@@ -0,0 +1,169 @@
+/* Copyright (c) 2008-2024 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "command.h"
+#include "exception.h"
+#include "header.h"
+#include "math/rng.h"
+#include "thread.h"
+#include "types.h"
+
+#include "dwi/tractography/SIFT/contribution_store.h"
+
+using namespace MR;
+using namespace App;
+using namespace MR::DWI::Tractography::SIFT;
+
+// clang-format off
+void usage() {
+  AUTHOR = "MRtrix3 contributors";
+  SYNOPSIS = "Verify correct operation of the compressed storage of SIFT streamline contributions";
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+}
+// clang-format on
+
+constexpr track_t num_tracks = 20000;
+
+// Generate the contributions of a streamline deterministically from its index,
+//   including fixel indices beyond the range of 24 bits and repeated fixel indices
+std::vector<Track_fixel_contribution> generate(const track_t index) {
+  Math::RNG rng(index);
+  std::vector<Track_fixel_contribution> result;
+  const size_t count = index % 100;
+  const uint32_t range = (index % 3) ? (1U << 20) : (1U << 30);
+  for (size_t n = 0; n != count; ++n) {
+    const uint32_t fixel = 1 + (rng() % range);
+    result.push_back(Track_fixel_contribution(fixel, 0.01F * (rng() % 100)));
+    if (!(rng() % 10))
+      result.push_back(Track_fixel_contribution(fixel, 0.01F * (rng() % 100)));
+  }
+  return result;
+}
+
+class Writer {
+public:
+  Writer(ContributionStore &store, std::atomic<track_t> &next) : arena(store), next(next) {}
+  Writer(const Writer &that) : arena(that.arena), next(that.next) {}
+  void execute() {
+    track_t index;
+    while ((index = next++) < num_tracks) {
+      auto contributions = generate(index);
+      arena.set(index, contributions, float(index), float(2 * index));
+    }
+  }
+
+private:
+  ContributionStore::Arena arena;
+  std::atomic<track_t> &next;
+};
+
+void run() {
+  std::vector<std::string> failed_tests;
+  auto test = [&](const bool result, const std::string msg) {
+    if (!result)
+      failed_tests.push_back(msg);
+  };
+
+  Header H;
+  H.ndim() = 3;
+  for (size_t axis = 0; axis != 3; ++axis) {
+    H.size(axis) = 10;
+    H.spacing(axis) = 1.0;
+  }
+  Track_fixel_contribution::set_scaling(H);
+
+  // Contributions to the same fixel may be stored in any order
+  auto matches = [](const TrackContribution &stored, std::vector<Track_fixel_contribution> expected) {
+    auto order = [](const Track_fixel_contribution &a, const Track_fixel_contribution &b) {
+      return a < b || (!(b < a) && a.get_length() < b.get_length());
+    };
+    std::vector<Track_fixel_contribution> decoded(stored.begin(), stored.end());
+    if (decoded.size() != stored.dim() || decoded.size() != expected.size())
+      return false;
+    std::sort(expected.begin(), expected.end(), order);
+    std::sort(decoded.begin(), decoded.end(), order);
+    for (size_t n = 0; n != expected.size(); ++n) {
+      if (decoded[n].get_fixel_index() != expected[n].get_fixel_index() ||
+          decoded[n].get_length() != expected[n].get_length())
+        return false;
+    }
+    return stored.bytes() == TrackContribution::encoded_size(expected);
+  };
+
+  // Without a memory budget, and with a budget small enough that all blocks are spilled to file
+  for (const size_t max_bytes : {size_t(0), size_t(1)}) {
+    const std::string mode = max_bytes ? "spilled" : "in-memory";
+    ContributionStore store;
+    store.initialise(num_tracks, max_bytes);
+    {
+      std::atomic<track_t> next(0);
+      Writer writer(store, next);
+      Thread::run(Thread::multi(writer, 4), "contribution writers").wait();
+    }
+    store.finalise();
+    test(bool(max_bytes) == bool(store.spilled()),
+         "Unexpected amount of " + mode + " data written to file: " + str(store.spilled()));
+
+    bool all_match = true;
+    for (track_t index = 0; index != num_tracks; ++index) {
+      const TrackContribution stored(store[index]);
+      all_match &= stored && matches(stored, generate(index)) && stored.get_total_contribution() == float(index) &&
+                   stored.get_total_length() == float(2 * index);
+    }
+    test(all_match, "Contributions not preserved in " + mode + " storage");
+
+    // Remove every other fixel, re-indexing the remainder, as done when excluding fixels from the model
+    {
+      ContributionStore::Arena arena(store);
+      for (track_t index = 0; index != num_tracks; ++index) {
+        std::vector<Track_fixel_contribution> remapped;
+        for (const auto &c : store[index]) {
+          if (c.get_fixel_index() % 2)
+            remapped.push_back(Track_fixel_contribution((c.get_fixel_index() + 1) / 2, c.get_length()));
+        }
+        arena.replace(index, remapped, -float(index));
+      }
+    }
+    all_match = true;
+    for (track_t index = 0; index != num_tracks; ++index) {
+      std::vector<Track_fixel_contribution> expected;
+      for (const auto &c : generate(index)) {
+        if (c.get_fixel_index() % 2)
+          expected.push_back(Track_fixel_contribution((c.get_fixel_index() + 1) / 2, c.get_length()));
+      }
+      const TrackContribution stored(store[index]);
+      all_match &= matches(stored, expected) && stored.get_total_contribution() == -float(index) &&
+                   stored.get_total_length() == float(2 * index);
+    }
+    test(all_match, "Contributions not preserved after re-indexing in " + mode + " storage");
+
+    for (track_t index = 0; index != num_tracks; index += 2)
+      store.erase(index);
+    test(store.count() == num_tracks / 2, "Incorrect number of streamlines after removal in " + mode + " storage");
+    test(!store[0] && store[1], "Incorrect streamlines removed in " + mode + " storage");
+  }
+
+  if (!failed_tests.empty()) {
+    Exception e(str(failed_tests.size()) + " tests of SIFT contribution storage failed:");
+    for (auto s : failed_tests)
+      e.push_back(s);
+    throw e;
+  }
+}
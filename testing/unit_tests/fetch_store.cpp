@@ -0,0 +1,111 @@
+/* Copyright (c) 2008-2024 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include <cstring>
+
+#include "command.h"
+#include "datatype.h"
+#include "exception.h"
+#include "fetch_store.h"
+#include "math/rng.h"
+
+using namespace MR;
+using namespace App;
+
+// clang-format off
+void usage() {
+  AUTHOR = "MRtrix3 contributors";
+  SYNOPSIS = "Verify that the bulk fetch/store functions match their per-voxel equivalents";
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+}
+// clang-format on
+
+#define NUM_VALUES 1000
+// exercise runs that do not start on a byte or word boundary:
+#define FIRST_VALUE 3
+
+const std::vector<DataType> datatypes = {
+    DataType::Bit,       DataType::Int8,      DataType::UInt8,      DataType::Int16LE,    DataType::UInt16LE,
+    DataType::Int16BE,   DataType::UInt16BE,  DataType::Int32LE,    DataType::UInt32LE,   DataType::Int32BE,
+    DataType::UInt32BE,  DataType::Int64LE,   DataType::UInt64LE,   DataType::Int64BE,    DataType::UInt64BE,
+    DataType::Float16LE, DataType::Float16BE, DataType::Float32LE,  DataType::Float32BE,  DataType::Float64LE,
+    DataType::Float64BE, DataType::CFloat32LE, DataType::CFloat32BE, DataType::CFloat64LE, DataType::CFloat64BE};
+
+std::vector<std::string> failed_tests;
+
+template <typename ValueType> void test(const std::string &type_name) {
+  Math::RNG::Uniform<double> rng;
+  std::vector<ValueType> values(NUM_VALUES);
+  for (auto &v : values)
+    v = ValueType(200.0 * rng() - 100.0);
+
+  for (const auto datatype : datatypes) {
+    for (const auto &scaling : std::vector<std::pair<default_type, default_type>>{{0.0, 1.0}, {1.5, 0.25}}) {
+      const std::string msg = std::string(datatype.specifier()) + " to " + type_name + " with offset " +
+                              str(scaling.first) + " and scale " + str(scaling.second);
+      const size_t bytes = (NUM_VALUES * datatype.bits() + 7) / 8;
+      std::vector<uint8_t> per_voxel(bytes, 0), bulk(bytes, 0);
+
+      FetchScaleFunction<ValueType> fetch_func;
+      StoreScaleFunction<ValueType> store_func;
+      FetchScaleSpanFunction<ValueType> fetch_span_func;
+      StoreScaleSpanFunction<ValueType> store_span_func;
+      __set_fetch_store_scale_functions(fetch_func, store_func, datatype);
+      __set_fetch_store_scale_span_functions(fetch_span_func, store_span_func, datatype);
+
+      for (size_t n = FIRST_VALUE; n < NUM_VALUES; ++n)
+        store_func(values[n], per_voxel.data(), n, scaling.first, scaling.second);
+      store_span_func(values.data() + FIRST_VALUE,
+                      bulk.data(),
+                      FIRST_VALUE,
+                      NUM_VALUES - FIRST_VALUE,
+                      scaling.first,
+                      scaling.second);
+      if (memcmp(per_voxel.data(), bulk.data(), bytes))
+        failed_tests.push_back("store from " + msg);
+
+      std::vector<ValueType> fetched(NUM_VALUES);
+      fetch_span_func(fetched.data() + FIRST_VALUE,
+                      per_voxel.data(),
+                      FIRST_VALUE,
+                      NUM_VALUES - FIRST_VALUE,
+                      scaling.first,
+                      scaling.second);
+      for (size_t n = FIRST_VALUE; n < NUM_VALUES; ++n) {
+        if (fetched[n] != fetch_func(per_voxel.data(), n, scaling.first, scaling.second)) {
+          failed_tests.push_back("fetch from " + msg + " (at index " + str(n) + ")");
+          break;
+        }
+      }
+    }
+  }
+}
+
+void run() {
+  test<uint8_t>("uint8");
+  test<int16_t>("int16");
+  test<int32_t>("int32");
+  test<int64_t>("int64");
+  test<float>("float32");
+  test<double>("float64");
+
+  if (!failed_tests.empty()) {
+    Exception e(str(failed_tests.size()) + " tests of bulk fetch/store functions failed:");
+    for (auto s : failed_tests)
+      e.push_back(s);
+    throw e;
+  }
+}
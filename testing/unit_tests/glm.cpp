@@ -0,0 +1,125 @@
+/* Copyright (c) 2008-2024 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include <random>
+
+#include "command.h"
+#include "exception.h"
+#include "types.h"
+
+#include "math/stats/glm.h"
+#include "math/stats/shuffle.h"
+#include "math/stats/typedefs.h"
+
+using namespace MR;
+using namespace App;
+using namespace Math::Stats;
+using namespace Math::Stats::GLM;
+
+#define NUM_INPUTS 40
+#define NUM_FACTORS 3
+// Sufficient for the block of shuffles to be processed in several tiles of image elements
+#define NUM_ELEMENTS 1000
+#define NUM_SHUFFLES 50
+
+// clang-format off
+void usage() {
+  AUTHOR = "MRtrix3 contributors";
+  SYNOPSIS = "Verify that fixed-design GLM statistics computed for a block of shuffles"
+             " match those computed for each shuffle in turn";
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+}
+// clang-format on
+
+void run() {
+  std::vector<std::string> failed_tests;
+  std::mt19937 rng(42);
+  std::normal_distribution<default_type> normal;
+
+  matrix_type design(NUM_INPUTS, NUM_FACTORS);
+  design.col(0).setOnes();
+  for (ssize_t row = 0; row != NUM_INPUTS; ++row) {
+    design(row, 1) = row % 2 ? 1.0 : 0.0;
+    design(row, 2) = normal(rng);
+  }
+
+  // Effects of interest: a t-test on the group difference, and an F-test across both regressors
+  const matrix_type contrasts = (matrix_type(2, NUM_FACTORS) << 0.0, 1.0, 0.0, 0.0, 0.0, 1.0).finished();
+  std::vector<Hypothesis> hypotheses;
+  hypotheses.emplace_back(matrix_type::ConstRowXpr(contrasts.row(0)), 0);
+  hypotheses.emplace_back(contrasts, 1);
+
+  matrix_type measurements(NUM_INPUTS, NUM_ELEMENTS);
+  for (ssize_t col = 0; col != NUM_ELEMENTS; ++col) {
+    const default_type effect = 0.01 * (col % 100);
+    for (ssize_t row = 0; row != NUM_INPUTS; ++row)
+      measurements(row, col) = effect * design(row, 1) + (1.0 + (row % 2)) * normal(rng);
+  }
+
+  index_array_type variance_groups(NUM_INPUTS);
+  for (ssize_t row = 0; row != NUM_INPUTS; ++row)
+    variance_groups[row] = row % 2;
+
+  std::vector<Shuffle> shuffles;
+  Shuffler shuffler(NUM_INPUTS, NUM_SHUFFLES, Shuffler::error_t::EE, false);
+  Shuffle shuffle;
+  while (shuffler(shuffle))
+    shuffles.push_back(shuffle);
+
+  // Relative difference permitted, given that the position of each element within
+  //   the matrix products may differ between the two paths
+  auto compare = [&](const matrix_type &a, const matrix_type &b, const std::string &msg) {
+    if (a.rows() != b.rows() || a.cols() != b.cols()) {
+      failed_tests.push_back(msg + ": dimensions differ");
+      return;
+    }
+    for (ssize_t col = 0; col != a.cols(); ++col) {
+      for (ssize_t row = 0; row != a.rows(); ++row) {
+        const default_type x = a(row, col), y = b(row, col);
+        if (std::abs(x - y) > 1e-9 * std::max({std::abs(x), std::abs(y), default_type(1)})) {
+          failed_tests.push_back(msg + ": element " + str(row) + ", hypothesis " + str(col) + " (" + str(x) +
+                                 " vs " + str(y) + ")");
+          return;
+        }
+      }
+    }
+  };
+
+  auto test = [&](const TestBase &glm, const std::string &name) {
+    std::vector<matrix_type> block_stats, block_zstats;
+    glm(shuffles, block_stats, block_zstats);
+    if (block_stats.size() != shuffles.size() || block_zstats.size() != shuffles.size()) {
+      failed_tests.push_back(name + ": incorrect number of outputs for block of shuffles");
+      return;
+    }
+    matrix_type stats, zstats;
+    for (size_t k = 0; k != shuffles.size(); ++k) {
+      glm(shuffles[k], stats, zstats);
+      compare(block_stats[k], stats, name + ", shuffle " + str(k) + ", statistic");
+      compare(block_zstats[k], zstats, name + ", shuffle " + str(k) + ", Z-statistic");
+    }
+  };
+
+  test(TestFixedHomoscedastic(measurements, design, hypotheses), "Homoscedastic");
+  test(TestFixedHeteroscedastic(measurements, design, hypotheses, variance_groups), "Heteroscedastic");
+
+  if (!failed_tests.empty()) {
+    Exception e(str(failed_tests.size()) + " tests of GLM block processing failed:");
+    for (auto s : failed_tests)
+      e.push_back(s);
+    throw e;
+  }
+}
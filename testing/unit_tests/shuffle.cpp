@@ -67,7 +67,7 @@ void run() {
     Shuffle shuffle;
     Eigen::Array<int, Eigen::Dynamic, 1> shuffled_data;
     while (in(shuffle)) {
-      shuffled_data = (shuffle.data * dummy_data.matrix()).cast<int>();
+      shuffled_data = (shuffle.matrix() * dummy_data.matrix()).cast<int>();
       for (size_t i = 0; i != ROWS; ++i) {
         if (block_indices[std::abs(shuffled_data[i]) - 1] != block_indices[i]) {
           failed_tests.push_back(msg);
@@ -82,7 +82,7 @@ void run() {
     Shuffle shuffle;
     Eigen::Array<int, Eigen::Dynamic, 1> shuffled_data;
     while (in(shuffle)) {
-      shuffled_data = (shuffle.data * dummy_data.matrix()).cast<int>();
+      shuffled_data = (shuffle.matrix() * dummy_data.matrix()).cast<int>();
       for (const auto &b : blocks) {
         // Ensure that either all values in the block have been flipped,
         //   or none have been flipped
@@ -103,7 +103,7 @@ void run() {
     Shuffle shuffle;
     Eigen::Array<int, Eigen::Dynamic, 1> shuffled_data;
     while (in(shuffle)) {
-      shuffled_data = (shuffle.data * dummy_data.matrix()).cast<int>();
+      shuffled_data = (shuffle.matrix() * dummy_data.matrix()).cast<int>();
       for (const auto &b1 : blocks) {
         // Only test each block once; use the first index within the block
         const size_t first_in = *b1.begin();
@@ -136,7 +136,7 @@ void run() {
       for (const auto &previous : matrices) {
         if (temp.index == previous.index)
           duplicate_index = true;
-        if (temp.data == previous.data)
+        if ((temp.permutation == previous.permutation).all() && (temp.sign == previous.sign).all())
           duplicate_data = true;
         matrices.push_back(temp);
       }
@@ -147,6 +147,20 @@ void run() {
       failed_tests.push_back(msg + " (duplicate shuffle matrix data)");
   };
 
+  auto test_apply = [&](Shuffler &in, const std::string &msg) {
+    in.reset();
+    Shuffle shuffle;
+    vector_type gathered, expected;
+    while (in(shuffle)) {
+      shuffle.apply(dummy_data, gathered);
+      expected = (shuffle.matrix() * dummy_data.matrix()).array();
+      if (!(gathered == expected).all()) {
+        failed_tests.push_back(msg);
+        return;
+      }
+    }
+  };
+
   auto test_kernel = [&](const size_t requested_number,
                          const size_t expected_number,
                          const Shuffler::error_t error_type,
@@ -168,6 +182,7 @@ void run() {
       if (error_type == Shuffler::error_t::ISE || error_type == Shuffler::error_t::BOTH)
         test_signflip_whole(temp, "Broken whole-block sign-flipping; " + error_string + "; " + test_string);
     }
+    test_apply(temp, "Shuffle application inconsistent with shuffling matrix; " + error_string + "; " + test_string);
     if (test_uniqueness)
       test_unique(temp, "Bad shuffles; " + error_string + "; " + eb_string + "; " + test_string);
   };
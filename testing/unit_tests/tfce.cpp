@@ -0,0 +1,161 @@
+/* Copyright (c) 2008-2024 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include <random>
+
+#include "command.h"
+#include "exception.h"
+#include "header.h"
+#include "types.h"
+
+#include "connectome/enhance.h"
+#include "filter/connected_components.h"
+#include "math/stats/typedefs.h"
+#include "misc/voxel2vector.h"
+#include "stats/cluster.h"
+#include "stats/tfce.h"
+
+using namespace MR;
+using namespace App;
+using Math::Stats::matrix_type;
+using Math::Stats::value_type;
+using Math::Stats::vector_type;
+
+#define GRID_SIZE 16
+#define NUM_NODES 24
+#define NUM_CONTRASTS 3
+
+// clang-format off
+void usage() {
+  AUTHOR = "MRtrix3 contributors";
+  SYNOPSIS = "Verify that single-pass TFCE integration matches explicit integration across thresholds";
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+}
+// clang-format on
+
+void run() {
+  std::vector<std::string> failed_tests;
+  std::mt19937 rng(42);
+  std::normal_distribution<value_type> normal;
+
+  // Relative difference permitted, given the differing order of summation
+  auto compare = [&](const vector_type &a, const vector_type &b, const std::string &msg) {
+    for (ssize_t i = 0; i != a.size(); ++i) {
+      if (std::abs(a[i] - b[i]) > 1e-9 * std::max({std::abs(a[i]), std::abs(b[i]), value_type(1)})) {
+        failed_tests.push_back(msg + ": element " + str(i) + " (" + str(a[i]) + " vs " + str(b[i]) + ")");
+        return;
+      }
+    }
+  };
+
+  auto tfce = [](const Stats::TFCE::Wrapper &wrapper, const matrix_type &input) {
+    matrix_type output(input.rows(), input.cols());
+    static_cast<const Stats::EnhancerBase &>(wrapper)(input, output);
+    return output;
+  };
+
+  // Image domain: spatially smooth random data, so that non-trivial clusters form
+  const Header header = [] {
+    Header H;
+    H.ndim() = 3;
+    for (size_t axis = 0; axis != 3; ++axis) {
+      H.size(axis) = GRID_SIZE;
+      H.spacing(axis) = 1.0;
+      H.stride(axis) = axis + 1;
+    }
+    H.transform().setIdentity();
+    H.datatype() = DataType::Float32;
+    return H;
+  }();
+  const Voxel2Vector v2v(header);
+  const size_t num_voxels = v2v.size();
+
+  const matrix_type noise = matrix_type::NullaryExpr(num_voxels, NUM_CONTRASTS, [&]() { return normal(rng); });
+  matrix_type voxel_data(matrix_type::Zero(num_voxels, NUM_CONTRASTS));
+  for (size_t i = 0; i != num_voxels; ++i) {
+    const auto &pos = v2v[i];
+    size_t count = 0;
+    for (int dx = -1; dx <= 1; ++dx) {
+      for (int dy = -1; dy <= 1; ++dy) {
+        for (int dz = -1; dz <= 1; ++dz) {
+          const std::vector<int> neighbour{int(pos[0]) + dx, int(pos[1]) + dy, int(pos[2]) + dz};
+          const auto j = v2v(neighbour);
+          if (j != Voxel2Vector::invalid) {
+            voxel_data.row(i) += noise.row(j);
+            ++count;
+          }
+        }
+      }
+    }
+    voxel_data.row(i) *= 4.0 / std::sqrt(value_type(count));
+  }
+
+  for (const bool use_26_neighbours : {false, true}) {
+    Filter::Connector connector;
+    connector.adjacency.set_26_adjacency(use_26_neighbours);
+    connector.adjacency.initialise(header, v2v);
+    const std::string connectivity = use_26_neighbours ? "26-connectivity" : "6-connectivity";
+
+    for (const auto &parameters : std::vector<std::array<value_type, 3>>{{0.1, 0.5, 2.0}, {0.05, 1.0, 1.0}}) {
+      const value_type dH = parameters[0], E = parameters[1], H = parameters[2];
+      Stats::TFCE::Wrapper wrapper(std::make_shared<Stats::Cluster::ClusterSize>(connector, 0.0), dH, E, H);
+      const matrix_type result = tfce(wrapper, voxel_data);
+      for (ssize_t col = 0; col != voxel_data.cols(); ++col) {
+        // Explicit integration, performing connected-component labelling at each threshold
+        const auto in = std::as_const(voxel_data).col(col);
+        vector_type expected = vector_type::Zero(num_voxels);
+        for (value_type h = dH; (h - dH) < in.maxCoeff(); h += dH) {
+          std::vector<Filter::Connector::Cluster> clusters;
+          std::vector<uint32_t> labels(num_voxels, 0);
+          connector.run(clusters, labels, in, h);
+          for (size_t i = 0; i != num_voxels; ++i)
+            expected[i] += std::pow(labels[i] ? clusters[labels[i] - 1].size : 0.0, E) * std::pow(h, H);
+        }
+        compare(result.col(col).array(),
+                expected,
+                "Voxel-wise TFCE; " + connectivity + "; dH=" + str(dH, 2) + ", E=" + str(E, 2) + ", H=" + str(H, 2));
+      }
+    }
+  }
+
+  // Connectome domain
+  {
+    const Connectome::Enhance::NBS nbs(NUM_NODES);
+    const size_t num_edges = NUM_NODES * (NUM_NODES + 1) / 2;
+    const matrix_type edge_data =
+        matrix_type::NullaryExpr(num_edges, NUM_CONTRASTS, [&]() { return 2.0 + normal(rng); });
+    const value_type dH = 0.1, E = 0.4, H = 3.0;
+    Stats::TFCE::Wrapper wrapper(std::make_shared<Connectome::Enhance::NBS>(nbs), dH, E, H);
+    const matrix_type result = tfce(wrapper, edge_data);
+    matrix_type extent(num_edges, 1);
+    for (ssize_t col = 0; col != edge_data.cols(); ++col) {
+      const auto in = edge_data.col(col);
+      vector_type expected = vector_type::Zero(num_edges);
+      for (value_type h = dH; (h - dH) < in.maxCoeff(); h += dH) {
+        nbs(in, h, extent.col(0));
+        expected += extent.col(0).array().pow(E) * std::pow(h, H);
+      }
+      compare(result.col(col).array(), expected, "Connectome TFCE");
+    }
+  }
+
+  if (!failed_tests.empty()) {
+    Exception e(str(failed_tests.size()) + " tests of single-pass TFCE integration failed:");
+    for (auto s : failed_tests)
+      e.push_back(s);
+    throw e;
+  }
+}